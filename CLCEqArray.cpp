@@ -0,0 +1,451 @@
+/*****************************************************************************
+*  CLCEqArray.cpp                                       CSIVM LaserCanvas
+*  Array variables and the reductions sum, mean, rms, norm and dot
+*  Class declaration in CLCEqtn.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* DoEquationArray(..) evaluates an equation in which some variables are ar-
+* rays of iNumElem elements rather than single values, e.g.
+*
+*    g * rms(v - mean(v))                   // AC amplitude of signal v
+*    dot(w, x) / sum(w)                     // weighted average
+*
+* Variables are bound by an EQBIND each, as for DoEquationBound(..): one with
+* a stride is an array, one with stride 0 a single value. Arrays may only be
+* used inside the argument of a reduction, which is evaluated element by ele-
+* ment and reduced to a single value:
+*
+*    sum(x)    x[0] + x[1] + ..             mean(x)   sum(x) / n
+*    norm(x)   sqrt(sum(x^2))               rms(x)    sqrt(sum(x^2) / n)
+*    dot(x,y)  sum(x * y)
+*
+* A single value is an array of one element, so sum(3) is 3 and DoEquation(..)
+* evaluates the reductions this way. In dot(..), a single value paired with
+* an array is used for every element. The answer of a reduction has the di-
+* mension of its argument (dot: of the product).
+*
+* The first call splits the program at its reductions into one program per
+* argument, in which reductions nested inside it are extra variables, and one
+* program for the rest; this is kept until a new program is parsed. Reductions
+* are evaluated innermost first. Each argument runs through the batch kernel
+* (see CLCEqBatch.cpp) a chunk of elements at a time, and is summed while the
+* chunk is in cache. An argument that is just a double array bound with
+* stride sizeof(double) is summed where it is, without being copied.
+*
+* Summation
+* ---------
+* By default every chunk is summed into 8 partial sums, which the compiler can
+* keep in vector registers; rounding errors grow at most like n (in practice
+* like sqrt(n)). With uFlags
+*    EQBATCH_SUMPAIRWISE  blocks of 128 are summed so, then added in pairs,
+*                         pairs of pairs, ..: errors grow like log(n), at
+*                         nearly the same speed.
+*    EQBATCH_SUMKAHAN     every element is added with compensation (Neumaier):
+*                         the error does not grow with n, but the sum runs
+*                         element by element, several times slower.
+* The sums are portable C++; no instruction set specific intrinsics are used.
+*
+* Usage Example
+* -------------
+*    EQBIND Bind[2] = { { pdSignal, sizeof(double), EQBIND_DOUBLE },  // v
+*                       { &dGain,   0,              EQBIND_DOUBLE } }; // g
+*    Eq.ParseEquation("g * rms(v - mean(v))", "v\0g\0");
+*    if(Eq.DoEquationArray(Bind, iNumSamples, &dAns) != EQERR_NONE) ..
+*
+* Errors are those of DoEquationBound(..), with the position in the source
+* string of the first failing element; mean(..) and rms(..) of no elements
+* are a division by zero, and an array outside any reduction is reported as
+* EQERR_EVAL_ARRAYNOTREDUCED.
+******************************************************************************/
+#include "CLCEqtn.h"                        // header file and definitions
+#include <stdlib.h>                         // malloc, calloc, free
+#include <string.h>                         // memset
+#include <math.h>                           // sqrt
+
+#define EQARRAY_CHUNK              1024     // elements evaluated and summed together
+#define EQARRAY_BLOCK               128     // elements per block of pairwise summation
+#define EQARRAY_NUMACC                8     // partial sums
+#define EQARRAY_MAXLEVEL             48     // levels of pairwise summation (2^48 blocks)
+
+//===Plan=================================================
+typedef struct tagEQREDUCE {
+   int        iOp;                          // OP_NARG_ code
+   int        iArgc;                        // 1, or 2 for dot(..)
+   int        iFirst;                       // first token of the arguments
+   int        iPt;                          // token of the reduction
+   CEquation *pEqArg[2];                    // program of each argument
+} EQREDUCE;
+
+struct tagEQARRAYPLAN {
+   int        iNumVar;                      // variables of the parsed program
+   int        iNumReduce;                   // reductions, innermost first
+   EQREDUCE  *pReduce;                      // iNumReduce entries
+   CEquation *pEqMain;                      // program with reductions as variables
+   UNITBASE  *puUnit;                       // dimension of variables, then of reductions
+};
+
+//===Sums=================================================
+// Running sum of the terms of one reduction in the manner
+// of the EQBATCH_SUM flags.
+typedef struct tagEQARRAYSUM {
+   double dAcc[EQARRAY_NUMACC];             // partial sums
+   double dComp;                            // compensation (EQBATCH_SUMKAHAN)
+   double dLevel[EQARRAY_MAXLEVEL];         // pending pairwise sums
+   unsigned long long ullBlocks;            // blocks added (bit k: dLevel[k] in use)
+   UINT   uMode;                            // EQBATCH_SUM flag, or 0
+} EQARRAYSUM;
+
+//---Partial sums-------------------------------
+// Adds n terms into the EQARRAY_NUMACC partial sums.
+static void _EqArrayAcc(double *pdAcc, const double *pd, int n) {
+   double s0=pdAcc[0], s1=pdAcc[1], s2=pdAcc[2], s3=pdAcc[3];
+   double s4=pdAcc[4], s5=pdAcc[5], s6=pdAcc[6], s7=pdAcc[7];
+   int    i;                                // element
+   for(i=0; i+EQARRAY_NUMACC<=n; i+=EQARRAY_NUMACC) {
+      s0 += pd[i];   s1 += pd[i+1]; s2 += pd[i+2]; s3 += pd[i+3];
+      s4 += pd[i+4]; s5 += pd[i+5]; s6 += pd[i+6]; s7 += pd[i+7];
+   }
+   for(; i<n; i++) s0 += pd[i];
+   pdAcc[0]=s0; pdAcc[1]=s1; pdAcc[2]=s2; pdAcc[3]=s3;
+   pdAcc[4]=s4; pdAcc[5]=s5; pdAcc[6]=s6; pdAcc[7]=s7;
+}
+
+static double _EqArrayAccTotal(const double *pdAcc) {
+   return(((pdAcc[0] + pdAcc[1]) + (pdAcc[2] + pdAcc[3])) + ((pdAcc[4] + pdAcc[5]) + (pdAcc[6] + pdAcc[7])));
+}
+
+//---Add----------------------------------------
+static void _EqArraySumAdd(EQARRAYSUM *pSum, const double *pd, int n) {
+   double dAcc[EQARRAY_NUMACC];             // sums of one block
+   double dBlock, t, s;                     // block sum, compensated sum
+   int    i, k, iLen;                       // element, level, block length
+
+   switch(pSum->uMode) {
+   case EQBATCH_SUMKAHAN:
+      for(s=pSum->dAcc[0], i=0; i<n; i++) {
+         t = s + pd[i];
+         pSum->dComp += (fabs(s) >= fabs(pd[i])) ? (s - t) + pd[i] : (pd[i] - t) + s;
+         s = t;
+      }
+      pSum->dAcc[0] = s;
+      break;
+
+   case EQBATCH_SUMPAIRWISE:
+      for(i=0; i<n; i+=EQARRAY_BLOCK) {
+         iLen = MIN(EQARRAY_BLOCK, n-i);
+         memset(dAcc, 0, sizeof(dAcc));
+         _EqArrayAcc(dAcc, pd+i, iLen);
+         dBlock = _EqArrayAccTotal(dAcc);
+         for(k=0; (k<EQARRAY_MAXLEVEL-1) && (pSum->ullBlocks & (1ULL<<k)); k++)
+            dBlock += pSum->dLevel[k];      // merge equal levels, as a binary counter
+         pSum->dLevel[k] = dBlock;
+         pSum->ullBlocks++;
+      }
+      break;
+
+   default:
+      _EqArrayAcc(pSum->dAcc, pd, n);
+      break;
+   }
+}
+
+//---Total--------------------------------------
+static double _EqArraySumTotal(const EQARRAYSUM *pSum) {
+   double dSum = 0.00;                      // total
+   int    k;                                // level
+   switch(pSum->uMode) {
+   case EQBATCH_SUMKAHAN:
+      return(pSum->dAcc[0] + pSum->dComp);
+   case EQBATCH_SUMPAIRWISE:
+      for(k=0; k<EQARRAY_MAXLEVEL; k++)     // smallest levels first
+         if(pSum->ullBlocks & (1ULL<<k)) dSum += pSum->dLevel[k];
+      return(dSum);
+   default:
+      return(_EqArrayAccTotal(pSum->dAcc));
+   }
+}
+
+//---Reduction----------------------------------
+static BOOL _EqIsReduction(const VALOP *pvo) {
+   return((pvo->uTyp == VOTYP_OP) && (pvo->uOp >= OP_NARG+OP_NARG_SUM) && (pvo->uOp <= OP_NARG+OP_NARG_DOT));
+}
+
+/*********************************************************
+* _BuildArrayPlan                                 Private
+* Splits the program at its reductions (see the top of
+* this file). The operands of a token are found from the
+* stack heights: the operand ending at token t starts after
+* the last earlier token leaving the stack lower than t.
+* Reduction j becomes variable iNumVar+j of the programs
+* that use its answer; its dimension is found by analysing
+* its argument programs, innermost first. Returns FALSE,
+* with iError set, if out of memory.
+*********************************************************/
+BOOL CEquation::_BuildArrayPlan(void) {
+   EQARRAYPLAN *pPlan;                      // plan being built
+   EQREDUCE    *pRed;                       // reduction being split
+   int         *piHgt;                      // stack height after each token
+   int          iStart[2], iEnd[2];         // token ranges of the arguments
+   int          iPt, j, k, t;               // tokens, reductions, arguments
+
+   piHgt = _StackHeights();
+   pPlan = (EQARRAYPLAN*) calloc(1, sizeof(EQARRAYPLAN));
+   if((piHgt == NULL) || (pPlan == NULL)) {
+      if(piHgt) free(piHgt);
+      if(pPlan) free(pPlan);
+      iError = EQERR_PARSE_ALLOCFAIL;
+      return(FALSE);
+   }
+   m_pArray = pPlan;
+
+   //---Count------------------------------------
+   for(iPt=0; iPt<iEqnLength; iPt++) {
+      if(pvoEquation[iPt].uTyp == VOTYP_REF) pPlan->iNumVar = MAX(pPlan->iNumVar, pvoEquation[iPt].iRef+1);
+      if(_EqIsReduction(&pvoEquation[iPt])) pPlan->iNumReduce++;
+   }
+   pPlan->puUnit  = (UNITBASE*) calloc(pPlan->iNumVar + pPlan->iNumReduce + 1, sizeof(UNITBASE));
+   pPlan->pReduce = (EQREDUCE*) calloc(pPlan->iNumReduce + 1, sizeof(EQREDUCE));
+   if((pPlan->puUnit == NULL) || (pPlan->pReduce == NULL)) goto AllocFail;
+
+   //---Operands---------------------------------
+   for(j=0, iPt=0; iPt<iEqnLength; iPt++) {
+      if(!_EqIsReduction(&pvoEquation[iPt])) continue;
+      pRed = &pPlan->pReduce[j++];
+      pRed->iOp   = pvoEquation[iPt].uOp - OP_NARG;
+      pRed->iArgc = CEquationNArgOpArgc[pRed->iOp];
+      pRed->iPt   = iPt;
+      for(t=iPt-1, k=pRed->iArgc-1; k>=0; k--) {
+         iEnd[k] = t;
+         for(t--; (t>=0) && (piHgt[t]>=piHgt[iEnd[k]]); t--) ;
+         iStart[k] = t+1;
+      }
+      pRed->iFirst = iStart[0];
+
+      //---Programs, innermost first----------
+      for(k=0; k<pRed->iArgc; k++) {
+         if((pRed->pEqArg[k] = _ArrayProgram(iStart[k], iEnd[k], FALSE)) == NULL) goto AllocFail;
+         pRed->pEqArg[k]->_AnalyzeProgram();
+      }
+      pPlan->puUnit[pPlan->iNumVar + j-1] = pRed->pEqArg[0]->m_uUnitStatic;
+      if(pRed->iOp == OP_NARG_DOT)
+         EqDimMul(pRed->pEqArg[0]->m_uUnitStatic, pRed->pEqArg[1]->m_uUnitStatic, &pPlan->puUnit[pPlan->iNumVar + j-1]);
+   }
+
+   //---Rest-------------------------------------
+   if(pPlan->iNumReduce > 0)
+      if((pPlan->pEqMain = _ArrayProgram(0, iEqnLength-1, TRUE)) == NULL) goto AllocFail;
+   free(piHgt);
+   return(TRUE);
+
+AllocFail:
+   free(piHgt);
+   _FreeArrayPlan();
+   iError = EQERR_PARSE_ALLOCFAIL;
+   return(FALSE);
+}
+
+//---Free---------------------------------------
+void CEquation::_FreeArrayPlan(void) {
+   EQARRAYPLAN *pPlan = m_pArray;           // plan to free
+   m_pArray = NULL;
+   if(pPlan == NULL) return;
+   if(pPlan->pReduce) {
+      for(int j=0; j<pPlan->iNumReduce; j++) {
+         if(pPlan->pReduce[j].pEqArg[0]) delete(pPlan->pReduce[j].pEqArg[0]);
+         if(pPlan->pReduce[j].pEqArg[1]) delete(pPlan->pReduce[j].pEqArg[1]);
+      }
+      free(pPlan->pReduce);
+   }
+   if(pPlan->pEqMain) delete(pPlan->pEqMain);
+   if(pPlan->puUnit) free(pPlan->puUnit);
+   free(pPlan);
+}
+
+//---Sub-program--------------------------------
+// Copy of tokens iStart..iEnd, in which every outermost
+// reduction is replaced by its variable. The copy has the
+// same source string, so error positions stay valid, and
+// the target unit only if tfTarget. NULL if out of memory.
+CEquation *CEquation::_ArrayProgram(int iStart, int iEnd, BOOL tfTarget) {
+   EQARRAYPLAN *pPlan = m_pArray;           // plan being built
+   CEquation   *pEq;                        // new program
+   VALOP        vo;                         // replacement of a reduction
+   int          iPt, iLen, j, jOuter;       // tokens, reductions
+
+   pEq = new CEquation;
+   if((pEq == NULL) || (pEq->_CopyProgram(this) != EQERR_NONE)) {
+      if(pEq) delete(pEq);
+      return(NULL);
+   }
+   for(iLen=0, iPt=iStart; iPt<=iEnd; iPt++) {
+      for(jOuter=-1, j=0; (j<pPlan->iNumReduce) && (pPlan->pReduce[j].pEqArg[0]); j++) // those built so far
+         if((pPlan->pReduce[j].iFirst == iPt) && (pPlan->pReduce[j].iPt <= iEnd)) jOuter = j;
+      if(jOuter < 0) { pEq->pvoEquation[iLen++] = pvoEquation[iPt]; continue; }
+      vo.iRef = pPlan->iNumVar + jOuter;
+      vo.iPos = pvoEquation[pPlan->pReduce[jOuter].iPt].iPos;
+      vo.uTyp = VOTYP_REF;
+      pEq->pvoEquation[iLen++] = vo;
+      iPt = pPlan->pReduce[jOuter].iPt;     // skip the reduction
+   }
+   pEq->iEqnLength  = iLen;
+   pEq->m_puRefUnit = pPlan->puUnit;
+   if(!tfTarget) {
+      pEq->m_uUnitTarget.u = 0;
+      pEq->m_dScleTarget   = 0.00;
+      pEq->m_dOffsTarget   = 0.00;
+      pEq->m_szUnit[0]     = '\0';
+   }
+   return(pEq);
+}
+
+/*********************************************************
+* DoEquationArray
+* Evaluates the equation with array variables, reduced by
+* sum(..), mean(..), rms(..), norm(..) and dot(..); see the
+* top of this file. pBind has one entry per variable of
+* the parsed variable list; an entry with a stride is an
+* array of iNumElem elements. uFlags are EQBATCH_ flags,
+* including the EQBATCH_SUM flags. The answer, its unit
+* and any error are left as by DoEquation(..).
+*********************************************************/
+int CEquation::DoEquationArray(const EQBIND pBind[], int iNumElem, double *pdAns, UINT uFlags) {
+   EQARRAYPLAN *pPlan;                      // split program
+   EQREDUCE    *pRed;                       // reduction being evaluated
+   CEquation   *pEq;                        // program being evaluated
+   EQBIND      *pBindChunk;                 // variables of a chunk
+   EQARRAYSUM   Sum;                        // running sum
+   double      *pdVal;                      // values of single variables and reductions
+   double      *pdBuf;                      // answers of a chunk, two arguments
+   const double *pa, *pb;                   // terms of a chunk
+   int          iNumVar, iNumExt;           // variables, with reductions
+   int          iElem, iLen, n;             // elements of a chunk, of a reduction
+   int          iPt, j, k, iErr;            // tokens, reductions, arguments
+   BOOL         tfArray[2];                 // argument uses an array
+   BOOL         tfInPlace[2];               // argument is a double array read in place
+
+   if((iEqnLength <= 0) || (pvoEquation == NULL)) return(iError=EQERR_EVAL_NOEQUATION);
+   for(iPt=0; iPt<iEqnLength; iPt++)
+      if((pvoEquation[iPt].uTyp == VOTYP_OP) && (pvoEquation[iPt].uOp == OP_SET))
+         return(iError=EQERR_EVAL_ASSIGNNOTALLOWED);
+   if((m_pArray == NULL) && !_BuildArrayPlan()) return(iError);
+   pPlan   = m_pArray;
+   iNumVar = pPlan->iNumVar;
+   iNumExt = iNumVar + pPlan->iNumReduce;
+   if((pBind == NULL) && (iNumVar > 0)) return(iError=EQERR_EVAL_CONTAINSVAR);
+   if(iNumElem < 0) iNumElem = 0;
+
+   //---Scratch----------------------------------
+   pdVal = (double*) malloc((iNumExt + 2*EQARRAY_CHUNK + 1) * sizeof(double) + (iNumExt + 1) * sizeof(EQBIND));
+   if(pdVal == NULL) return(iError=EQERR_PARSE_ALLOCFAIL);
+   pdBuf      = pdVal + iNumExt + 1;
+   pBindChunk = (EQBIND*) (pdBuf + 2*EQARRAY_CHUNK);
+   for(k=0; k<iNumVar; k++)
+      pdVal[k] = (pBind[k].uStride) ? 0.00 : EqBindValue(&pBind[k], 0);
+   for(k=iNumVar; k<iNumExt; k++) {
+      pBindChunk[k].pBase   = &pdVal[k];    // reductions are single values
+      pBindChunk[k].uStride = 0;
+      pBindChunk[k].iType   = EQBIND_DOUBLE;
+   }
+
+   //---Reductions, innermost first--------------
+   for(iErr=EQERR_NONE, j=0; (j<pPlan->iNumReduce) && (iErr==EQERR_NONE); j++) {
+      pRed = &pPlan->pReduce[j];
+      for(n=1, k=0; k<pRed->iArgc; k++) {
+         pEq = pRed->pEqArg[k];
+         tfArray[k] = tfInPlace[k] = FALSE;
+         for(iPt=0; iPt<pEq->iEqnLength; iPt++)
+            if((pEq->pvoEquation[iPt].uTyp == VOTYP_REF) && (pEq->pvoEquation[iPt].iRef < iNumVar)
+               && (pBind[pEq->pvoEquation[iPt].iRef].uStride != 0)) tfArray[k] = TRUE;
+         if(tfArray[k]) n = iNumElem;       // single values are used for every element
+         iPt = pEq->pvoEquation[0].iRef;
+         tfInPlace[k] = tfArray[k] && (pEq->iEqnLength == 1) && (pBind[iPt].iType == EQBIND_DOUBLE)
+                        && (pBind[iPt].uStride == sizeof(double));
+      }
+
+      memset(&Sum, 0, sizeof(Sum));
+      Sum.uMode = uFlags & (EQBATCH_SUMPAIRWISE | EQBATCH_SUMKAHAN);
+      if(Sum.uMode == (EQBATCH_SUMPAIRWISE | EQBATCH_SUMKAHAN)) Sum.uMode = EQBATCH_SUMKAHAN;
+      for(iElem=0; (iElem<n) && (iErr==EQERR_NONE); iElem+=iLen) {
+         iLen = MIN(EQARRAY_CHUNK, n-iElem);
+         for(k=0; k<iNumVar; k++) {         // variables from element iElem
+            pBindChunk[k] = pBind[k];
+            pBindChunk[k].pBase = (const char*) pBind[k].pBase + (size_t) iElem * pBind[k].uStride;
+         }
+         pa = pb = NULL;
+         for(k=0; (k<pRed->iArgc) && (iErr==EQERR_NONE); k++) {
+            pEq = pRed->pEqArg[k];
+            if(tfInPlace[k]) {
+               pb = (const double*) pBindChunk[pEq->pvoEquation[0].iRef].pBase;
+            } else {
+               iErr = pEq->DoEquationBound(pBindChunk, iLen, pdBuf + k*EQARRAY_CHUNK, NULL, uFlags & ~(EQBATCH_SUMPAIRWISE | EQBATCH_SUMKAHAN));
+               if(iErr != EQERR_NONE) iErrorLocation = pEq->iErrorLocation;
+               pb = pdBuf + k*EQARRAY_CHUNK;
+            }
+            if(k == 0) pa = pb;
+         }
+         if(iErr != EQERR_NONE) break;
+
+         //---Terms-----------------------------
+         switch(pRed->iOp) {
+         case OP_NARG_RMS:
+         case OP_NARG_NORM:
+            for(k=0; k<iLen; k++) pdBuf[k] = pa[k] * pa[k];
+            pa = pdBuf;
+            break;
+         case OP_NARG_DOT:
+            for(k=0; k<iLen; k++) pdBuf[k] = pa[k] * pb[k];
+            pa = pdBuf;
+            break;
+         }
+         _EqArraySumAdd(&Sum, pa, iLen);
+      }
+      if(iErr != EQERR_NONE) break;
+
+      //---Result----------------------------
+      pdVal[iNumVar+j] = _EqArraySumTotal(&Sum);
+      switch(pRed->iOp) {
+      case OP_NARG_MEAN:
+      case OP_NARG_RMS:
+         if(n == 0) {
+            iErr = EQERR_MATH_DIV_ZERO;
+            iErrorLocation = pvoEquation[pRed->iPt].iPos;
+            break;
+         }
+         pdVal[iNumVar+j] /= (double) n;
+         if(pRed->iOp == OP_NARG_RMS) pdVal[iNumVar+j] = sqrt(pdVal[iNumVar+j]);
+         break;
+      case OP_NARG_NORM:
+         pdVal[iNumVar+j] = sqrt(pdVal[iNumVar+j]);
+         break;
+      }
+   }
+
+   //---Rest of the equation---------------------
+   if(iErr == EQERR_NONE) {
+      for(iPt=0; iPt<iEqnLength; iPt++) {   // arrays only inside reductions
+         for(j=0; (j<pPlan->iNumReduce) && ((iPt<pPlan->pReduce[j].iFirst) || (iPt>pPlan->pReduce[j].iPt)); j++) ;
+         if((j == pPlan->iNumReduce) && (pvoEquation[iPt].uTyp == VOTYP_REF) && (pBind[pvoEquation[iPt].iRef].uStride != 0)) {
+            iErr = EQERR_EVAL_ARRAYNOTREDUCED;
+            iErrorLocation = pvoEquation[iPt].iPos;
+            break;
+         }
+      }
+   }
+   if(iErr == EQERR_NONE) {
+      if(pPlan->pEqMain == NULL) {
+         iErr = DoEquation(pdVal, pdAns);
+      } else {
+         pEq  = pPlan->pEqMain;
+         iErr = pEq->DoEquation(pdVal, pdAns);
+         iErrorLocation     = pEq->iErrorLocation;
+         m_uUnitAns         = pEq->m_uUnitAns;
+         m_tfUnitAnsDerived = pEq->m_tfUnitAnsDerived;
+         m_tfUnitStale      = pEq->m_tfUnitStale;
+         memcpy(m_szUnit, pEq->m_szUnit, sizeof(m_szUnit));
+      }
+   }
+   free(pdVal);
+   return(iError=iErr);
+}
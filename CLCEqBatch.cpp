@@ -0,0 +1,1143 @@
+/*****************************************************************************
+*  CLCEqBatch.cpp                                       CSIVM LaserCanvas
+*  Batch evaluation of CEquation programs and unit conversion of arrays
+*  Class declaration in CLCEqtn.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* DoEquation(..) evaluates one set of variables at a time, checking the units
+* of every operation on the way. When the same equation is applied to many
+* rows of data, DoEquationBatch(..) does the same work column by column:
+*
+*  - The units of a program do not depend on the variable values (variables
+*    are dimensionless), so they are checked once by _AnalyzeProgram() when
+*    the equation is parsed, including the dimension of a "#" target unit.
+*  - Rows are processed in chunks of EQBATCH_CHUNK. Each operation runs as a
+*    simple loop over the chunk that the compiler can vectorize, and the tar-
+*    get unit conversion is applied in the same loop that stores the answers.
+*  - Math errors (division by zero, log of negative numbers, ..) are flagged
+*    per row. Flagged rows are evaluated again by DoEquation(..), so that
+*    answers and error codes are exactly those of the single-row call. With
+*    EQBATCH_UNCHECKED, the checks are skipped and only rows with an inf or
+*    NaN answer are evaluated again.
+*  - With EQBATCH_FASTMATH or EQBATCH_FASTMATH_HIGH, exp, log, the trig func-
+*    tions and tanh use the polynomial kernels of CLCEqFast.cpp instead of
+*    libm. Rows evaluated again by DoEquation(..) use libm.
+*
+* A few programs have units that do depend on the values, e.g. x m ^ y or
+* if(x, 1 m, 2 s). These, and programs that fail the unit check outright,
+* are evaluated row by row with DoEquation(..).
+*
+* Usage Example
+* -------------
+*    const double *pdCol[2] = { dX, dY };   // one array per variable
+*    int iRow;                              // first row with an error
+*
+*    Eq.ParseEquation("x + sin(pi * y) m # mm", "x\0y\0");
+*    if(Eq.DoEquationBatch(pdCol, iNumRows, dAns, &iRow) != EQERR_NONE)
+*       ..                                  // rows before iRow are valid
+*
+* DoEquationBound(..) reads the variables where the application keeps them,
+* e.g. members of an array of structs, described by an EQBIND per variable:
+*
+*    EQBIND Bind[2] = { { &pBeam[0].w, sizeof(BEAM), EQBIND_DOUBLE },
+*                       { &pBeam[0].z, sizeof(BEAM), EQBIND_DOUBLE } };
+*    Eq.DoEquationBound(Bind, iNumBeams, dAns);
+*
+* DoEquationFilter(..) evaluates a condition, e.g. "T > 300 && p < 2e5",
+* and returns the rows where it holds as a bitmap and / or a list of row in-
+* dices, without storing answers. A chunk stops being evaluated as soon as
+* one operand of a top-level && is false in all its rows.
+*
+* ConvertUnits(..) applies the same scale and offset arithmetic to whole ar-
+* rays, e.g. ConvertUnits("degF", "K", dIn, dOut, n).
+******************************************************************************/
+#include "CLCEqtn.h"                        // header file and definitions
+#include "CLCEqFast.h"                      // approximate transcendentals
+#include <float.h>                          // FLT_MAX, DBL_MAX
+
+#define EQBATCH_CHUNK               256     // rows evaluated together
+#define EQBATCH_MAXSCALARVAR         64     // variables for DoEquation(float[], ..)
+#define EQBATCH_EXPMAX_DOUBLE    709.00     // largest argument of exp(..), as DoEquation(..)
+#define EQBATCH_EXPMAX_FLOAT      88.72     // the same for the float range
+
+//---Stack entry for analysis-------------------
+typedef struct tagEQBATCHUNIT {
+   UNITBASE uUnit;                          // dimension of entry
+   BOOL     tfConst;                        // value known at parse time
+   double   dVal;                           // value, if tfConst
+} EQBATCHUNIT;
+
+//---Stack entry for evaluation-----------------
+template<class T> struct TEqBatchSlot {
+   const T *pd;                             // values of this entry for the chunk
+   T       *pdBuf;                          // buffer owned by this stack level
+};
+
+/*********************************************************
+* Bound variables
+* EqBindValue returns row iRow of a bound variable.
+* _EqBindChunk returns rows iRow0.. iRow0+n-1 as an array
+* of T: the bound memory itself if it is already such an
+* array, else a copy in pd.
+*********************************************************/
+double EqBindValue(const EQBIND *pb, int iRow) {
+   const char *pc = (const char*) pb->pBase + (size_t) iRow * pb->uStride;
+   switch(pb->iType) {
+   case EQBIND_FLOAT: return((double) *(const float*) pc);
+   case EQBIND_INT32: return((double) *(const int*) pc);
+   default:           return(*(const double*) pc);
+   }
+}
+
+template<class T>
+static const T *_EqBindChunk(const EQBIND *pb, int iRow0, int n, T *pd) {
+   const char *pc = (const char*) pb->pBase + (size_t) iRow0 * pb->uStride;
+   size_t      uStride = pb->uStride;       // bytes per row
+   int         r;                           // row loop counter
+
+   switch(pb->iType) {
+   case EQBIND_FLOAT:
+      if((sizeof(T) == sizeof(float)) && (uStride == sizeof(float))) return((const T*) pc);
+      for(r=0; r<n; r++) pd[r] = (T) *(const float*) (pc + r*uStride);
+      break;
+   case EQBIND_INT32:
+      for(r=0; r<n; r++) pd[r] = (T) *(const int*) (pc + r*uStride);
+      break;
+   default:
+      if((sizeof(T) == sizeof(double)) && (uStride == sizeof(double))) return((const T*) pc);
+      for(r=0; r<n; r++) pd[r] = (T) *(const double*) (pc + r*uStride);
+      break;
+   }
+   return(pd);
+}
+
+/*********************************************************
+* Callbacks
+* _EqCallChunk evaluates a callback (see AddCallback(..))
+* over n rows of its argument slots into pd, flagging the
+* rows that fail. A batch function, in double, gets the
+* argument columns as they are; otherwise the function is
+* called row by row from here.
+*********************************************************/
+template<class T>
+static void _EqCallChunk(const EQCALLBACK *pc, const TEqBatchSlot<T> *pArg, int n, T pd[], unsigned char ucBad[]) {
+   double dArg[EQCALLBACK_MAXARG];          // arguments of one row
+   int    r, k;                             // row, argument
+   int    iErr;                             // failure of the row
+   for(r=0; r<n; r++) {
+      for(k=0; k<pc->iArgc; k++) dArg[k] = (double) pArg[k].pd[r];
+      iErr  = EQERR_NONE;
+      pd[r] = (T) pc->pfn(dArg, pc->pUser, &iErr);
+      if(iErr != EQERR_NONE) ucBad[r] = 1;
+   }
+}
+
+static void _EqCallChunk(const EQCALLBACK *pc, const TEqBatchSlot<double> *pArg, int n, double pd[], unsigned char ucBad[]) {
+   const double *pdArg[EQCALLBACK_MAXARG];  // argument columns
+   int k;                                   // argument
+   if(pc->pfnBatch == NULL) { _EqCallChunk<double>(pc, pArg, n, pd, ucBad); return; }
+   for(k=0; k<pc->iArgc; k++) pdArg[k] = pArg[k].pd;
+   if(pc->pfnBatch(pdArg, n, pd, pc->pUser) != 0) memset(ucBad, 1, n);
+}
+
+/*********************************************************
+* _AnalyzeProgram                                 Private
+* Runs through the program once on units alone, the way
+* DoEquation(..) would, to find
+*  - the dimension of the answer,
+*  - the deepest the stack gets, and
+*  - the number of variables referenced.
+* m_tfBatchScalar is set if any row would fail the unit
+* checks, or if units depend on values: a power with a
+* variable or non-integer exponent of a dimensioned base,
+* if(..) with branches of different units, and mod / rem
+* of different units (not an error if dividing by zero).
+* In those cases DoEquationBatch(..) runs row by row.
+* Callbacks follow their dimension rule (EqCallbackDim).
+* The constants the batch kernel needs are tabulated in
+* double and float: for token i, [2i] holds the value or
+* unit scale and [2i+1] the unit offset; the target unit's
+* scale and offset follow the last token.
+* pArena, if given, supplies the scratch unit stack.
+*********************************************************/
+void CEquation::_AnalyzeProgram(CEqArena *pArena) {
+   EQBATCHUNIT *pStk;                       // unit stack
+   EQBATCHUNIT  e1, e2;                     // popped arguments
+   VALOP        vo;                         // token being processed
+   int          iTop;                       // stack height
+   int          iPt;                        // pointer into program
+   int          iArg, iArgc;                // n-arg ops
+   BOOL         tfScalar;                   // row-by-row evaluation required
+   const EQINTERPTABLE *pTable;             // interp1(..) table
+   UNITBASE     uArg[EQCALLBACK_MAXARG];    // dimensions of a callback's arguments
+
+   m_tfAnalyzed    = TRUE;
+   m_tfBatchScalar = TRUE;                  // until proven otherwise
+   m_iBatchDepth   = 0;
+   m_iBatchNumVar  = 0;
+   m_uUnitStatic.u = 0;
+   if((iEqnLength <= 0) || (pvoEquation == NULL)) return;
+   _BuildConstTable();
+   pStk = (EQBATCHUNIT*) ((pArena) ? pArena->Alloc((iEqnLength+1) * sizeof(EQBATCHUNIT))
+                                   : malloc((iEqnLength+1) * sizeof(EQBATCHUNIT)));
+   if(pStk == NULL) return;
+
+   tfScalar = FALSE;
+   iTop     = 0;
+   for(iPt=0; iPt<iEqnLength && !tfScalar; iPt++) {
+      vo = pvoEquation[iPt];
+      switch(vo.uTyp) {
+      //===Values=========================================
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+         pStk[iTop].uUnit.u = 0; pStk[iTop].tfConst = TRUE; pStk[iTop].dVal = vo.dVal; iTop++;
+         break;
+
+      case VOTYP_REF:
+         pStk[iTop].uUnit.u = (m_puRefUnit) ? m_puRefUnit[vo.iRef].u : 0; pStk[iTop].tfConst = FALSE; iTop++;
+         if(vo.iRef+1 > m_iBatchNumVar) m_iBatchNumVar = vo.iRef+1;
+         break;
+
+      case VOTYP_UNIT:
+         if((iTop < 1) || (EqDimMul(pStk[iTop-1].uUnit, CEquationSIDim[vo.iUnit], &pStk[iTop-1].uUnit) != EQERR_NONE)) {
+            tfScalar = TRUE; break;
+         }
+         pStk[iTop-1].dVal = CEquationSIUnit[vo.iUnit][EQSI_NUMUNIT_BASE+1]
+            + pStk[iTop-1].dVal * CEquationSIUnit[vo.iUnit][EQSI_NUMUNIT_BASE];
+         break;
+
+      case VOTYP_CALL:
+         iArgc = vo.pCall->iArgc;
+         if(iTop < iArgc) { tfScalar = TRUE; break; }
+         for(iArg=0; iArg<iArgc; iArg++) uArg[iArg] = pStk[iTop-iArgc+iArg].uUnit;
+         if(EqCallbackDim(vo.pCall, uArg, &e1.uUnit) != EQERR_NONE) { tfScalar = TRUE; break; }
+         e1.tfConst = FALSE;
+         iTop -= iArgc;
+         pStk[iTop++] = e1;
+         break;
+
+      //===Operators======================================
+      case VOTYP_OP:
+         //---Binary---------------------------
+         if(vo.uOp < OP_UNARY) {
+            if((vo.uOp == OP_SET) || (iTop < 2)) { tfScalar = TRUE; break; } // assignment not allowed
+            e2 = pStk[--iTop]; e1 = pStk[--iTop];
+            switch(vo.uOp) {
+            case OP_PSH: pStk[iTop++] = e1; e1 = e2; break; // both stay on stack
+            case OP_POP: e1 = e2; break;
+            case OP_ADD: case OP_SUB:
+            case OP_OR:  case OP_AND:
+            case OP_LTE: case OP_GTE:
+            case OP_LT:  case OP_GT:
+            case OP_NEQ: case OP_EQ:
+               if(e1.uUnit.u != e2.uUnit.u) { tfScalar = TRUE; break; }
+               if((vo.uOp != OP_ADD) && (vo.uOp != OP_SUB)) e1.uUnit.u = 0;
+               e1.dVal    = (vo.uOp == OP_ADD) ? e1.dVal + e2.dVal : e1.dVal - e2.dVal;
+               e1.tfConst = e1.tfConst && e2.tfConst && ((vo.uOp == OP_ADD) || (vo.uOp == OP_SUB));
+               break;
+            case OP_MUL:
+               if(EqDimMul(e1.uUnit, e2.uUnit, &e1.uUnit) != EQERR_NONE) { tfScalar = TRUE; break; }
+               e1.dVal *= e2.dVal; e1.tfConst = e1.tfConst && e2.tfConst;
+               break;
+            case OP_DIV:
+               if(EqDimDiv(e1.uUnit, e2.uUnit, &e1.uUnit) != EQERR_NONE) { tfScalar = TRUE; break; }
+               e1.tfConst = e1.tfConst && e2.tfConst && (e2.dVal != 0.00);
+               if(e1.tfConst) e1.dVal /= e2.dVal;
+               break;
+            case OP_POW:
+               if(e2.uUnit.u != 0) { tfScalar = TRUE; break; }
+               if(e1.uUnit.u != 0) {        // dimension depends on exponent
+                  if(!e2.tfConst || (e2.dVal != floor(e2.dVal))) { tfScalar = TRUE; break; }
+                  if(EqDimPow(e1.uUnit, e2.dVal, &e1.uUnit) != EQERR_NONE) { tfScalar = TRUE; break; }
+               }
+               e1.tfConst = FALSE;
+               break;
+            default: tfScalar = TRUE; break;
+            }
+            pStk[iTop++] = e1;
+
+         //---Unary----------------------------
+         } else if(vo.uOp < OP_NARG) {
+            if(iTop < 1) { tfScalar = TRUE; break; }
+            e1 = pStk[iTop-1];
+            switch(vo.uOp - OP_UNARY) {
+            case OP_ABS: case OP_CEIL: case OP_FLOOR: case OP_ROUND:
+               break;
+            case OP_SQRT:
+               if(EqDimPow(e1.uUnit, 0.50, &e1.uUnit) != EQERR_NONE) tfScalar = TRUE;
+               break;
+            case OP_EXP:  case OP_LOG10: case OP_LOG:
+            case OP_COS:  case OP_SIN:   case OP_TAN:
+            case OP_ACOS: case OP_ASIN:  case OP_ATAN:
+            case OP_COSH: case OP_SINH:  case OP_TANH:
+            case OP_SIND: case OP_COSD:  case OP_TAND:
+            case OP_ASIND:case OP_ACOSD: case OP_ATAND:
+            case OP_NOT:  case OP_SIGN:
+               if(e1.uUnit.u != 0) tfScalar = TRUE;
+               break;
+            default: tfScalar = TRUE; break;
+            }
+            e1.tfConst = FALSE;
+            pStk[iTop-1] = e1;
+
+         //---N-argument-----------------------
+         } else {
+            if(vo.uOp - OP_NARG >= NUM_NARGOP) { tfScalar = TRUE; break; }
+            iArgc = CEquationNArgOpArgc[vo.uOp - OP_NARG];
+            if(iArgc < 0) {                 // variable argument count follows
+               if((++iPt >= iEqnLength) || (pvoEquation[iPt].uTyp != VOTYP_NARGC)) { tfScalar = TRUE; break; }
+               iArgc = pvoEquation[iPt].iArgc;
+            }
+            if((iArgc < 1) || (iTop < iArgc)) { tfScalar = TRUE; break; }
+            switch(vo.uOp - OP_NARG) {
+            case OP_NARG_MOD: case OP_NARG_REM:
+               if(pStk[iTop-1].uUnit.u != pStk[iTop-2].uUnit.u) tfScalar = TRUE;
+               e1 = pStk[iTop-1];
+               break;
+            case OP_NARG_ATAN2: case OP_NARG_ATAN2D:
+               if(pStk[iTop-1].uUnit.u != pStk[iTop-2].uUnit.u) tfScalar = TRUE;
+               e1.uUnit.u = 0;
+               break;
+            case OP_NARG_MAX: case OP_NARG_MIN:
+               for(iArg=1; iArg<iArgc; iArg++)
+                  if(pStk[iTop-1-iArg].uUnit.u != pStk[iTop-1].uUnit.u) tfScalar = TRUE;
+               e1 = pStk[iTop-1];
+               break;
+            case OP_NARG_IF:
+               if((pStk[iTop-3].uUnit.u != 0) || (pStk[iTop-2].uUnit.u != pStk[iTop-1].uUnit.u)) tfScalar = TRUE;
+               e1 = pStk[iTop-1];
+               break;
+            case OP_NARG_SUM: case OP_NARG_MEAN:
+            case OP_NARG_RMS: case OP_NARG_NORM:
+               e1 = pStk[iTop-1];
+               break;
+            case OP_NARG_DOT:
+               if(EqDimMul(pStk[iTop-2].uUnit, pStk[iTop-1].uUnit, &e1.uUnit) != EQERR_NONE) tfScalar = TRUE;
+               break;
+            case OP_NARG_INTERP1:           // units of a table named in the program
+               pTable = (pStk[iTop-2].tfConst) ? EqFindTable(pStk[iTop-2].dVal) : NULL;
+               if((pTable == NULL) || (pStk[iTop-2].uUnit.u != 0) || (pStk[iTop-1].uUnit.u != pTable->uUnitX.u)) { tfScalar = TRUE; break; }
+               e1.uUnit = pTable->uUnitY;
+               break;
+            default: tfScalar = TRUE; break;
+            }
+            e1.tfConst = FALSE;
+            iTop -= iArgc;
+            pStk[iTop++] = e1;
+         }
+         break;
+
+      default:
+         tfScalar = TRUE;
+         break;
+      }
+      if(iTop > m_iBatchDepth) m_iBatchDepth = iTop;
+   }
+
+   //===Answer============================================
+   if(iTop != 1) tfScalar = TRUE;           // malformed program
+   if(!tfScalar) {
+      m_uUnitStatic = pStk[0].uUnit;
+      if((m_dScleTarget != 0.00) && (m_uUnitTarget.u != m_uUnitStatic.u)) tfScalar = TRUE; // every row fails
+   }
+   m_tfBatchScalar = tfScalar;
+   if(pArena == NULL) free(pStk);
+}
+
+/*********************************************************
+* _BuildConstTable                                Private
+* Fills m_pdConst and m_pfConst (one allocation) with the
+* values, prefixes and unit factors of the program, so the
+* float path uses constants rounded once instead of at
+* every row. The block is kept for later programs that
+* fit. Left NULL if out of memory.
+*********************************************************/
+void CEquation::_BuildConstTable(void) {
+   int iNum;                                // entries per table
+   int iPt;                                 // pointer into program
+
+   iNum = 2 * (iEqnLength + 1);
+   if(iNum > m_iConstAlloc) {
+      if(m_pdConst) free(m_pdConst);
+      m_pdConst = (double*) malloc(iNum * (sizeof(double) + sizeof(float)));
+      m_iConstAlloc = (m_pdConst) ? iNum : 0;
+   }
+   m_pfConst = NULL;
+   if(m_pdConst == NULL) return;
+   m_pfConst = (float*) (m_pdConst + iNum);
+   for(iPt=0; iPt<iEqnLength; iPt++) {
+      m_pdConst[2*iPt] = m_pdConst[2*iPt+1] = 0.00;
+      switch(pvoEquation[iPt].uTyp) {
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+         m_pdConst[2*iPt]   = pvoEquation[iPt].dVal;
+         break;
+      case VOTYP_UNIT:
+         m_pdConst[2*iPt]   = CEquationSIUnit[pvoEquation[iPt].iUnit][EQSI_NUMUNIT_BASE];
+         m_pdConst[2*iPt+1] = CEquationSIUnit[pvoEquation[iPt].iUnit][EQSI_NUMUNIT_BASE+1];
+         break;
+      }
+   }
+   m_pdConst[2*iEqnLength]   = (m_dScleTarget != 0.00) ? m_dScleTarget : 1.00;
+   m_pdConst[2*iEqnLength+1] = (m_dScleTarget != 0.00) ? m_dOffsTarget : 0.00;
+   for(iPt=0; iPt<iNum; iPt++) m_pfConst[iPt] = (float) m_pdConst[iPt];
+}
+
+//---Float range--------------------------------
+// TRUE if a row's answer in double is finite but too large
+// for T; the float path reports it as EQERR_MATH_OVERFLOW.
+template<class T> static inline BOOL _EqOutOfRange(double d) {
+   return((sizeof(T) == sizeof(float)) && (fabs(d) > FLT_MAX) && (fabs(d) <= DBL_MAX));
+}
+
+/*********************************************************
+* _DoBatchRow                                     Private
+* Evaluates a single row with DoEquation(..), gathering
+* the variables into pdRow (m_iBatchNumVar entries). The
+* first error is kept in *pFirst; further errors are re-
+* corded in *pStatus, if given, and the row's answer set
+* to NaN. Returns FALSE if evaluation should stop.
+*********************************************************/
+template<class T>
+BOOL CEquation::_DoBatchRow(const T *const pVar[], const EQBIND *pBind, int iRow, double *pdRow, T pAns[], EQBATCHSTATUS *pStatus, EQROWERROR *pFirst) {
+   unsigned long long uNaN = 0x7FF8000000000000ull; // quiet NaN
+   double dAns;                             // answer in double
+   int    iErr;                             // row error
+
+   for(int iVar=0; iVar<m_iBatchNumVar; iVar++)
+      pdRow[iVar] = (pBind) ? EqBindValue(&pBind[iVar], iRow) : (double) pVar[iVar][iRow];
+   dAns = (double) pAns[iRow];
+   iErr = DoEquation(pdRow, &dAns);
+   pAns[iRow] = (T) dAns;
+   if((iErr == EQERR_NONE) && _EqOutOfRange<T>(dAns)) {
+      iErr = iError = EQERR_MATH_OVERFLOW;
+      iErrorLocation = pvoEquation[iEqnLength-1].iPos;
+   }
+   if(iErr == EQERR_NONE) return(TRUE);
+
+   if(pFirst->iError == EQERR_NONE) {
+      pFirst->iRow   = iRow;
+      pFirst->iError = iErr;
+      pFirst->iPos   = iErrorLocation;
+   }
+   if(pStatus == NULL) return(FALSE);       // stop at first error
+
+   memcpy(&dAns, &uNaN, sizeof(double));
+   pAns[iRow] = (T) dAns;
+   if(pStatus->pucBits) pStatus->pucBits[iRow >> 3] |= (unsigned char) (1 << (iRow & 7));
+   if((pStatus->pErr) && (pStatus->iNumErr < pStatus->iMaxErr)) {
+      pStatus->pErr[pStatus->iNumErr].iRow   = iRow;
+      pStatus->pErr[pStatus->iNumErr].iError = iErr;
+      pStatus->pErr[pStatus->iNumErr].iPos   = iErrorLocation;
+   }
+   pStatus->iNumErr++;                      // counted even if not listed
+   return(TRUE);
+}
+
+/*********************************************************
+* DoEquationBatch
+* Evaluates the equation for iNumRows rows. pdVar[k] is
+* the array of values of variable k, one per row, and the
+* answers are placed in pdAns. Evaluation stops at the
+* first row that returns an error; its index is placed in
+* *piErrRow (iNumRows if there was no error) and all rows
+* before it have valid answers.
+* uFlags:
+*  EQBATCH_UNCHECKED  Skip the argument checks of each
+*     operation and let inf / NaN propagate. Only rows
+*     whose answer is not finite are evaluated again by
+*     DoEquation(..) for the error code and location.
+*     Errors whose inf / NaN does not reach the answer,
+*     e.g. in the unused branch of if(..), go unreported,
+*     as does exp(..) of 709..709.78, which is finite.
+* Returns an error code, as DoEquation(..) for that row.
+*********************************************************/
+int CEquation::DoEquationBatch(const double *const pdVar[], int iNumRows, double pdAns[], int *piErrRow, UINT uFlags) {
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   if(m_pfnNativeBatch && (uFlags == 0) && !m_tfProfile) // see CompileNative(..)
+      return(_DoEquationNativeBatch(pdVar, iNumRows, pdAns, piErrRow));
+   return(_DoEquationBatch(pdVar, NULL, iNumRows, pdAns, m_pdConst, uFlags, NULL, piErrRow));
+}
+
+/*********************************************************
+* DoEquationBatchRows
+* As DoEquationBatch(..), but every row is evaluated even
+* if some fail. pStatus must be prepared by the caller:
+*  pucBits  NULL, or (iNumRows+7)/8 bytes; the bit of each
+*           failed row is set (row k: byte k/8, bit k%8)
+*  pErr     NULL, or iMaxErr entries; (row, error, source
+*           position) of the first iMaxErr failed rows
+* iNumErr returns the number of failed rows. The answer of
+* a failed row is NaN.
+* Returns the error of the first failed row, which is also
+* left in the equation for GetLastError(..).
+*********************************************************/
+int CEquation::DoEquationBatchRows(const double *const pdVar[], int iNumRows, double pdAns[], EQBATCHSTATUS *pStatus, UINT uFlags) {
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   if(pStatus) {
+      pStatus->iNumErr = 0;
+      if((pStatus->pucBits) && (iNumRows > 0)) memset(pStatus->pucBits, 0x00, (iNumRows+7) / 8);
+   }
+   return(_DoEquationBatch(pdVar, NULL, iNumRows, pdAns, m_pdConst, uFlags, pStatus, NULL));
+}
+
+/*********************************************************
+* Single Precision
+* The same calls for float variables and answers. The
+* program is the same; its constants and unit factors are
+* converted to float once, when the program is analyzed,
+* and every operation is carried out in float, so vector
+* loops handle twice as many rows per instruction.
+* Rows that fail (or, with EQBATCH_UNCHECKED, whose answer
+* is not finite) are evaluated again in double precision
+* by DoEquation(..) for the error code; their answer is
+* then rounded to float.
+*
+* Accuracy relative to the double path, per operation, in
+* units of float epsilon (2^-23 = 1.2e-7) of the result:
+*   + - * / sqrt, unit and target factors   0.5 (rounded)
+*   exp log log10 sin cos tan asin acos atan
+*   sinh cosh tanh, atan2                   1 - 2 (libm)
+*   ^                                       1 - 2, times
+*                                           |log x| for x^y
+*   sind cosd tand, asind acosd atand       2 - 3 (argument
+*                                           scaling first)
+*   mod rem                                 1, but a fully
+*                                           wrong answer if
+*                                           x/y exceeds 2^24
+*   abs ceil floor round sign, comparisons  exact
+* Errors are those of the double path, with the float
+* range in place of the double one: a row in which a val-
+* ue leaves the float range is evaluated again in double,
+* and an answer beyond 3.4e38 that is finite there, e.g.
+* exp(x) of x > 88.72, is EQERR_MATH_OVERFLOW.
+* Constants are rounded to float (e.g. pi by 2.8e-8 rel.);
+* errors accumulate through the program as usual, and sub-
+* tracting nearly equal values loses digits much sooner
+* than in double.
+*********************************************************/
+int CEquation::DoEquation(float fVar[], float *pfAns) {
+   const float *pfCol[EQBATCH_MAXSCALARVAR]; // one-row columns
+   float fAns = 0.0f;                       // answer
+   int   iVar;                              // loop counter
+
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   if(m_iBatchNumVar > EQBATCH_MAXSCALARVAR) return(iError=EQERR_PARSE_ALLOCFAIL);
+   if((fVar == NULL) && (m_iBatchNumVar > 0)) return(iError=EQERR_EVAL_CONTAINSVAR);
+   for(iVar=0; iVar<m_iBatchNumVar; iVar++) pfCol[iVar] = &fVar[iVar];
+   if(_DoEquationBatch(pfCol, NULL, 1, &fAns, m_pfConst, 0, NULL, NULL) != EQERR_NONE) return(iError);
+   if(pfAns) *pfAns = fAns;
+   return(iError=EQERR_NONE);
+}
+
+int CEquation::DoEquationBatch(const float *const pfVar[], int iNumRows, float pfAns[], int *piErrRow, UINT uFlags) {
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   return(_DoEquationBatch(pfVar, NULL, iNumRows, pfAns, m_pfConst, uFlags, NULL, piErrRow));
+}
+
+int CEquation::DoEquationBatchRows(const float *const pfVar[], int iNumRows, float pfAns[], EQBATCHSTATUS *pStatus, UINT uFlags) {
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   if(pStatus) {
+      pStatus->iNumErr = 0;
+      if((pStatus->pucBits) && (iNumRows > 0)) memset(pStatus->pucBits, 0x00, (iNumRows+7) / 8);
+   }
+   return(_DoEquationBatch(pfVar, NULL, iNumRows, pfAns, m_pfConst, uFlags, pStatus, NULL));
+}
+
+/*********************************************************
+* DoEquationBound
+* As DoEquationBatch(..), but variable k is read from the
+* memory described by pBind[k] (see EQBIND) rather than an
+* array of its own: members of an array of structs, float
+* or integer columns, or one value for all rows. pBind has
+* one entry per variable of the parsed variable list. Rows
+* are converted to the type of the answer a chunk at a
+* time; double (float) columns are read in place. Native
+* code (CompileNative) is not used.
+*********************************************************/
+int CEquation::DoEquationBound(const EQBIND pBind[], int iNumRows, double pdAns[], int *piErrRow, UINT uFlags) {
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   return(_DoEquationBatch((const double *const *) NULL, pBind, iNumRows, pdAns, m_pdConst, uFlags, NULL, piErrRow));
+}
+
+int CEquation::DoEquationBoundRows(const EQBIND pBind[], int iNumRows, double pdAns[], EQBATCHSTATUS *pStatus, UINT uFlags) {
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   if(pStatus) {
+      pStatus->iNumErr = 0;
+      if((pStatus->pucBits) && (iNumRows > 0)) memset(pStatus->pucBits, 0x00, (iNumRows+7) / 8);
+   }
+   return(_DoEquationBatch((const double *const *) NULL, pBind, iNumRows, pdAns, m_pdConst, uFlags, pStatus, NULL));
+}
+
+int CEquation::DoEquationBound(const EQBIND pBind[], int iNumRows, float pfAns[], int *piErrRow, UINT uFlags) {
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   return(_DoEquationBatch((const float *const *) NULL, pBind, iNumRows, pfAns, m_pfConst, uFlags, NULL, piErrRow));
+}
+
+/*********************************************************
+* DoEquationFilter
+* Evaluates the equation as a condition: a row is selected
+* if its answer is non-zero, as for if(..), and it has no
+* error. The answers themselves are not stored. pFilter
+* must be prepared by the caller:
+*  pucBits  NULL, or (iNumRows+7)/8 bytes; the bit of each
+*           selected row is set (row k: byte k/8, bit k%8)
+*  piSel    NULL, or iNumRows entries; the indices of the
+*           selected rows, in order
+* iNumSel returns the number of rows selected and iNumErr
+* the number left out because of an error. Rows that are
+* false anyway are not always checked for errors: once an
+* operand of a top-level && is false for a whole chunk of
+* rows, the rest of the chunk's equation is skipped.
+* uFlags are those of DoEquationBatch(..).
+* Returns EQERR_NONE unless the equation can not be eval-
+* uated at all.
+*********************************************************/
+int CEquation::DoEquationFilter(const double *const pdVar[], int iNumRows, EQFILTER *pFilter, UINT uFlags) {
+   if(pFilter == NULL) return(iError=EQERR_PARSE_NOEQUATION);
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   return(_DoEquationBatch(pdVar, NULL, iNumRows, (double*) NULL, m_pdConst, uFlags, NULL, NULL, pFilter));
+}
+
+int CEquation::DoEquationFilterBound(const EQBIND pBind[], int iNumRows, EQFILTER *pFilter, UINT uFlags) {
+   if(pFilter == NULL) return(iError=EQERR_PARSE_NOEQUATION);
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   return(_DoEquationBatch((const double *const *) NULL, pBind, iNumRows, (double*) NULL, m_pdConst, uFlags, NULL, NULL, pFilter));
+}
+
+//===Filter Rows==========================================
+// One row by DoEquation(..); TRUE if selected.
+template<class T>
+BOOL CEquation::_DoFilterRow(const T *const pVar[], const EQBIND *pBind, int iRow, double *pdRow, EQFILTER *pFilter) {
+   double dAns = 0.00;                      // answer
+   for(int iVar=0; iVar<m_iBatchNumVar; iVar++)
+      pdRow[iVar] = (pBind) ? EqBindValue(&pBind[iVar], iRow) : (double) pVar[iVar][iRow];
+   if((DoEquation(pdRow, &dAns) != EQERR_NONE) || _EqOutOfRange<T>(dAns)) {
+      pFilter->iNumErr++;
+      return(FALSE);
+   }
+   return(dAns != 0.00);
+}
+
+//===Filter Early Exit====================================
+// TRUE if any of n values is non-zero (or NaN).
+template<class T>
+static BOOL _EqAnyNonZero(const T *pa, int n) {
+   int iAny = 0;                            // counted without branches
+   for(int r=0; r<n; r++) iAny |= (pa[r] != (T) 0.00);
+   return(iAny != 0);
+}
+
+//===Filter Output========================================
+// A chunk's selection is kept as bits, row r in bit r%8 of
+// byte r/8, so that mostly empty chunks are skipped a byte
+// at a time. _EqFilterPack sets the bit of each non-zero
+// answer; _EqFilterStore copies the bits of n rows from
+// iRow0, a multiple of 8, to the caller's bitmap and adds
+// the rows to the index list.
+template<class T>
+static void _EqFilterPack(const T *pa, int n, unsigned char *pucSel) {
+   unsigned char uc;                        // bits of 8 rows
+   int           r, k;                      // row loop counters
+   for(r=0; r+8<=n; r+=8)
+      pucSel[r >> 3] = (unsigned char) ((pa[r] != (T) 0.00) | ((pa[r+1] != (T) 0.00) << 1)
+         | ((pa[r+2] != (T) 0.00) << 2) | ((pa[r+3] != (T) 0.00) << 3)
+         | ((pa[r+4] != (T) 0.00) << 4) | ((pa[r+5] != (T) 0.00) << 5)
+         | ((pa[r+6] != (T) 0.00) << 6) | ((pa[r+7] != (T) 0.00) << 7));
+   if(r < n) {                              // last rows
+      for(uc=0, k=0; r+k<n; k++) uc |= (unsigned char) ((pa[r+k] != (T) 0.00) << k);
+      pucSel[r >> 3] = uc;
+   }
+}
+
+static void _EqFilterStore(EQFILTER *pFilter, const unsigned char *pucSel, int iRow0, int n) {
+   unsigned char uc;                        // bits of 8 rows
+   int           iNumSel = pFilter->iNumSel; // rows selected so far
+   int           iNumByte = (n + 7) >> 3;   // bytes of selection
+   int           i, k, kMax;                // byte and bit loop counters
+
+   if(pFilter->pucBits) memcpy(pFilter->pucBits + (iRow0 >> 3), pucSel, iNumByte);
+   for(i=0; i<iNumByte; i++) {
+      if((uc = pucSel[i]) == 0) continue;
+      if(pFilter->piSel) {                  // write every row, advance on selected
+         kMax = MIN(8, n - 8*i);
+         for(k=0; k<kMax; k++) { pFilter->piSel[iNumSel] = iRow0 + 8*i + k; iNumSel += (uc >> k) & 1; }
+      } else {                              // count bits
+         uc = (unsigned char) (uc - ((uc >> 1) & 0x55));
+         uc = (unsigned char) ((uc & 0x33) + ((uc >> 2) & 0x33));
+         iNumSel += (uc + (uc >> 4)) & 0x0F;
+      }
+   }
+   pFilter->iNumSel = iNumSel;
+}
+
+//===Conjuncts============================================
+// Marks the last token of each operand of the top-level &&
+// chain, e.g. of "a > 1", "b < 2" and "c" in a>1 && b<2 && c,
+// for DoEquationFilter(..) to stop early. Follows the stack
+// height through the program: the right operand of the &&
+// at token e starts after the last token before it at which
+// the stack was as high as after e. Returns NULL if there
+// is no top-level && (or no memory); free() the result.
+unsigned char *CEquation::_FilterConjuncts(void) {
+   unsigned char *pucEnd;                   // result
+   int           *piHgt;                    // stack height after each token
+   int           *piRange;                  // ranges still to split: start, end
+   VALOP          vo;                       // token
+   int            iNum;                     // ranges pending
+   int            s, e, j;                  // range and split point
+
+   if((iEqnLength < 3) || (pvoEquation[iEqnLength-1].uTyp != VOTYP_OP)
+      || (pvoEquation[iEqnLength-1].uOp != OP_AND)) return(NULL);
+   pucEnd  = (unsigned char*) calloc(iEqnLength, sizeof(unsigned char));
+   piHgt   = _StackHeights();
+   piRange = (int*) malloc(2 * iEqnLength * sizeof(int));
+   if((pucEnd == NULL) || (piHgt == NULL) || (piRange == NULL)) {
+      if(pucEnd)  free(pucEnd);
+      if(piHgt)   free(piHgt);
+      if(piRange) free(piRange);
+      return(NULL);
+   }
+
+   //---Split at each &&------------------------
+   piRange[0] = 0;                          // whole program
+   piRange[1] = iEqnLength-1;
+   iNum = 1;
+   while(iNum > 0) {
+      iNum--;
+      s = piRange[2*iNum];
+      e = piRange[2*iNum+1];
+      vo = pvoEquation[e];
+      if((vo.uTyp == VOTYP_OP) && (vo.uOp == OP_AND) && (e > s)) {
+         for(j=e-2; (j>=s) && (piHgt[j]!=piHgt[e]); j--) ;
+         if(j >= s) {
+            piRange[2*iNum] = s;   piRange[2*iNum+1] = j;   iNum++; // left operand
+            piRange[2*iNum] = j+1; piRange[2*iNum+1] = e-1; iNum++; // right operand
+            continue;
+         }
+      }
+      pucEnd[e] = 1;
+   }
+   pucEnd[iEqnLength-2] = 0;                // last operand: nothing left to skip
+   free(piHgt);
+   free(piRange);
+   return(pucEnd);
+}
+
+//---Stack height-------------------------------
+// Height of the stack after each token, as in
+// _DoEquationBatch; the n-arg operator of a NARGC token
+// gets the height before its arguments are popped. NULL
+// if out of memory; free() the result.
+int *CEquation::_StackHeights(void) {
+   int  *piHgt;                             // result
+   VALOP vo;                                // token
+   int   iPt, iTop, iArgc;                  // program walk
+
+   if((piHgt = (int*) malloc(MAX(1, iEqnLength) * sizeof(int))) == NULL) return(NULL);
+   for(iTop=0, iPt=0; iPt<iEqnLength; iPt++) {
+      vo = pvoEquation[iPt];
+      switch(vo.uTyp) {
+      case VOTYP_VAL: case VOTYP_PREFIX: case VOTYP_REF: iTop++; break;
+      case VOTYP_CALL: iTop -= vo.pCall->iArgc - 1; break;
+      case VOTYP_OP:
+         if(vo.uOp < OP_UNARY) { if(vo.uOp != OP_PSH) iTop--; }
+         else if(vo.uOp >= OP_NARG) {
+            iArgc = CEquationNArgOpArgc[vo.uOp - OP_NARG];
+            if((iArgc < 0) && (iPt+1 < iEqnLength)) { piHgt[iPt++] = iTop; iArgc = pvoEquation[iPt].iArgc; }
+            iTop -= iArgc - 1;
+         }
+         break;
+      }
+      piHgt[iPt] = iTop;
+   }
+   return(piHgt);
+}
+
+//===Implementation=======================================
+// T is double or float; pConst holds the program's constants
+// converted to T (see _AnalyzeProgram). Variables come from
+// the columns pVar, or from pBind if it is not NULL. With
+// pFilter, answers are turned into a selection instead of
+// being stored in pAns.
+template<class T>
+int CEquation::_DoEquationBatch(const T *const pVar[], const EQBIND *pBind, int iNumRows, T pAns[], const T *pConst, UINT uFlags, EQBATCHSTATUS *pStatus, int *piErrRow, EQFILTER *pFilter) {
+   TEqBatchSlot<T> *pSlot;                  // evaluation stack
+   T           *pMem;                       // buffers for all stack levels
+   double      *pdRow;                      // one row of variables, for DoEquation
+   T           *pd;                         // output of current op
+   const T     *pa, *pb, *pc;               // arguments of current op
+   unsigned char ucBad[EQBATCH_CHUNK];      // rows that need DoEquation
+   unsigned char ucSel[EQBATCH_CHUNK/8];    // rows selected by filter, one bit each
+   unsigned char *pucConj = NULL;           // tokens ending an operand of && (filter)
+   VALOP        vo;                         // token being processed
+   int          iRow0;                      // first row of chunk
+   int          n;                          // rows in chunk
+   int          r;                          // row loop counter
+   int          iTop;                       // stack height
+   int          iPt;                        // pointer into program
+   int          iArg, iArgc;                // n-arg ops
+   int          iBad;                       // any row flagged in chunk
+   int          iOther;                     // any row naming another table
+   const EQINTERPTABLE *pTable;             // interp1(..) table of chunk
+   BOOL         tfCheck;                    // check arguments of each op
+   int          iTier;                      // EQFAST_ accuracy of transcendentals
+   T            tScl, tOff;                 // unit conversion
+   const T      tExpMax = (T) ((sizeof(T) == sizeof(float)) ? EQBATCH_EXPMAX_FLOAT : EQBATCH_EXPMAX_DOUBLE);
+   EQROWERROR   First;                      // first failed row
+#ifdef EQPROFILE
+   EQPROFILETOKEN *pProf;                   // counters, NULL unless profiling
+   unsigned long long uTick = 0;            // ticks at start of token
+   int          iProfPt = 0;                // token being timed
+#endif//EQPROFILE
+
+   if(piErrRow) *piErrRow = 0;
+   if(pFilter) { pFilter->iNumSel = 0; pFilter->iNumErr = 0; }
+   tfCheck = !(uFlags & EQBATCH_UNCHECKED);
+   iTier   = (uFlags & EQBATCH_FASTMATH_HIGH) ? EQFAST_HIGH : (uFlags & EQBATCH_FASTMATH) ? EQFAST_LOW : EQFAST_NONE;
+   if(iEqnLength <= 0) return(iError=EQERR_EVAL_NOEQUATION);
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   if((pVar == NULL) && (pBind == NULL) && (m_iBatchNumVar > 0)) return(iError=EQERR_EVAL_CONTAINSVAR);
+   if(iNumRows <= 0) return(iError=EQERR_NONE);
+
+   pdRow = (double*) malloc((m_iBatchNumVar+1) * sizeof(double));
+   if(pdRow == NULL) return(iError=EQERR_PARSE_ALLOCFAIL);
+   memset(&First, 0x00, sizeof(First));
+   First.iRow = iNumRows;                   // no failed row yet
+
+   //===Row by Row========================================
+   if(m_tfBatchScalar && pFilter) {
+      for(iRow0=0; iRow0<iNumRows; iRow0+=EQBATCH_CHUNK) {
+         n = MIN(EQBATCH_CHUNK, iNumRows-iRow0);
+         memset(ucSel, 0x00, sizeof(ucSel));
+         for(r=0; r<n; r++)
+            if(_DoFilterRow(pVar, pBind, iRow0+r, pdRow, pFilter)) ucSel[r >> 3] |= (unsigned char) (1 << (r & 7));
+         _EqFilterStore(pFilter, ucSel, iRow0, n);
+      }
+      free(pdRow);
+      iErrorLocation = 0;
+      return(iError=EQERR_NONE);
+   }
+   if(m_tfBatchScalar) {
+      for(r=0; r<iNumRows; r++)
+         if(!_DoBatchRow(pVar, pBind, r, pdRow, pAns, pStatus, &First)) break;
+      if(piErrRow) *piErrRow = First.iRow;
+      iErrorLocation = First.iPos;
+      free(pdRow);
+      return(iError=First.iError);
+   }
+
+   //===Columns===========================================
+   // One extra level serves as scratch for max(..) / min(..)
+   // and callbacks.
+   pSlot = (TEqBatchSlot<T>*) malloc((m_iBatchDepth+1) * sizeof(TEqBatchSlot<T>));
+   pMem  = (T*) malloc((m_iBatchDepth+1) * EQBATCH_CHUNK * sizeof(T));
+   if((pSlot == NULL) || (pMem == NULL) || (pConst == NULL)) {
+      if(pSlot) free(pSlot);
+      if(pMem)  free(pMem);
+      free(pdRow);
+      return(iError=EQERR_PARSE_ALLOCFAIL);
+   }
+   for(iTop=0; iTop<=m_iBatchDepth; iTop++) pSlot[iTop].pdBuf = pMem + iTop*EQBATCH_CHUNK;
+   if(pFilter) pucConj = _FilterConjuncts();
+#ifdef EQPROFILE
+   // Rows re-evaluated by DoEquation(..) below count again there.
+   if((pProf = _ProfileCounters()) != NULL) m_uProfileEvals += iNumRows;
+#endif//EQPROFILE
+
+   for(iRow0=0; (iRow0<iNumRows) && ((First.iError==EQERR_NONE) || pStatus); iRow0+=EQBATCH_CHUNK) {
+      n = MIN(EQBATCH_CHUNK, iNumRows-iRow0);
+      memset(ucBad, 0x00, n);
+      iTop = 0;
+
+      for(iPt=0; iPt<iEqnLength; iPt++) {
+         vo = pvoEquation[iPt];
+#ifdef EQPROFILE
+         if(pProf) { iProfPt = iPt; uTick = EQPROFILE_TICKS(); }
+#endif//EQPROFILE
+         switch(vo.uTyp) {
+         //===Values======================================
+         case VOTYP_VAL:
+         case VOTYP_PREFIX:
+            pd = pSlot[iTop].pdBuf; tScl = pConst[2*iPt];
+            for(r=0; r<n; r++) pd[r] = tScl;
+            pSlot[iTop++].pd = pd;
+            break;
+
+         case VOTYP_REF:                    // read straight from caller's array
+            if(pBind) pSlot[iTop].pd = _EqBindChunk(&pBind[vo.iRef], iRow0, n, pSlot[iTop].pdBuf);
+            else      pSlot[iTop].pd = pVar[vo.iRef] + iRow0;
+            iTop++;
+            break;
+
+         case VOTYP_UNIT:
+            pa = pSlot[iTop-1].pd; pd = pSlot[iTop-1].pdBuf;
+            tScl = pConst[2*iPt]; tOff = pConst[2*iPt+1];
+            for(r=0; r<n; r++) pd[r] = tOff + pa[r] * tScl;
+            pSlot[iTop-1].pd = pd;
+            break;
+
+         //===Callbacks===================================
+         // Answers into the scratch level, which no argument
+         // uses, then swapped in as for max(..).
+         case VOTYP_CALL:
+            iArgc = vo.pCall->iArgc;
+            pd = pSlot[m_iBatchDepth].pdBuf;
+            _EqCallChunk(vo.pCall, pSlot+iTop-iArgc, n, pd, ucBad);
+            pSlot[m_iBatchDepth].pdBuf = pSlot[iTop-iArgc].pdBuf;
+            pSlot[iTop-iArgc].pdBuf    = pd;
+            iTop -= iArgc - 1;
+            pSlot[iTop-1].pd = pd;
+            break;
+
+         //===Binary Operators============================
+         case VOTYP_OP:
+            if(vo.uOp < OP_UNARY) {
+               if(vo.uOp == OP_PSH) break;  // both stay on stack
+               pa = pSlot[iTop-2].pd; pb = pSlot[iTop-1].pd; pd = pSlot[iTop-2].pdBuf;
+               switch(vo.uOp) {
+               case OP_POP: for(r=0; r<n; r++) pd[r] = pb[r]; break;
+               case OP_ADD: for(r=0; r<n; r++) pd[r] = pa[r] + pb[r]; break;
+               case OP_SUB: for(r=0; r<n; r++) pd[r] = pa[r] - pb[r]; break;
+               case OP_MUL: for(r=0; r<n; r++) pd[r] = pa[r] * pb[r]; break;
+               case OP_DIV:
+                  if(tfCheck) for(r=0; r<n; r++) ucBad[r] |= (pb[r] == (T) 0.00);
+                  for(r=0; r<n; r++) pd[r] = pa[r] / pb[r];
+                  break;
+               case OP_POW:
+                  if(tfCheck) for(r=0; r<n; r++) ucBad[r] |= ((pa[r] == (T) 0.00) && (pb[r] < (T) 0.00));
+                  for(r=0; r<n; r++) pd[r] = ((pa[r]==(T) 0.00) && (pb[r]==(T) 0.00)) ? (T) 1.00
+                     : pow(pa[r], (pa[r] < (T) 0.00) ? floor(pb[r]+(T) 0.50) : pb[r]);
+                  break;
+               case OP_OR:  for(r=0; r<n; r++) pd[r] = ((pa[r]!=(T) 0.00) || (pb[r]!=(T) 0.00)) ? (T) 1.00 : (T) 0.00; break;
+               case OP_AND: for(r=0; r<n; r++) pd[r] = ((pa[r]!=(T) 0.00) && (pb[r]!=(T) 0.00)) ? (T) 1.00 : (T) 0.00; break;
+               case OP_LTE: for(r=0; r<n; r++) pd[r] = (pa[r] <= pb[r]) ? (T) 1.00 : (T) 0.00; break;
+               case OP_GTE: for(r=0; r<n; r++) pd[r] = (pa[r] >= pb[r]) ? (T) 1.00 : (T) 0.00; break;
+               case OP_LT : for(r=0; r<n; r++) pd[r] = (pa[r] <  pb[r]) ? (T) 1.00 : (T) 0.00; break;
+               case OP_GT : for(r=0; r<n; r++) pd[r] = (pa[r] >  pb[r]) ? (T) 1.00 : (T) 0.00; break;
+               case OP_NEQ: for(r=0; r<n; r++) pd[r] = (pa[r] != pb[r]) ? (T) 1.00 : (T) 0.00; break;
+               case OP_EQ : for(r=0; r<n; r++) pd[r] = (pa[r] == pb[r]) ? (T) 1.00 : (T) 0.00; break;
+               }
+               pSlot[--iTop - 1].pd = pd;
+
+            //===Unary Operators==========================
+            } else if(vo.uOp < OP_NARG) {
+               pa = pSlot[iTop-1].pd; pd = pSlot[iTop-1].pdBuf;
+               if(tfCheck) switch(vo.uOp - OP_UNARY) {
+               case OP_ACOS: case OP_ASIN:
+                  for(r=0; r<n; r++) ucBad[r] |= (fabs(pa[r]) > (T) 1.00);
+                  break;
+               case OP_LOG: case OP_LOG10:
+                  for(r=0; r<n; r++) ucBad[r] |= (pa[r] <= (T) 0.00);
+                  break;
+               case OP_SQRT:
+                  for(r=0; r<n; r++) ucBad[r] |= (pa[r] < (T) 0.00);
+                  break;
+               case OP_EXP:
+                  for(r=0; r<n; r++) ucBad[r] |= (pa[r] > tExpMax);
+                  break;
+               }
+               if(!EqFastUnary(vo.uOp - OP_UNARY, iTier, pa, pd, n)) switch(vo.uOp - OP_UNARY) {
+               case OP_ABS:   for(r=0; r<n; r++) pd[r] = fabs(pa[r]);  break;
+               case OP_SQRT:  for(r=0; r<n; r++) pd[r] = sqrt(pa[r]);  break;
+               case OP_EXP:   for(r=0; r<n; r++) pd[r] = exp(pa[r]);   break;
+               case OP_LOG10: for(r=0; r<n; r++) pd[r] = log10(pa[r]); break;
+               case OP_LOG:   for(r=0; r<n; r++) pd[r] = log(pa[r]);   break;
+               case OP_CEIL:  for(r=0; r<n; r++) pd[r] = ceil(pa[r]);  break;
+               case OP_FLOOR: for(r=0; r<n; r++) pd[r] = floor(pa[r]); break;
+               case OP_ROUND: for(r=0; r<n; r++) pd[r] = floor(pa[r]+(T) 0.500); break;
+               case OP_COS:   for(r=0; r<n; r++) pd[r] = cos(pa[r]);   break;
+               case OP_SIN:   for(r=0; r<n; r++) pd[r] = sin(pa[r]);   break;
+               case OP_TAN:   for(r=0; r<n; r++) pd[r] = tan(pa[r]);   break;
+               case OP_ACOS:  for(r=0; r<n; r++) pd[r] = acos(pa[r]);  break;
+               case OP_ASIN:  for(r=0; r<n; r++) pd[r] = asin(pa[r]);  break;
+               case OP_ATAN:  for(r=0; r<n; r++) pd[r] = atan(pa[r]);  break;
+               case OP_COSH:  for(r=0; r<n; r++) pd[r] = cosh(pa[r]);  break;
+               case OP_SINH:  for(r=0; r<n; r++) pd[r] = sinh(pa[r]);  break;
+               case OP_TANH:  for(r=0; r<n; r++) pd[r] = tanh(pa[r]);  break;
+               case OP_SIND:  for(r=0; r<n; r++) pd[r] = sin(pa[r] * (T) M_PI_180); break;
+               case OP_COSD:  for(r=0; r<n; r++) pd[r] = cos(pa[r] * (T) M_PI_180); break;
+               case OP_TAND:  for(r=0; r<n; r++) pd[r] = tan(pa[r] * (T) M_PI_180); break;
+               case OP_ASIND: for(r=0; r<n; r++) pd[r] = (T) M_180_PI * asin(pa[r]); break;
+               case OP_ACOSD: for(r=0; r<n; r++) pd[r] = (T) M_180_PI * acos(pa[r]); break;
+               case OP_ATAND: for(r=0; r<n; r++) pd[r] = (T) M_180_PI * atan(pa[r]); break;
+               case OP_NOT:   for(r=0; r<n; r++) pd[r] = (pa[r]==(T) 0.00) ? (T) 1.00 : (T) 0.00; break;
+               case OP_SIGN:  for(r=0; r<n; r++) pd[r] = (pa[r]==(T) 0.00) ? (T) 0.00 : (pa[r]<(T) 0.00) ? (T) -1.00 : (T) 1.00; break;
+               }
+               pSlot[iTop-1].pd = pd;
+
+            //===N-Argument Operators=====================
+            } else {
+               iArgc = CEquationNArgOpArgc[vo.uOp - OP_NARG];
+               if(iArgc < 0) iArgc = pvoEquation[++iPt].iArgc; // VOTYP_NARGC checked by _AnalyzeProgram
+               switch(vo.uOp - OP_NARG) {
+               case OP_NARG_MOD:
+               case OP_NARG_REM:            // rows dividing by zero left to DoEquation
+                  pa = pSlot[iTop-2].pd; pb = pSlot[iTop-1].pd; pd = pSlot[iTop-2].pdBuf;
+                  if(tfCheck) for(r=0; r<n; r++) ucBad[r] |= (pb[r] == (T) 0.00);
+                  for(r=0; r<n; r++) pd[r] = pa[r] - pb[r]*floor(pa[r]/pb[r]);
+                  if((vo.uOp-OP_NARG) == OP_NARG_REM)
+                     for(r=0; r<n; r++) if(SIGN(pa[r]) != SIGN(pb[r])) pd[r] -= pb[r];
+                  break;
+               case OP_NARG_ATAN2:
+               case OP_NARG_ATAN2D:
+                  pa = pSlot[iTop-2].pd; pb = pSlot[iTop-1].pd; pd = pSlot[iTop-2].pdBuf;
+                  for(r=0; r<n; r++) pd[r] = (pb[r]==(T) 0.00) ?
+                     ((pa[r]==(T) 0.00) ? (T) 0.00 : ((pa[r]>(T) 0.00) ? (T) (M_PI/2.00) : -(T) (M_PI/2.00)))
+                     : atan2(pa[r], pb[r]);
+                  if((vo.uOp-OP_NARG) == OP_NARG_ATAN2D)
+                     for(r=0; r<n; r++) pd[r] *= (T) M_180_PI;
+                  break;
+               case OP_NARG_MAX:
+               case OP_NARG_MIN:            // accumulate in scratch, then swap in
+                  pd = pSlot[m_iBatchDepth].pdBuf; pb = pSlot[iTop-1].pd;
+                  for(r=0; r<n; r++) pd[r] = pb[r];
+                  for(iArg=1; iArg<iArgc; iArg++) {
+                     pa = pSlot[iTop-1-iArg].pd;
+                     if((vo.uOp-OP_NARG) == OP_NARG_MAX) for(r=0; r<n; r++) pd[r] = (pa[r] > pd[r]) ? pa[r] : pd[r];
+                     else                                for(r=0; r<n; r++) pd[r] = (pa[r] < pd[r]) ? pa[r] : pd[r];
+                  }
+                  pSlot[m_iBatchDepth].pdBuf = pSlot[iTop-iArgc].pdBuf;
+                  pSlot[iTop-iArgc].pdBuf    = pd;
+                  break;
+               case OP_NARG_IF:
+                  pc = pSlot[iTop-3].pd; pa = pSlot[iTop-2].pd; pb = pSlot[iTop-1].pd; pd = pSlot[iTop-3].pdBuf;
+                  for(r=0; r<n; r++) pd[r] = (pc[r]==(T) 0.00) ? pb[r] : pa[r];
+                  break;
+               case OP_NARG_SUM:            // each row a one-element array
+               case OP_NARG_MEAN:
+                  pa = pSlot[iTop-1].pd; pd = pSlot[iTop-1].pdBuf;
+                  if(pd != pa) for(r=0; r<n; r++) pd[r] = pa[r];
+                  break;
+               case OP_NARG_RMS:
+               case OP_NARG_NORM:
+                  pa = pSlot[iTop-1].pd; pd = pSlot[iTop-1].pdBuf;
+                  for(r=0; r<n; r++) pd[r] = fabs(pa[r]);
+                  break;
+               case OP_NARG_DOT:
+                  pa = pSlot[iTop-2].pd; pb = pSlot[iTop-1].pd; pd = pSlot[iTop-2].pdBuf;
+                  for(r=0; r<n; r++) pd[r] = pa[r] * pb[r];
+                  break;
+               case OP_NARG_INTERP1:        // one table for the chunk, else row by row
+                  pa = pSlot[iTop-2].pd; pb = pSlot[iTop-1].pd; pd = pSlot[iTop-2].pdBuf;
+                  pTable = EqFindTable((double) pa[0]);
+                  for(iOther=0, r=0; r<n; r++) iOther |= (pa[r] != pa[0]);
+                  if((pTable == NULL) || iOther) {
+                     for(r=0; r<n; r++) { pd[r] = (T) NAN; ucBad[r] = 1; }
+                     break;
+                  }
+                  EqInterp1Batch(pTable, pb, pd, n, ucBad);
+                  break;
+               default:                     // left to DoEquation to report
+                  pd = pSlot[iTop-iArgc].pdBuf;
+                  for(r=0; r<n; r++) { pd[r] = (T) NAN; ucBad[r] = 1; }
+                  break;
+               }
+               iTop -= iArgc - 1;
+               pSlot[iTop-1].pd = pd;
+            }
+            break;
+         }//switch
+#ifdef EQPROFILE
+         if(pProf) {
+            pProf[iProfPt].uCount += n;
+            pProf[iProfPt].uTimed++;
+            pProf[iProfPt].uTicks += EQPROFILE_TICKS() - uTick;
+         }
+#endif//EQPROFILE
+         if(pucConj && pucConj[iPt] && !_EqAnyNonZero(pSlot[iTop-1].pd, n)) break; // operand of && false in every row
+      }//for(iPt)
+
+      //===Filter: non-zero answers without error========
+      if(pFilter) {
+         if(iPt < iEqnLength) {             // stopped early, nothing selected
+            memset(ucSel, 0x00, sizeof(ucSel));
+         } else {
+            pa = pSlot[0].pd;
+            if(m_dScleTarget != 0.00) {     // in the scratch level
+               pd = pSlot[m_iBatchDepth].pdBuf;
+               tScl = pConst[2*iEqnLength]; tOff = pConst[2*iEqnLength+1];
+               for(r=0; r<n; r++) pd[r] = (pa[r] - tOff) / tScl;
+               pa = pd;
+            }
+            _EqFilterPack(pa, n, ucSel);
+            if(!tfCheck) for(r=0; r<n; r++) ucBad[r] = (pa[r] - pa[r] != (T) 0.00); // inf or NaN
+            else if(sizeof(T) == sizeof(float)) for(r=0; r<n; r++) ucBad[r] |= (pa[r] - pa[r] != (T) 0.00);
+            for(iBad=0, r=0; r<n; r++) iBad |= ucBad[r];
+            if(iBad) {                      // false rows stay out either way
+               for(r=0; r<n; r++)
+                  if(ucBad[r] && (ucSel[r >> 3] & (1 << (r & 7)))
+                     && !_DoFilterRow(pVar, pBind, iRow0+r, pdRow, pFilter))
+                     ucSel[r >> 3] &= (unsigned char) ~(1 << (r & 7));
+            }
+         }
+         _EqFilterStore(pFilter, ucSel, iRow0, n);
+         continue;
+      }
+
+      //===Store, with target unit conversion============
+      pa = pSlot[0].pd; pd = pAns + iRow0;
+      if(m_dScleTarget != 0.00) {
+         tScl = pConst[2*iEqnLength]; tOff = pConst[2*iEqnLength+1];
+         for(r=0; r<n; r++) pd[r] = (pa[r] - tOff) / tScl;
+      } else {
+         for(r=0; r<n; r++) pd[r] = pa[r];
+      }
+      if(!tfCheck) for(r=0; r<n; r++) ucBad[r] = (pd[r] - pd[r] != (T) 0.00); // inf or NaN
+      else if(sizeof(T) == sizeof(float)) for(r=0; r<n; r++) ucBad[r] |= (pd[r] - pd[r] != (T) 0.00); // may be beyond float range
+
+      //===Flagged rows==================================
+      for(iBad=0, r=0; r<n; r++) iBad |= ucBad[r];
+      if(iBad) {
+         for(r=0; r<n; r++)
+            if(ucBad[r] && !_DoBatchRow(pVar, pBind, iRow0+r, pdRow, pAns, pStatus, &First)) break;
+      }
+   }//for(iRow0)
+
+   //===Finish============================================
+   if(piErrRow) *piErrRow = First.iRow;
+   if((m_dScleTarget == 0.00)
+      && ((m_uUnitStatic.u != m_uUnitAns.u) || m_tfUnitAnsDerived)) { // same as DoEquation(..)
+      m_uUnitAns = m_uUnitStatic;
+      m_tfUnitAnsDerived = FALSE;
+      m_tfUnitStale = TRUE;
+   }
+   free(pSlot);
+   free(pMem);
+   free(pdRow);
+   if(pucConj) free(pucConj);
+   iErrorLocation = First.iPos;
+   return(iError=First.iError);
+}
+
+/*********************************************************
+* ConvertUnits
+* Converts iNum values from unit pszFrom to unit pszTo,
+* using the unit syntax following "#" in an equation,
+* e.g. "degF" to "K", or "nmi" to "m". pdIn and pdOut may
+* be the same array.
+* Returns EQERR_EVAL_UNITMISMATCH if the units are not of
+* the same dimension, or the error parsing either unit.
+*********************************************************/
+int CEquation::ConvertUnits(const char *pszFrom, const char *pszTo, const double pdIn[], double pdOut[], int iNum) {
+   CEquation Eq;                            // for _StringToUnit(..)
+   UNITBASE  uFrom, uTo;                    // dimensions
+   double    dSclFrom, dOffFrom;            // from unit to SI
+   double    dSclTo, dOffTo;                // to unit to SI
+   double    dScl, dOff;                    // combined conversion
+   int       iErr;                          // return code
+
+   if((pszFrom == NULL) || (pszTo == NULL)) return(EQERR_PARSE_UNITEXPECTED);
+   if((iErr = Eq._StringToUnit(pszFrom, NULL, 0, &uFrom, &dSclFrom, &dOffFrom)) != EQERR_NONE) return(iErr);
+   if((iErr = Eq._StringToUnit(pszTo,   NULL, 0, &uTo,   &dSclTo,   &dOffTo  )) != EQERR_NONE) return(iErr);
+   if(uFrom.u != uTo.u) return(EQERR_EVAL_UNITMISMATCH);
+
+   //---Single multiply-add per value-----------
+   // x_to = (x_from * scl_from + off_from - off_to) / scl_to
+   dScl = dSclFrom / dSclTo;
+   dOff = (dOffFrom - dOffTo) / dSclTo;
+   for(int k=0; k<iNum; k++) pdOut[k] = pdIn[k] * dScl + dOff;
+   return(EQERR_NONE);
+}
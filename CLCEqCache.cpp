@@ -0,0 +1,260 @@
+/*****************************************************************************
+*  CLCEqCache.cpp                                       CSIVM LaserCanvas
+*  Cache of parsed CEquation programs keyed by equation text
+*  Class declaration in CLCEqCache.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* Servers and batch tools tend to receive the same few formulas over and over.
+* CEquationCache keeps the parsed RPN program of recently used equations so
+* that only the first occurrence pays for ParseEquation(..).
+*
+* Usage Example
+* -------------
+*    CEquationCache Cache;                  // shared by all threads
+*    CEquation      Eq;                     // per-request equation
+*
+*    if(Cache.ParseEquation(&Eq, "x + sin(pi * y)", "x\0y\0") == EQERR_NONE)
+*       Eq.DoEquation(dVar, &dAns);
+*
+* On a hit, the supplied equation shares the cached program, as a copy of a
+* CEquation does: no parsing takes place and nothing is allocated. The cache
+* keeps its own copy of each program, made once on the miss, and a program
+* stays alive while any equation shares it, even after its entry is evicted.
+* Parse errors are not cached, and are reported on the supplied equation ex-
+* actly as by CEquation::ParseEquation(..).
+*
+* Memory use is accounted per entry (key, source string, and RPN stack). When
+* the budget is exceeded, least-recently-used entries are evicted.
+******************************************************************************/
+#include "CLCEqCache.h"                     // header file and definitions
+
+/*********************************************************
+*  Constructor and initialization
+*********************************************************/
+CEquationCache::CEquationCache(size_t uMaxBytes) {
+   EQLOCK_INIT(&m_Lock);                    // prepare lock
+   m_iNumBucket = EQCACHE_MINBUCKETS;       // initial table size
+   m_ppBucket   = (EQCACHEENTRY**) calloc(m_iNumBucket, sizeof(EQCACHEENTRY*));
+   if(m_ppBucket == NULL) m_iNumBucket = 0; // cache disabled on alloc failure
+   m_pLruHead   = NULL;                     // no entries yet
+   m_pLruTail   = NULL;
+   memset(&m_Stats, 0x00, sizeof(m_Stats)); // clear counters
+   m_Stats.uMaxBytes = uMaxBytes;           // memory budget
+}
+
+/*********************************************************
+*  Destructor
+*********************************************************/
+CEquationCache::~CEquationCache() {
+   Clear();                                 // free all entries
+   if(m_ppBucket) free(m_ppBucket);
+   m_ppBucket = NULL;
+   EQLOCK_DELETE(&m_Lock);
+}
+
+/*********************************************************
+*  Key
+*  The key is the equation text and its NULL, followed by
+*  the double-NULL terminated variable name list (or just
+*  a single NULL if there are no variables).
+*********************************************************/
+int CEquationCache::_KeyLength(const char *szEqn, const char *pszVars, int *piEqnLen) {
+   const char *psz;                         // loop pointer into variable list
+   *piEqnLen = (int) strlen(szEqn) + 1;     // text including NULL
+   if(pszVars == NULL) return(*piEqnLen + 1);
+   for(psz=pszVars; *psz; psz+=strlen(psz)+1); // skip to double-NULL
+   return(*piEqnLen + (int)(psz - pszVars) + 1);
+}
+
+//===Find=================================================
+EQCACHEENTRY *CEquationCache::_Find(const char *pKey, int iKeyLen, unsigned int uHash) {
+   EQCACHEENTRY *pEnt;                      // loop pointer
+   if(m_iNumBucket <= 0) return(NULL);
+   for(pEnt=m_ppBucket[uHash & (m_iNumBucket-1)]; pEnt; pEnt=pEnt->pNext) {
+      if((pEnt->uHash==uHash) && (pEnt->iKeyLen==iKeyLen)
+         && (memcmp(pEnt->pszKey, pKey, iKeyLen)==0)) return(pEnt);
+   }
+   return(NULL);
+}
+
+/*********************************************************
+*  Least-recently-used list
+*********************************************************/
+void CEquationCache::_LruUnlink(EQCACHEENTRY *pEnt) {
+   if(pEnt->pLruPrev) pEnt->pLruPrev->pLruNext = pEnt->pLruNext;
+   else m_pLruHead = pEnt->pLruNext;
+   if(pEnt->pLruNext) pEnt->pLruNext->pLruPrev = pEnt->pLruPrev;
+   else m_pLruTail = pEnt->pLruPrev;
+   pEnt->pLruPrev = pEnt->pLruNext = NULL;
+}
+
+void CEquationCache::_LruPushHead(EQCACHEENTRY *pEnt) {
+   pEnt->pLruPrev = NULL;
+   pEnt->pLruNext = m_pLruHead;
+   if(m_pLruHead) m_pLruHead->pLruPrev = pEnt;
+   else m_pLruTail = pEnt;
+   m_pLruHead = pEnt;
+}
+
+//===Remove===============================================
+void CEquationCache::_Remove(EQCACHEENTRY *pEnt) {
+   EQCACHEENTRY **ppEnt;                    // link to this entry in bucket
+   for(ppEnt=&m_ppBucket[pEnt->uHash & (m_iNumBucket-1)]; *ppEnt; ppEnt=&(*ppEnt)->pNext) {
+      if(*ppEnt == pEnt) { *ppEnt = pEnt->pNext; break; }
+   }
+   _LruUnlink(pEnt);
+   m_Stats.uBytes -= pEnt->uBytes;          // release accounted memory
+   m_Stats.iEntries--;
+   delete(pEnt->pEq);
+   free(pEnt);                              // key follows the entry
+}
+
+//===Trim=================================================
+void CEquationCache::_Trim(size_t uMaxBytes) {
+   while((m_pLruTail != NULL) && (m_Stats.uBytes > uMaxBytes)) {
+      _Remove(m_pLruTail);                  // drop least recently used
+      m_Stats.ulEvictions++;
+   }
+}
+
+//===Grow=================================================
+// Rehash into twice as many buckets. Keeps chains short
+// when the budget allows many small entries.
+void CEquationCache::_Grow(void) {
+   EQCACHEENTRY **ppNew;                    // new bucket array
+   EQCACHEENTRY  *pEnt, *pNext;             // loop pointers
+   int            iNew = m_iNumBucket * 2;  // new bucket count
+
+   ppNew = (EQCACHEENTRY**) calloc(iNew, sizeof(EQCACHEENTRY*));
+   if(ppNew == NULL) return;                // keep existing table on failure
+   for(int k=0; k<m_iNumBucket; k++) {
+      for(pEnt=m_ppBucket[k]; pEnt; pEnt=pNext) {
+         pNext = pEnt->pNext;
+         pEnt->pNext = ppNew[pEnt->uHash & (iNew-1)];
+         ppNew[pEnt->uHash & (iNew-1)] = pEnt;
+      }
+   }
+   free(m_ppBucket);
+   m_ppBucket   = ppNew;
+   m_iNumBucket = iNew;
+}
+
+/*********************************************************
+*  ParseEquation
+*  Equivalent to pEq->ParseEquation(szEqn, pszVars, pCtx),
+*  but answered from the cache when the same text and
+*  variable list were parsed before.
+*  Returns an error code, which is also left in pEq.
+*********************************************************/
+int CEquationCache::ParseEquation(CEquation *pEq, const char *szEqn, const char *pszVars, CEqParseContext *pCtx) {
+   EQCACHEENTRY *pEnt;                      // matched or new entry
+   CEquation    *pEqNew;                    // cache's own copy of the program
+   char          szKey[EQCACHE_KEYBYTES];   // short keys assembled here..
+   char         *pszKey;                    //..longer ones on the heap
+   int           iKeyLen;                   // length of key
+   int           iEqnLen;                   // length of equation text in key
+   unsigned int  uHash;                     // key hash
+   int           iErr;                      // return code
+
+   if((pEq==NULL) || (szEqn==NULL)) return(EQERR_PARSE_NOEQUATION);
+
+   //---Assemble key----------------------------
+   iKeyLen = _KeyLength(szEqn, pszVars, &iEqnLen);
+   pszKey  = (iKeyLen <= (int) sizeof(szKey)) ? szKey : (char*) malloc(iKeyLen);
+   if(pszKey == NULL) return(pEq->ParseEquation(szEqn, pszVars, pCtx)); // just parse
+   memcpy(pszKey, szEqn, iEqnLen);
+   if(pszVars) memcpy(pszKey+iEqnLen, pszVars, iKeyLen-iEqnLen);
+   else pszKey[iEqnLen] = '\0';
+   uHash = EqHashFnv1a(pszKey, iKeyLen);
+
+   //---Lookup----------------------------------
+   EQLOCK_ENTER(&m_Lock);
+   pEnt = _Find(pszKey, iKeyLen, uHash);
+   if(pEnt) {
+      _LruUnlink(pEnt);                     // now most recently used
+      _LruPushHead(pEnt);
+      m_Stats.ulHits++;
+      pEq->_ShareProgram(pEnt->pEq);        // share while entry is pinned by the lock
+      iErr = pEq->iError;
+      EQLOCK_LEAVE(&m_Lock);
+      if(pszKey != szKey) free(pszKey);
+      return(iErr);
+   }
+   m_Stats.ulMisses++;
+   EQLOCK_LEAVE(&m_Lock);
+
+   //---Miss: parse outside lock----------------
+   iErr = pEq->ParseEquation(szEqn, pszVars, pCtx);
+   pEnt = NULL;
+   if(iErr == EQERR_NONE) {                 // errors are not cached
+      pEnt = (EQCACHEENTRY*) calloc(1, sizeof(EQCACHEENTRY) + iKeyLen);
+      if(pEnt) {
+         pEnt->pszKey = (char*) (pEnt + 1);
+         memcpy(pEnt->pszKey, pszKey, iKeyLen);
+      }
+   }
+   if(pszKey != szKey) free(pszKey);
+   if(pEnt == NULL) return(iErr);
+   pszKey = pEnt->pszKey;
+
+   pEqNew = new CEquation;
+   if((pEqNew==NULL) || (pEqNew->_CopyProgram(pEq)!=EQERR_NONE)) {
+      delete(pEqNew);
+      free(pEnt);
+      return(iErr);                         // parsed fine, just not cached
+   }
+   pEnt->uHash  = uHash;
+   pEnt->iKeyLen= iKeyLen;
+   pEnt->pEq    = pEqNew;
+   pEnt->uBytes = sizeof(EQCACHEENTRY) + iKeyLen + pEqNew->GetMemoryUsage();
+
+   //---Insert----------------------------------
+   EQLOCK_ENTER(&m_Lock);
+   if((m_iNumBucket <= 0) || (pEnt->uBytes > m_Stats.uMaxBytes)
+      || (_Find(pszKey, iKeyLen, uHash) != NULL)) { // disabled, too big, or another thread won
+      EQLOCK_LEAVE(&m_Lock);
+      delete(pEqNew);
+      free(pEnt);
+      return(iErr);
+   }
+   _Trim(m_Stats.uMaxBytes - pEnt->uBytes); // make room
+   if(m_Stats.iEntries >= 2*m_iNumBucket) _Grow();
+   pEnt->pNext = m_ppBucket[uHash & (m_iNumBucket-1)];
+   m_ppBucket[uHash & (m_iNumBucket-1)] = pEnt;
+   _LruPushHead(pEnt);
+   m_Stats.uBytes += pEnt->uBytes;
+   m_Stats.iEntries++;
+   EQLOCK_LEAVE(&m_Lock);
+   return(iErr);
+}
+
+/*********************************************************
+*  Budget, statistics, and clearing
+*********************************************************/
+void CEquationCache::SetMaxBytes(size_t uMaxBytes) {
+   EQLOCK_ENTER(&m_Lock);
+   m_Stats.uMaxBytes = uMaxBytes;
+   _Trim(uMaxBytes);                        // evict down to new budget
+   EQLOCK_LEAVE(&m_Lock);
+}
+
+void CEquationCache::Clear(void) {
+   EQLOCK_ENTER(&m_Lock);
+   while(m_pLruHead) _Remove(m_pLruHead);   // not counted as evictions
+   EQLOCK_LEAVE(&m_Lock);
+}
+
+void CEquationCache::GetStats(EQCACHESTATS *pStats) {
+   if(pStats == NULL) return;
+   EQLOCK_ENTER(&m_Lock);
+   *pStats = m_Stats;
+   EQLOCK_LEAVE(&m_Lock);
+}
+
+void CEquationCache::ResetStats(void) {
+   EQLOCK_ENTER(&m_Lock);
+   m_Stats.ulHits = m_Stats.ulMisses = m_Stats.ulEvictions = 0;
+   EQLOCK_LEAVE(&m_Lock);
+}
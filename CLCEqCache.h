@@ -0,0 +1,72 @@
+/*****************************************************************************
+*  CLCEqCache.h                                         CSIVM LaserCanvas
+*  Cache of parsed CEquation programs keyed by equation text
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+#ifndef CLCEQCACHE_H
+#define CLCEQCACHE_H
+#include "CLCEqtn.h"                        // CEquation class
+
+#define EQCACHE_DEFAULTBYTES   (4*1024*1024) // default memory budget
+#define EQCACHE_MINBUCKETS           64     // initial hash table size
+#define EQCACHE_KEYBYTES            256     // keys up to this long looked up without malloc
+
+//---Statistics---------------------------------
+typedef struct tagEQCACHESTATS {
+   unsigned long ulHits;                    // lookups answered from the cache
+   unsigned long ulMisses;                  // lookups that had to parse
+   unsigned long ulEvictions;               // entries dropped to respect the budget
+   int           iEntries;                  // number of cached programs
+   size_t        uBytes;                    // memory held by cached programs
+   size_t        uMaxBytes;                 // memory budget
+} EQCACHESTATS;
+
+//---Cache entry--------------------------------
+typedef struct tagEQCACHEENTRY {
+   struct tagEQCACHEENTRY *pNext;           // next in hash bucket
+   struct tagEQCACHEENTRY *pLruPrev;        // more recently used
+   struct tagEQCACHEENTRY *pLruNext;        // less recently used
+   unsigned int  uHash;                     // hash of key
+   char         *pszKey;                    // equation text, NULL, variable list (follows entry)
+   int           iKeyLen;                   // length of key including all NULLs
+   size_t        uBytes;                    // memory accounted to this entry
+   CEquation    *pEq;                       // parsed equation
+} EQCACHEENTRY;
+
+/*********************************************************
+* CEquationCache declaration
+* Bounded least-recently-used cache of parsed equations.
+* The key is the equation text together with the variable
+* name list, since the same text compiles differently for
+* different variable names. Calls may be made from several
+* threads at once; parsing on a miss happens outside the
+* lock.
+*********************************************************/
+class CEquationCache {
+private:
+   EQLOCK          m_Lock;                  // serializes access to everything below
+   EQCACHEENTRY  **m_ppBucket;              // hash buckets
+   int             m_iNumBucket;            // number of buckets (power of 2)
+   EQCACHEENTRY   *m_pLruHead;              // most recently used
+   EQCACHEENTRY   *m_pLruTail;              // least recently used
+   EQCACHESTATS    m_Stats;                 // counters and memory use
+
+   static int  _KeyLength(const char *szEqn, const char *pszVars, int *piEqnLen);
+   EQCACHEENTRY *_Find(const char *pKey, int iKeyLen, unsigned int uHash);
+   void  _LruUnlink(EQCACHEENTRY *pEnt);
+   void  _LruPushHead(EQCACHEENTRY *pEnt);
+   void  _Remove(EQCACHEENTRY *pEnt);       // unlink and free an entry
+   void  _Trim(size_t uMaxBytes);           // evict until within budget
+   void  _Grow(void);                       // double the number of buckets
+
+public:
+   CEquationCache(size_t uMaxBytes=EQCACHE_DEFAULTBYTES);
+   ~CEquationCache();
+   int   ParseEquation(CEquation *pEq, const char *szEqn, const char *pszVars, CEqParseContext *pCtx=NULL); // parse, or share from cache
+   void  SetMaxBytes(size_t uMaxBytes);     // change the memory budget
+   void  Clear(void);                       // drop all entries
+   void  GetStats(EQCACHESTATS *pStats);    // snapshot of counters
+   void  ResetStats(void);                  // zero the hit/miss/eviction counters
+};
+
+#endif/*CLCEQCACHE_H*/
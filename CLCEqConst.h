@@ -0,0 +1,1152 @@
+/*****************************************************************************
+*  CLCEqConst.h                                         CSIVM LaserCanvas
+*  Compile-time parsing of equations fixed in the source code
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* Formulas that are fixed in the program's own source do not need a CEquation
+* at run time. EQCONST(..) parses the string literal while compiling, with the
+* grammar, operators, constants and units of ParseEquation(..), and yields an
+* object whose call operator is straight-line code that the compiler inlines,
+* and vectorizes where the functions allow:
+*
+*    static constexpr auto Waist = EQCONST("w0 um * sqrt(1 + (z/zR)^2) # um",
+*                                          "w0\0z\0zR\0");
+*    for(k=0; k<n; k++) pdW[k] = Waist(w0, pdZ[k], zR);
+*
+* Equations that ParseEquation(..) would reject fail to compile, as do those
+* that DoEquation(..) would fail on units for every row, and those whose units
+* depend on the values (a dimensioned base raised to a variable or fractional
+* power, if(..) or mod / rem on different units). The diagnostic names
+* EQCX_ERROR<iError, iPos>, the EQERR_ code and position in the string.
+*
+* Evaluation
+* ----------
+*  Eq(a, b, ..)          One argument per variable, in the order of the var-
+*                        iable list. No argument checks: division by zero,
+*                        log of negative numbers etc. give inf / NaN, as with
+*                        EQBATCH_UNCHECKED. All float arguments evaluate in
+*                        float, anything else in double.
+*  Eq.Answer(pVar)       The same, variables in an array (double or float).
+*  Eq.DoEquation(pdVar, pdAns)
+*                        Checked as DoEquation(..): returns the same EQERR_
+*                        code, and the source position in *piPos if given.
+*
+* Results are those of DoEquation(..), but may differ in the last bit where
+*  - the compiler turns pow(x, 2) with a constant exponent into x*x,
+*  - numbers have more than 15 significant digits or exponents beyond +/-22,
+*    as they are read here rather than by sscanf(..), and
+*  - target units carry powers (e.g. "# cm3").
+* Hexadecimal numbers are not read, and target units with fractional powers
+* must be unscaled ("# m0.5", not "# mm0.5").
+*
+* Requires C++17. Programs are limited to EQCX_MAXOPS tokens.
+******************************************************************************/
+#ifndef CLCEQCONST_H
+#define CLCEQCONST_H
+#if !((__cplusplus >= 201703L) || (defined(_MSVC_LANG) && (_MSVC_LANG >= 201703L)))
+# error CLCEqConst.h requires C++17
+#endif
+#include "CLCEqTables.h"                    // tables, OP_ and EQERR_ codes
+#include <utility>                          // std::index_sequence
+#include <type_traits>                      // std::conditional, std::is_same
+
+#define EQCX_MAXOPS                 256     // longest program, and parse stacks
+#define EQCX_CONSTMAX             1e150     // largest constant followed by the unit analysis
+
+//===Program==============================================
+// As VALOP, without the union (constant evaluation can not
+// switch union members), and with what _AnalyzeProgram()
+// learns about each token.
+typedef struct tagEQCXOP {
+   unsigned char uTyp = VOTYP_UNDEFINED;    // VOTYP_ type
+   int    iOp   = 0;                        // operator, variable, unit index or argument count
+   double dVal  = 0.00;                     // value; scale of unit
+   double dOff  = 0.00;                     // offset of unit
+   int    iPos  = 0;                        // position in source string
+   int    iTop  = 0;                        // stack height before this token
+   int    iArgc = 0;                        // arguments of operator
+} EQCXOP;
+
+typedef struct tagEQCXPROG {
+   EQCXOP op[EQCX_MAXOPS];                  // program
+   int    iNumOps     = 0;                  // tokens in program
+   int    iError      = EQERR_NONE;         // parse or unit error
+   int    iErrPos     = 0;                  // position of error in source
+   int    iNumVar     = 0;                  // variables referenced
+   int    iNumArg     = 0;                  // variables in list
+   int    iDepth      = 0;                  // maximum stack height
+   unsigned long long uUnitAns = 0;         // dimension of answer (UNITBASE)
+   bool   tfTarget    = false;              // "#" target unit given
+   unsigned long long uUnitTarget = 0;      // target dimension
+   double dScleTarget = 0.00;               // target scale and offset
+   double dOffsTarget = 0.00;
+} EQCXPROG;
+
+//===Stack================================================
+// Fixed-size counterpart of TEqStack, same semantics.
+template<class T> struct TEqCxStack {
+   T    t[EQCX_MAXOPS] = {};                // elements
+   int  iTop = 0;                           // number of elements
+
+   constexpr int Push(T v) {
+      if(iTop >= EQCX_MAXOPS) return(-1);
+      t[iTop++] = v;
+      return(iTop);
+   }
+   constexpr int InsertBack(T v, int iOffs) {
+      if(iTop >= EQCX_MAXOPS) return(-1);
+      for(int k=iTop; k>iTop+iOffs; k--) t[k] = t[k-1];
+      t[iTop+iOffs] = v;
+      return(++iTop);
+   }
+   constexpr T   Pop(void)  { return((iTop <= 0) ? T() : t[--iTop]); }
+   constexpr T   Peek(void) const { return((iTop <= 0) ? T() : t[iTop-1]); }
+   constexpr int Top(void)  const { return(iTop); }
+   constexpr T   PeekBack(int iOffs=-1) const {
+      return(((iTop+iOffs) < 0) || (iOffs >= 0) ? T() : t[iTop+iOffs]);
+   }
+};
+
+//===String Helpers=======================================
+constexpr int _EqCxStrLen(const char *psz) {
+   int n = 0;
+   while(psz[n]) n++;
+   return(n);
+}
+
+// strchr(pszSet, c) != NULL, including the terminating NULL
+constexpr bool _EqCxStrChr(const char *pszSet, char c) {
+   for(int k=0; ; k++) {
+      if(pszSet[k] == c) return(true);
+      if(pszSet[k] == '\0') return(false);
+   }
+}
+
+constexpr int _EqCxStrNCmp(const char *psz1, const char *psz2, int n) {
+   for(int k=0; k<n; k++) {
+      if(psz1[k] != psz2[k]) return(((unsigned char) psz1[k] < (unsigned char) psz2[k]) ? -1 : 1);
+      if(psz1[k] == '\0') return(0);
+   }
+   return(0);
+}
+
+//===Numbers==============================================
+constexpr double _EqCxFloor(double d) {
+   long long ll = 0;
+   if((d != d) || (d >= 9.0e18) || (d <= -9.0e18)) return(d); // NaN, or integer already
+   ll = (long long) d;
+   return(((double) ll > d) ? (double) (ll-1) : (double) ll);
+}
+
+constexpr double _EqCxFabs(double d) { return((d < 0.00) ? -d : d); }
+
+// x^n for integer n, rounded once from long double
+constexpr double _EqCxPowInt(double dX, long lN) {
+   long double ldP = 1.0L, ldX = dX;
+   long lAbs = (lN < 0) ? -lN : lN;
+   if(lN == 1) return(dX);
+   for(; lAbs > 0; lAbs >>= 1) {
+      if(lAbs & 1) ldP *= ldX;
+      ldX *= ldX;
+   }
+   return((double) ((lN < 0) ? 1.0L / ldP : ldP));
+}
+
+//---Scan number--------------------------------
+// Reads a decimal number as sscanf("%lg") would, with an
+// optional sign. Returns the characters read, 0 if none.
+constexpr int _EqCxScanNumber(const char *psz, double *pd) {
+   unsigned long long uMant = 0;            // significant digits
+   int  iDigits = 0;                        // digits in uMant
+   int  iExp    = 0;                        // decimal exponent of uMant
+   int  iExpIn  = 0;                        // exponent as written
+   int  iSign   = 1, iExpSign = 1;          // signs
+   int  iNum    = 0;                        // digits seen
+   int  k = 0, kExp = 0;                    // scan position
+   long double ldVal = 0.0L, ldPwr = 1.0L;  // slow path
+   double dVal = 0.00;                      // fast path
+   const double dPwr10[23] = { 1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,
+      1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22 };
+
+   if((psz[k] == '+') || (psz[k] == '-')) {
+      iSign = (psz[k] == '-') ? -1 : 1;
+      k++;
+   }
+   for(; (psz[k] >= '0') && (psz[k] <= '9'); k++, iNum++) {
+      if(iDigits < 19) {
+         uMant = 10*uMant + (psz[k]-'0');
+         if(uMant) iDigits++;
+      }
+      else iExp++;
+   }
+   if(psz[k] == '.') {
+      for(k++; (psz[k] >= '0') && (psz[k] <= '9'); k++, iNum++) {
+         if(iDigits < 19) {
+            uMant = 10*uMant + (psz[k]-'0');
+            if(uMant) iDigits++;
+            iExp--;
+         }
+      }
+   }
+   if(iNum == 0) return(0);
+   if((psz[k] == 'e') || (psz[k] == 'E')) { // exponent only if digits follow
+      kExp = k+1;
+      if((psz[kExp] == '+') || (psz[kExp] == '-')) { iExpSign = (psz[kExp] == '-') ? -1 : 1; kExp++; }
+      if((psz[kExp] >= '0') && (psz[kExp] <= '9')) {
+         for(; (psz[kExp] >= '0') && (psz[kExp] <= '9'); kExp++) if(iExpIn < 100000) iExpIn = 10*iExpIn + (psz[kExp]-'0');
+         iExp += iExpSign * iExpIn;
+         k = kExp;
+      }
+   }
+
+   if(uMant == 0) {
+      dVal = 0.00;
+   } else if((uMant < (1ull << 53)) && (iExp >= -22) && (iExp <= 22)) { // exact operands, one rounding
+      dVal = (iExp >= 0) ? (double) uMant * dPwr10[iExp] : (double) uMant / dPwr10[-iExp];
+   } else if(iExp + iDigits > 310) {
+      dVal = HUGE_VAL;
+   } else if(iExp + iDigits < -330) {
+      dVal = 0.00;
+   } else {
+      ldVal = (long double) uMant;
+      for(int e=(iExp<0)?-iExp:iExp; e>0; e--) ldPwr *= 10.0L;
+      dVal = (double) ((iExp < 0) ? ldVal / ldPwr : ldVal * ldPwr);
+   }
+   *pd = iSign * dVal;
+   return(k);
+}
+
+//===Dimensions===========================================
+// EqDimMul(..) etc. on the packed UNITBASE.u
+constexpr long _EqCxGcd(long a, long b) {
+   long t = 0;
+   a = ABS(a); b = ABS(b);
+   while(b != 0) { t = a % b; a = b; b = t; }
+   return(a);
+}
+
+constexpr int _EqCxDimPack(long *plNum, long lDen, unsigned long long *pu) {
+   long lGcd = lDen;
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) lGcd = _EqCxGcd(lGcd, plNum[iBase]);
+   if(lGcd > 1) {
+      for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) plNum[iBase] /= lGcd;
+      lDen /= lGcd;
+   }
+   if((lDen < 1) || (lDen > 256)) return(EQERR_EVAL_UNITRANGE);
+   *pu = (unsigned long long) (lDen-1) << EQDIM_DENSHIFT;
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) {
+      if((plNum[iBase] < -128) || (plNum[iBase] > 127)) return(EQERR_EVAL_UNITRANGE);
+      *pu |= EQDIM_LANE(plNum[iBase], iBase);
+   }
+   return(EQERR_NONE);
+}
+
+// iSign +1 multiplies, -1 divides
+constexpr int _EqCxDimMul(unsigned long long u1, unsigned long long u2, int iSign, unsigned long long *pu) {
+   long lNum[EQSI_NUMUNIT_BASE] = {};
+   long lDen1 = (long) (u1 >> EQDIM_DENSHIFT) + 1;
+   long lDen2 = (long) (u2 >> EQDIM_DENSHIFT) + 1;
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++)
+      lNum[iBase] = (signed char) (u1 >> (8*iBase)) * lDen2 + iSign * (signed char) (u2 >> (8*iBase)) * lDen1;
+   return(_EqCxDimPack(lNum, lDen1*lDen2, pu));
+}
+
+constexpr int _EqCxDimPow(unsigned long long u1, double dPwr, unsigned long long *pu) {
+   long lNum[EQSI_NUMUNIT_BASE] = {};
+   long lP = 0, lQ = 1;
+   double dP = 0.00;
+
+   if((u1 == 0) || (dPwr == 1.00)) { *pu = u1; return(EQERR_NONE); }
+   if(_EqCxFabs(dPwr) > 32767.00) return(EQERR_EVAL_UNITRANGE);
+   for(lQ=1; lQ<=EQDIM_MAXDEN; lQ++) {
+      dP = dPwr * lQ;
+      lP = (long) _EqCxFloor(dP + 0.50);
+      if(_EqCxFabs(dP - lP) < 1e-9 * lQ) break;
+   }
+   if(lQ > EQDIM_MAXDEN) return(EQERR_EVAL_UNITRANGE);
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) lNum[iBase] = (signed char) (u1 >> (8*iBase)) * lP;
+   return(_EqCxDimPack(lNum, ((long) (u1 >> EQDIM_DENSHIFT) + 1) * lQ, pu));
+}
+
+//===Units================================================
+// As _EqUnitLookup(..): the iLen characters at psz are a
+// unit, or a prefix followed by a unit; plain units win.
+typedef struct tagEQCXUNIT {
+   int    iUnit  = -1;                      // index into CEquationSIUnit
+   int    iPrfx  = -1;                      // index into CEquationSIUnitPrefix, or -1
+   double dScale = 1.00;                    // prefix times unit scale
+   double dOffset= 0.00;                    // unit offset
+} EQCXUNIT;
+
+constexpr bool _EqCxUnitLookup(const char *psz, int iLen, EQCXUNIT *pUnit) {
+   const char *pszUnit = nullptr;           // unit string loop pointer
+   int iUnit = 0, iPrfx = 0;                // loop counters
+   int iOffs = 0;                           // prefix length
+
+   if((iLen <= 0) || (iLen >= 8)) return(false); // EQUNIT_MAXKEY
+   for(iPrfx=-1; iPrfx<EQSI_NUMUNIT_PREFIX; iPrfx++) {
+      if((iPrfx >= 0) && (psz[0] != CEquationSIUnitPrefixStr[iPrfx])) continue;
+      iOffs = (iPrfx >= 0) ? 1 : 0;
+      for(pszUnit=CEquationSIUnitStr, iUnit=0; iUnit<EQSI_NUMUNIT_INPUT; pszUnit+=_EqCxStrLen(pszUnit)+1, iUnit++) {
+         if((_EqCxStrLen(pszUnit) == iLen-iOffs) && (_EqCxStrNCmp(psz+iOffs, pszUnit, iLen-iOffs) == 0)) {
+            pUnit->iUnit   = iUnit;
+            pUnit->iPrfx   = iPrfx;
+            pUnit->dScale  = ((iPrfx >= 0) ? CEquationSIUnitPrefix[iPrfx] : 1.00) * CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE];
+            pUnit->dOffset = CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE+1];
+            return(true);
+         }
+      }
+   }
+   return(false);
+}
+
+//---Target unit--------------------------------
+// As CEquation::_StringToUnit(..).
+constexpr int _EqCxStringToUnit(const char *psz, EQCXPROG *pProg, int *piErrLoc) {
+   unsigned long long uUnit = 0, uUnitCur = 0; // dimensions
+   double   dScale = 1.00, dOffset = 0.00;  // result
+   double   dPwrCur = 1.00, dSclCur = 1.00; // current unit
+   double   dVal = 0.00;                    // scanned power
+   int      iUnit = -1, iSign = +1;         // current unit, numerator / denominator
+   int      iTokLen = 0, k = 0;             // token length, scan position
+   int      iNumOut = 0;                    // units and solidus "printed"
+   bool     tfSolidusLast = false;          // output ends in "/"
+   int      iError = EQERR_NONE;
+   EQCXUNIT Key;
+
+   *piErrLoc = 0;
+   if(psz[0] == '\0') return(EQERR_PARSE_UNITEXPECTED);
+   while(psz[k] == ' ') k++;
+   if(psz[k] == '1') k++;                   // skip "1" in "1/" or "1mm"
+
+   do {
+      //---Apply current---
+      if(iUnit >= 0) {
+         if((_EqCxDimPow(uUnitCur, iSign * dPwrCur, &uUnitCur) != EQERR_NONE)
+            || (_EqCxDimMul(uUnit, uUnitCur, +1, &uUnit) != EQERR_NONE)) {
+            iError = EQERR_PARSE_UNITINCOMPATIBLE;
+            break;
+         }
+         uUnitCur = CEquationSIDim[iUnit].u;
+         if((dSclCur != 1.00) && (dPwrCur != _EqCxFloor(dPwrCur))) { iError = EQERR_PARSE_UNITINCOMPATIBLE; break; } // no pow() here
+         if(iSign > 0) dScale *= _EqCxPowInt(dSclCur, (long) dPwrCur);
+         else dScale /= _EqCxPowInt(dSclCur, (long) dPwrCur);
+         dSclCur = dPwrCur = 1.00;
+      }
+
+      while(psz[k] == ' ') k++;
+      if(psz[k] == '\0') break;
+
+      //---Solidus---
+      if(psz[k] == '/') {
+         if(iSign < 1) { iError = EQERR_PARSE_ILLEGALCHAR; break; }
+         iNumOut++;
+         tfSolidusLast = true;
+         iUnit = -1;
+         iSign = -1;
+         k++;
+         continue;
+      }
+
+      //---Unit---
+      for(iTokLen=0; psz[k+iTokLen] && _EqCxStrChr(EQ_VALIDUNIT, psz[k+iTokLen]); iTokLen++);
+      Key = EQCXUNIT();
+      if(!_EqCxUnitLookup(psz+k, iTokLen, &Key)) { iError = EQERR_PARSE_UNITEXPECTED; break; }
+      iUnit = Key.iUnit;
+      if( ((CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE] != 1.00) && (dOffset != 0.00))
+         || ((Key.dOffset != 0.00) && (dScale != 1.00))
+         || ((Key.dOffset != 0.00) && (iSign < 0)) ) {
+         iError = EQERR_PARSE_UNITINCOMPATIBLE;
+         break;
+      }
+      uUnitCur = CEquationSIDim[iUnit].u;
+      dSclCur *= Key.dScale;
+      dOffset += Key.dOffset;
+      iNumOut++;
+      tfSolidusLast = false;
+      k += iTokLen;
+
+      //---Power---
+      while(psz[k] == ' ') k++;
+      if(_EqCxScanNumber(psz+k, &dVal) > 0) {
+         if((dVal < 0.00) && (iSign < 0)) { iError = EQERR_PARSE_UNITEXPECTED; break; }
+         if(dOffset != 0.00) { iError = EQERR_PARSE_UNITINCOMPATIBLE; break; }
+         dPwrCur = dVal;
+         while(psz[k] && _EqCxStrChr("-+0123456789", psz[k])) k++;
+      }
+   } while(iError == EQERR_NONE);
+
+   if((iError == EQERR_NONE) && (iNumOut > 0) && tfSolidusLast) iError = EQERR_PARSE_UNITEXPECTED;
+   if(iError != EQERR_NONE) *piErrLoc = k;
+   pProg->uUnitTarget = uUnit;
+   pProg->dScleTarget = dScale;
+   pProg->dOffsTarget = dOffset;
+   return(iError);
+}
+
+//===Parser===============================================
+// Ports of CEquation::_ProcessOps(..), _ParseEquationUnits(..)
+// and ParseEquation(..); see there for comments.
+constexpr int _EqCxProcessOps(TEqCxStack<EQCXOP> &vos, TEqCxStack<int> &isOps, TEqCxStack<int> &isPos,
+      int iThisOp, int iBrktOff, int *piErrLoc) {
+   int    iPrevOp = 0;
+   EQCXOP vo;
+
+   do {
+      if(isOps.Top() <= 0) break;
+      iPrevOp = isOps.Peek();
+      if(iPrevOp < iThisOp) {
+         if(   (iPrevOp<OP_RELOPMIN) || (iPrevOp>OP_RELOPMAX)
+            || (iThisOp<OP_RELOPMIN) || (iThisOp>OP_RELOPMAX) ) break;
+      }
+      if((iThisOp==OP_PSH+iBrktOff) && (iPrevOp==iThisOp)) break;
+
+      iPrevOp = isOps.Pop();
+      while(iPrevOp >= OP_BRACKETOFFSET) iPrevOp -= OP_BRACKETOFFSET;
+      vo = EQCXOP();
+      vo.uTyp = VOTYP_OP;
+      vo.iOp  = iPrevOp;
+      vo.iPos = isPos.Pop();
+      if(vos.Push(vo) < 0) { *piErrLoc = vo.iPos; return(EQERR_PARSE_STACKOVERFLOW); }
+      if(iPrevOp == OP_SET) {
+         vo.uTyp = VOTYP_REF;
+         vo.iOp  = isOps.Pop();
+         vo.iPos = isPos.Pop();
+         if(vos.Push(vo) < 0) { *piErrLoc = vo.iPos; return(EQERR_PARSE_STACKOVERFLOW); }
+      }
+      iPrevOp -= OP_NARG;
+      if((iPrevOp>=0) && (iPrevOp<NUM_NARGOP) && CEquationNArgOpArgc[iPrevOp]<0) {
+         vo.uTyp = VOTYP_NARGC;
+         vo.iOp  = isOps.Pop();
+         vo.iPos = isPos.Pop();
+         if(vos.Push(vo) < 0) { *piErrLoc = vo.iPos; return(EQERR_PARSE_STACKOVERFLOW); }
+      }
+   } while(1);
+   return(EQERR_NONE);
+}
+
+constexpr int _EqCxParseUnits(const char *psz, int iThisPt, int iBrktOff, TEqCxStack<int> &isOps, TEqCxStack<int> &isPos,
+      TEqCxStack<EQCXOP> &vos, int uLookFor, int *piError, int *piErrLoc) {
+   EQCXUNIT Key;
+   EQCXOP   vo;
+   int      iTokLen = 0, iThisOp = 0;
+
+   for(iTokLen=1; psz[iThisPt+iTokLen] && _EqCxStrChr(EQ_VALIDUNIT, psz[iThisPt+iTokLen]); iTokLen++);
+   if(!_EqCxUnitLookup(psz+iThisPt, iTokLen, &Key)) return(0);
+   if(Key.iPrfx >= 0) iThisPt++;
+
+   //---hanging---
+   if(uLookFor == LOOKFOR_NUMBER) {
+      iThisOp = isOps.Peek(); while(iThisOp > OP_BRACKETOFFSET) iThisOp -= OP_BRACKETOFFSET;
+      switch(iThisOp) {
+      case OP_DIV:
+         vo.uTyp = VOTYP_PREFIX; vo.dVal = 1.00; vo.iPos = iThisPt;
+         if(vos.Push(vo) < 0) { *piError = EQERR_PARSE_STACKOVERFLOW; return(0); }
+         iBrktOff += OP_BRACKETOFFSET;
+         break;
+      case OP_MUL:
+         isOps.Pop();
+         isPos.Pop();
+         break;
+      default:
+         *piError = EQERR_PARSE_NUMBEREXPECTED;
+         return(0);
+      }
+   } else {
+      iThisOp = iBrktOff + OP_BRACKETOFFSET;
+      _EqCxProcessOps(vos, isOps, isPos, iThisOp, iBrktOff, piErrLoc);
+   }
+
+   //---prefix---
+   if(Key.iPrfx >= 0) {
+      if(*piError != EQERR_NONE) return(0);
+      vo = EQCXOP();
+      vo.uTyp = VOTYP_PREFIX; vo.dVal = CEquationSIUnitPrefix[Key.iPrfx]; vo.iPos = iThisPt;
+      if(vos.Push(vo) < 0) { *piError = EQERR_PARSE_STACKOVERFLOW; return(0); }
+      isOps.Push(OP_MUL + iBrktOff);
+      isPos.Push(iThisPt);
+   }
+
+   //---unit---
+   iThisOp = isOps.Peek(); while(iThisOp>OP_BRACKETOFFSET) iThisOp-=OP_BRACKETOFFSET;
+   iThisOp = OP_MUL + iBrktOff + (iThisOp==OP_DIV)*OP_BRACKETOFFSET;
+   vo = EQCXOP();
+   vo.uTyp = VOTYP_UNIT;
+   vo.iOp  = Key.iUnit;
+   vo.iPos = iThisPt;
+   if(vos.Push(vo) < 0) { *piError = EQERR_PARSE_STACKOVERFLOW; return(0); }
+   _EqCxProcessOps(vos, isOps, isPos, iThisOp, iBrktOff, piErrLoc);
+   return(iTokLen);
+}
+
+constexpr void _EqCxAnalyze(EQCXPROG *pProg, int iLen);
+
+constexpr EQCXPROG EqCxParse(const char *_szEqtn, const char *pszVars) {
+   EQCXPROG Prog;                           // result
+   TEqCxStack<int>    isPos;                // stack of operator positions
+   TEqCxStack<int>    isOps;                // stack of pending operations
+   TEqCxStack<EQCXOP> vosParsEqn;           // RPN stack of parsed equation
+   int    uLookFor  = LOOKFOR_NUMBER;       // parse status, next token
+   int    iLen      = _EqCxStrLen(_szEqtn); // source length
+   int    iThisPt   = 0;                    // index into source string
+   int    iThisScan = 0;                    // advance in this scan
+   double dThisVal  = 0.00;                 // numeric value
+   int    iTokLen   = 0;                    // length of this token
+   int    iThisOp   = 0;                    // current binary operator
+   int    iUnOp = 0, iNArgOp = 0, iCnst = 0, iVrbl = 0; // loop counters
+   const char *pszSt = nullptr;             // offset into character arrays
+   int    iBrktOff  = 0;                    // bracket offset
+   int    iError    = EQERR_NONE;           // parse error
+   int    iErrLoc   = 0;                    // error location
+   EQCXOP vo;                               // value/operator for stack
+
+   while((iThisPt < iLen) && (iError==EQERR_NONE)) {
+      while(_szEqtn[iThisPt] == ' ') iThisPt++;
+      if(iThisPt >= iLen) break;
+      if(_EqCxStrChr(EQ_ILLEGALCHAR, _szEqtn[iThisPt])) { iError = EQERR_PARSE_ILLEGALCHAR; break; }
+      iThisScan = 0;
+      vo = EQCXOP();
+
+      switch(uLookFor) {
+      //---Number-----------------------------------------
+      case LOOKFOR_NUMBER:
+         if(_EqCxStrChr(EQ_VALIDCHAR, _szEqtn[iThisPt])) {
+            iTokLen = 1;
+            while((iThisPt+iTokLen < iLen) && _EqCxStrChr(EQ_VALIDSYMB, _szEqtn[iThisPt+iTokLen])) iTokLen++;
+
+            //---variables---
+            if(pszVars != nullptr) {
+               for(pszSt=pszVars, iVrbl=0; *pszSt; pszSt+=_EqCxStrLen(pszSt)+1, iVrbl++) {
+                  if(_EqCxStrNCmp(_szEqtn+iThisPt, pszSt, MAX(_EqCxStrLen(pszSt), iTokLen)) == 0) {
+                     vo.uTyp = VOTYP_REF; vo.iOp = iVrbl; vo.iPos = iThisPt;
+                     if(vosParsEqn.Push(vo) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+                     iThisScan = _EqCxStrLen(pszSt);
+                     uLookFor = LOOKFOR_BINARYOP;
+                     break;
+                  }
+               }
+               if(uLookFor==LOOKFOR_BINARYOP) break;
+            }
+
+            //---dimensioned constant---
+            for(pszSt=CEquationSIUnitConstStr, iCnst=0; iCnst<EQSI_NUMCONST; pszSt+=_EqCxStrLen(pszSt)+1, iCnst++) {
+               if(_EqCxStrNCmp(_szEqtn+iThisPt, pszSt, MAX(_EqCxStrLen(pszSt), iTokLen)) == 0) {
+                  vo.uTyp = VOTYP_VAL; vo.dVal = CEquationSIConst[iCnst]; vo.iPos = iThisPt;
+                  if(vosParsEqn.Push(vo) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+                  if(CEquationSIConstUnitIndx[iCnst] >= 0) {
+                     vo = EQCXOP();
+                     vo.uTyp = VOTYP_UNIT; vo.iOp = CEquationSIConstUnitIndx[iCnst]; vo.iPos = iThisPt;
+                     if(vosParsEqn.Push(vo) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+                  }
+                  iThisScan = _EqCxStrLen(pszSt);
+                  uLookFor = LOOKFOR_BINARYOP;
+                  break;
+               }
+            }
+            if(iCnst < EQSI_NUMCONST) break;
+
+            //---unary---
+            for(pszSt=CEquationUnaryOpStr, iUnOp=0; iUnOp<NUM_UNARYOP; pszSt+=_EqCxStrLen(pszSt)+1, iUnOp++) {
+               if(_EqCxStrNCmp(_szEqtn+iThisPt, pszSt, MAX(_EqCxStrLen(pszSt), iTokLen)) == 0) {
+                  isPos.Push(iThisPt);
+                  if(isOps.Push(OP_UNARY + iUnOp + iBrktOff) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+                  iThisScan = iTokLen;
+                  uLookFor = LOOKFOR_BRACKET;
+                  break;
+               }
+            }
+            if(iUnOp < NUM_UNARYOP) break;
+
+            //---n-arg---
+            for(pszSt=CEquationNArgOpStr, iNArgOp=0; iNArgOp<NUM_NARGOP; pszSt+=_EqCxStrLen(pszSt)+1, iNArgOp++) {
+               if(_EqCxStrNCmp(_szEqtn+iThisPt, pszSt, MAX(_EqCxStrLen(pszSt), iTokLen)) == 0) {
+                  isPos.Push(iThisPt);
+                  if(isOps.Push(OP_NARG + iNArgOp + iBrktOff) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+                  iThisScan = iTokLen;
+                  uLookFor = LOOKFOR_BRACKET;
+                  break;
+               }
+            }
+            if(iNArgOp < NUM_NARGOP) break;
+
+            //---hanging unit---
+            iThisScan = _EqCxParseUnits(_szEqtn, iThisPt, iBrktOff, isOps, isPos, vosParsEqn, uLookFor, &iError, &iErrLoc);
+            if(iThisScan > 0) { uLookFor = LOOKFOR_BINARYOP; break; }
+            iError = EQERR_PARSE_UNKNOWNFUNCVAR;
+
+         //---Negative sign---
+         } else if(_szEqtn[iThisPt] == '-') {
+            vo.uTyp = VOTYP_VAL; vo.dVal = -1.00; vo.iPos = iThisPt;
+            if(vosParsEqn.Push(vo) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+            isOps.Push(OP_MUL + iBrktOff);
+            isPos.Push(iThisPt);
+            iThisScan = 1;
+            uLookFor  = LOOKFOR_NUMBER;
+
+         //---Positive sign---
+         } else if(_szEqtn[iThisPt] == '+') {
+            iThisScan = 1;
+            uLookFor  = LOOKFOR_NUMBER;
+
+         //---Number---
+         } else if((iThisScan = _EqCxScanNumber(_szEqtn+iThisPt, &dThisVal)) > 0) {
+            vo.uTyp = VOTYP_VAL; vo.dVal = dThisVal; vo.iPos = iThisPt;
+            if(vosParsEqn.Push(vo) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+            uLookFor = LOOKFOR_BINARYOP;
+
+         //---Bracket---
+         } else if(_szEqtn[iThisPt] == '(') {
+            iBrktOff += OP_BRACKETOFFSET;
+            iThisScan = 1;
+            uLookFor  = LOOKFOR_NUMBER;
+
+         } else {
+            iError = EQERR_PARSE_NUMBEREXPECTED;
+         }
+         break;
+
+      //---Binary operator--------------------------------
+      case LOOKFOR_BINARYOP:
+         switch(_szEqtn[iThisPt]) {
+         case '+': case '-': case '*': case '/': case '^':
+         case '<': case '>': case '!': case '=': case '|': case '&':
+         case ',':
+            iThisOp = OP_NULL;
+                 if(_EqCxStrNCmp(&_szEqtn[iThisPt], "," , 1)==0) { iThisOp = OP_PSH; iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "+" , 1)==0) { iThisOp = OP_ADD; iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "-" , 1)==0) { iThisOp = OP_SUB; iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "*" , 1)==0) { iThisOp = OP_MUL; iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "/" , 1)==0) { iThisOp = OP_DIV; iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "^" , 1)==0) { iThisOp = OP_POW; iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "||", 2)==0) { iThisOp = OP_OR;  iThisScan = 2; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "&&", 2)==0) { iThisOp = OP_AND; iThisScan = 2; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "|" , 1)==0) { iThisOp = OP_OR;  iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "&" , 1)==0) { iThisOp = OP_AND; iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "<=", 2)==0) { iThisOp = OP_LTE; iThisScan = 2; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], ">=", 2)==0) { iThisOp = OP_GTE; iThisScan = 2; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "<" , 1)==0) { iThisOp = OP_LT;  iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], ">" , 1)==0) { iThisOp = OP_GT;  iThisScan = 1; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "!=", 2)==0) { iThisOp = OP_NEQ; iThisScan = 2; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "==", 2)==0) { iThisOp = OP_EQ;  iThisScan = 2; }
+            else if(_EqCxStrNCmp(&_szEqtn[iThisPt], "=" , 1)==0) { iThisOp = OP_SET; iThisScan = 1; }
+            if(iThisOp==OP_NULL) { iError = EQERR_PARSE_BINARYOPEXPECTED; break; }
+
+            //---Assignment---
+            if(iThisOp == OP_SET) {
+               vo = vosParsEqn.Peek();
+               if(vo.uTyp != VOTYP_REF) { iError = EQERR_PARSE_ASSIGNNOTVAR; iThisPt--; break; }
+               vo = vosParsEqn.Pop();
+               isOps.Push(vo.iOp);
+               isPos.Push(vo.iPos);
+            }
+
+            //---Push / Pops---
+            if(iThisOp == OP_PSH) {
+               if(iBrktOff<=0) iThisOp = OP_POP;
+               iCnst = 0;
+               do {
+                  iNArgOp = isOps.PeekBack(--iCnst);
+                  if(iNArgOp <= iBrktOff) break;
+                  while(iNArgOp > OP_BRACKETOFFSET) iNArgOp -= OP_BRACKETOFFSET;
+                  if((iNArgOp>=OP_NARG) && (iNArgOp<OP_NARG+NUM_NARGOP)
+                     && (CEquationNArgOpArgc[iNArgOp-OP_NARG]<0)) iCnst--;
+                  if(iNArgOp==OP_SET) iCnst--;
+               } while(1);
+               if( (iNArgOp-iBrktOff+OP_BRACKETOFFSET==0)
+                  || (iNArgOp < iBrktOff-OP_BRACKETOFFSET+OP_BINARYMIN) )
+                  iThisOp = OP_POP;
+            }
+
+            //---Process---
+            iThisOp += iBrktOff;
+            iError = _EqCxProcessOps(vosParsEqn, isOps, isPos, iThisOp, iBrktOff, &iErrLoc);
+            if(isOps.Push(iThisOp) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+            isPos.Push(iThisPt);
+            uLookFor  = LOOKFOR_NUMBER;
+            break;
+
+         //---Closing bracket---
+         case ')':
+            iCnst = iVrbl = 0;
+            do {
+               iNArgOp = isOps.PeekBack(--iCnst);
+               if(iNArgOp <= iBrktOff) break;
+               if((iNArgOp-iBrktOff) == OP_PSH) iVrbl++;
+               while(iNArgOp > OP_BRACKETOFFSET) iNArgOp -= OP_BRACKETOFFSET;
+               if((iNArgOp>=OP_NARG) && (iNArgOp<OP_NARG+NUM_NARGOP)
+                  && (CEquationNArgOpArgc[iNArgOp-OP_NARG]<0)) iCnst--;
+               if(iNArgOp==OP_SET) iCnst--;
+            } while(1);
+
+            iBrktOff -= OP_BRACKETOFFSET;
+            if(iBrktOff < 0) iError = EQERR_PARSE_UNOPENEDBRACKET;
+            else iThisScan = 1;
+            uLookFor  = LOOKFOR_BINARYOP;
+
+            iNArgOp -= iBrktOff + OP_NARG;
+            iVrbl   += 1;
+            if((iNArgOp>=0) && (iNArgOp<NUM_NARGOP)) {
+               if((iVrbl < ABS(CEquationNArgOpArgc[iNArgOp]))
+                  || ((CEquationNArgOpArgc[iNArgOp]>0) && (iVrbl>CEquationNArgOpArgc[iNArgOp]))) {
+                  iThisPt = isPos.PeekBack(iCnst) - 1;
+                  iError = EQERR_PARSE_NARGBADCOUNT;
+                  break;
+               }
+               if(CEquationNArgOpArgc[iNArgOp] < 0) {
+                  if(isOps.InsertBack(iVrbl, iCnst) < 0) iError = EQERR_PARSE_STACKOVERFLOW;
+                  isPos.InsertBack(isPos.PeekBack(iCnst), iCnst);
+               }
+            } else {
+               if(iVrbl > 1) {
+                  iThisPt = isPos.PeekBack(iCnst) - 1;
+                  iError = EQERR_PARSE_NARGBADCOUNT;
+                  break;
+               }
+            }
+            break;
+
+         //---Units---
+         default:
+            iThisScan = _EqCxParseUnits(_szEqtn, iThisPt, iBrktOff, isOps, isPos, vosParsEqn, uLookFor, &iError, &iErrLoc);
+            if(iThisScan > 0) { uLookFor = LOOKFOR_BINARYOP; break; }
+
+            //---Target unit---
+            if(_szEqtn[iThisPt] == '#') {
+               iThisPt++;
+               Prog.tfTarget = true;
+               iError = _EqCxStringToUnit(_szEqtn+iThisPt, &Prog, &iErrLoc);
+               if(iError != EQERR_NONE) iThisPt += iErrLoc;
+               else iThisPt = iLen;
+               iThisScan = 1;
+            } else {
+               iError = EQERR_PARSE_BINARYOPEXPECTED;
+            }
+            break;
+         }
+         break;
+
+      //---Bracket -(- -----------------------------------
+      case LOOKFOR_BRACKET:
+         if(_szEqtn[iThisPt] == '(') {
+            iBrktOff += OP_BRACKETOFFSET;
+            iThisScan = 1;
+            uLookFor  = LOOKFOR_NUMBER;
+         } else {
+            iError = EQERR_PARSE_BRACKETEXPECTED;
+         }
+         break;
+      }
+      if((iThisScan==0) && (iError==EQERR_NONE)) iError = EQERR_PARSE_NOADVANCE;
+      iThisPt += iThisScan;
+   }
+
+   //===Completion========================================
+   do {
+      iErrLoc = iThisPt;
+      if(iError != EQERR_NONE) break;
+      if(iBrktOff > 0)              { iError = EQERR_PARSE_BRACKETSOPEN;    break; }
+      if(uLookFor==LOOKFOR_BRACKET) { iError = EQERR_PARSE_BRACKETEXPECTED; break; }
+      if(uLookFor==LOOKFOR_NUMBER)  { iError = EQERR_PARSE_NUMBEREXPECTED;  break; }
+      iError = _EqCxProcessOps(vosParsEqn, isOps, isPos, -1, iBrktOff, &iErrLoc);
+   } while(0);
+   if(iError != EQERR_NONE) {
+      Prog.iError  = iError;
+      Prog.iErrPos = iErrLoc;
+      return(Prog);
+   }
+
+   //===Program, without OP_PSH===========================
+   for(pszSt=pszVars; pszSt && *pszSt; pszSt+=_EqCxStrLen(pszSt)+1) Prog.iNumArg++;
+   for(iCnst=0; iCnst<vosParsEqn.Top(); iCnst++) {
+      vo = vosParsEqn.t[iCnst];
+      if((vo.uTyp == VOTYP_OP) && (vo.iOp == OP_PSH)) continue;
+      Prog.op[Prog.iNumOps++] = vo;
+   }
+   if(!Prog.tfTarget) Prog.dScleTarget = 0.00;
+   _EqCxAnalyze(&Prog, iLen);
+   return(Prog);
+}
+
+//===Analysis=============================================
+// As _AnalyzeProgram(), but a program whose units are not
+// known at compile time is an error rather than a reason
+// to evaluate row by row. Fills in the stack height of
+// every token and the unit factors. Constant values are
+// followed only while they stay below EQCX_CONSTMAX, as
+// inf and NaN are not constant expressions.
+typedef struct tagEQCXUNITSTK {
+   unsigned long long u = 0;                // dimension
+   bool   tfConst = false;                  // value known
+   double dVal    = 0.00;                   // value, if tfConst
+} EQCXUNITSTK;
+
+constexpr void _EqCxAnalyze(EQCXPROG *pProg, int iLen) {
+   EQCXUNITSTK Stk[EQCX_MAXOPS] = {};       // unit stack
+   EQCXUNITSTK e1, e2;                      // popped arguments
+   int iTop = 0, iPt = 0;                   // stack height, pointer into program
+   int iArg = 0, iArgc = 0;                 // n-arg ops
+   int iErr = EQERR_NONE;                   // first error
+   EQCXOP *po = nullptr;                    // token being processed
+
+   for(iPt=0; (iPt<pProg->iNumOps) && (iErr==EQERR_NONE); iPt++) {
+      po = &pProg->op[iPt];
+      po->iTop = iTop;
+      switch(po->uTyp) {
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+         Stk[iTop] = EQCXUNITSTK(); Stk[iTop].tfConst = true; Stk[iTop].dVal = po->dVal; iTop++;
+         break;
+
+      case VOTYP_REF:
+         Stk[iTop] = EQCXUNITSTK(); iTop++;
+         if(po->iOp+1 > pProg->iNumVar) pProg->iNumVar = po->iOp+1;
+         break;
+
+      case VOTYP_UNIT:
+         po->dVal = CEquationSIUnit[po->iOp][EQSI_NUMUNIT_BASE];
+         po->dOff = CEquationSIUnit[po->iOp][EQSI_NUMUNIT_BASE+1];
+         if(_EqCxDimMul(Stk[iTop-1].u, CEquationSIDim[po->iOp].u, +1, &Stk[iTop-1].u) != EQERR_NONE) { iErr = EQERR_EVAL_UNITRANGE; break; }
+         if(Stk[iTop-1].tfConst) Stk[iTop-1].dVal = po->dOff + Stk[iTop-1].dVal * po->dVal;
+         break;
+
+      case VOTYP_NARGC:                     // consumed with its operator
+         break;
+
+      case VOTYP_OP:
+         //---Binary---
+         if(po->iOp < OP_UNARY) {
+            if(po->iOp == OP_SET) { iErr = EQERR_EVAL_ASSIGNNOTALLOWED; break; }
+            po->iArgc = 2;
+            e2 = Stk[--iTop]; e1 = Stk[--iTop];
+            switch(po->iOp) {
+            case OP_PSH: Stk[iTop++] = e1; e1 = e2; break;
+            case OP_POP: e1 = e2; break;
+            case OP_ADD: case OP_SUB:
+            case OP_OR:  case OP_AND:
+            case OP_LTE: case OP_GTE:
+            case OP_LT:  case OP_GT:
+            case OP_NEQ: case OP_EQ:
+               if(e1.u != e2.u) { iErr = EQERR_EVAL_UNITMISMATCH; break; }
+               if((po->iOp != OP_ADD) && (po->iOp != OP_SUB)) e1.u = 0;
+               e1.tfConst = e1.tfConst && e2.tfConst && ((po->iOp == OP_ADD) || (po->iOp == OP_SUB));
+               if(e1.tfConst) e1.dVal = (po->iOp == OP_ADD) ? e1.dVal + e2.dVal : e1.dVal - e2.dVal;
+               break;
+            case OP_MUL:
+               if(_EqCxDimMul(e1.u, e2.u, +1, &e1.u) != EQERR_NONE) { iErr = EQERR_EVAL_UNITRANGE; break; }
+               e1.tfConst = e1.tfConst && e2.tfConst;
+               if(e1.tfConst) e1.dVal *= e2.dVal;
+               break;
+            case OP_DIV:
+               if(_EqCxDimMul(e1.u, e2.u, -1, &e1.u) != EQERR_NONE) { iErr = EQERR_EVAL_UNITRANGE; break; }
+               e1.tfConst = e1.tfConst && e2.tfConst && (_EqCxFabs(e2.dVal) >= 1.0/EQCX_CONSTMAX);
+               if(e1.tfConst) e1.dVal /= e2.dVal;
+               break;
+            case OP_POW:
+               if(e2.u != 0) { iErr = EQERR_EVAL_UNITNOTDIMLESS; break; }
+               if(e1.u != 0) {              // dimension depends on exponent
+                  if(!e2.tfConst || (e2.dVal != _EqCxFloor(e2.dVal))) { iErr = EQERR_EVAL_UNITRANGE; break; }
+                  if(_EqCxDimPow(e1.u, e2.dVal, &e1.u) != EQERR_NONE) { iErr = EQERR_EVAL_UNITRANGE; break; }
+               }
+               e1.tfConst = false;
+               break;
+            default: iErr = EQERR_EVAL_UNKNOWNBINARYOP; break;
+            }
+            Stk[iTop++] = e1;
+
+         //---Unary---
+         } else if(po->iOp < OP_NARG) {
+            po->iArgc = 1;
+            e1 = Stk[iTop-1];
+            switch(po->iOp - OP_UNARY) {
+            case OP_ABS: case OP_CEIL: case OP_FLOOR: case OP_ROUND:
+               break;
+            case OP_SQRT:
+               if(_EqCxDimPow(e1.u, 0.50, &e1.u) != EQERR_NONE) iErr = EQERR_EVAL_UNITRANGE;
+               break;
+            case OP_EXP:  case OP_LOG10: case OP_LOG:
+            case OP_COS:  case OP_SIN:   case OP_TAN:
+            case OP_ACOS: case OP_ASIN:  case OP_ATAN:
+            case OP_COSH: case OP_SINH:  case OP_TANH:
+            case OP_SIND: case OP_COSD:  case OP_TAND:
+            case OP_ASIND:case OP_ACOSD: case OP_ATAND:
+            case OP_NOT:  case OP_SIGN:
+               if(e1.u != 0) iErr = EQERR_EVAL_UNITNOTDIMLESS;
+               break;
+            default: iErr = EQERR_EVAL_UNKNOWNUNARYOP; break;
+            }
+            e1.tfConst = false;
+            Stk[iTop-1] = e1;
+
+         //---N-argument---
+         } else {
+            if(po->iOp - OP_NARG >= NUM_NARGOP) { iErr = EQERR_EVAL_UNKNOWNNARGOP; break; }
+            iArgc = CEquationNArgOpArgc[po->iOp - OP_NARG];
+            if(iArgc < 0) iArgc = pProg->op[iPt+1].iOp; // VOTYP_NARGC follows
+            po->iArgc = iArgc;
+            switch(po->iOp - OP_NARG) {
+            case OP_NARG_MOD: case OP_NARG_REM:
+               if(Stk[iTop-1].u != Stk[iTop-2].u) iErr = EQERR_EVAL_UNITMISMATCH;
+               e1 = Stk[iTop-1];
+               break;
+            case OP_NARG_ATAN2: case OP_NARG_ATAN2D:
+               if(Stk[iTop-1].u != Stk[iTop-2].u) iErr = EQERR_EVAL_UNITMISMATCH;
+               e1 = EQCXUNITSTK();
+               break;
+            case OP_NARG_MAX: case OP_NARG_MIN:
+               for(iArg=1; iArg<iArgc; iArg++)
+                  if(Stk[iTop-1-iArg].u != Stk[iTop-1].u) iErr = EQERR_EVAL_UNITMISMATCH;
+               e1 = Stk[iTop-1];
+               break;
+            case OP_NARG_IF:
+               if(Stk[iTop-3].u != 0) iErr = EQERR_EVAL_UNITNOTDIMLESS;
+               else if(Stk[iTop-2].u != Stk[iTop-1].u) iErr = EQERR_EVAL_UNITMISMATCH;
+               e1 = Stk[iTop-1];
+               break;
+            case OP_NARG_SUM: case OP_NARG_MEAN:
+            case OP_NARG_RMS: case OP_NARG_NORM:
+               e1 = Stk[iTop-1];
+               break;
+            case OP_NARG_DOT:
+               e1 = Stk[iTop-2];
+               if(_EqCxDimMul(e1.u, Stk[iTop-1].u, +1, &e1.u) != EQERR_NONE) iErr = EQERR_EVAL_UNITRANGE;
+               break;
+            case OP_NARG_INTERP1:           // tables are only registered at run time
+               e1 = Stk[iTop-1];
+               iErr = EQERR_EVAL_NOTABLE;
+               break;
+            case OP_NARG_FUNCTION:          // user functions are only defined at run time
+               iErr = EQERR_EVAL_UNKNOWNNARGOP;
+               break;
+            }
+            e1.tfConst = false;
+            iTop -= iArgc;
+            Stk[iTop++] = e1;
+         }
+         break;
+
+      default:
+         iErr = EQERR_EVAL_UNKNOWNVALOP;
+         break;
+      }
+      if((iTop > 0) && (_EqCxFabs(Stk[iTop-1].dVal) > EQCX_CONSTMAX)) Stk[iTop-1].tfConst = false;
+      if(iTop > pProg->iDepth) pProg->iDepth = iTop;
+   }
+
+   //===Answer============================================
+   if(iErr != EQERR_NONE) {
+      pProg->iError  = iErr;
+      pProg->iErrPos = pProg->op[iPt-1].iPos;
+      return;
+   }
+   if(iTop != 1) {
+      pProg->iError  = EQERR_EVAL_STACKNOTEMPTY;
+      pProg->iErrPos = pProg->op[pProg->iNumOps-1].iPos;
+      return;
+   }
+   pProg->uUnitAns = Stk[0].u;
+   if(pProg->tfTarget && (pProg->uUnitTarget != pProg->uUnitAns)) {
+      pProg->iError  = EQERR_EVAL_UNITMISMATCH;
+      pProg->iErrPos = iLen;                // as DoEquation(..), end of string
+   }
+}
+
+//===Compile Errors=======================================
+// Instantiated with the error of the program, so that the
+// code and position show in the compiler's diagnostic.
+template<int iError, int iPos> struct EQCX_ERROR {
+   static_assert(iError == EQERR_NONE, "EQCONST: equation rejected, see EQCX_ERROR<EQERR_ code, position>");
+   static constexpr bool tfOk = true;
+};
+
+//---Precision of the call operator-------------
+template<class... A> struct TEqCxReal {
+   typedef typename std::conditional<(sizeof...(A) > 0) && (std::is_same<A, float>::value && ...), float, double>::type T;
+};
+
+/*********************************************************
+* TEqConst declaration
+* S provides static constexpr Eqn() and Vars(), the equa-
+* tion and its variable list; see EQCONST(..).
+*********************************************************/
+template<class S> class TEqConst {
+public:
+   static constexpr EQCXPROG Prog = EqCxParse(S::Eqn(), S::Vars());
+   static constexpr int NumVar = Prog.iNumVar; // variables referenced
+   static constexpr int NumArg = Prog.iNumArg; // variables in list
+   static_assert(EQCX_ERROR<Prog.iError, Prog.iErrPos>::tfOk, "EQCONST");
+
+private:
+   //---One token----------------------------------
+   // Returns false, with *piErr, if a checked argument fails.
+   template<class T, int I, bool tfCheck>
+   static inline bool _Step(T s[], const T v[], int *piErr) {
+      constexpr EQCXOP o = Prog.op[I];
+      constexpr int A = o.iTop - 2;         // first of two arguments
+      constexpr int B = o.iTop - 1;         // last argument
+      (void) v; (void) piErr;
+
+      if constexpr((o.uTyp == VOTYP_VAL) || (o.uTyp == VOTYP_PREFIX)) {
+         s[o.iTop] = (T) o.dVal;
+      } else if constexpr(o.uTyp == VOTYP_REF) {
+         s[o.iTop] = v[o.iOp];
+      } else if constexpr(o.uTyp == VOTYP_UNIT) {
+         s[B] = (T) o.dOff + s[B] * (T) o.dVal;
+
+      //---Binary---------------------------------
+      } else if constexpr((o.uTyp == VOTYP_OP) && (o.iOp < OP_UNARY)) {
+         if constexpr(o.iOp == OP_POP)      s[A] = s[B];
+         else if constexpr(o.iOp == OP_ADD) s[A] = s[A] + s[B];
+         else if constexpr(o.iOp == OP_SUB) s[A] = s[A] - s[B];
+         else if constexpr(o.iOp == OP_MUL) s[A] = s[A] * s[B];
+         else if constexpr(o.iOp == OP_DIV) {
+            if constexpr(tfCheck) if(s[B] == (T) 0.00) { *piErr = EQERR_MATH_DIV_ZERO; return(false); }
+            s[A] = s[A] / s[B];
+         } else if constexpr(o.iOp == OP_POW) {
+            if(s[A] < (T) 0.00) s[B] = floor(s[B] + (T) 0.50);
+            if constexpr(tfCheck) if((s[A] == (T) 0.00) && (s[B] < (T) 0.00)) { *piErr = EQERR_MATH_DIV_ZERO; return(false); }
+            s[A] = ((s[A] == (T) 0.00) && (s[B] == (T) 0.00)) ? (T) 1.00 : (T) pow(s[A], s[B]);
+         }
+         else if constexpr(o.iOp == OP_OR)  s[A] = ((s[A] != (T) 0.00) || (s[B] != (T) 0.00)) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(o.iOp == OP_AND) s[A] = ((s[A] != (T) 0.00) && (s[B] != (T) 0.00)) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(o.iOp == OP_LTE) s[A] = (s[A] <= s[B]) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(o.iOp == OP_GTE) s[A] = (s[A] >= s[B]) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(o.iOp == OP_LT)  s[A] = (s[A] <  s[B]) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(o.iOp == OP_GT)  s[A] = (s[A] >  s[B]) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(o.iOp == OP_NEQ) s[A] = (s[A] != s[B]) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(o.iOp == OP_EQ)  s[A] = (s[A] == s[B]) ? (T) 1.00 : (T) 0.00;
+
+      //---Unary----------------------------------
+      } else if constexpr((o.uTyp == VOTYP_OP) && (o.iOp < OP_NARG)) {
+         constexpr int U = o.iOp - OP_UNARY;
+         if constexpr(tfCheck) {
+            if constexpr((U == OP_ACOS) || (U == OP_ASIN)) {
+               if(fabs(s[B]) > 1.00) { *piErr = EQERR_MATH_DOMAIN; return(false); }
+            } else if constexpr((U == OP_LOG) || (U == OP_LOG10)) {
+               if(s[B] == 0.00) { *piErr = EQERR_MATH_LOG_ZERO; return(false); }
+               if(s[B] <  0.00) { *piErr = EQERR_MATH_LOG_NEG;  return(false); }
+            } else if constexpr(U == OP_SQRT) {
+               if(s[B] < 0.00) { *piErr = EQERR_MATH_SQRT_NEG; return(false); }
+            } else if constexpr(U == OP_EXP) {
+               if(s[B] > 709.00) { *piErr = EQERR_MATH_OVERFLOW; return(false); }
+            }
+         }
+         if constexpr(U == OP_ABS)        s[B] = fabs(s[B]);
+         else if constexpr(U == OP_SQRT)  s[B] = sqrt(s[B]);
+         else if constexpr(U == OP_EXP)   s[B] = exp(s[B]);
+         else if constexpr(U == OP_LOG10) s[B] = log10(s[B]);
+         else if constexpr(U == OP_LOG)   s[B] = log(s[B]);
+         else if constexpr(U == OP_CEIL)  s[B] = ceil(s[B]);
+         else if constexpr(U == OP_FLOOR) s[B] = floor(s[B]);
+         else if constexpr(U == OP_ROUND) s[B] = floor(s[B] + (T) 0.50);
+         else if constexpr(U == OP_COS)   s[B] = cos(s[B]);
+         else if constexpr(U == OP_SIN)   s[B] = sin(s[B]);
+         else if constexpr(U == OP_TAN)   s[B] = tan(s[B]);
+         else if constexpr(U == OP_ACOS)  s[B] = acos(s[B]);
+         else if constexpr(U == OP_ASIN)  s[B] = asin(s[B]);
+         else if constexpr(U == OP_ATAN)  s[B] = atan(s[B]);
+         else if constexpr(U == OP_COSH)  s[B] = cosh(s[B]);
+         else if constexpr(U == OP_SINH)  s[B] = sinh(s[B]);
+         else if constexpr(U == OP_TANH)  s[B] = tanh(s[B]);
+         else if constexpr(U == OP_SIND)  s[B] = sin(s[B] * (T) M_PI_180);
+         else if constexpr(U == OP_COSD)  s[B] = cos(s[B] * (T) M_PI_180);
+         else if constexpr(U == OP_TAND)  s[B] = tan(s[B] * (T) M_PI_180);
+         else if constexpr(U == OP_ASIND) s[B] = (T) M_180_PI * asin(s[B]);
+         else if constexpr(U == OP_ACOSD) s[B] = (T) M_180_PI * acos(s[B]);
+         else if constexpr(U == OP_ATAND) s[B] = (T) M_180_PI * atan(s[B]);
+         else if constexpr(U == OP_NOT)   s[B] = (s[B] == (T) 0.00) ? (T) 1.00 : (T) 0.00;
+         else if constexpr(U == OP_SIGN)  s[B] = (s[B] == (T) 0.00) ? (T) 0.00 : (s[B] < (T) 0.00) ? (T) -1.00 : (T) 1.00;
+
+      //---N-argument-----------------------------
+      } else if constexpr(o.uTyp == VOTYP_OP) {
+         constexpr int N = o.iOp - OP_NARG;
+         if constexpr(N == OP_NARG_MOD) {   // answer is x if y==0
+            if(s[B] != (T) 0.00) s[A] = s[A] - s[B] * floor(s[A] / s[B]);
+         } else if constexpr(N == OP_NARG_REM) {
+            if constexpr(tfCheck) if(s[B] == (T) 0.00) { *piErr = EQERR_MATH_DIV_ZERO; return(false); }
+            s[A] = s[A] - s[B] * floor(s[A] / s[B]) - ((SIGN(s[A]) != SIGN(s[B])) ? s[B] : (T) 0.00);
+         } else if constexpr((N == OP_NARG_ATAN2) || (N == OP_NARG_ATAN2D)) {
+            s[A] = (s[B] == (T) 0.00) ?
+               ((s[A] == (T) 0.00) ? (T) 0.00 : ((s[A] > (T) 0.00) ? (T) (M_PI/2.00) : (T) (-M_PI/2.00)))
+               : (T) atan2(s[A], s[B]);
+            if constexpr(N == OP_NARG_ATAN2D) s[A] *= (T) M_180_PI;
+         } else if constexpr((N == OP_NARG_MAX) || (N == OP_NARG_MIN)) {
+            T t = s[B];                     // compared from the last argument down
+            for(int k=1; k<o.iArgc; k++) {
+               if constexpr(N == OP_NARG_MAX) t = (s[B-k] > t) ? s[B-k] : t;
+               else                           t = (s[B-k] < t) ? s[B-k] : t;
+            }
+            s[o.iTop - o.iArgc] = t;
+         } else if constexpr(N == OP_NARG_IF) {
+            s[A-1] = (s[A-1] == (T) 0.00) ? s[B] : s[A];
+         } else if constexpr((N == OP_NARG_RMS) || (N == OP_NARG_NORM)) {
+            s[B] = fabs(s[B]);               // one-element arrays
+         } else if constexpr(N == OP_NARG_DOT) {
+            s[A] = s[A] * s[B];
+         }
+      }
+      return(true);
+   }
+
+   //---Whole program------------------------------
+   template<class T, bool tfCheck, size_t... I>
+   static inline int _Run(const T v[], T *pAns, int *piPos, std::index_sequence<I...>) {
+      T   s[(Prog.iDepth > 0) ? Prog.iDepth : 1] = {}; // stack levels, kept in registers
+      int iErr = EQERR_NONE;                // checked error
+      int iPt  = 0;                         // failed token
+      (void) iPt;
+      if constexpr(tfCheck) {
+         if(!((_Step<T, (int) I, true>(s, v, &iErr) && (++iPt, true)) && ...)) {
+            if(piPos) *piPos = Prog.op[iPt].iPos;
+            return(iErr);
+         }
+      } else {
+         (_Step<T, (int) I, false>(s, v, &iErr), ...);
+      }
+      if constexpr(Prog.tfTarget) *pAns = (s[0] - (T) Prog.dOffsTarget) / (T) Prog.dScleTarget;
+      else                        *pAns = s[0];
+      return(EQERR_NONE);
+   }
+
+public:
+   //---Unchecked--------------------------------
+   template<class T> static inline T Answer(const T v[]) {
+      T tAns = (T) 0.00;
+      _Run<T, false>(v, &tAns, NULL, std::make_index_sequence<Prog.iNumOps>());
+      return(tAns);
+   }
+
+   template<class... A> inline typename TEqCxReal<A...>::T operator()(A... a) const {
+      typedef typename TEqCxReal<A...>::T T;
+      static_assert(sizeof...(A) == NumArg, "EQCONST: one argument per variable in list");
+      const T v[] = { (T) a..., (T) 0.00 };
+      return(Answer<T>(v));
+   }
+
+   //---Checked, as CEquation::DoEquation(..)---
+   static inline int DoEquation(const double dVar[], double *pdAns, int *piPos=NULL) {
+      double dAns = 0.00;
+      int    iErr = _Run<double, true>(dVar, &dAns, piPos, std::make_index_sequence<Prog.iNumOps>());
+      if((iErr == EQERR_NONE) && pdAns) *pdAns = dAns;
+      return(iErr);
+   }
+
+   static constexpr UNITBASE AnswerUnit(void) { return(UNITBASE{ Prog.tfTarget ? Prog.uUnitTarget : Prog.uUnitAns }); }
+};
+
+/*********************************************************
+* EQCONST
+* Parses szEqn with variables szVars (double-NULL termin-
+* ated, as ParseEquation(..)) at compile time and returns
+* a TEqConst object. Both must be string literals.
+*********************************************************/
+#define EQCONST(szEqn, szVars) ([]{                                          \
+   struct EqCxSrc {                                                          \
+      static constexpr const char *Eqn(void)  { return(szEqn); }             \
+      static constexpr const char *Vars(void) { return(szVars); }            \
+   };                                                                        \
+   return(TEqConst<EqCxSrc>());                                              \
+}())
+
+#endif/*CLCEQCONST_H*/
@@ -0,0 +1,510 @@
+/*****************************************************************************
+*  CLCEqFast.cpp                                        CSIVM LaserCanvas
+*  Approximate transcendental functions for batch evaluation
+*  Declarations in CLCEqFast.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* With EQBATCH_FASTMATH or EQBATCH_FASTMATH_HIGH, DoEquationBatch(..) replaces
+* the libm calls for exp, log, log10, sin, cos, tan, atan, tanh and the degree
+* variants sind, cosd, tand and atand by the kernels in this file. Each kernel
+* reduces the argument to a small interval and evaluates a fixed polynomial
+* there, using only arithmetic, selects and bit operations, so the loop over a
+* block of rows vectorizes (best with AVX2 or better enabled, e.g. -march=na-
+* tive). The tier selects the polynomial degree:
+*
+*  function       reduction                          LOW         HIGH
+*  exp            x = k ln2 + r,  |r| <= ln2/2        degree 7    degree 13
+*  log, log10     x = 2^e m,  s = (m-1)/(m+1)        s^9         s^19
+*  sin cos tan    x = k pi/2 + r,  |r| <= pi/4       r^9, r^8    r^17, r^16
+*  atan           1/x, then 15 degree steps          u^13        u^27
+*  tanh           expm1 below 0.35, exp above        2x^9        2x^17
+*
+* Arguments outside the range of the reduction (|x| > 1e5 for the trig func-
+* tions, 8192 in float; exp beyond the normal range; log of zero, negative,
+* denormal or infinite values; NaN) are handed to libm after the vector loop.
+*
+* Accuracy
+* --------
+* EqFastMeasure(..) compares a kernel with libm at evenly spaced bit patterns
+* between two limits, i.e. evenly in exponent over the whole domain when the
+* limits are the largest finite values. Worst errors found with 1e7 points
+* over the whole domain are
+*
+*                  double LOW    double HIGH    float (either tier)
+*  exp            7e-9 rel      1 ulp          1 ulp
+*  log, log10     2e-9 rel      2 ulp          2 - 4 ulp
+*  sin cos        3.5e-8 rel    2 ulp          2 - 4 ulp
+*  tan            3.2e-8 rel    3 ulp          4 ulp
+*  atan           6.3e-10 rel   2 ulp          2 ulp
+*  tanh           5.6e-9 rel    4 ulp          3 ulp
+*
+* The degree variants add the rounding of x*pi/180 (or 180/pi) as in libm, to
+* at most 4 ulp in double HIGH and 5 ulp in float. Measure the tier over the
+* expected range of arguments before relying on it, e.g.
+*
+*    EQFASTERR Err;
+*    EqFastMeasure(OP_SIN, EQFAST_LOW, FALSE, -1e3, 1e3, 1000000, &Err);
+*    printf("%g rel, %g ulp at %g\n", Err.dMaxRel, Err.dMaxUlp, Err.dArgMaxUlp);
+*
+* or for all kernels, tiers and precisions at once with "ceqbench -a num -r
+* lo hi" (bench/CLCEqBench.cpp); the table above was made that way.
+******************************************************************************/
+#include "CLCEqFast.h"                      // header file and definitions
+#include <float.h>                          // DBL_MAX, FLT_MAX, ..
+
+// The kernels select between values with comparisons that GCC will not
+// vectorize while it must preserve floating point traps; none are enabled
+// here. (-ffast-math is not suitable: the kernels rely on NaN tests and on
+// the order of the argument reduction.)
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC optimize("no-trapping-math")
+#endif
+
+#define EQFAST_BLOCK                 64     // rows per vector loop
+
+#define EQFAST_LOG2E        1.4426950408889634074  // 1 / ln(2)
+#define EQFAST_LOG10E       0.43429448190325182765 // 1 / ln(10)
+#define EQFAST_SQRT2        1.4142135623730950488
+#define EQFAST_SQRT3        1.7320508075688772935
+#define EQFAST_PI_2         1.5707963267948966192  // pi/2
+#define EQFAST_PI_6         0.52359877559829887308 // pi/6
+#define EQFAST_2_PI         0.63661977236758134308 // 2/pi
+#define EQFAST_TAN_PI12     0.26794919243112270647 // tan(pi/12)
+#define EQFAST_LN2_HI       6.93147180369123816490e-01 // ln(2), exact times e
+#define EQFAST_LN2_LO       1.90821492927058770002e-10 // remainder
+#define EQFAST_LN2_HIF      0.693359375                // same for float
+#define EQFAST_LN2_LOF     -2.12194440e-4
+#define EQFAST_PIO2_1       1.57079632673412561417e+00 // pi/2 in three parts
+#define EQFAST_PIO2_2       6.07710050630396597660e-11
+#define EQFAST_PIO2_3       2.02226624879595063154e-21
+#define EQFAST_PIO2_1F      1.5703125                  // same for float
+#define EQFAST_PIO2_2F      4.837512969970703125e-4
+#define EQFAST_PIO2_3F      7.54978995489188216e-8
+
+//===Coefficients=========================================
+// Taylor series; the number of terms used depends on the tier.
+static const double EqFastExpC[14] = {      // 1/k!
+   1.0, 1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720, 1.0/5040, 1.0/40320,
+   1.0/362880, 1.0/3628800, 1.0/39916800, 1.0/479001600, 1.0/6227020800.0 };
+static const double EqFastExpm1C[17] = {    // 1/(k+1)!, expm1(x) = x * P(x)
+   1.0, 1.0/2, 1.0/6, 1.0/24, 1.0/120, 1.0/720, 1.0/5040, 1.0/40320,
+   1.0/362880, 1.0/3628800, 1.0/39916800, 1.0/479001600, 1.0/6227020800.0,
+   1.0/87178291200.0, 1.0/1307674368000.0, 1.0/20922789888000.0,
+   1.0/355687428096000.0 };
+static const double EqFastSinC[8] = {       // sin(r) = r + r z P(z)
+  -1.0/6, 1.0/120, -1.0/5040, 1.0/362880, -1.0/39916800, 1.0/6227020800.0,
+  -1.0/1307674368000.0, 1.0/355687428096000.0 };
+static const double EqFastCosC[8] = {       // cos(r) = 1 + z P(z)
+  -1.0/2, 1.0/24, -1.0/720, 1.0/40320, -1.0/3628800, 1.0/479001600,
+  -1.0/87178291200.0, 1.0/20922789888000.0 };
+static const double EqFastLogC[10] = {      // log(m) = s P(s^2)
+   2.0, 2.0/3, 2.0/5, 2.0/7, 2.0/9, 2.0/11, 2.0/13, 2.0/15, 2.0/17, 2.0/19 };
+static const double EqFastAtanC[13] = {     // atan(u) = u + u z P(z)
+  -1.0/3, 1.0/5, -1.0/7, 1.0/9, -1.0/11, 1.0/13, -1.0/15, 1.0/17, -1.0/19,
+   1.0/21, -1.0/23, 1.0/25, -1.0/27 };
+
+/*********************************************************
+* Helpers
+* Horner evaluation with N terms, rounding, and the bit
+* operations for powers of two in both precisions. Round-
+* ing goes through int rather than floor(..), and integers
+* are moved into the exponent by adding 1.5 * 2^52 (2^23):
+* both vectorize where floor(..) and conversions to long
+* long do not.
+*********************************************************/
+// Unrolled by recursion, since a loop over the terms would
+// keep the loop over the rows from vectorizing.
+template<class T, int N> struct TEqFastPoly {
+   static inline T Eval(T x, const double *pdC) { return(TEqFastPoly<T, N-1>::Eval(x, pdC+1) * x + (T) pdC[0]); }
+};
+template<class T> struct TEqFastPoly<T, 1> {
+   static inline T Eval(T, const double *pdC) { return((T) pdC[0]); }
+};
+
+template<class T, int N>
+static inline T _EqFastPoly(T x, const double *pdC) {
+   return(TEqFastPoly<T, N>::Eval(x, pdC));
+}
+
+template<class T>
+static inline T _EqFastAbs(T x) {                 // |x| (-0 stays -0), see pragma above
+   return((x < (T) 0.00) ? -x : x);
+}
+
+template<class T>
+static inline int _EqFastNint(T x) {              // nearest integer, |x| < 2^31
+   return((int) (x + ((x < (T) 0.00) ? (T) -0.50 : (T) 0.50)));
+}
+
+static inline double _EqFastPow2(double k) {       // 2^k, k integral and in range
+   unsigned long long u;                    // k in low bits, then 2^k
+   double d = k + 6755399441055744.0;
+   memcpy(&u, &d, sizeof(u));
+   u = (u + 1023) << 52;
+   memcpy(&d, &u, sizeof(d));
+   return(d);
+}
+static inline float _EqFastPow2(float k) {
+   unsigned int u;
+   float f = k + 12582912.0f;
+   memcpy(&u, &f, sizeof(u));
+   u = (u + 127) << 23;
+   memcpy(&f, &u, sizeof(f));
+   return(f);
+}
+
+static inline double _EqFastSplit(double x, double *pe) { // x = 2^e m, 1 <= m < 2, x normal
+   unsigned long long u, ue;                // bits of x, of exponent as double
+   double de;
+   memcpy(&u, &x, sizeof(u));
+   ue = (u >> 52) | 0x4330000000000000ull;  // 2^52 + biased exponent
+   memcpy(&de, &ue, sizeof(de));
+   *pe = (de - 4503599627370496.0) - 1023.0;
+   u = (u & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;
+   memcpy(&x, &u, sizeof(x));
+   return(x);
+}
+static inline float _EqFastSplit(float x, float *pe) {
+   unsigned int u, ue;
+   float fe;
+   memcpy(&u, &x, sizeof(u));
+   ue = (u >> 23) | 0x4B000000u;
+   memcpy(&fe, &ue, sizeof(fe));
+   *pe = (fe - 8388608.0f) - 127.0f;
+   u = (u & 0x007FFFFFu) | 0x3F800000u;
+   memcpy(&x, &u, sizeof(x));
+   return(x);
+}
+
+/*********************************************************
+* Element kernels
+* Each assumes its argument lies in the reduced range; the
+* array kernel below clamps arguments and fixes up those
+* that were out of range.
+*********************************************************/
+//===Exponential==========================================
+template<class T, int HI>
+static inline T _EqFastExp(T x) {
+   const BOOL tfF = (sizeof(T) == sizeof(float));
+   T k = (T) _EqFastNint(x * (T) EQFAST_LOG2E);
+   T r = (x - k * (T) (tfF ? EQFAST_LN2_HIF : EQFAST_LN2_HI)) - k * (T) (tfF ? EQFAST_LN2_LOF : EQFAST_LN2_LO);
+   return(_EqFastPoly<T, HI ? 14 : 8>(r, EqFastExpC) * _EqFastPow2(k));
+}
+
+//===Logarithm============================================
+template<class T, int HI>
+static inline T _EqFastLog(T x) {
+   const BOOL tfF = (sizeof(T) == sizeof(float));
+   T e, m, s;                               // exponent, mantissa, reduced
+   m = _EqFastSplit(x, &e);
+   e = (m > (T) EQFAST_SQRT2) ? e + (T) 1.00 : e;
+   m = (m > (T) EQFAST_SQRT2) ? m * (T) 0.50 : m;
+   s = (m - (T) 1.00) / (m + (T) 1.00);
+   return(e * (T) (tfF ? EQFAST_LN2_HIF : EQFAST_LN2_HI)
+      + (s * _EqFastPoly<T, HI ? 10 : 5>(s*s, EqFastLogC) + e * (T) (tfF ? EQFAST_LN2_LOF : EQFAST_LN2_LO)));
+}
+
+//===Sine, Cosine, Tangent================================
+// iFn is 0 for sin, 1 for cos, 2 for tan. Quadrant q of
+// the reduction selects +/-sin(r) or +/-cos(r); it is kept
+// in floating point so the loop stays in one vector type.
+template<class T, int HI>
+static inline T _EqFastTrig(T x, int iFn) {
+   const BOOL tfF = (sizeof(T) == sizeof(float));
+   T   k, r, z, s, c;                       // multiple of pi/2, reduced arg, sin(r), cos(r)
+   T   q;                                   // quadrant 0..3
+   int iK;                                  // k as integer
+   iK = _EqFastNint(x * (T) EQFAST_2_PI);
+   k  = (T) iK;
+   r = ((x - k * (T) (tfF ? EQFAST_PIO2_1F : EQFAST_PIO2_1))
+           - k * (T) (tfF ? EQFAST_PIO2_2F : EQFAST_PIO2_2))
+           - k * (T) (tfF ? EQFAST_PIO2_3F : EQFAST_PIO2_3);
+   z = r * r;
+   s = r + r * z * _EqFastPoly<T, HI ? 8 : 4>(z, EqFastSinC);
+   c = (T) 1.00 + z * _EqFastPoly<T, HI ? 8 : 4>(z, EqFastCosC);
+   q = (T) (iK & 3);
+   if(iFn == 2) return(((q == (T) 1.00) || (q == (T) 3.00)) ? -c / s : s / c);
+   q = (q + (T) iFn >= (T) 4.00) ? q + (T) iFn - (T) 4.00 : q + (T) iFn; // cos(x) = sin(x + pi/2)
+   s = ((q == (T) 1.00) || (q == (T) 3.00)) ? c : s;
+   return((q >= (T) 2.00) ? -s : s);
+}
+
+//===Arc Tangent==========================================
+template<class T, int HI>
+static inline T _EqFastAtan(T x) {
+   T a, t, u, p;                            // |x|, reduced to [0,1], to [0,tan(pi/12)]
+   a = _EqFastAbs(x);
+   t = (a > (T) 1.00) ? (T) 1.00 / a : a;
+   u = (t > (T) EQFAST_TAN_PI12) ? (t * (T) EQFAST_SQRT3 - (T) 1.00) / (t + (T) EQFAST_SQRT3) : t;
+   p = u + u * (u*u) * _EqFastPoly<T, HI ? 13 : 6>(u*u, EqFastAtanC);
+   p = (t > (T) EQFAST_TAN_PI12) ? p + (T) EQFAST_PI_6 : p;
+   p = (a > (T) 1.00) ? (T) EQFAST_PI_2 - p : p;
+   return((x < (T) 0.00) ? -p : p);
+}
+
+//===Hyperbolic Tangent===================================
+// tanh = expm1(2x) / (expm1(2x) + 2) for small x, where
+// (exp(2x) - 1) / (exp(2x) + 1) would lose digits. The
+// operands are blended with a 0/1 factor t rather than se-
+// lected, which GCC would turn into a branch.
+template<class T, int HI>
+static inline T _EqFastTanh(T x) {
+   const BOOL tfF = (sizeof(T) == sizeof(float));
+   T a, e, E, t;                            // |x|, expm1(2a), exp(2a), small a
+   a = _EqFastAbs(x);
+   e = (a < (T) 0.35) ? (T) 2.00 * a : (T) 0.70;
+   e = e * _EqFastPoly<T, HI ? 17 : 9>(e, EqFastExpm1C);
+   E = _EqFastExp<T, HI>((a < (T) (tfF ? 9.00 : 20.00)) ? (T) 2.00 * a : (T) (tfF ? 18.00 : 40.00));
+   t = (a < (T) 0.35) ? (T) 1.00 : (T) 0.00;
+   a = (t * e + ((T) 1.00 - t) * (E - (T) 1.00)) / (t * (e + (T) 2.00) + ((T) 1.00 - t) * (E + (T) 1.00));
+   return((x < (T) 0.00) ? -a : a);
+}
+
+/*********************************************************
+* _EqFastKernel
+* Applies op iOp to n values. pa and pd may be the same
+* array. Each block is copied in, padded to EQFAST_BLOCK so
+* that the loops have a fixed length, and copied out after
+* out of range arguments have been handed to libm.
+*********************************************************/
+template<class T, int HI>
+static void _EqFastKernel(int iOp, const T pa[], T pd[], int n) {
+   const BOOL tfF = (sizeof(T) == sizeof(float));
+   const T tTrigLim = (T) (tfF ? 8192.00 : 1.00e5); // largest reduced trig argument
+   const T tExpLo   = (T) (tfF ? -87.00 : -708.00); // normal range of exp
+   const T tExpHi   = (T) (tfF ?  88.00 :  709.00);
+   const T tLogLo   = (T) (tfF ? FLT_MIN : DBL_MIN); // normal range of log
+   const T tLogHi   = (T) (tfF ? FLT_MAX : DBL_MAX);
+   T   a[EQFAST_BLOCK];                     // arguments
+   T   y[EQFAST_BLOCK];                     // results
+   T   x;                                   // argument
+   int i0, m, r;                            // block start, length, loop counter
+   int iFn;                                 // sin, cos or tan
+
+   for(i0=0; i0<n; i0+=EQFAST_BLOCK) {
+      m = MIN(EQFAST_BLOCK, n-i0);
+      for(r=0; r<m; r++) a[r] = pa[i0+r];
+      for(r=m; r<EQFAST_BLOCK; r++) a[r] = (T) 1.00; // valid for every op
+      switch(iOp) {
+      //===Exponential and Logarithm======================
+      case OP_EXP:
+         for(r=0; r<EQFAST_BLOCK; r++) {
+            x = a[r];
+            x = (x >= tExpLo) ? ((x <= tExpHi) ? x : tExpHi) : tExpLo;
+            y[r] = _EqFastExp<T,HI>(x);
+         }
+         for(r=0; r<m; r++) if(!((a[r] >= tExpLo) && (a[r] <= tExpHi))) y[r] = exp(a[r]);
+         break;
+      case OP_LOG:
+      case OP_LOG10:
+         for(r=0; r<EQFAST_BLOCK; r++) {
+            x = a[r];
+            x = ((x >= tLogLo) && (x <= tLogHi)) ? x : (T) 1.00;
+            y[r] = _EqFastLog<T,HI>(x);
+         }
+         if(iOp == OP_LOG10) for(r=0; r<EQFAST_BLOCK; r++) y[r] *= (T) EQFAST_LOG10E;
+         for(r=0; r<m; r++) if(!((a[r] >= tLogLo) && (a[r] <= tLogHi))) y[r] = (iOp == OP_LOG10) ? log10(a[r]) : log(a[r]);
+         break;
+
+      //===Trigonometric==================================
+      case OP_SIN: case OP_COS: case OP_TAN:
+      case OP_SIND: case OP_COSD: case OP_TAND:
+         iFn = ((iOp == OP_SIN) || (iOp == OP_SIND)) ? 0 : ((iOp == OP_COS) || (iOp == OP_COSD)) ? 1 : 2;
+         if(iOp >= OP_SIND) for(r=0; r<EQFAST_BLOCK; r++) a[r] *= (T) M_PI_180;
+         for(r=0; r<EQFAST_BLOCK; r++) {
+            x = a[r];
+            x = (_EqFastAbs(x) <= tTrigLim) ? x : (T) 0.00;
+            y[r] = _EqFastTrig<T,HI>(x, iFn);
+         }
+         for(r=0; r<m; r++) if(!(_EqFastAbs(a[r]) <= tTrigLim)) y[r] = (iFn == 0) ? sin(a[r]) : (iFn == 1) ? cos(a[r]) : tan(a[r]);
+         break;
+      case OP_ATAN:
+      case OP_ATAND:
+         for(r=0; r<EQFAST_BLOCK; r++) {
+            x = a[r];
+            x = (x == x) ? x : (T) 0.00;
+            y[r] = _EqFastAtan<T,HI>(x);
+         }
+         for(r=0; r<m; r++) if(a[r] != a[r]) y[r] = a[r];
+         if(iOp == OP_ATAND) for(r=0; r<EQFAST_BLOCK; r++) y[r] *= (T) M_180_PI;
+         break;
+
+      //===Hyperbolic=====================================
+      case OP_TANH:
+         for(r=0; r<EQFAST_BLOCK; r++) {
+            x = a[r];
+            x = (x == x) ? x : (T) 0.00;
+            y[r] = _EqFastTanh<T,HI>(x);
+         }
+         for(r=0; r<m; r++) if(a[r] != a[r]) y[r] = a[r];
+         break;
+      }
+      for(r=0; r<m; r++) pd[i0+r] = y[r];
+   }
+}
+
+/*********************************************************
+* EqFastHasOp
+* Returns TRUE if unary op iUnaryOp (OP_ code without
+* OP_UNARY) has an approximate kernel.
+*********************************************************/
+BOOL EqFastHasOp(int iUnaryOp) {
+   switch(iUnaryOp) {
+   case OP_EXP:  case OP_LOG:  case OP_LOG10:
+   case OP_SIN:  case OP_COS:  case OP_TAN:  case OP_ATAN:
+   case OP_SIND: case OP_COSD: case OP_TAND: case OP_ATAND:
+   case OP_TANH:
+      return(TRUE);
+   }
+   return(FALSE);
+}
+
+/*********************************************************
+* EqFastUnary
+* Evaluates pd[i] = op(pa[i]) for n values at accuracy tier
+* iTier. pa and pd may be the same array. Returns FALSE,
+* leaving pd untouched, if the op has no kernel or iTier
+* is EQFAST_NONE; the caller then uses libm.
+*********************************************************/
+template<class T>
+BOOL EqFastUnary(int iUnaryOp, int iTier, const T pa[], T pd[], int n) {
+   if((iTier == EQFAST_NONE) || !EqFastHasOp(iUnaryOp)) return(FALSE);
+   if(iTier == EQFAST_HIGH) _EqFastKernel<T,1>(iUnaryOp, pa, pd, n);
+   else                     _EqFastKernel<T,0>(iUnaryOp, pa, pd, n);
+   return(TRUE);
+}
+template BOOL EqFastUnary<double>(int iUnaryOp, int iTier, const double pa[], double pd[], int n);
+template BOOL EqFastUnary<float>(int iUnaryOp, int iTier, const float pa[], float pd[], int n);
+
+/*********************************************************
+* EqFastMeasure
+* Accuracy harness: compares the kernel for iUnaryOp at
+* tier iTier with libm at iNum arguments between dLo and
+* dHi, spaced evenly in their bit patterns so that every
+* binade of the range is covered alike. With dLo >= dHi,
+* the whole domain of the function is used (positive
+* values for log). With tfFloat, the float kernel is
+* measured against libm in double and errors are in float
+* ulp. Results of the same infinity, or NaN for NaN, count
+* as exact; relative errors are taken where the libm re-
+* sult is not zero.
+*********************************************************/
+//---Ordered bit patterns-----------------------
+// Maps values to integers of the same order, and back.
+static unsigned long long _EqFastKey(double d, BOOL tfFloat) {
+   unsigned long long u;                    // bit pattern
+   unsigned int       uf;                   // float bit pattern
+   float              f;                    // value as float
+   if(tfFloat) {
+      f = (float) d;
+      memcpy(&uf, &f, sizeof(uf));
+      return((uf & 0x80000000u) ? (unsigned long long) (0x80000000u - (uf & 0x7FFFFFFFu)) : (unsigned long long) uf + 0x80000000u);
+   }
+   memcpy(&u, &d, sizeof(u));
+   return((u & 0x8000000000000000ull) ? 0x8000000000000000ull - (u & 0x7FFFFFFFFFFFFFFFull) : u + 0x8000000000000000ull);
+}
+
+static double _EqFastUnkey(unsigned long long k, BOOL tfFloat) {
+   unsigned long long u;                    // bit pattern
+   unsigned int       uf;                   // float bit pattern
+   float              f;                    // value as float
+   double             d;                    // value
+   if(tfFloat) {
+      uf = (k >= 0x80000000u) ? (unsigned int) (k - 0x80000000u) : (unsigned int) (0x80000000u - k) | 0x80000000u;
+      memcpy(&f, &uf, sizeof(f));
+      return((double) f);
+   }
+   u = (k >= 0x8000000000000000ull) ? k - 0x8000000000000000ull : (0x8000000000000000ull - k) | 0x8000000000000000ull;
+   memcpy(&d, &u, sizeof(d));
+   return(d);
+}
+
+//---libm reference-----------------------------
+// In float the degree variants scale the argument in float
+// as the kernels do, and libm is applied to that.
+static double _EqFastRef(int iUnaryOp, double x, BOOL tfFloat) {
+   double xr;                               // argument in radians
+   xr = tfFloat ? (double) ((float) x * (float) M_PI_180) : x * M_PI_180;
+   switch(iUnaryOp) {
+   case OP_EXP:   return(exp(x));
+   case OP_LOG:   return(log(x));
+   case OP_LOG10: return(log10(x));
+   case OP_SIN:   return(sin(x));
+   case OP_COS:   return(cos(x));
+   case OP_TAN:   return(tan(x));
+   case OP_ATAN:  return(atan(x));
+   case OP_TANH:  return(tanh(x));
+   case OP_SIND:  return(sin(xr));
+   case OP_COSD:  return(cos(xr));
+   case OP_TAND:  return(tan(xr));
+   case OP_ATAND: return(M_180_PI * atan(x));
+   }
+   return(0.00);
+}
+
+//===Implementation=======================================
+int EqFastMeasure(int iUnaryOp, int iTier, BOOL tfFloat, double dLo, double dHi, int iNum, EQFASTERR *pErr) {
+   double dIn[EQFAST_BLOCK], dOut[EQFAST_BLOCK]; // arguments and results in double
+   float  fIn[EQFAST_BLOCK], fOut[EQFAST_BLOCK]; // the same in float
+   unsigned long long kLo, kHi;             // range as ordered bit patterns
+   double dRef, dDiff, dUlp, dRel;          // libm result, error
+   double dSumSq;                           // sum of squared relative errors
+   int    iRel;                             // number of relative errors summed
+   int    i0, m, r, e;                      // block start, length, loop counter, exponent
+
+   if(pErr == NULL) return(EQERR_NONE);
+   memset(pErr, 0x00, sizeof(EQFASTERR));
+   if(!EqFastHasOp(iUnaryOp) || (iTier == EQFAST_NONE)) return(EQERR_EVAL_UNKNOWNUNARYOP);
+   if(iNum < 2) iNum = 2;
+   if(dLo >= dHi) {
+      dHi = tfFloat ? FLT_MAX : DBL_MAX;
+      dLo = ((iUnaryOp == OP_LOG) || (iUnaryOp == OP_LOG10)) ? 0.00 : -dHi;
+   }
+   kLo = _EqFastKey(dLo, tfFloat);
+   kHi = _EqFastKey(dHi, tfFloat);
+
+   dSumSq = 0.00;
+   iRel   = 0;
+   for(i0=0; i0<iNum; i0+=EQFAST_BLOCK) {
+      m = MIN(EQFAST_BLOCK, iNum-i0);
+      for(r=0; r<m; r++) {                  // kLo + (kHi-kLo) * i / (iNum-1)
+         unsigned long long k = kLo + (unsigned long long) ((double) (kHi - kLo) * ((double) (i0+r) / (iNum-1)));
+         dIn[r] = _EqFastUnkey((k > kHi) ? kHi : k, tfFloat);
+         fIn[r] = (float) dIn[r];
+      }
+      if(tfFloat) {
+         EqFastUnary(iUnaryOp, iTier, fIn, fOut, m);
+         for(r=0; r<m; r++) dOut[r] = (double) fOut[r];
+      } else {
+         EqFastUnary(iUnaryOp, iTier, dIn, dOut, m);
+      }
+
+      for(r=0; r<m; r++) {
+         dRef = _EqFastRef(iUnaryOp, dIn[r], tfFloat);
+         if(tfFloat) dRef = (double) (float) dRef; // rounded, or +/-inf
+         if((dRef != dRef) && (dOut[r] != dOut[r])) continue; // both NaN
+         if(dRef == dOut[r]) {              // exact
+            pErr->iNum++;
+            iRel++;
+            continue;
+         }
+         dDiff = fabs(dOut[r] - dRef);
+         frexp(dRef, &e);                   // ulp of reference
+         dUlp  = ldexp(1.00, e - (tfFloat ? 24 : 53));
+         if(dUlp < (tfFloat ? 1.40e-45 : 4.94e-324)) dUlp = tfFloat ? 1.40e-45 : 4.94e-324;
+         if(dDiff != dDiff) dDiff = HUGE_VAL; // NaN for a number, or inf - inf
+         if(dDiff / dUlp > pErr->dMaxUlp) { pErr->dMaxUlp = dDiff / dUlp; pErr->dArgMaxUlp = dIn[r]; }
+         if(dRef != 0.00) {
+            dRel = dDiff / fabs(dRef);
+            if(dRel > pErr->dMaxRel) pErr->dMaxRel = dRel;
+            dSumSq += (dRel < 1.00) ? dRel * dRel : 1.00;
+            iRel++;
+         }
+         pErr->iNum++;
+      }
+   }
+   pErr->dRmsRel = (iRel > 0) ? sqrt(dSumSq / iRel) : 0.00;
+   return(EQERR_NONE);
+}
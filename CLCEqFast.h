@@ -0,0 +1,30 @@
+/*****************************************************************************
+*  CLCEqFast.h                                          CSIVM LaserCanvas
+*  Approximate transcendental functions for batch evaluation
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+#ifndef CLCEQFAST_H
+#define CLCEQFAST_H
+#include "CLCEqtn.h"                        // CEquation class, OP_ codes
+
+//===Accuracy Tiers=======================================
+// Selected with the EQBATCH_FASTMATH flags of DoEquationBatch(..).
+// Measured bounds against libm are listed in CLCEqFast.cpp.
+#define EQFAST_NONE                   0     // libm
+#define EQFAST_LOW                    1     // better than 1e-7 relative
+#define EQFAST_HIGH                   2     // within 4 ulp of libm
+
+//---Result of an accuracy measurement----------
+typedef struct tagEQFASTERR {
+   double dMaxRel;                          // largest relative error
+   double dMaxUlp;                          // largest error in ulp of the libm result
+   double dArgMaxUlp;                       // argument of largest ulp error
+   double dRmsRel;                          // root mean square relative error
+   int    iNum;                             // number of arguments compared
+} EQFASTERR;
+
+BOOL EqFastHasOp(int iUnaryOp);             // OP_ (without OP_UNARY) has a kernel
+template<class T> BOOL EqFastUnary(int iUnaryOp, int iTier, const T pa[], T pd[], int n);
+int  EqFastMeasure(int iUnaryOp, int iTier, BOOL tfFloat, double dLo, double dHi, int iNum, EQFASTERR *pErr);
+
+#endif/*CLCEQFAST_H*/
@@ -0,0 +1,482 @@
+/*****************************************************************************
+*  CLCEqFunc.cpp                                        CSIVM LaserCanvas
+*  User-defined functions and native callbacks
+*  Class declaration in CLCEqtn.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* DefineFunction(..) registers a formula under a name, with parameters, for
+* use in later equations as if it were a built-in function:
+*
+*    CEquation::DefineFunction("gauss(x, w) = exp(-2*x^2/w^2)");
+*    Eq.ParseEquation("P0 * gauss(r - r0, w0 um)", "P0\0r\0r0\0");
+*
+* The body is parsed once, when the function is defined, with the parameters
+* as its variables. An equation calling the function is parsed as usual, and
+* each call is then replaced by the body's program, in which every parameter
+* stands for the program of the corresponding argument. The result is the
+* same program as that of the pasted formula, gauss(r - r0, w0 um) becoming
+*    exp(-2*(r - r0)^2/(w0 um)^2)
+* so evaluation, batches, native code and saved records know nothing of user
+* functions, and calls cost nothing at evaluation time. An argument used twice
+* in the body is therefore also evaluated twice.
+*
+* Rules
+* -----
+*  - At least 1 and at most EQFUNC_MAXPARAM parameters.
+*  - The body may use its parameters, constants, units, tables, built-in and
+*    previously defined functions. It may not assign to parameters nor have a
+*    target unit (#..); units of the arguments pass through the body.
+*  - Names of built-in functions, constants and callbacks cannot be used.
+*    Variables of the calling equation hide functions of the same name.
+*  - Defining an existing name replaces the function for equations parsed
+*    from then on. Programs already parsed, e.g. in a CEquationCache, keep
+*    the former body; a saved record re-parsed from source uses the new one.
+*
+* Callbacks
+* ---------
+* AddCallback(..) makes a C function callable from equations, for what the
+* grammar cannot express, e.g. Bessel functions or a lookup in a database:
+*
+*    static double J0(const double pdArg[], void *pUser, int *piErr) {
+*       return(j0(pdArg[0]));
+*    }
+*    CEquation::AddCallback("besselj0", 1, J0);
+*    Eq.ParseEquation("besselj0(2.405 * r / a)", "r\0a\0");
+*
+* The name is parsed like that of a built-in function. The program holds a
+* token pointing to the callback, so evaluation calls the function through
+* its pointer without looking up the name. The batch calls use pfnBatch if
+* one is given, passing the argument columns of a chunk of rows (in double
+* only); otherwise, and in float, pfn is called row by row. A row for which
+* pfn sets *piErr, or all rows of a chunk for which pfnBatch returns non-
+* zero, are evaluated again by DoEquation(..), so the error is reported.
+*
+* Dimension rules: by default all arguments and the answer are dimension-
+* less. pszUnitArg gives the dimensions of the arguments instead, one unit
+* for all or one per argument separated by commas ("K, Pa"), and pszUnitAns
+* that of the answer; values are passed and returned in SI units. With
+*    EQCALLBACK_SAMEDIM  the arguments have any one dimension, the answer
+*                        the same (e.g. a smooth maximum), and with
+*    EQCALLBACK_ANYDIM   the arguments are not checked.
+*
+* Callbacks cannot be compiled to native code nor written to a library file
+* (EQERR_FILE_CALLBACK). A saved record finds the callback again by name
+* when it is loaded. Adding a callback under an existing name replaces its
+* functions and pUser, and must keep its arguments and dimensions; after
+* FreeCallbacks() equations calling them must be parsed again.
+*
+* Functions and callbacks are shared by all equations of the process. They
+* are not safe to register while other threads parse or evaluate equations.
+******************************************************************************/
+#include "CLCEqtn.h"                        // header file and definitions
+#include <stdlib.h>                         // malloc, calloc, free
+#include <string.h>                         // memcpy, memmove, strlen, strchr
+
+#define EQFUNC_MINSLOTS              32     // initial size of the hash indices
+#define EQFUNC_MAXUNITSTR            64     // characters of a callback's argument unit
+
+//===Registry=============================================
+// Each function is one block: EQFUNCTION, program, name.
+struct tagEQFUNCTION {
+   unsigned int uHash;                      // FNV-1a hash of the name
+   int          iNumParam;                  // parameters, REF 0..iNumParam-1 in pvoBody
+   int          iBodyLen;                   // tokens in pvoBody
+   const VALOP *pvoBody;                    // program of the body
+   const char  *pszName;                    // name in equations
+};
+
+static EQFUNCTION **s_ppFunc    = NULL;     // hash index of functions
+static int          s_iNumSlot  = 0;        // size of s_ppFunc (power of 2)
+static int          s_iNumFunc  = 0;        // functions defined
+
+static EQCALLBACK **s_ppCall    = NULL;     // hash index of callbacks
+static int          s_iNumCallSlot = 0;     // size of s_ppCall (power of 2)
+static int          s_iNumCall  = 0;        // callbacks added
+
+//---Slot---------------------------------------
+// Slot of the name of iLen characters at psz, or the empty
+// slot where it would go.
+static EQFUNCTION **_EqFuncSlot(const char *psz, int iLen, unsigned int uHash) {
+   EQFUNCTION *pf;                          // function in slot
+   int         k;                           // slot
+   for(k=(int) (uHash & (s_iNumSlot-1)); (pf = s_ppFunc[k]) != NULL; k=(k+1) & (s_iNumSlot-1))
+      if((pf->uHash == uHash) && ((int) strlen(pf->pszName) == iLen) && (memcmp(pf->pszName, psz, iLen) == 0)) break;
+   return(&s_ppFunc[k]);
+}
+
+/*********************************************************
+* EqFindFunction
+* Function named by the iLen characters at psz, NULL if
+* none is defined.
+*********************************************************/
+const EQFUNCTION *EqFindFunction(const char *psz, int iLen) {
+   if(s_iNumFunc == 0) return(NULL);
+   return(*_EqFuncSlot(psz, iLen, EqHashFnv1a(psz, iLen)));
+}
+
+//---Callback slot------------------------------
+static EQCALLBACK **_EqCallSlot(const char *psz, int iLen, unsigned int uHash) {
+   EQCALLBACK *pc;                          // callback in slot
+   int         k;                           // slot
+   for(k=(int) (uHash & (s_iNumCallSlot-1)); (pc = s_ppCall[k]) != NULL; k=(k+1) & (s_iNumCallSlot-1))
+      if((pc->uHash == uHash) && ((int) strlen(pc->pszName) == iLen) && (memcmp(pc->pszName, psz, iLen) == 0)) break;
+   return(&s_ppCall[k]);
+}
+
+/*********************************************************
+* EqFindCallback
+* Callback named by the iLen characters at psz, NULL if
+* none is registered.
+*********************************************************/
+const EQCALLBACK *EqFindCallback(const char *psz, int iLen) {
+   if(s_iNumCall == 0) return(NULL);
+   return(*_EqCallSlot(psz, iLen, EqHashFnv1a(psz, iLen)));
+}
+
+/*********************************************************
+* EqCallbackDim
+* Applies the dimension rule of a callback (see top of
+* file) to the dimensions of its arguments. Returns
+* EQERR_EVAL_UNITNOTDIMLESS or EQERR_EVAL_UNITMISMATCH if
+* they do not fit, with *puAns set in any case.
+*********************************************************/
+int EqCallbackDim(const EQCALLBACK *pc, const UNITBASE puArg[], UNITBASE *puAns) {
+   int k;                                   // argument
+   if(pc->uFlags & EQCALLBACK_SAMEDIM) {
+      *puAns = puArg[0];
+      for(k=1; k<pc->iArgc; k++) if(puArg[k].u != puArg[0].u) return(EQERR_EVAL_UNITMISMATCH);
+      return(EQERR_NONE);
+   }
+   *puAns = pc->uUnitAns;
+   if(pc->uFlags & EQCALLBACK_ANYDIM) return(EQERR_NONE);
+   for(k=0; k<pc->iArgc; k++)
+      if(puArg[k].u != pc->uUnitArg[k].u) return((pc->uUnitArg[k].u == 0) ? EQERR_EVAL_UNITNOTDIMLESS : EQERR_EVAL_UNITMISMATCH);
+   return(EQERR_NONE);
+}
+
+//---Name---------------------------------------
+// Length of the identifier at psz, 0 if there is none.
+static int _EqFuncName(const char *psz) {
+   int iLen;                                // characters
+   if((*psz == '\0') || (strchr(EQ_VALIDCHAR, *psz) == NULL)) return(0);
+   for(iLen=1; (psz[iLen] != '\0') && (strchr(EQ_VALIDSYMB, psz[iLen]) != NULL); iLen++) ;
+   return(iLen);
+}
+
+//---Built-in-----------------------------------
+// TRUE if iLen characters at psz name one of the iNum
+// strings of the NULL-separated list pszList.
+static BOOL _EqFuncInList(const char *psz, int iLen, const char *pszList, int iNum) {
+   for(; iNum > 0; iNum--, pszList += strlen(pszList)+1)
+      if(((int) strlen(pszList) == iLen) && (memcmp(pszList, psz, iLen) == 0)) return(TRUE);
+   return(FALSE);
+}
+
+/*********************************************************
+* EqIsBuiltinName
+* TRUE if the iLen characters at psz name a built-in
+* function, n-arg operator or constant. User functions,
+* callbacks and tables must not hide these.
+*********************************************************/
+BOOL EqIsBuiltinName(const char *psz, int iLen) {
+   return(   _EqFuncInList(psz, iLen, CEquationUnaryOpStr, NUM_UNARYOP)
+          || _EqFuncInList(psz, iLen, CEquationNArgOpStr, NUM_NARGOP)
+          || _EqFuncInList(psz, iLen, CEquationSIUnitConstStr, EQSI_NUMCONST));
+}
+
+/*********************************************************
+* DefineFunction
+* Registers "name(p1, p2, ..) = body" (see top of file).
+* Returns
+*  EQERR_NONE
+*  EQERR_PARSE_FUNCDEF  no name, parameter list or "=",
+*                       a built-in, callback or table
+*                       name, an assignment or a target
+*                       unit in the body
+*  EQERR_PARSE_ALLOCFAIL, or the error parsing the body
+*********************************************************/
+int CEquation::DefineFunction(const char *pszDef) {
+   CEquation    Eq;                         // program of the body
+   EQFUNCTION  *pf;                         // new function
+   EQFUNCTION **ppSlot;                     // its slot
+   EQFUNCTION **ppOld;                      // index being grown
+   char        *pszParam;                   // double-NULL parameter list
+   const char  *psz;                        // scan of definition
+   const char  *pszName;                    // function name
+   int          iNameLen, iLen;             // identifier lengths
+   int          iNumParam;                  // parameters
+   int          iParamLen;                  // used in pszParam
+   int          k, iOld;                    // tokens, slots
+   int          iErr;                       // body errors
+
+   //---Head-------------------------------------
+   if(pszDef == NULL) return(EQERR_PARSE_FUNCDEF);
+   for(psz=pszDef; *psz == ' '; psz++) ;
+   pszName = psz;
+   if((iNameLen = _EqFuncName(pszName)) == 0) return(EQERR_PARSE_FUNCDEF);
+   if(   EqIsBuiltinName(pszName, iNameLen)
+      || (EqFindCallback(pszName, iNameLen) != NULL)
+      || (EqFindTableName(pszName, iNameLen) != NULL)) return(EQERR_PARSE_FUNCDEF);
+   for(psz+=iNameLen; *psz == ' '; psz++) ;
+   if(*psz++ != '(') return(EQERR_PARSE_FUNCDEF);
+
+   if((pszParam = (char*) malloc(strlen(psz) + 2)) == NULL) return(EQERR_PARSE_ALLOCFAIL);
+   for(iNumParam=0, iParamLen=0; ; ) {
+      while(*psz == ' ') psz++;
+      if((iLen = _EqFuncName(psz)) == 0) {
+         iNumParam = 0;
+         break;
+      }
+      memcpy(pszParam+iParamLen, psz, iLen);
+      iParamLen += iLen;
+      pszParam[iParamLen++] = '\0';
+      iNumParam++;
+      for(psz+=iLen; *psz == ' '; psz++) ;
+      if(*psz != ',') break;
+      psz++;
+   }
+   pszParam[iParamLen] = '\0';              // double-NULL
+   if(*psz == ')') for(psz++; *psz == ' '; psz++) ;
+   else iNumParam = 0;                      // malformed list
+   if((iNumParam < 1) || (iNumParam > EQFUNC_MAXPARAM) || (psz[0] != '=') || (psz[1] == '=')) {
+      free(pszParam);
+      return(EQERR_PARSE_FUNCDEF);
+   }
+
+   //---Body-------------------------------------
+   iErr = Eq.ParseEquation(psz+1, pszParam);
+   free(pszParam);
+   if(iErr != EQERR_NONE) return(iErr);
+   if(Eq.m_dScleTarget != 0.00) return(EQERR_PARSE_FUNCDEF); // target unit
+   for(k=0; k<Eq.iEqnLength; k++)
+      if((Eq.pvoEquation[k].uTyp == VOTYP_OP) && (Eq.pvoEquation[k].uOp == OP_SET)) return(EQERR_PARSE_FUNCDEF);
+
+   pf = (EQFUNCTION*) malloc(sizeof(EQFUNCTION) + Eq.iEqnLength * sizeof(VALOP) + iNameLen + 1);
+   if(pf == NULL) return(EQERR_PARSE_ALLOCFAIL);
+   memcpy((VALOP*) (pf + 1), Eq.pvoEquation, Eq.iEqnLength * sizeof(VALOP));
+   memcpy((char*) (pf + 1) + Eq.iEqnLength * sizeof(VALOP), pszName, iNameLen);
+   ((char*) (pf + 1))[Eq.iEqnLength * sizeof(VALOP) + iNameLen] = '\0';
+   pf->uHash     = EqHashFnv1a(pszName, iNameLen);
+   pf->iNumParam = iNumParam;
+   pf->iBodyLen  = Eq.iEqnLength;
+   pf->pvoBody   = (VALOP*) (pf + 1);
+   pf->pszName   = (char*) (pf + 1) + Eq.iEqnLength * sizeof(VALOP);
+
+   //---Index------------------------------------
+   if(2*(s_iNumFunc+1) > s_iNumSlot) {
+      ppOld = s_ppFunc;
+      iOld  = s_iNumSlot;
+      s_iNumSlot = MAX(EQFUNC_MINSLOTS, 2*s_iNumSlot);
+      s_ppFunc   = (EQFUNCTION**) calloc(s_iNumSlot, sizeof(EQFUNCTION*));
+      if(s_ppFunc == NULL) {
+         s_ppFunc   = ppOld;
+         s_iNumSlot = iOld;
+         free(pf);
+         return(EQERR_PARSE_ALLOCFAIL);
+      }
+      for(k=0; k<iOld; k++)
+         if(ppOld[k]) *_EqFuncSlot(ppOld[k]->pszName, (int) strlen(ppOld[k]->pszName), ppOld[k]->uHash) = ppOld[k];
+      if(ppOld) free(ppOld);
+   }
+   ppSlot = _EqFuncSlot(pszName, iNameLen, pf->uHash);
+   if(*ppSlot != NULL) {                    // replace
+      free(*ppSlot);
+      s_iNumFunc--;
+   }
+   *ppSlot = pf;
+   s_iNumFunc++;
+   return(EQERR_NONE);
+}
+
+//===Free=================================================
+void CEquation::FreeFunctions(void) {
+   for(int k=0; k<s_iNumSlot; k++) if(s_ppFunc[k]) free(s_ppFunc[k]);
+   if(s_ppFunc) free(s_ppFunc);
+   s_ppFunc   = NULL;
+   s_iNumSlot = 0;
+   s_iNumFunc = 0;
+}
+
+/*********************************************************
+* AddCallback
+* Registers a native function of iArgc arguments (see top
+* of file). pfnBatch, pUser and the units are optional.
+* Returns
+*  EQERR_NONE
+*  EQERR_PARSE_FUNCDEF  name not a valid identifier, or a
+*                       built-in, user function or table
+*                       name;
+*                       no pfn; iArgc out of range; or
+*                       arguments or dimensions differ
+*                       from those of the same name
+*  EQERR_PARSE_ALLOCFAIL, or the error of a unit string
+*********************************************************/
+int CEquation::AddCallback(const char *pszName, int iArgc, EQCALLBACKFN pfn, EQCALLBACKBATCHFN pfnBatch, void *pUser,
+      UINT uFlags, const char *pszUnitArg, const char *pszUnitAns) {
+   CEquation    Eq;                         // for _StringToUnit(..)
+   EQCALLBACK   Call;                       // assembled record
+   EQCALLBACK  *pc;                         // stored record
+   EQCALLBACK **ppSlot;                     // its slot
+   EQCALLBACK **ppOld;                      // index being grown
+   char         szUnit[EQFUNC_MAXUNITSTR];  // one argument's unit
+   const char  *psz;                        // scan of pszUnitArg
+   double       dScl, dOff;                 // unused conversion
+   int          iNameLen, iLen;             // name, unit lengths
+   int          k, iOld;                    // arguments, slots
+   int          iErr;                       // unit errors
+
+   //---Check------------------------------------
+   if((pszName == NULL) || (pfn == NULL) || (iArgc < 1) || (iArgc > EQCALLBACK_MAXARG)) return(EQERR_PARSE_FUNCDEF);
+   iNameLen = (int) strlen(pszName);
+   if((_EqFuncName(pszName) != iNameLen) || (iNameLen == 0)
+      || EqIsBuiltinName(pszName, iNameLen)
+      || (EqFindFunction(pszName, iNameLen) != NULL)
+      || (EqFindTableName(pszName, iNameLen) != NULL)) return(EQERR_PARSE_FUNCDEF);
+
+   //---Dimensions-------------------------------
+   memset(&Call, 0x00, sizeof(Call));
+   if(pszUnitAns && ((iErr = Eq._StringToUnit(pszUnitAns, NULL, 0, &Call.uUnitAns, &dScl, &dOff)) != EQERR_NONE)) return(iErr);
+   for(k=0, psz=pszUnitArg; psz && (k < iArgc); k++) {
+      for(iLen=0; psz[iLen] && (psz[iLen] != ','); iLen++) ;
+      if(iLen >= (int) sizeof(szUnit)) return(EQERR_PARSE_FUNCDEF);
+      memcpy(szUnit, psz, iLen);
+      szUnit[iLen] = '\0';
+      if((iErr = Eq._StringToUnit(szUnit, NULL, 0, &Call.uUnitArg[k], &dScl, &dOff)) != EQERR_NONE) return(iErr);
+      psz = (psz[iLen] == ',') ? psz+iLen+1 : NULL;
+   }
+   if(psz != NULL) return(EQERR_PARSE_FUNCDEF); // more units than arguments
+   if(k == 1) for(; k<iArgc; k++) Call.uUnitArg[k] = Call.uUnitArg[0]; // one for all
+   else if((k > 1) && (k < iArgc)) return(EQERR_PARSE_FUNCDEF);
+   Call.pfn      = pfn;
+   Call.pfnBatch = pfnBatch;
+   Call.pUser    = pUser;
+   Call.iArgc    = iArgc;
+   Call.uFlags   = uFlags;
+   Call.uHash    = EqHashFnv1a(pszName, iNameLen);
+
+   //---Replace in place-------------------------
+   // Programs point to the record; it stays where it is.
+   if((pc = (EQCALLBACK*) EqFindCallback(pszName, iNameLen)) != NULL) {
+      if((pc->iArgc != iArgc) || (pc->uFlags != uFlags) || (pc->uUnitAns.u != Call.uUnitAns.u)) return(EQERR_PARSE_FUNCDEF);
+      for(k=0; k<iArgc; k++) if(pc->uUnitArg[k].u != Call.uUnitArg[k].u) return(EQERR_PARSE_FUNCDEF);
+      pc->pfn      = pfn;
+      pc->pfnBatch = pfnBatch;
+      pc->pUser    = pUser;
+      return(EQERR_NONE);
+   }
+
+   //---New record-------------------------------
+   pc = (EQCALLBACK*) malloc(sizeof(EQCALLBACK) + iNameLen + 1);
+   if(pc == NULL) return(EQERR_PARSE_ALLOCFAIL);
+   *pc = Call;
+   memcpy((char*) (pc + 1), pszName, iNameLen+1);
+   pc->pszName = (char*) (pc + 1);
+
+   if(2*(s_iNumCall+1) > s_iNumCallSlot) {
+      ppOld = s_ppCall;
+      iOld  = s_iNumCallSlot;
+      s_iNumCallSlot = MAX(EQFUNC_MINSLOTS, 2*s_iNumCallSlot);
+      s_ppCall = (EQCALLBACK**) calloc(s_iNumCallSlot, sizeof(EQCALLBACK*));
+      if(s_ppCall == NULL) {
+         s_ppCall       = ppOld;
+         s_iNumCallSlot = iOld;
+         free(pc);
+         return(EQERR_PARSE_ALLOCFAIL);
+      }
+      for(k=0; k<iOld; k++)
+         if(ppOld[k]) *_EqCallSlot(ppOld[k]->pszName, (int) strlen(ppOld[k]->pszName), ppOld[k]->uHash) = ppOld[k];
+      if(ppOld) free(ppOld);
+   }
+   ppSlot  = _EqCallSlot(pszName, iNameLen, pc->uHash);
+   *ppSlot = pc;
+   s_iNumCall++;
+   return(EQERR_NONE);
+}
+
+//===Free=================================================
+void CEquation::FreeCallbacks(void) {
+   for(int k=0; k<s_iNumCallSlot; k++) if(s_ppCall[k]) free(s_ppCall[k]);
+   if(s_ppCall) free(s_ppCall);
+   s_ppCall       = NULL;
+   s_iNumCallSlot = 0;
+   s_iNumCall     = 0;
+}
+
+/*********************************************************
+* _ResolveFunctions                               Private
+* Called by _ParseEquation(..) on the finished program.
+* Each call, an OP_NARG_FUNCTION token and its argument
+* count, is resolved by the name at the token's source
+* position:
+*  - a callback becomes a single VOTYP_CALL token;
+*  - a user function is replaced by its body. The argu-
+*    ments are found from the stack heights, as in
+*    _BuildArrayPlan(); an assignment leaves the stack
+*    lower by one before its variable token. Body tokens
+*    take the position of the call, for error messages.
+* Calls are resolved from the left, so those within argu-
+* ments come first. Returns an error code, with iError-
+* Location at the failing call.
+*********************************************************/
+int CEquation::_ResolveFunctions(void) {
+   const EQFUNCTION *pf;                    // function called
+   const EQCALLBACK *pc;                    // callback called
+   VALOP *pvoNew;                           // program with one call replaced
+   int   *piHgt;                            // stack height after each token
+   int    iStart[EQFUNC_MAXPARAM], iEnd[EQFUNC_MAXPARAM]; // token ranges of the arguments
+   int    iPt, iPos, iLen, iNew;            // call, its name, new program
+   int    j, k, t;                          // body tokens, arguments, tokens
+
+   for(iPt=0; iPt<iEqnLength; iPt++) {
+      if((pvoEquation[iPt].uTyp != VOTYP_OP) || (pvoEquation[iPt].uOp != OP_NARG+OP_NARG_FUNCTION)) continue;
+      iPos = iErrorLocation = pvoEquation[iPt].iPos;
+      if((iLen = _EqFuncName(pszSrcEquation+iPos)) == 0) return(EQERR_PARSE_UNKNOWNFUNCVAR);
+
+      //---Callback-------------------------------
+      if((pf = EqFindFunction(pszSrcEquation+iPos, iLen)) == NULL) {
+         if((pc = EqFindCallback(pszSrcEquation+iPos, iLen)) == NULL) return(EQERR_PARSE_UNKNOWNFUNCVAR);
+         if((iPt+1 >= iEqnLength) || (pvoEquation[iPt+1].iArgc != pc->iArgc)) return(EQERR_PARSE_NARGBADCOUNT);
+         pvoEquation[iPt].uTyp  = VOTYP_CALL;
+         pvoEquation[iPt].pCall = pc;
+         memmove(pvoEquation+iPt+1, pvoEquation+iPt+2, (iEqnLength-iPt-2) * sizeof(VALOP));
+         iEqnLength--;                      // argument count dropped
+         continue;
+      }
+      if((iPt+1 >= iEqnLength) || (pvoEquation[iPt+1].iArgc != pf->iNumParam)) return(EQERR_PARSE_NARGBADCOUNT);
+
+      //---Arguments------------------------------
+      if((piHgt = _StackHeights()) == NULL) return(EQERR_PARSE_ALLOCFAIL);
+      for(t=iPt-1, k=pf->iNumParam-1; k>=0; k--) {
+         iEnd[k] = t;
+         for(t--; (t>=0) && ((piHgt[t]>=piHgt[iEnd[k]])
+            || ((pvoEquation[t].uTyp == VOTYP_OP) && (pvoEquation[t].uOp == OP_SET))); t--) ;
+         iStart[k] = t+1;
+      }
+      free(piHgt);
+
+      //---Replace--------------------------------
+      iNew = iEqnLength - (iPt+2 - iStart[0]);
+      for(j=0; j<pf->iBodyLen; j++)
+         iNew += (pf->pvoBody[j].uTyp == VOTYP_REF) ? iEnd[pf->pvoBody[j].iRef] - iStart[pf->pvoBody[j].iRef] + 1 : 1;
+      if((pvoNew = (VALOP*) malloc(MAX(1, iNew) * sizeof(VALOP))) == NULL) return(EQERR_PARSE_ALLOCFAIL);
+      memcpy(pvoNew, pvoEquation, iStart[0] * sizeof(VALOP));
+      for(iLen=iStart[0], j=0; j<pf->iBodyLen; j++) {
+         if(pf->pvoBody[j].uTyp == VOTYP_REF) {
+            k = pf->pvoBody[j].iRef;
+            memcpy(pvoNew+iLen, pvoEquation+iStart[k], (iEnd[k]-iStart[k]+1) * sizeof(VALOP));
+            iLen += iEnd[k]-iStart[k]+1;
+         } else {
+            pvoNew[iLen] = pf->pvoBody[j];
+            pvoNew[iLen++].iPos = iPos;
+         }
+      }
+      memcpy(pvoNew+iLen, pvoEquation+iPt+2, (iEqnLength-iPt-2) * sizeof(VALOP));
+      free(pvoEquation);
+      pvoEquation = pvoNew;
+      m_iEqnAlloc = iEqnLength = iNew;
+      iPt = iLen - 1;                       // continue after the body
+   }
+   return(EQERR_NONE);
+}
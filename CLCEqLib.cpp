@@ -0,0 +1,336 @@
+/*****************************************************************************
+*  CLCEqLib.cpp                                         CSIVM LaserCanvas
+*  Memory-mapped library file of compiled CEquation programs
+*  Class declaration in CLCEqLib.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* A library file holds many compiled equations together with a hash index by
+* name. It is mapped read-only, so worker processes on the same machine share
+* a single physical copy, and opening it costs only a check of each program.
+*
+* Usage Example
+* -------------
+*    // build (once)
+*    CEquationLibrary::Write("formulas.eql", iNum, ppEq, ppszName);
+*
+*    // use (every process)
+*    CEquationLibrary Lib;
+*    CEquation        Eq;
+*    Lib.Open("formulas.eql");
+*    Lib.Attach(Lib.Find("beam_waist"), &Eq); // no allocation
+*    Eq.DoEquation(dVar, &dAns);
+*
+* An attached equation refers into the mapping: the library must stay open
+* while the equation is used. Re-parsing or loading into the equation simply
+* drops the reference. dVar must hold at least GetNumVar(..) values.
+******************************************************************************/
+#include "CLCEqLib.h"                       // header file and definitions
+#ifndef _WIN32
+# include <sys/mman.h>                      // mmap
+# include <sys/stat.h>                      // fstat
+# include <fcntl.h>                         // open
+# include <unistd.h>                        // close
+#endif//_WIN32
+
+#define EQLIB_ROUNDUP(n)  (((n) + EQLIB_ALIGN-1) & ~(size_t)(EQLIB_ALIGN-1))
+
+/*********************************************************
+*  Constructor and destructor
+*********************************************************/
+CEquationLibrary::CEquationLibrary(void) {
+   m_pBase  = NULL;                         // nothing mapped
+   m_uLen   = 0;
+   m_pHead  = NULL;
+   m_pEntry = NULL;
+   m_puSlot = NULL;
+#ifdef _WIN32
+   m_hFile  = INVALID_HANDLE_VALUE;
+   m_hMap   = NULL;
+#endif//_WIN32
+}
+
+CEquationLibrary::~CEquationLibrary() {
+   Close();
+}
+
+/*********************************************************
+*  Write
+*  Builds a library file from parsed equations. Names are
+*  optional; if pszName is NULL, each equation's source
+*  string doubles as its name. Names should be unique,
+*  otherwise Find(..) returns the first. Equations that
+*  call functions registered by AddCallback(..) cannot be
+*  written (EQERR_FILE_CALLBACK): the addresses are only
+*  valid in this process.
+*********************************************************/
+int CEquationLibrary::Write(const char *pszFile, int iNum, CEquation *const pEq[], const char *const pszName[]) {
+   EQLIBHEADER  *pHead;                     // header in buffer
+   EQLIBENTRY   *pEnt;                      // entry in buffer
+   unsigned int *puSlot;                    // hash index in buffer
+   unsigned char *pBuf;                     // assembled file
+   const char   *pszNm;                     // name of this equation
+   size_t        uStr;                      // size of string area
+   size_t        uOps;                      // size of VALOP area
+   size_t        uOffs;                     // running offset
+   size_t        uOffsStr;                  // running string offset
+   size_t        uLen;                      // total file length
+   unsigned int  uNumSlot;                  // hash index size
+   unsigned int  uSlot;                     // hash probe
+   FILE         *fp;                        // output file
+   int           k, iPt;                    // loop counters
+   int           iErr;                      // return code
+
+   if((pszFile==NULL) || (iNum<0) || ((iNum>0) && (pEq==NULL))) return(EQERR_FILE_READWRITE);
+
+   //---Sizes-----------------------------------
+   for(uStr=uOps=0, k=0; k<iNum; k++) {
+      if((pEq[k]==NULL) || (pEq[k]->iEqnLength<=0) || (pEq[k]->pszSrcEquation==NULL))
+         return(EQERR_PARSE_NOEQUATION);
+      for(iPt=0; iPt<pEq[k]->iEqnLength; iPt++)
+         if(pEq[k]->pvoEquation[iPt].uTyp == VOTYP_CALL) return(EQERR_FILE_CALLBACK);
+      pszNm = (pszName) ? pszName[k] : pEq[k]->pszSrcEquation;
+      uStr += strlen(pszNm) + 1 + strlen(pEq[k]->pszSrcEquation) + 1;
+      uOps += EQLIB_ROUNDUP(pEq[k]->iEqnLength * sizeof(VALOP));
+   }
+   for(uNumSlot=16; uNumSlot < 2*(unsigned int)iNum; uNumSlot*=2);
+   uOffs = EQLIB_ROUNDUP(sizeof(EQLIBHEADER));
+   uOffs = EQLIB_ROUNDUP(uOffs + iNum*sizeof(EQLIBENTRY));
+   uOffs = uOffs + uNumSlot*sizeof(unsigned int);
+   uLen  = EQLIB_ROUNDUP(uOffs + uStr) + uOps;
+   if(uLen >= 0xFFFFFFFFu) return(EQERR_FILE_BUFFERSIZE); // 32-bit offsets
+
+   pBuf = (unsigned char*) calloc(uLen, 1);
+   if(pBuf == NULL) return(EQERR_PARSE_ALLOCFAIL);
+
+   //---Header----------------------------------
+   pHead = (EQLIBHEADER*) pBuf;
+   memcpy(pHead->szMagic, EQLIB_MAGIC, 4);
+   pHead->uVersion   = EQLIB_VERSION;
+   pHead->uByteOrder = EQLIB_BYTEORDER;
+   pHead->uSizeValop = sizeof(VALOP);
+   pHead->uSizeEntry = sizeof(EQLIBENTRY);
+   pHead->uSignature = EqTableSignature();
+   pHead->uNumEntry  = iNum;
+   pHead->uNumSlot   = uNumSlot;
+   pHead->uEntryOffs = (unsigned int) EQLIB_ROUNDUP(sizeof(EQLIBHEADER));
+   pHead->uSlotOffs  = (unsigned int) EQLIB_ROUNDUP(pHead->uEntryOffs + iNum*sizeof(EQLIBENTRY));
+   pHead->uFileLen   = (unsigned int) uLen;
+   puSlot = (unsigned int*) (pBuf + pHead->uSlotOffs);
+
+   //---Entries---------------------------------
+   uOffsStr = pHead->uSlotOffs + uNumSlot*sizeof(unsigned int);
+   uOffs    = EQLIB_ROUNDUP(uOffsStr + uStr); // VALOP arrays follow strings
+   for(k=0; k<iNum; k++) {
+      pEnt  = (EQLIBENTRY*) (pBuf + pHead->uEntryOffs) + k;
+      pszNm = (pszName) ? pszName[k] : pEq[k]->pszSrcEquation;
+      pEnt->uNameHash = EqHashFnv1a(pszNm, strlen(pszNm));
+      pEnt->uNameOffs = (unsigned int) uOffsStr;
+      strcpy((char*) pBuf+uOffsStr, pszNm);
+      uOffsStr += strlen(pszNm) + 1;
+      pEnt->uSrcOffs  = (unsigned int) uOffsStr;
+      strcpy((char*) pBuf+uOffsStr, pEq[k]->pszSrcEquation);
+      uOffsStr += strlen(pEq[k]->pszSrcEquation) + 1;
+      pEnt->uOpsOffs  = (unsigned int) uOffs;
+      pEnt->iNumOps   = pEq[k]->iEqnLength;
+      for(iPt=0; iPt<pEq[k]->iEqnLength; iPt++)
+         if(pEq[k]->pvoEquation[iPt].uTyp == VOTYP_REF) pEnt->iNumVar = MAX(pEnt->iNumVar, pEq[k]->pvoEquation[iPt].iRef+1);
+      memcpy(pBuf+uOffs, pEq[k]->pvoEquation, pEq[k]->iEqnLength * sizeof(VALOP));
+      uOffs += EQLIB_ROUNDUP(pEq[k]->iEqnLength * sizeof(VALOP));
+      pEnt->uUnitTarget = pEq[k]->m_uUnitTarget;
+      pEnt->dScleTarget = pEq[k]->m_dScleTarget;
+      pEnt->dOffsTarget = pEq[k]->m_dOffsTarget;
+      if(pEq[k]->m_dScleTarget != 0.00)     // target unit string only
+         memcpy(pEnt->szUnit, pEq[k]->m_szUnit, sizeof(pEnt->szUnit));
+
+      //---index---
+      for(uSlot=pEnt->uNameHash & (uNumSlot-1); puSlot[uSlot]!=0; uSlot=(uSlot+1) & (uNumSlot-1));
+      puSlot[uSlot] = k + 1;
+   }
+   pHead->uChecksum = EqHashFnv1a(pBuf+sizeof(EQLIBHEADER), uLen-sizeof(EQLIBHEADER));
+
+   //---Write-----------------------------------
+   iErr = EQERR_NONE;
+   fp = fopen(pszFile, "wb");
+   if(fp == NULL) iErr = EQERR_FILE_READWRITE;
+   else {
+      if(fwrite(pBuf, 1, uLen, fp) != uLen) iErr = EQERR_FILE_READWRITE;
+      if(fclose(fp) != 0) iErr = EQERR_FILE_READWRITE;
+   }
+   free(pBuf);
+   return(iErr);
+}
+
+/*********************************************************
+*  Open / Close
+*  Maps the file read-only. The header, the entry table
+*  and every program are validated. With tfVerify, the
+*  checksum of the whole file is checked as well, which
+*  also touches the strings.
+*********************************************************/
+int CEquationLibrary::Open(const char *pszFile, BOOL tfVerify) {
+   int iErr;                                // validation result
+   Close();                                 // drop previous mapping
+   if(pszFile == NULL) return(EQERR_FILE_READWRITE);
+
+#ifdef _WIN32
+   LARGE_INTEGER liSize;                    // file size
+   m_hFile = CreateFileA(pszFile, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if(m_hFile == INVALID_HANDLE_VALUE) return(EQERR_FILE_READWRITE);
+   if(!GetFileSizeEx(m_hFile, &liSize) || (liSize.QuadPart < (LONGLONG) sizeof(EQLIBHEADER))) { Close(); return(EQERR_FILE_BADFORMAT); }
+   m_hMap = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+   if(m_hMap == NULL) { Close(); return(EQERR_FILE_READWRITE); }
+   m_pBase = (const unsigned char*) MapViewOfFile(m_hMap, FILE_MAP_READ, 0, 0, 0);
+   if(m_pBase == NULL) { Close(); return(EQERR_FILE_READWRITE); }
+   m_uLen = (size_t) liSize.QuadPart;
+#else
+   struct stat st;                          // file size
+   void *pv;                                // mapping
+   int   fd = open(pszFile, O_RDONLY);
+   if(fd < 0) return(EQERR_FILE_READWRITE);
+   if((fstat(fd, &st) != 0) || (st.st_size < (off_t) sizeof(EQLIBHEADER))) { close(fd); return(EQERR_FILE_BADFORMAT); }
+   pv = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);                               // mapping keeps its own reference
+   if(pv == MAP_FAILED) return(EQERR_FILE_READWRITE);
+   m_pBase = (const unsigned char*) pv;
+   m_uLen  = (size_t) st.st_size;
+#endif//_WIN32
+
+   iErr = _Validate(tfVerify);
+   if(iErr != EQERR_NONE) Close();
+   return(iErr);
+}
+
+void CEquationLibrary::Close(void) {
+#ifdef _WIN32
+   if(m_pBase) UnmapViewOfFile((LPCVOID) m_pBase);
+   if(m_hMap) CloseHandle(m_hMap);
+   if(m_hFile != INVALID_HANDLE_VALUE) CloseHandle(m_hFile);
+   m_hMap  = NULL;
+   m_hFile = INVALID_HANDLE_VALUE;
+#else
+   if(m_pBase) munmap((void*) m_pBase, m_uLen);
+#endif//_WIN32
+   m_pBase  = NULL;
+   m_uLen   = 0;
+   m_pHead  = NULL;
+   m_pEntry = NULL;
+   m_puSlot = NULL;
+}
+
+//===Validate=============================================
+// Bounds-check everything Attach(..) and the evaluators
+// will later trust
+int CEquationLibrary::_Validate(BOOL tfVerify) {
+   const EQLIBENTRY *pEnt;                  // entry loop pointer
+   const VALOP      *pvo;                   // entry's program
+   unsigned int k;                          // loop counter
+   int          iPt;                        // token loop counter
+
+   m_pHead = (const EQLIBHEADER*) m_pBase;
+   if(memcmp(m_pHead->szMagic, EQLIB_MAGIC, 4) != 0) return(EQERR_FILE_BADFORMAT);
+   if((m_pHead->uVersion   != EQLIB_VERSION)
+      || (m_pHead->uByteOrder != EQLIB_BYTEORDER)
+      || (m_pHead->uSizeValop != sizeof(VALOP))
+      || (m_pHead->uSizeEntry != sizeof(EQLIBENTRY))
+      || (m_pHead->uSignature != EqTableSignature())) return(EQERR_FILE_VERSION);
+   if((m_pHead->uFileLen != m_uLen)
+      || (m_pHead->uEntryOffs % EQLIB_ALIGN) || (m_pHead->uSlotOffs % sizeof(unsigned int))
+      || (m_pHead->uEntryOffs + (size_t) m_pHead->uNumEntry*sizeof(EQLIBENTRY) > m_uLen)
+      || (m_pHead->uSlotOffs  + (size_t) m_pHead->uNumSlot*sizeof(unsigned int) > m_uLen)
+      || (m_pHead->uNumSlot == 0) || (m_pHead->uNumSlot & (m_pHead->uNumSlot-1))
+      || (m_pHead->uNumSlot <= m_pHead->uNumEntry)) return(EQERR_FILE_BADFORMAT);
+   if(tfVerify && (m_pHead->uChecksum != EqHashFnv1a(m_pBase+sizeof(EQLIBHEADER), m_uLen-sizeof(EQLIBHEADER))))
+      return(EQERR_FILE_CHECKSUM);
+
+   m_pEntry = (const EQLIBENTRY*)   (m_pBase + m_pHead->uEntryOffs);
+   m_puSlot = (const unsigned int*) (m_pBase + m_pHead->uSlotOffs);
+   for(k=0; k<m_pHead->uNumEntry; k++) {
+      pEnt = m_pEntry + k;
+      if((pEnt->uNameOffs >= m_uLen) || (pEnt->uSrcOffs >= m_uLen)
+         || (memchr(m_pBase+pEnt->uNameOffs, '\0', m_uLen-pEnt->uNameOffs) == NULL)
+         || (memchr(m_pBase+pEnt->uSrcOffs,  '\0', m_uLen-pEnt->uSrcOffs ) == NULL)
+         || (pEnt->uOpsOffs % EQLIB_ALIGN) || (pEnt->iNumOps <= 0)
+         || (pEnt->uOpsOffs + (size_t) pEnt->iNumOps*sizeof(VALOP) > m_uLen)
+         || (pEnt->iNumVar < 0)
+         || (memchr(pEnt->szUnit, '\0', sizeof(pEnt->szUnit)) == NULL)) return(EQERR_FILE_BADFORMAT);
+
+      //---program---
+      // Write(..) never stores callbacks, so a pointer here
+      // could only be planted; never call through it.
+      pvo = (const VALOP*) (m_pBase + pEnt->uOpsOffs);
+      for(iPt=0; iPt<pEnt->iNumOps; iPt++)
+         if(pvo[iPt].uTyp == VOTYP_CALL) return(EQERR_FILE_CALLBACK);
+      if(!CEquation::_CheckProgram(pvo, pEnt->iNumOps, pEnt->iNumVar)) return(EQERR_FILE_BADFORMAT);
+   }
+   return(EQERR_NONE);
+}
+
+/*********************************************************
+*  Lookup
+*********************************************************/
+int CEquationLibrary::GetCount(void) {
+   return((m_pHead) ? (int) m_pHead->uNumEntry : 0);
+}
+
+const char *CEquationLibrary::GetName(int iIndex) {
+   if((m_pHead==NULL) || (iIndex<0) || (iIndex>=(int) m_pHead->uNumEntry)) return(NULL);
+   return((const char*) m_pBase + m_pEntry[iIndex].uNameOffs);
+}
+
+int CEquationLibrary::GetNumVar(int iIndex) {
+   if((m_pHead==NULL) || (iIndex<0) || (iIndex>=(int) m_pHead->uNumEntry)) return(0);
+   return(m_pEntry[iIndex].iNumVar);
+}
+
+int CEquationLibrary::FindHash(unsigned int uNameHash) {
+   unsigned int uSlot;                      // probe position
+   unsigned int uEnt;                       // entry index + 1
+   if(m_pHead == NULL) return(-1);
+   for(uSlot=uNameHash & (m_pHead->uNumSlot-1); (uEnt=m_puSlot[uSlot])!=0; uSlot=(uSlot+1) & (m_pHead->uNumSlot-1)) {
+      if((uEnt <= m_pHead->uNumEntry) && (m_pEntry[uEnt-1].uNameHash == uNameHash)) return(uEnt-1);
+   }
+   return(-1);
+}
+
+int CEquationLibrary::Find(const char *pszName) {
+   unsigned int uHash;                      // name hash
+   unsigned int uSlot;                      // probe position
+   unsigned int uEnt;                       // entry index + 1
+   if((m_pHead == NULL) || (pszName == NULL)) return(-1);
+   uHash = EqHashFnv1a(pszName, strlen(pszName));
+   for(uSlot=uHash & (m_pHead->uNumSlot-1); (uEnt=m_puSlot[uSlot])!=0; uSlot=(uSlot+1) & (m_pHead->uNumSlot-1)) {
+      if((uEnt <= m_pHead->uNumEntry) && (m_pEntry[uEnt-1].uNameHash == uHash)
+         && (strcmp((const char*) m_pBase + m_pEntry[uEnt-1].uNameOffs, pszName) == 0)) return(uEnt-1);
+   }
+   return(-1);
+}
+
+/*********************************************************
+*  Attach
+*  Points the equation at the mapped program and source.
+*  Only the target unit state is copied into the equation
+*  itself; no memory is allocated.
+*********************************************************/
+int CEquationLibrary::Attach(int iIndex, CEquation *pEq) {
+   const EQLIBENTRY *pEnt;                  // entry to attach
+   if(pEq == NULL) return(EQERR_PARSE_NOEQUATION);
+   if((m_pHead==NULL) || (iIndex<0) || (iIndex>=(int) m_pHead->uNumEntry))
+      return(pEq->iError=EQERR_PARSE_NOEQUATION);
+   pEnt = m_pEntry + iIndex;
+
+   pEq->FreeSrcEquation();                  // release anything owned
+   pEq->FreeEquation();
+   pEq->pszSrcEquation = (char*)  (m_pBase + pEnt->uSrcOffs);
+   pEq->pvoEquation    = (VALOP*) (m_pBase + pEnt->uOpsOffs);
+   pEq->iEqnLength     = pEnt->iNumOps;
+   pEq->m_tfAttached   = TRUE;
+   pEq->m_uUnitTarget  = pEnt->uUnitTarget;
+   pEq->m_dScleTarget  = pEnt->dScleTarget;
+   pEq->m_dOffsTarget  = pEnt->dOffsTarget;
+   memcpy(pEq->m_szUnit, pEnt->szUnit, sizeof(pEq->m_szUnit));
+   pEq->_ResetProgramState();
+   pEq->iErrorLocation = 0;
+   return(pEq->iError=EQERR_NONE);
+}
@@ -0,0 +1,91 @@
+/*****************************************************************************
+*  CLCEqLib.h                                           CSIVM LaserCanvas
+*  Memory-mapped library file of compiled CEquation programs
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+#ifndef CLCEQLIB_H
+#define CLCEQLIB_H
+#include "CLCEqtn.h"                        // CEquation class
+
+//===File Format==========================================
+// Unlike SaveEquation(..), the library is written in the host's
+// native layout so that the VALOP arrays can be evaluated where
+// they lie in the mapped file. The header records byte order,
+// structure sizes and table signature; a library built on a
+// different platform or version is rejected with EQERR_FILE_VERSION
+// and must be rebuilt from source. Every program is checked on
+// Open(..) as LoadEquation(..) checks a record, so a damaged or
+// crafted file is rejected before anything is evaluated.
+//
+//   EQLIBHEADER
+//   EQLIBENTRY[uNumEntry]         at uEntryOffs
+//   unsigned int[uNumSlot]        at uSlotOffs, hash index (entry+1, 0=empty)
+//   names and source strings
+//   VALOP arrays                  8-byte aligned
+#define EQLIB_MAGIC              "CEQL"     // file identifier
+#define EQLIB_VERSION                 4     // increment when layout changes
+#define EQLIB_BYTEORDER      0x01020304     // written in host order
+#define EQLIB_ALIGN                   8     // alignment of VALOP arrays
+
+typedef struct tagEQLIBHEADER {
+   char         szMagic[4];                 // EQLIB_MAGIC
+   unsigned int uVersion;                   // EQLIB_VERSION
+   unsigned int uByteOrder;                 // EQLIB_BYTEORDER
+   unsigned int uSizeValop;                 // sizeof(VALOP)
+   unsigned int uSizeEntry;                 // sizeof(EQLIBENTRY)
+   unsigned int uSignature;                 // EqTableSignature()
+   unsigned int uNumEntry;                  // number of equations
+   unsigned int uNumSlot;                   // hash index size (power of 2)
+   unsigned int uEntryOffs;                 // offset of entry table
+   unsigned int uSlotOffs;                  // offset of hash index
+   unsigned int uFileLen;                   // total file length
+   unsigned int uChecksum;                  // FNV-1a of all bytes after header
+} EQLIBHEADER;
+
+typedef struct tagEQLIBENTRY {
+   unsigned int uNameHash;                  // EqHashFnv1a of name
+   unsigned int uNameOffs;                  // offset of name string
+   unsigned int uSrcOffs;                   // offset of source string
+   unsigned int uOpsOffs;                   // offset of VALOP array
+   int          iNumOps;                    // number of VALOPs
+   int          iNumVar;                    // variables referenced (highest iRef + 1)
+   UNITBASE     uUnitTarget;                // target unit state as CEquation
+   double       dScleTarget;
+   double       dOffsTarget;
+   char         szUnit[32];                 // target unit string
+} EQLIBENTRY;
+
+/*********************************************************
+* CEquationLibrary declaration
+* A read-only library is shared by all processes that map
+* it; equations attached to it allocate no memory.
+*********************************************************/
+class CEquationLibrary {
+private:
+   const unsigned char *m_pBase;            // mapped file
+   size_t               m_uLen;             // mapped length
+   const EQLIBHEADER   *m_pHead;            // header in mapped file
+   const EQLIBENTRY    *m_pEntry;           // entry table
+   const unsigned int  *m_puSlot;           // hash index
+#ifdef _WIN32
+   HANDLE               m_hFile;            // file handle
+   HANDLE               m_hMap;             // file mapping handle
+#endif//_WIN32
+
+   int  _Validate(BOOL tfVerify);           // check header and entries
+
+public:
+   CEquationLibrary(void);
+   ~CEquationLibrary();
+   static int Write(const char *pszFile, int iNum, CEquation *const pEq[], const char *const pszName[]);
+   int  Open(const char *pszFile, BOOL tfVerify=FALSE); // map library read-only
+   void Close(void);                        // unmap library
+   int  GetCount(void);                     // number of equations
+   const char *GetName(int iIndex);         // name of equation iIndex
+   int  Find(const char *pszName);          // index of named equation, or -1
+   int  FindHash(unsigned int uNameHash);   // index by EqHashFnv1a(name), or -1
+   int  GetNumVar(int iIndex);              // variables dVar[] must hold for equation iIndex
+   int  Attach(int iIndex, CEquation *pEq); // point equation at mapped program
+};
+
+#endif/*CLCEQLIB_H*/
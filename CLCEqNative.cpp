@@ -0,0 +1,603 @@
+/*****************************************************************************
+*  CLCEqNative.cpp                                      CSIVM LaserCanvas
+*  Compilation of CEquation programs to native code
+*  Class declaration in CLCEqtn.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* CompileNative(..) translates a parsed program into a C function, has the
+* system's C compiler build it into a shared object, and loads it. From then
+* on DoEquation(..) and DoEquationBatch(..) call the compiled function in-
+* stead of interpreting the program:
+*
+*  - Each stack level of the program becomes a local variable; constants and
+*    unit factors are written into the code, and the target unit conversion
+*    is applied before returning the answer.
+*  - The argument checks of DoEquation(..) are kept, in the same order, and
+*    return the same error codes and source positions. Units need no checks:
+*    only programs whose units pass _AnalyzeProgram() can be compiled.
+*  - Shared objects are kept in a cache directory, named by a hash of the
+*    generated source and the compiler, so a program is compiled only once
+*    per machine. Concurrent processes build under temporary names and re-
+*    name the result into place.
+*  - Loading a shared object runs its code, so the cache directory and every
+*    object in it must belong to this user and be writable by no one else;
+*    anything else is never loaded. By default the cache is a directory of
+*    its own under TMPDIR (POSIX, created with mode 0700), or TEMP, which is
+*    per-user on Windows.
+*
+* Programs whose units depend on the values (see _AnalyzeProgram), that
+* assign to variables, look up tables with interp1(..) or call functions
+* registered by AddCallback(..) return EQERR_FILE_NOTNATIVE and stay inter-
+* preted, as do DoEquationBatchRows(..), the float calls, and DoEquation-
+* Batch(..) with any EQBATCH_ flags.
+*
+* Usage Example
+* -------------
+*    Eq.ParseEquation("(x + sin(pi * y)) m # mm", "x\0y\0");
+*    if(Eq.CompileNative("/var/cache/ceq") != EQERR_NONE)
+*       ..                                  // still works, interpreted
+*    Eq.DoEquation(dVar, &dAns);            // native if compiled
+*
+* The compiler is invoked as "cc" (POSIX) or "cl" (Windows) unless given; it
+* must be on the path. Results are the same as interpreted to the last bit,
+* provided the compiler uses the same libm and does not contract a*b+c into
+* fused multiply-adds (disabled by the flags below).
+******************************************************************************/
+#include "CLCEqtn.h"                        // header file and definitions
+#include <stdlib.h>                         // system, getenv
+#include <stdarg.h>                         // va_list
+#ifdef _WIN32
+# include <process.h>                       // _getpid
+# define EQNATIVE_EXT         ".dll"        // shared object extension
+# define EQNATIVE_FLAGS       "/nologo /O2 /fp:precise /LD"
+# define EQNATIVE_CC          "cl"
+#else
+# include <dlfcn.h>                         // dlopen
+# include <unistd.h>                        // getpid, geteuid
+# include <sys/stat.h>                      // stat, mkdir, chmod
+# define EQNATIVE_EXT         ".so"
+# define EQNATIVE_FLAGS       "-O2 -ffp-contract=off -shared -fPIC"
+# define EQNATIVE_CC          "cc"
+#endif//_WIN32
+
+#define EQNATIVE_MAXPATH           1024     // longest file name or command
+#define EQNATIVE_SZNUM               32     // formatted constant
+
+//---Growing output buffer----------------------
+typedef struct tagEQNATBUF {
+   char  *psz;                              // text so far (malloc'd)
+   size_t len;                              // length of text
+   size_t max;                              // allocated length
+   BOOL   tfFail;                           // out of memory
+} EQNATBUF;
+
+/*********************************************************
+* _EqNatPrint                                     Private
+* printf(..) to the end of an EQNATBUF, growing it.
+*********************************************************/
+static void _EqNatPrint(EQNATBUF *pBuf, const char *pszFmt, ...) {
+   va_list va;                              // arguments
+   char   *psz;                             // reallocated buffer
+   int     iLen;                            // formatted length
+
+   if(pBuf->tfFail) return;
+   for(;;) {
+      va_start(va, pszFmt);
+      iLen = vsnprintf(pBuf->psz + pBuf->len, pBuf->max - pBuf->len, pszFmt, va);
+      va_end(va);
+      if(iLen < 0) { pBuf->tfFail = TRUE; return; }
+      if(pBuf->len + iLen < pBuf->max) { pBuf->len += iLen; return; }
+      psz = (char*) realloc(pBuf->psz, 2 * pBuf->max + iLen);
+      if(psz == NULL) { pBuf->tfFail = TRUE; return; }
+      pBuf->psz  = psz;
+      pBuf->max  = 2 * pBuf->max + iLen;
+   }
+}
+
+/*********************************************************
+* _EqNatNum                                       Private
+* Formats a constant as a C expression that reads back
+* as exactly the same double.
+*********************************************************/
+static const char *_EqNatNum(double d, char *psz) {
+   if(d != d)                 strcpy(psz, "NAN");
+   else if(d - d != 0.00)     strcpy(psz, (d > 0.00) ? "HUGE_VAL" : "(-HUGE_VAL)");
+   else if(d < 0.00)          sprintf(psz, "(%.17g)", d);
+   else                       sprintf(psz, "%.17g", d);
+   return(psz);
+}
+
+/*********************************************************
+* _NativeSource                                   Private
+* Generates the C source of the program: ceq_row(..) for
+* one row, and the exported functions
+*   int ceq_abi(void)                        EQNATIVE_ABI
+*   int ceq_eval(pdVar, pdAns, piPos)        EQNATIVEFN
+*   int ceq_batch(pdVar, n, pdAns, piErrRow, piPos)
+*                                            EQNATIVEBATCHFN
+* They return an EQERR_ code, and on error the position
+* in the source string in *piPos. Returns the source in a
+* malloc'd string, or NULL with iError set.
+*********************************************************/
+char *CEquation::_NativeSource(void) {
+   EQNATBUF Buf;                            // output
+   VALOP    vo;                             // token being processed
+   char     szA[EQNATIVE_SZNUM];            // formatted constants
+   char     szB[EQNATIVE_SZNUM];
+   const char *psz;                         // source string loop pointer
+   int      iPt;                            // pointer into program
+   int      iTop;                           // stack height
+   int      iArg, iArgc;                    // n-arg ops
+   int      a, b, c;                        // stack levels of arguments
+   int      iPos;                           // source position of token
+
+   if((iEqnLength <= 0) || (pvoEquation == NULL)) { iError = EQERR_EVAL_NOEQUATION; return(NULL); }
+   if(!m_tfAnalyzed) _AnalyzeProgram();
+   if(m_tfBatchScalar) { iError = EQERR_FILE_NOTNATIVE; return(NULL); }
+   for(iPt=0; iPt<iEqnLength; iPt++)        // tables and callbacks live in this process only
+      if(((pvoEquation[iPt].uTyp == VOTYP_OP) && (pvoEquation[iPt].uOp == OP_NARG+OP_NARG_INTERP1))
+         || (pvoEquation[iPt].uTyp == VOTYP_CALL)) { iError = EQERR_FILE_NOTNATIVE; return(NULL); }
+
+   memset(&Buf, 0x00, sizeof(Buf));
+   Buf.max = 4096;
+   Buf.psz = (char*) malloc(Buf.max);
+   if(Buf.psz == NULL) { iError = EQERR_PARSE_ALLOCFAIL; return(NULL); }
+   Buf.psz[0] = '\0';
+
+   //===Preamble==========================================
+   _EqNatPrint(&Buf, "/* %s native program\n   ", CLCEQTN_SZVERSION);
+   for(psz=pszSrcEquation; psz && *psz; psz++) { // source, without closing the comment
+      if((psz[0] == '*') && (psz[1] == '/')) _EqNatPrint(&Buf, "* ");
+      else if((*psz != '\r') && (*psz != '\n')) _EqNatPrint(&Buf, "%c", *psz);
+   }
+   _EqNatPrint(&Buf, " */\n"
+      "#include <math.h>\n"
+      "#ifdef _WIN32\n"
+      "# define CEQ_EXPORT __declspec(dllexport)\n"
+      "#else\n"
+      "# define CEQ_EXPORT\n"
+      "#endif\n"
+      "#define CEQ_SIGN(x) ( ((x)==0.0) ? 0 : (((x)>0) ? +1 : -1) )\n\n");
+   _EqNatPrint(&Buf, "static int ceq_row(const double *const v[], int r, double *pdAns, int *piPos) {\n   double s0");
+   for(iTop=1; iTop<m_iBatchDepth; iTop++) _EqNatPrint(&Buf, ", s%d", iTop);
+   _EqNatPrint(&Buf, ";\n");
+
+   //===Program===========================================
+   // Mirrors DoEquation(..); a, b and c are the stack levels
+   // of the first, second and third arguments.
+   iTop = 0;
+   for(iPt=0; iPt<iEqnLength; iPt++) {
+      vo   = pvoEquation[iPt];
+      iPos = vo.iPos;
+      switch(vo.uTyp) {
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+         _EqNatPrint(&Buf, "   s%d = %s;\n", iTop++, _EqNatNum(vo.dVal, szA));
+         break;
+
+      case VOTYP_REF:
+         _EqNatPrint(&Buf, "   s%d = v[%d][r];\n", iTop++, vo.iRef);
+         break;
+
+      case VOTYP_UNIT:
+         a = iTop-1;
+         _EqNatPrint(&Buf, "   s%d = %s + s%d * %s;\n", a,
+            _EqNatNum(CEquationSIUnit[vo.iUnit][EQSI_NUMUNIT_BASE+1], szA), a,
+            _EqNatNum(CEquationSIUnit[vo.iUnit][EQSI_NUMUNIT_BASE], szB));
+         break;
+
+      case VOTYP_OP:
+         //===Binary Operators============================
+         if(vo.uOp < OP_UNARY) {
+            a = iTop-2;
+            b = iTop-1;
+            switch(vo.uOp) {
+            case OP_PSH: break;             // both stay on stack
+            case OP_POP: _EqNatPrint(&Buf, "   s%d = s%d;\n", a, b); break;
+            case OP_ADD: _EqNatPrint(&Buf, "   s%d = s%d + s%d;\n", a, a, b); break;
+            case OP_SUB: _EqNatPrint(&Buf, "   s%d = s%d - s%d;\n", a, a, b); break;
+            case OP_MUL: _EqNatPrint(&Buf, "   s%d = s%d * s%d;\n", a, a, b); break;
+            case OP_DIV:
+               _EqNatPrint(&Buf, "   if(s%d == 0.0) { *piPos = %d; return(%d); }\n", b, iPos, EQERR_MATH_DIV_ZERO);
+               _EqNatPrint(&Buf, "   s%d = s%d / s%d;\n", a, a, b);
+               break;
+            case OP_POW:
+               _EqNatPrint(&Buf, "   if(s%d < 0.0) s%d = floor(s%d + 0.5);\n", a, b, b);
+               _EqNatPrint(&Buf, "   if((s%d == 0.0) && (s%d < 0.0)) { *piPos = %d; return(%d); }\n", a, b, iPos, EQERR_MATH_DIV_ZERO);
+               _EqNatPrint(&Buf, "   s%d = ((s%d == 0.0) && (s%d == 0.0)) ? 1.0 : pow(s%d, s%d);\n", a, a, b, a, b);
+               break;
+            case OP_OR:  _EqNatPrint(&Buf, "   s%d = ((s%d != 0.0) || (s%d != 0.0)) ? 1.0 : 0.0;\n", a, a, b); break;
+            case OP_AND: _EqNatPrint(&Buf, "   s%d = ((s%d != 0.0) && (s%d != 0.0)) ? 1.0 : 0.0;\n", a, a, b); break;
+            case OP_LTE: _EqNatPrint(&Buf, "   s%d = (s%d <= s%d) ? 1.0 : 0.0;\n", a, a, b); break;
+            case OP_GTE: _EqNatPrint(&Buf, "   s%d = (s%d >= s%d) ? 1.0 : 0.0;\n", a, a, b); break;
+            case OP_LT:  _EqNatPrint(&Buf, "   s%d = (s%d <  s%d) ? 1.0 : 0.0;\n", a, a, b); break;
+            case OP_GT:  _EqNatPrint(&Buf, "   s%d = (s%d >  s%d) ? 1.0 : 0.0;\n", a, a, b); break;
+            case OP_NEQ: _EqNatPrint(&Buf, "   s%d = (s%d != s%d) ? 1.0 : 0.0;\n", a, a, b); break;
+            case OP_EQ:  _EqNatPrint(&Buf, "   s%d = (s%d == s%d) ? 1.0 : 0.0;\n", a, a, b); break;
+            default: Buf.tfFail = TRUE; break; // OP_SET excluded by _AnalyzeProgram
+            }
+            if(vo.uOp != OP_PSH) iTop--;
+
+         //===Unary Operators=============================
+         } else if(vo.uOp < OP_NARG) {
+            a = iTop-1;
+            switch(vo.uOp - OP_UNARY) {
+            case OP_ACOS:
+            case OP_ASIN:
+               _EqNatPrint(&Buf, "   if(fabs(s%d) > 1.0) { *piPos = %d; return(%d); }\n", a, iPos, EQERR_MATH_DOMAIN);
+               break;
+            case OP_LOG10:
+            case OP_LOG:
+               _EqNatPrint(&Buf, "   if(s%d == 0.0) { *piPos = %d; return(%d); }\n", a, iPos, EQERR_MATH_LOG_ZERO);
+               _EqNatPrint(&Buf, "   if(s%d <  0.0) { *piPos = %d; return(%d); }\n", a, iPos, EQERR_MATH_LOG_NEG);
+               break;
+            case OP_SQRT:
+               _EqNatPrint(&Buf, "   if(s%d < 0.0) { *piPos = %d; return(%d); }\n", a, iPos, EQERR_MATH_SQRT_NEG);
+               break;
+            case OP_EXP:
+               _EqNatPrint(&Buf, "   if(s%d > 709.0) { *piPos = %d; return(%d); }\n", a, iPos, EQERR_MATH_OVERFLOW);
+               break;
+            }
+            switch(vo.uOp - OP_UNARY) {
+            case OP_ABS:   _EqNatPrint(&Buf, "   s%d = fabs(s%d);\n",  a, a); break;
+            case OP_SQRT:  _EqNatPrint(&Buf, "   s%d = sqrt(s%d);\n",  a, a); break;
+            case OP_EXP:   _EqNatPrint(&Buf, "   s%d = exp(s%d);\n",   a, a); break;
+            case OP_LOG10: _EqNatPrint(&Buf, "   s%d = log10(s%d);\n", a, a); break;
+            case OP_LOG:   _EqNatPrint(&Buf, "   s%d = log(s%d);\n",   a, a); break;
+            case OP_CEIL:  _EqNatPrint(&Buf, "   s%d = ceil(s%d);\n",  a, a); break;
+            case OP_FLOOR: _EqNatPrint(&Buf, "   s%d = floor(s%d);\n", a, a); break;
+            case OP_ROUND: _EqNatPrint(&Buf, "   s%d = floor(s%d + 0.5);\n", a, a); break;
+            case OP_COS:   _EqNatPrint(&Buf, "   s%d = cos(s%d);\n",   a, a); break;
+            case OP_SIN:   _EqNatPrint(&Buf, "   s%d = sin(s%d);\n",   a, a); break;
+            case OP_TAN:   _EqNatPrint(&Buf, "   s%d = tan(s%d);\n",   a, a); break;
+            case OP_ACOS:  _EqNatPrint(&Buf, "   s%d = acos(s%d);\n",  a, a); break;
+            case OP_ASIN:  _EqNatPrint(&Buf, "   s%d = asin(s%d);\n",  a, a); break;
+            case OP_ATAN:  _EqNatPrint(&Buf, "   s%d = atan(s%d);\n",  a, a); break;
+            case OP_COSH:  _EqNatPrint(&Buf, "   s%d = cosh(s%d);\n",  a, a); break;
+            case OP_SINH:  _EqNatPrint(&Buf, "   s%d = sinh(s%d);\n",  a, a); break;
+            case OP_TANH:  _EqNatPrint(&Buf, "   s%d = tanh(s%d);\n",  a, a); break;
+            case OP_SIND:  _EqNatPrint(&Buf, "   s%d = sin(s%d * %s);\n", a, a, _EqNatNum(M_PI_180, szA)); break;
+            case OP_COSD:  _EqNatPrint(&Buf, "   s%d = cos(s%d * %s);\n", a, a, _EqNatNum(M_PI_180, szA)); break;
+            case OP_TAND:  _EqNatPrint(&Buf, "   s%d = tan(s%d * %s);\n", a, a, _EqNatNum(M_PI_180, szA)); break;
+            case OP_ASIND: _EqNatPrint(&Buf, "   s%d = %s * asin(s%d);\n", a, _EqNatNum(M_180_PI, szA), a); break;
+            case OP_ACOSD: _EqNatPrint(&Buf, "   s%d = %s * acos(s%d);\n", a, _EqNatNum(M_180_PI, szA), a); break;
+            case OP_ATAND: _EqNatPrint(&Buf, "   s%d = %s * atan(s%d);\n", a, _EqNatNum(M_180_PI, szA), a); break;
+            case OP_NOT:   _EqNatPrint(&Buf, "   s%d = (s%d == 0.0) ? 1.0 : 0.0;\n", a, a); break;
+            case OP_SIGN:  _EqNatPrint(&Buf, "   s%d = (s%d == 0.0) ? 0.0 : (s%d < 0.0) ? -1.0 : 1.0;\n", a, a, a); break;
+            default: Buf.tfFail = TRUE; break;
+            }
+
+         //===N-Argument Operators========================
+         } else {
+            iArgc = CEquationNArgOpArgc[vo.uOp - OP_NARG];
+            if(iArgc < 0) iArgc = pvoEquation[++iPt].iArgc; // VOTYP_NARGC checked by _AnalyzeProgram
+            c = iTop-3;
+            a = iTop-2;
+            b = iTop-1;
+            switch(vo.uOp - OP_NARG) {
+            case OP_NARG_MOD:               // answer is x if y==0
+               _EqNatPrint(&Buf, "   if(s%d != 0.0) s%d = s%d - s%d * floor(s%d / s%d);\n", b, a, a, b, a, b);
+               break;
+            case OP_NARG_REM:
+               _EqNatPrint(&Buf, "   if(s%d == 0.0) { *piPos = %d; return(%d); }\n", b, iPos, EQERR_MATH_DIV_ZERO);
+               _EqNatPrint(&Buf, "   s%d = s%d - s%d * floor(s%d / s%d) - ((CEQ_SIGN(s%d) != CEQ_SIGN(s%d)) ? s%d : 0.0);\n",
+                  a, a, b, a, b, a, b, b);
+               break;
+            case OP_NARG_ATAN2:
+            case OP_NARG_ATAN2D:
+               _EqNatPrint(&Buf, "   s%d = (s%d == 0.0) ? ((s%d == 0.0) ? 0.0 : ((s%d > 0.0) ? %s : -%s)) : atan2(s%d, s%d);\n",
+                  a, b, a, a, _EqNatNum(M_PI/2.00, szA), szA, a, b);
+               if((vo.uOp - OP_NARG) == OP_NARG_ATAN2D) _EqNatPrint(&Buf, "   s%d *= %s;\n", a, _EqNatNum(M_180_PI, szA));
+               break;
+            case OP_NARG_MAX:               // compared from the last argument down
+            case OP_NARG_MIN:
+               for(iArg=1; iArg<iArgc; iArg++)
+                  _EqNatPrint(&Buf, "   if(s%d %c s%d) s%d = s%d;\n", b-iArg,
+                     ((vo.uOp - OP_NARG) == OP_NARG_MAX) ? '>' : '<', b, b, b-iArg);
+               if(iArgc > 1) _EqNatPrint(&Buf, "   s%d = s%d;\n", iTop-iArgc, b);
+               break;
+            case OP_NARG_IF:
+               _EqNatPrint(&Buf, "   s%d = (s%d == 0.0) ? s%d : s%d;\n", c, c, b, a);
+               break;
+            case OP_NARG_SUM:               // one-element arrays
+            case OP_NARG_MEAN:
+               break;
+            case OP_NARG_RMS:
+            case OP_NARG_NORM:
+               _EqNatPrint(&Buf, "   s%d = fabs(s%d);\n", b, b);
+               break;
+            case OP_NARG_DOT:
+               _EqNatPrint(&Buf, "   s%d = s%d * s%d;\n", a, a, b);
+               break;
+            default: Buf.tfFail = TRUE; break;
+            }
+            iTop -= iArgc - 1;
+         }
+         break;
+
+      default:
+         Buf.tfFail = TRUE;
+         break;
+      }
+   }
+
+   //===Answer, with target unit conversion===============
+   if(m_dScleTarget != 0.00)
+      _EqNatPrint(&Buf, "   *pdAns = (s0 - %s) / %s;\n", _EqNatNum(m_dOffsTarget, szA), _EqNatNum(m_dScleTarget, szB));
+   else
+      _EqNatPrint(&Buf, "   *pdAns = s0;\n");
+   _EqNatPrint(&Buf, "   return(0);\n}\n\n");
+
+   //===Exported Functions================================
+   _EqNatPrint(&Buf,
+      "CEQ_EXPORT int ceq_abi(void) { return(%d); }\n\n"
+      "CEQ_EXPORT int ceq_eval(const double *pdVar, double *pdAns, int *piPos) {\n"
+      "   const double *v[%d];\n"
+      "   int k;\n"
+      "   for(k=0; k<%d; k++) v[k] = pdVar + k;\n"
+      "   return(ceq_row(v, 0, pdAns, piPos));\n"
+      "}\n\n"
+      "CEQ_EXPORT int ceq_batch(const double *const pdVar[], int iNumRows, double pdAns[], int *piErrRow, int *piPos) {\n"
+      "   int r, iErr = 0;\n"
+      "   for(r=0; r<iNumRows; r++)\n"
+      "      if((iErr = ceq_row(pdVar, r, pdAns + r, piPos)) != 0) break;\n"
+      "   *piErrRow = r;\n"
+      "   return(iErr);\n"
+      "}\n",
+      EQNATIVE_ABI, MAX(m_iBatchNumVar, 1), m_iBatchNumVar);
+
+   if(Buf.tfFail) {
+      free(Buf.psz);
+      iError = EQERR_PARSE_ALLOCFAIL;
+      return(NULL);
+   }
+   iError = EQERR_NONE;
+   return(Buf.psz);
+}
+
+/*********************************************************
+* WriteNativeSource
+* Copies the C source that CompileNative(..) would build
+* into pszBuf, with *pLen its size. As SaveEquation(..),
+* a NULL pszBuf returns the size needed in *pLen, which
+* includes the terminating NULL.
+*********************************************************/
+int CEquation::WriteNativeSource(char *pszBuf, size_t *pLen) {
+   char  *pszSrc;                           // generated source
+   size_t len;                              // length needed
+
+   if(pLen == NULL) return(iError=EQERR_FILE_BUFFERSIZE);
+   if((pszSrc = _NativeSource()) == NULL) return(iError);
+   len = strlen(pszSrc) + 1;
+   if((pszBuf == NULL) || (*pLen < len)) {  // size only, or too small
+      iError = (pszBuf == NULL) ? EQERR_NONE : EQERR_FILE_BUFFERSIZE;
+      *pLen  = len;
+      free(pszSrc);
+      return(iError);
+   }
+   *pLen = len;
+   memcpy(pszBuf, pszSrc, len);
+   free(pszSrc);
+   return(iError=EQERR_NONE);
+}
+
+//---Private path-------------------------------
+// TRUE if pszPath is a directory (tfDir) or a regular file
+// that is not a link, owned by this user and writable by
+// no one else. Whoever could replace a shared object could
+// run code in this process, so no other is loaded.
+static BOOL _EqNatPrivate(const char *pszPath, BOOL tfDir) {
+#ifdef _WIN32
+   return(pszPath != NULL);                 // TEMP is per-user
+#else
+   struct stat st;                          // owner and mode
+   if((tfDir ? stat(pszPath, &st) : lstat(pszPath, &st)) != 0) return(FALSE);
+   if(tfDir ? !S_ISDIR(st.st_mode) : !S_ISREG(st.st_mode)) return(FALSE);
+   return((st.st_uid == geteuid()) && ((st.st_mode & (S_IWGRP | S_IWOTH)) == 0));
+#endif//_WIN32
+}
+
+/*********************************************************
+* CompileNative
+* Generates the program's C source, compiles it into a
+* shared object in pszCacheDir, and loads it. A shared
+* object built earlier for the same source and compiler
+* is loaded without compiling. The default pszCacheDir is
+* TMPDIR/ceq-<uid> (or /tmp/ceq-<uid>), created if need
+* be, on POSIX and TEMP on Windows. pszCompiler is the
+* compiler command, "cc" or "cl" if NULL. Returns
+*  EQERR_FILE_NOTNATIVE  program cannot be compiled
+*  EQERR_FILE_COMPILE    compiler failed or object could
+*                        not be loaded
+*  EQERR_FILE_READWRITE  cache directory not writable,
+*                        or not private to this user
+* On error, the equation remains interpreted.
+*********************************************************/
+int CEquation::CompileNative(const char *pszCacheDir, const char *pszCompiler) {
+   char  *pszSrc;                           // generated source
+   char   szLib[EQNATIVE_MAXPATH];          // cached shared object
+   char   szTmp[EQNATIVE_MAXPATH];          // shared object while building
+   char   szC[EQNATIVE_MAXPATH];            // source file
+   char   szCmd[4*EQNATIVE_MAXPATH];        // compiler command line
+#ifndef _WIN32
+   char   szDir[EQNATIVE_MAXPATH];          // default cache directory
+   const char *pszTmpDir;                   // TMPDIR
+#endif//_WIN32
+   unsigned int uKey1, uKey2;               // 64-bit cache key
+   int    iPid;                             // process id, for temporary names
+   FILE  *fp;                               // source file
+   BOOL   tfOk;                             // source written
+
+   FreeNative();
+   if((pszSrc = _NativeSource()) == NULL) return(iError);
+
+   //---Names-----------------------------------
+   if(pszCompiler == NULL) pszCompiler = EQNATIVE_CC;
+   if(pszCacheDir == NULL) {
+#ifdef _WIN32
+      pszCacheDir = getenv("TEMP");
+#else
+      pszTmpDir = getenv("TMPDIR");
+      if((pszTmpDir == NULL) || (*pszTmpDir == '\0') || (strlen(pszTmpDir) + 64 > EQNATIVE_MAXPATH)) pszTmpDir = "/tmp";
+      sprintf(szDir, "%s/ceq-%u", pszTmpDir, (unsigned int) geteuid());
+      mkdir(szDir, 0700);                   // fails harmlessly if it exists
+      pszCacheDir = szDir;
+#endif//_WIN32
+   }
+   if((pszCacheDir == NULL) || (strlen(pszCacheDir) + 64 > EQNATIVE_MAXPATH) || (strlen(pszCompiler) + 64 > EQNATIVE_MAXPATH)
+      || strchr(pszCacheDir, '"') || strchr(pszCompiler, '"') || !_EqNatPrivate(pszCacheDir, TRUE)) {
+      free(pszSrc);
+      return(iError=EQERR_FILE_READWRITE);
+   }
+   uKey1 = EqHashFnv1a(pszSrc, strlen(pszSrc));
+   uKey1 = EqHashFnv1a(pszCompiler, strlen(pszCompiler), uKey1);
+   uKey1 = EqHashFnv1a(EQNATIVE_FLAGS, strlen(EQNATIVE_FLAGS), uKey1);
+   uKey2 = EqHashFnv1a(pszSrc, strlen(pszSrc), 0x811C9DC5u ^ 0x5BD1E995u);
+   uKey2 = EqHashFnv1a(pszCompiler, strlen(pszCompiler), uKey2);
+   uKey2 = EqHashFnv1a(EQNATIVE_FLAGS, strlen(EQNATIVE_FLAGS), uKey2);
+#ifdef _WIN32
+   iPid = (int) _getpid();
+#else
+   iPid = (int) getpid();
+#endif//_WIN32
+   sprintf(szLib, "%s/ceq_%08x%08x" EQNATIVE_EXT, pszCacheDir, uKey1, uKey2);
+
+   //---Cached----------------------------------
+   if(_LoadNative(szLib) == EQERR_NONE) { free(pszSrc); return(iError=EQERR_NONE); }
+
+   //---Compile---------------------------------
+   sprintf(szC,   "%s/ceq_%08x%08x_%d.c", pszCacheDir, uKey1, uKey2, iPid);
+   sprintf(szTmp, "%s/ceq_%08x%08x_%d" EQNATIVE_EXT, pszCacheDir, uKey1, uKey2, iPid);
+   fp = fopen(szC, "w");
+   if(fp == NULL) { free(pszSrc); return(iError=EQERR_FILE_READWRITE); }
+   tfOk = (fputs(pszSrc, fp) >= 0);
+   if(fclose(fp) != 0) tfOk = FALSE;
+   free(pszSrc);
+   if(!tfOk) { remove(szC); return(iError=EQERR_FILE_READWRITE); }
+
+#ifdef _WIN32
+   sprintf(szCmd, "%s " EQNATIVE_FLAGS " \"%s\" /Fe\"%s\" /Fo\"%s\\\\\" >NUL 2>&1", pszCompiler, szC, szTmp, pszCacheDir);
+#else
+   sprintf(szCmd, "%s " EQNATIVE_FLAGS " -o \"%s\" \"%s\" -lm >/dev/null 2>&1", pszCompiler, szTmp, szC);
+#endif//_WIN32
+   tfOk = (system(szCmd) == 0);
+   remove(szC);
+#ifdef _WIN32
+   sprintf(szC, "%s/ceq_%08x%08x_%d.obj", pszCacheDir, uKey1, uKey2, iPid);
+   remove(szC);
+   sprintf(szC, "%s/ceq_%08x%08x_%d.lib", pszCacheDir, uKey1, uKey2, iPid);
+   remove(szC);
+   sprintf(szC, "%s/ceq_%08x%08x_%d.exp", pszCacheDir, uKey1, uKey2, iPid);
+   remove(szC);
+#endif//_WIN32
+   if(!tfOk) { remove(szTmp); return(iError=EQERR_FILE_COMPILE); }
+#ifndef _WIN32
+   chmod(szTmp, 0755);                      // whatever the umask, no one else may write
+#endif//_WIN32
+
+   //---Move into place, and load---------------
+   // Another process may have built the same object mean-
+   // while; either copy will do.
+   if(rename(szTmp, szLib) != 0) remove(szTmp);
+   return(iError=_LoadNative(szLib));
+}
+
+/*********************************************************
+* _LoadNative                                     Private
+* Loads a shared object built by CompileNative(..) and
+* looks up its functions. Returns EQERR_FILE_COMPILE if
+* it is missing, not private to this user, cannot be
+* loaded or was built for another ABI.
+*********************************************************/
+int CEquation::_LoadNative(const char *pszLib) {
+   int (*pfnAbi)(void);                     // ceq_abi
+
+   FreeNative();
+   if(!_EqNatPrivate(pszLib, FALSE)) return(EQERR_FILE_COMPILE);
+#ifdef _WIN32
+   HMODULE hLib = LoadLibraryA(pszLib);
+   if(hLib == NULL) return(EQERR_FILE_COMPILE);
+   pfnAbi           = (int (*)(void)) GetProcAddress(hLib, "ceq_abi");
+   m_pfnNative      = (EQNATIVEFN)      GetProcAddress(hLib, "ceq_eval");
+   m_pfnNativeBatch = (EQNATIVEBATCHFN) GetProcAddress(hLib, "ceq_batch");
+#else
+   void *hLib = dlopen(pszLib, RTLD_NOW | RTLD_LOCAL);
+   if(hLib == NULL) return(EQERR_FILE_COMPILE);
+   pfnAbi           = (int (*)(void)) dlsym(hLib, "ceq_abi");
+   m_pfnNative      = (EQNATIVEFN)      dlsym(hLib, "ceq_eval");
+   m_pfnNativeBatch = (EQNATIVEBATCHFN) dlsym(hLib, "ceq_batch");
+#endif//_WIN32
+   m_hNative = (void*) hLib;
+   if((pfnAbi == NULL) || (pfnAbi() != EQNATIVE_ABI) || (m_pfnNative == NULL) || (m_pfnNativeBatch == NULL)) {
+      FreeNative();
+      return(EQERR_FILE_COMPILE);
+   }
+   return(EQERR_NONE);
+}
+
+/*********************************************************
+* FreeNative
+* Unloads the native code; the equation is interpreted
+* again. Called whenever the program changes.
+*********************************************************/
+void CEquation::FreeNative(void) {
+   if(m_hNative) {
+#ifdef _WIN32
+      FreeLibrary((HMODULE) m_hNative);
+#else
+      dlclose(m_hNative);
+#endif//_WIN32
+   }
+   m_hNative        = NULL;
+   m_pfnNative      = NULL;
+   m_pfnNativeBatch = NULL;
+}
+
+/*********************************************************
+* _DoEquationNative                               Private
+* DoEquation(..) through the compiled function. The answer
+* dimension is m_uUnitStatic, as for batch evaluation.
+*********************************************************/
+int CEquation::_DoEquationNative(double dVar[], double *pdAns, BOOL tfAllowDerived) {
+   double dVal;                             // answer
+   int    iPos = 0;                         // error position
+
+   if((iError = m_pfnNative(dVar, &dVal, &iPos)) != EQERR_NONE) {
+      iErrorLocation = iPos;
+      return(iError);
+   }
+   if((m_dScleTarget == 0.00)
+      && ((m_uUnitStatic.u != m_uUnitAns.u) || (tfAllowDerived != m_tfUnitAnsDerived))) {
+      m_uUnitAns = m_uUnitStatic;
+      m_tfUnitAnsDerived = tfAllowDerived;
+      m_tfUnitStale = TRUE;
+   }
+   if(pdAns) *pdAns = dVal;
+   return(iError=EQERR_NONE);
+}
+
+/*********************************************************
+* _DoEquationNativeBatch                          Private
+* DoEquationBatch(..) through the compiled function; stops
+* at the first failed row in the same way.
+*********************************************************/
+int CEquation::_DoEquationNativeBatch(const double *const pdVar[], int iNumRows, double pdAns[], int *piErrRow) {
+   int iRow = 0;                            // first failed row
+   int iPos = 0;                            // error position
+
+   if(piErrRow) *piErrRow = 0;
+   if((pdVar == NULL) && (m_iBatchNumVar > 0)) return(iError=EQERR_EVAL_CONTAINSVAR);
+   if(iNumRows <= 0) return(iError=EQERR_NONE);
+   iError = m_pfnNativeBatch(pdVar, iNumRows, pdAns, &iRow, &iPos);
+   if(piErrRow) *piErrRow = iRow;
+   iErrorLocation = (iError != EQERR_NONE) ? iPos : 0;
+   if((m_dScleTarget == 0.00)
+      && ((m_uUnitStatic.u != m_uUnitAns.u) || m_tfUnitAnsDerived)) { // same as DoEquationBatch(..)
+      m_uUnitAns = m_uUnitStatic;
+      m_tfUnitAnsDerived = FALSE;
+      m_tfUnitStale = TRUE;
+   }
+   return(iError);
+}
@@ -0,0 +1,224 @@
+/*****************************************************************************
+*  CLCEqPool.cpp                                        CSIVM LaserCanvas
+*  Contiguous in-memory store of many compiled CEquation programs
+*  Class declaration in CLCEqPool.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* A stand-alone CEquation holds its own object, source string, program and
+* batch constant table, each a separate heap block. Applications that keep
+* hundreds of thousands of equations alive pay for all four per equation,
+* scattered over the heap. A CEquationPool keeps only the program, the source
+* and (if any) the target unit of each equation, one after another in large
+* blocks, and hands out an integer handle. The program is evaluated in place:
+* DoEquation(..) attaches an internal CEquation to it, much as a
+* CEquationLibrary attaches to its mapped file, or Attach(..) does the same
+* for the caller's own CEquation. Equations added one after the other and
+* evaluated in handle order are read sequentially from memory.
+*
+* Usage Example
+* -------------
+*    CEquationPool Pool;
+*    int h = Pool.Parse("x + sin(pi * y)", "x\0y\0");
+*    if(h >= 0) Pool.DoEquation(h, dVar, &dAns);
+*    ..
+*    Pool.Clear();                          // all equations at once
+*
+* Handles are issued in order from 0 and not reused until Clear(), so the
+* handle of a removed equation is detected rather than meeting another one.
+* Clear() starts again from 0: handles kept from before it may name the new
+* equations, and must be dropped with it. Records stay where they are until
+* Clear(): equations attached to the pool remain valid after Remove(..) of
+* another handle, and the pool must outlive them.
+******************************************************************************/
+#include "CLCEqPool.h"                      // header file and definitions
+#include <stdlib.h>                         // realloc
+
+#define EQPOOL_ROUNDUP(n)  (((n) + sizeof(double)-1) & ~(sizeof(double)-1))
+
+/*********************************************************
+*  Constructor and destructor
+*********************************************************/
+CEquationPool::CEquationPool(void) {
+   m_ppRec       = NULL;                    // no handles yet
+   m_iNumHandle  = 0;
+   m_iMaxHandle  = 0;
+   m_iNumRemoved = 0;
+   m_iEvalHandle = -1;
+}
+
+CEquationPool::~CEquationPool() {
+   Clear();
+}
+
+/*********************************************************
+*  Add
+*  Copies the compiled program of a parsed equation into
+*  the pool. The equation itself is not changed.
+*  Returns the handle, or -1 if the equation holds no
+*  program or memory runs out.
+*********************************************************/
+int CEquationPool::Add(CEquation *pEq) {
+   EQPOOLREC    *pRec;                      // new record
+   EQPOOLTARGET *pTgt;                      // target unit in record
+   EQPOOLREC   **ppRec;                     // grown handle table
+   size_t        uOps;                      // bytes of program
+   size_t        uSrc;                      // bytes of source
+   int           iMax;                      // new handle table size
+
+   if((pEq == NULL) || (pEq->iEqnLength <= 0) || (pEq->pszSrcEquation == NULL)) return(-1);
+
+   //---Handle table----------------------------
+   if(m_iNumHandle >= m_iMaxHandle) {
+      iMax  = MAX(EQPOOL_MINHANDLES, 2*m_iMaxHandle);
+      ppRec = (EQPOOLREC**) realloc(m_ppRec, iMax * sizeof(EQPOOLREC*));
+      if(ppRec == NULL) return(-1);
+      m_ppRec      = ppRec;
+      m_iMaxHandle = iMax;
+   }
+
+   //---Record----------------------------------
+   uOps = pEq->iEqnLength * sizeof(VALOP);
+   uSrc = strlen(pEq->pszSrcEquation) + 1;
+   pRec = (EQPOOLREC*) m_Arena.Alloc(sizeof(EQPOOLREC) + uOps
+      + ((pEq->m_dScleTarget != 0.00) ? sizeof(EQPOOLTARGET) : 0) + uSrc);
+   if(pRec == NULL) return(-1);
+   pRec->iNumOps = pEq->iEqnLength;
+   pRec->iFlags  = (pEq->m_dScleTarget != 0.00) ? EQPOOL_TARGET : 0;
+   memcpy(pRec+1, pEq->pvoEquation, uOps);
+   pTgt = (EQPOOLTARGET*) ((char*) (pRec+1) + uOps);
+   if(pRec->iFlags & EQPOOL_TARGET) {
+      pTgt->uUnitTarget = pEq->m_uUnitTarget;
+      pTgt->dScleTarget = pEq->m_dScleTarget;
+      pTgt->dOffsTarget = pEq->m_dOffsTarget;
+      memcpy(pTgt->szUnit, pEq->m_szUnit, sizeof(pTgt->szUnit));
+      pTgt++;
+   }
+   memcpy(pTgt, pEq->pszSrcEquation, uSrc);
+
+   m_ppRec[m_iNumHandle] = pRec;
+   return(m_iNumHandle++);
+}
+
+/*********************************************************
+*  Parse
+*  Parses an equation and adds it to the pool, without a
+*  CEquation of the caller's own.
+*  piErr    returns the parse error, if not NULL
+*  Returns the handle, or -1 on any error.
+*********************************************************/
+int CEquationPool::Parse(const char *szEqn, const char *pszVars, int *piErr) {
+   int iErr;                                // parse error
+   int h;                                   // new handle
+
+   iErr = m_EqParse.ParseEquation(szEqn, pszVars, &m_Ctx);
+   h    = (iErr == EQERR_NONE) ? Add(&m_EqParse) : -1;
+   if((iErr == EQERR_NONE) && (h < 0)) iErr = EQERR_PARSE_ALLOCFAIL;
+   if(piErr) *piErr = iErr;
+   return(h);
+}
+
+/*********************************************************
+*  Remove / Clear
+*  Remove(..) invalidates a handle; its record is freed
+*  with all others by Clear(), which also gives back the
+*  memory kept for parsing and issues handles from 0
+*  again.
+*********************************************************/
+int CEquationPool::Remove(int h) {
+   if(!IsValid(h)) return(EQERR_PARSE_NOEQUATION);
+   m_ppRec[h] = NULL;
+   m_iNumRemoved++;
+   if(m_iEvalHandle == h) m_iEvalHandle = -1;
+   return(EQERR_NONE);
+}
+
+void CEquationPool::Clear(void) {
+   m_EqEval.FreeSrcEquation();              // detach before the records go
+   m_iEvalHandle = -1;
+   m_Arena.Free();
+   if(m_ppRec) free(m_ppRec);
+   m_ppRec       = NULL;
+   m_iNumHandle  = 0;
+   m_iMaxHandle  = 0;
+   m_iNumRemoved = 0;
+   m_Ctx.Trim();
+}
+
+/*********************************************************
+*  Attach
+*  Points the equation at the pooled program and source,
+*  as CEquationLibrary::Attach(..). No memory is allocated.
+*********************************************************/
+int CEquationPool::Attach(int h, CEquation *pEq) {
+   const EQPOOLREC    *pRec;                // record to attach
+   const EQPOOLTARGET *pTgt;                // target unit in record
+   if(pEq == NULL) return(EQERR_PARSE_NOEQUATION);
+   if(!IsValid(h)) return(pEq->iError=EQERR_PARSE_NOEQUATION);
+   pRec = m_ppRec[h];
+   pTgt = (const EQPOOLTARGET*) ((const char*) (pRec+1) + pRec->iNumOps * sizeof(VALOP));
+
+   pEq->FreeSrcEquation();                  // release anything owned
+   pEq->FreeEquation();
+   pEq->pvoEquation  = (VALOP*) (pRec+1);
+   pEq->iEqnLength   = pRec->iNumOps;
+   pEq->m_tfAttached = TRUE;
+   if(pRec->iFlags & EQPOOL_TARGET) {
+      pEq->m_uUnitTarget = pTgt->uUnitTarget;
+      pEq->m_dScleTarget = pTgt->dScleTarget;
+      pEq->m_dOffsTarget = pTgt->dOffsTarget;
+      memcpy(pEq->m_szUnit, pTgt->szUnit, sizeof(pEq->m_szUnit));
+      pTgt++;
+   } else {
+      pEq->m_uUnitTarget.u = 0;
+      pEq->m_dScleTarget = 0.00;
+      pEq->m_dOffsTarget = 0.00;
+      pEq->m_szUnit[0]   = '\0';
+   }
+   pEq->pszSrcEquation = (char*) pTgt;
+   pEq->_ResetProgramState();
+   pEq->iErrorLocation = 0;
+   return(pEq->iError=EQERR_NONE);
+}
+
+/*********************************************************
+*  DoEquation
+*  Evaluates a pooled program as CEquation::DoEquation(..).
+*  Consecutive calls with the same handle attach once.
+*********************************************************/
+int CEquationPool::DoEquation(int h, double dVar[], double *pdAns) {
+   int iErr;                                // attach error
+   if(h != m_iEvalHandle) {
+      m_iEvalHandle = -1;
+      if((iErr = Attach(h, &m_EqEval)) != EQERR_NONE) return(iErr);
+      m_iEvalHandle = h;
+   }
+   return(m_EqEval.DoEquation(dVar, pdAns));
+}
+
+/*********************************************************
+*  GetStats
+*  Memory held by the pool, per live equation.
+*********************************************************/
+void CEquationPool::GetStats(EQPOOLSTATS *pStats) {
+   const EQPOOLREC *pRec;                   // record
+   size_t uBytes;                           // record bytes
+   int    h;                                // handle loop
+
+   if(pStats == NULL) return;
+   memset(pStats, 0x00, sizeof(EQPOOLSTATS));
+   for(h=0; h<m_iNumHandle; h++) {
+      if((pRec = m_ppRec[h]) == NULL) continue;
+      uBytes = sizeof(EQPOOLREC) + pRec->iNumOps * sizeof(VALOP);
+      if(pRec->iFlags & EQPOOL_TARGET) uBytes += sizeof(EQPOOLTARGET);
+      pStats->uBytesRecords += EQPOOL_ROUNDUP(uBytes + strlen((const char*) pRec + uBytes) + 1);
+   }
+   pStats->iNumEquations = GetCount();
+   pStats->iNumRemoved   = m_iNumRemoved;
+   pStats->uBytesHeld    = sizeof(CEquationPool) + m_Arena.Size() + m_iMaxHandle * sizeof(EQPOOLREC*)
+                         + m_EqParse.GetMemoryUsage() + m_EqEval.GetMemoryUsage() + m_Ctx.Size()
+                         - 2*sizeof(CEquation);       // objects counted in sizeof(CEquationPool)
+   if(pStats->iNumEquations > 0)
+      pStats->dBytesPerEquation = (double) pStats->uBytesHeld / (double) pStats->iNumEquations;
+}
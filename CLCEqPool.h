@@ -0,0 +1,80 @@
+/*****************************************************************************
+*  CLCEqPool.h                                          CSIVM LaserCanvas
+*  Contiguous in-memory store of many compiled CEquation programs
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+#ifndef CLCEQPOOL_H
+#define CLCEQPOOL_H
+#include "CLCEqtn.h"                        // CEquation class
+
+//===Records==============================================
+// Each program is one record in the pool's arena, in the
+// order added:
+//
+//   EQPOOLREC
+//   VALOP[iNumOps]
+//   EQPOOLTARGET                  only with EQPOOL_TARGET
+//   source string
+#define EQPOOL_TARGET            0x0001     // record has a target unit
+#define EQPOOL_MINHANDLES          1024     // initial size of handle table
+
+typedef struct tagEQPOOLREC {
+   int iNumOps;                             // VALOPs following the record
+   int iFlags;                              // EQPOOL_ flags
+} EQPOOLREC;
+
+typedef struct tagEQPOOLTARGET {            // target unit state as CEquation
+   UNITBASE uUnitTarget;
+   double   dScleTarget;
+   double   dOffsTarget;
+   char     szUnit[32];
+} EQPOOLTARGET;
+
+//---Statistics---------------------------------
+typedef struct tagEQPOOLSTATS {
+   int    iNumEquations;                    // live equations
+   int    iNumRemoved;                      // handles removed since Clear()
+   size_t uBytesRecords;                    // programs, sources and target units
+   size_t uBytesHeld;                       // all memory held by the pool
+   double dBytesPerEquation;                // uBytesHeld per live equation
+} EQPOOLSTATS;
+
+/*********************************************************
+* CEquationPool declaration
+* Many compiled programs in a few large blocks, addressed
+* by handles that stay valid until Remove(..) or Clear().
+* Removed records keep their space until Clear(), after
+* which handles are issued from 0 again. Not for
+* use by several threads at once, except Attach(..)ed
+* equations, which only read the pool.
+*********************************************************/
+class CEquationPool {
+private:
+   CEqArena        m_Arena;                 // records
+   EQPOOLREC     **m_ppRec;                 // record by handle, NULL if removed
+   int             m_iNumHandle;            // handles issued
+   int             m_iMaxHandle;            // size of m_ppRec
+   int             m_iNumRemoved;           // handles removed
+   CEquation       m_EqParse;               // scratch for Parse(..)
+   CEqParseContext m_Ctx;                   // parse scratch for Parse(..)
+   CEquation       m_EqEval;                // attached for DoEquation(..)
+   int             m_iEvalHandle;           // handle attached to m_EqEval, or -1
+
+   CEquationPool(const CEquationPool&);     // not copyable
+   CEquationPool& operator=(const CEquationPool&);
+
+public:
+   CEquationPool(void);
+   ~CEquationPool();
+   int  Add(CEquation *pEq);                // copy parsed program in, returns handle or -1
+   int  Parse(const char *szEqn, const char *pszVars, int *piErr=NULL); // parse and add
+   int  Remove(int h);                      // forget handle h
+   void Clear(void);                        // free all records at once
+   int  Attach(int h, CEquation *pEq);      // point equation at pooled program
+   int  DoEquation(int h, double dVar[], double *pdAns); // evaluate pooled program
+   BOOL IsValid(int h) { return((h >= 0) && (h < m_iNumHandle) && (m_ppRec[h] != NULL)); };
+   int  GetCount(void) { return(m_iNumHandle - m_iNumRemoved); }; // live equations
+   void GetStats(EQPOOLSTATS *pStats);      // memory use
+};
+
+#endif/*CLCEQPOOL_H*/
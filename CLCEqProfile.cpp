@@ -0,0 +1,430 @@
+/*****************************************************************************
+*  CLCEqProfile.cpp                                     CSIVM LaserCanvas
+*  Per-token evaluation profile of CEquation programs
+*  Class declaration in CLCEqtn.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* When the library is compiled with EQPROFILE defined, EnableProfile() makes
+* DoEquation(..) and the batch calls count, for every token of the program,
+* how often it runs and how many ticks it takes. Ticks are processor cycles
+* (rdtsc) on x86 and nanoseconds elsewhere. Reading the timer twice costs a
+* few ticks itself; this is measured once and subtracted from every timed
+* interval (one token of one row, or of one chunk of rows in a batch).
+*
+* GetProfile(..) sums the counters either by operator (all "sin" together)
+* or by position in the source string. By position, each entry also carries
+* the total including the tokens that compute its arguments, so "sin(pi*y)"
+* is charged for "pi*y" as well, and the costliest call of the expression is
+* the entry with the largest uTicksTotal. DumpProfile(..) writes both tables
+* as text or as one JSON object.
+*
+* Native code (CompileNative) is bypassed while profiling is enabled. Built
+* without EQPROFILE, the counting is compiled out of the evaluation loops and
+* EnableProfile(..) returns FALSE. Counters are per object and are dropped
+* when a new program is parsed, loaded or copied in.
+*
+* Usage Example
+* -------------
+*    Eq.ParseEquation("x + sin(pi * y) * sqrt(x * y)", "x\0y\0");
+*    Eq.EnableProfile();
+*    for(..) Eq.DoEquation(dVar, &dAns);
+*    Eq.DumpProfile(stderr);                // or EQPROFILE_JSON
+******************************************************************************/
+#include "CLCEqtn.h"                        // header file and definitions
+#include <stdlib.h>                         // malloc, qsort
+#ifndef _WIN32
+# include <time.h>                          // clock_gettime
+#endif//_WIN32
+
+#define EQPROFILE_SRCWIDTH           40     // source characters shown in text table
+#define EQPROFILE_CALIBRATE          64     // timer reads to find its overhead
+
+/*********************************************************
+* EqProfileNs
+* Monotonic clock in nanoseconds, for machines without a
+* cycle counter.
+*********************************************************/
+#ifdef EQPROFILE
+unsigned long long EqProfileNs(void) {
+#ifdef _WIN32
+   LARGE_INTEGER liNow, liFreq;             // performance counter
+   QueryPerformanceCounter(&liNow);
+   QueryPerformanceFrequency(&liFreq);
+   return((unsigned long long) ((double) liNow.QuadPart * 1e9 / (double) liFreq.QuadPart));
+#else
+   struct timespec ts;                      // current time
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((unsigned long long) ts.tv_sec * 1000000000ULL + (unsigned long long) ts.tv_nsec);
+#endif//_WIN32
+}
+#endif//EQPROFILE
+
+/*********************************************************
+* _EqProfileName                                  Private
+* Display name of a token.
+*********************************************************/
+static const char *_EqProfileName(const VALOP *pvo) {
+   switch(pvo->uTyp) {
+   case VOTYP_OP:     return(OP2STR(pvo->uOp));
+   case VOTYP_VAL:    return("Value");
+   case VOTYP_REF:    return("Variable");
+   case VOTYP_UNIT:   return("Unit");
+   case VOTYP_PREFIX: return("Prefix");
+   case VOTYP_CALL:   return(pvo->pCall->pszName);
+   }
+   return("*unknown*");
+}
+
+/*********************************************************
+* _EqProfileSpan                                  Private
+* Number of source characters belonging to the token at
+* iPos: a whole call "name(..)" including its brackets,
+* a number, a name, or an operator of one or two chars.
+*********************************************************/
+static int _EqProfileSpan(const char *pszSrc, int iPos) {
+   const char *psz;                         // scan pointer
+   char       *pszEnd;                      // end of number
+   int         iDepth;                      // bracket depth
+
+   if((pszSrc == NULL) || (iPos < 0) || (iPos >= (int) strlen(pszSrc))) return(0);
+   psz = pszSrc + iPos;
+
+   //===Numbers===========================================
+   if(((*psz >= '0') && (*psz <= '9')) || (*psz == '.')) {
+      strtod(psz, &pszEnd);
+      return((pszEnd > psz) ? (int) (pszEnd - psz) : 1);
+   }
+
+   //===Names, calls======================================
+   if(strchr(EQ_VALIDCHAR, *psz) || (*psz == '!')) {
+      if(*psz == '!') psz++;
+      else while((*psz != '\0') && strchr(EQ_VALIDSYMB, *psz)) psz++;
+      while(*psz == ' ') psz++;
+      if(*psz != '(') {                     // not a call: name only
+         for(psz=pszSrc+iPos+1; (*psz != '\0') && strchr(EQ_VALIDSYMB, *psz); psz++) ;
+         return((int) (psz - pszSrc) - iPos);
+      }
+      for(iDepth=0; *psz != '\0'; psz++) {
+         if(*psz == '(') iDepth++;
+         if((*psz == ')') && (--iDepth == 0)) { psz++; break; }
+      }
+      return((int) (psz - pszSrc) - iPos);
+   }
+
+   //===Operators=========================================
+   if(strchr("<>!=|&", psz[0]) && (psz[1] != '\0') && strchr("=|&", psz[1])) return(2);
+   return(1);
+}
+
+/*********************************************************
+* _EqProfileTotals                                Private
+* Walks the program as DoEquation(..) would, so that each
+* token's total is its own ticks plus those of the tokens
+* computing its arguments. Tokens consumed by the one
+* before (the variable of an assignment, argument counts)
+* are flagged in pucSkip.
+*********************************************************/
+static void _EqProfileTotals(const VALOP *pvo, int iLen, const unsigned long long *puSelf,
+      unsigned long long *puTotal, unsigned char *pucSkip) {
+   unsigned long long *puStk;               // totals of the values on the stack
+   unsigned long long  uSum;                // total of current op
+   int iPt;                                 // pointer into program
+   int iTop;                                // stack height
+   int iArgc;                               // arguments of op
+
+   memset(pucSkip, 0x00, iLen);
+   memset(puTotal, 0x00, iLen * sizeof(unsigned long long));
+   if((puStk = (unsigned long long*) malloc((iLen+1) * sizeof(unsigned long long))) == NULL) return;
+
+   for(iTop=0, iPt=0; iPt<iLen; iPt++) {
+      uSum = puSelf[iPt];
+      switch(pvo[iPt].uTyp) {
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+      case VOTYP_REF:
+         puStk[iTop++] = uSum;
+         break;
+
+      case VOTYP_UNIT:                      // scales the value below
+         if(iTop > 0) uSum += puStk[--iTop];
+         puStk[iTop++] = uSum;
+         break;
+
+      case VOTYP_OP:
+         if(pvo[iPt].uOp == OP_SET) {       // keeps value, variable follows
+            iArgc = 1;
+            if(iPt+1 < iLen) pucSkip[iPt+1] = TRUE;
+         } else if(pvo[iPt].uOp < OP_UNARY) {
+            iArgc = 2;
+         } else if(pvo[iPt].uOp < OP_NARG) {
+            iArgc = 1;
+         } else {
+            iArgc = CEquationNArgOpArgc[pvo[iPt].uOp - OP_NARG];
+            if((iArgc < 0) && (iPt+1 < iLen)) { iArgc = pvo[iPt+1].iArgc; pucSkip[iPt+1] = TRUE; }
+         }
+         for(; (iArgc > 0) && (iTop > 0); iArgc--) uSum += puStk[--iTop];
+         puStk[iTop++] = uSum;
+         break;
+
+      case VOTYP_CALL:
+         for(iArgc=pvo[iPt].pCall->iArgc; (iArgc > 0) && (iTop > 0); iArgc--) uSum += puStk[--iTop];
+         puStk[iTop++] = uSum;
+         break;
+
+      default:                              // VOTYP_NARGC
+         pucSkip[iPt] = TRUE;
+         break;
+      }
+      puTotal[iPt] = uSum;
+      if((iPt+1 < iLen) && pucSkip[iPt+1]) iPt++; // consumed with this token
+   }
+   free(puStk);
+}
+
+//===Sort orders==========================================
+static int _EqProfileCmpSelf(const void *pv1, const void *pv2) {
+   const EQPROFILEENTRY *pe1 = (const EQPROFILEENTRY*) pv1;
+   const EQPROFILEENTRY *pe2 = (const EQPROFILEENTRY*) pv2;
+   if(pe1->uTicks != pe2->uTicks) return((pe1->uTicks > pe2->uTicks) ? -1 : +1);
+   if(pe1->uCount != pe2->uCount) return((pe1->uCount > pe2->uCount) ? -1 : +1);
+   return(pe1->iOp - pe2->iOp);
+}
+static int _EqProfileCmpTotal(const void *pv1, const void *pv2) {
+   const EQPROFILEENTRY *pe1 = (const EQPROFILEENTRY*) pv1;
+   const EQPROFILEENTRY *pe2 = (const EQPROFILEENTRY*) pv2;
+   if(pe1->uTicksTotal != pe2->uTicksTotal) return((pe1->uTicksTotal > pe2->uTicksTotal) ? -1 : +1);
+   return(pe1->iPos - pe2->iPos);
+}
+
+/*********************************************************
+* EnableProfile
+* Starts (or stops) counting executions and ticks of each
+* token. Counters are kept while stopped; ResetProfile()
+* zeros them. Returns FALSE if the library was compiled
+* without EQPROFILE.
+*********************************************************/
+BOOL CEquation::EnableProfile(BOOL tfEnable) {
+#ifdef EQPROFILE
+   unsigned long long uT0, uDt, uMin;       // timer overhead
+   int k;                                   // calibration loop
+
+   if(tfEnable && !m_tfProfile) {
+      for(uMin=~0ULL, k=0; k<EQPROFILE_CALIBRATE; k++) {
+         uT0 = EQPROFILE_TICKS();
+         uDt = EQPROFILE_TICKS() - uT0;
+         if(uDt < uMin) uMin = uDt;
+      }
+      m_uProfileBias = uMin;
+   }
+   m_tfProfile = tfEnable;
+   return(TRUE);
+#else
+   (void) tfEnable;
+   m_tfProfile = FALSE;
+   return(FALSE);
+#endif//EQPROFILE
+}
+
+/*********************************************************
+* ResetProfile
+* Zeros the counters.
+*********************************************************/
+void CEquation::ResetProfile(void) {
+   if(m_pProfile) memset(m_pProfile, 0x00, iEqnLength * sizeof(EQPROFILETOKEN));
+   m_uProfileEvals = 0;
+}
+
+/*********************************************************
+* _ProfileCounters                                Private
+* Counters for the current program if profiling, allocated
+* on first use, else NULL.
+*********************************************************/
+EQPROFILETOKEN *CEquation::_ProfileCounters(void) {
+   if(!m_tfProfile || (iEqnLength <= 0)) return(NULL);
+   if(m_pProfile == NULL)
+      m_pProfile = (EQPROFILETOKEN*) calloc(iEqnLength, sizeof(EQPROFILETOKEN));
+   return(m_pProfile);
+}
+
+/*********************************************************
+* GetProfile
+* Sums the counters by operator (EQPROFILE_BYOP) or by
+* source position (EQPROFILE_BYPOS), and copies up to
+* iMax entries into pEntry, costliest first: by uTicks
+* for operators, by uTicksTotal for positions.
+*  pEntry   may be NULL to query the number of entries
+* Returns the number of entries available.
+*********************************************************/
+int CEquation::GetProfile(EQPROFILEENTRY *pEntry, int iMax, UINT uBy) {
+   EQPROFILEENTRY     *pAll;                // all entries
+   EQPROFILEENTRY     *pe;                  // entry of current token
+   unsigned long long *puSelf;              // ticks of each token, less overhead
+   unsigned long long *puTotal;             // including arguments
+   unsigned char      *pucSkip;             // token consumed by the one before
+   unsigned long long  uBias;               // timer overhead of token
+   unsigned long long  uCount;              // executions of token
+   int iPt;                                 // pointer into program
+   int iNum;                                // entries found
+   int k;                                   // entry loop counter
+
+   if(iEqnLength <= 0) return(0);
+   pAll    = (EQPROFILEENTRY*) malloc(iEqnLength * sizeof(EQPROFILEENTRY));
+   puSelf  = (unsigned long long*) malloc(2 * iEqnLength * sizeof(unsigned long long));
+   pucSkip = (unsigned char*) malloc(iEqnLength);
+   if((pAll == NULL) || (puSelf == NULL) || (pucSkip == NULL)) {
+      if(pAll)    free(pAll);
+      if(puSelf)  free(puSelf);
+      if(pucSkip) free(pucSkip);
+      return(0);
+   }
+   puTotal = puSelf + iEqnLength;
+
+   //===Own ticks, then totals============================
+   for(iPt=0; iPt<iEqnLength; iPt++) {
+      puSelf[iPt] = 0;
+      if(m_pProfile == NULL) continue;
+      uBias = m_pProfile[iPt].uTimed * m_uProfileBias;
+      if(m_pProfile[iPt].uTicks > uBias) puSelf[iPt] = m_pProfile[iPt].uTicks - uBias;
+   }
+   _EqProfileTotals(pvoEquation, iEqnLength, puSelf, puTotal, pucSkip);
+
+   //===Group tokens======================================
+   for(iNum=0, iPt=0; iPt<iEqnLength; iPt++) {
+      if(pucSkip[iPt]) continue;
+      uCount = (m_pProfile) ? m_pProfile[iPt].uCount : 0;
+      for(pe=NULL, k=0; (k<iNum) && (pe==NULL); k++) {
+         if(uBy == EQPROFILE_BYPOS) {
+            if(pAll[k].iPos == pvoEquation[iPt].iPos) pe = &pAll[k];
+         } else if(pAll[k].uTyp == pvoEquation[iPt].uTyp) {
+            if(pAll[k].uTyp == VOTYP_CALL) {  // by callback
+               if(pAll[k].pszName == pvoEquation[iPt].pCall->pszName) pe = &pAll[k];
+            } else if((pAll[k].uTyp != VOTYP_OP) || (pAll[k].iOp == (int) pvoEquation[iPt].uOp)) pe = &pAll[k];
+         }
+      }
+      if(pe == NULL) {                      // new entry
+         pe = &pAll[iNum++];
+         memset(pe, 0x00, sizeof(EQPROFILEENTRY));
+         pe->iPos = -1;
+         if(uBy == EQPROFILE_BYPOS) {
+            pe->iPos = pvoEquation[iPt].iPos;
+            pe->iLen = _EqProfileSpan(pszSrcEquation, pe->iPos);
+         }
+      }
+      //---Name after the op with the largest total--
+      if((pe->pszName == NULL)
+         || ((pvoEquation[iPt].uTyp == VOTYP_OP)
+            && ((pe->uTyp != VOTYP_OP) || (puTotal[iPt] >= pe->uTicksTotal)))) {
+         pe->uTyp    = pvoEquation[iPt].uTyp;
+         pe->iOp     = (pe->uTyp == VOTYP_OP) ? (int) pvoEquation[iPt].uOp : 0;
+         pe->pszName = _EqProfileName(&pvoEquation[iPt]);
+         if(uBy == EQPROFILE_BYPOS) pe->uCount = uCount;
+      }
+      pe->uTicks += puSelf[iPt];
+      if(uBy == EQPROFILE_BYPOS) pe->uTicksTotal = MAX(pe->uTicksTotal, puTotal[iPt]);
+      else                       pe->uCount += uCount;
+   }
+
+   //===Sort and copy=====================================
+   qsort(pAll, iNum, sizeof(EQPROFILEENTRY), (uBy == EQPROFILE_BYPOS) ? _EqProfileCmpTotal : _EqProfileCmpSelf);
+   if(pEntry) memcpy(pEntry, pAll, MIN(iMax, iNum) * sizeof(EQPROFILEENTRY));
+   free(pAll);
+   free(puSelf);
+   free(pucSkip);
+   return(iNum);
+}
+
+/*********************************************************
+* _EqProfileJsonStr                               Private
+* Writes iLen characters of psz as a JSON string.
+*********************************************************/
+static void _EqProfileJsonStr(FILE *fp, const char *psz, int iLen) {
+   fputc('"', fp);
+   for(; (iLen > 0) && (*psz != '\0'); psz++, iLen--) {
+      if((*psz == '"') || (*psz == '\\')) fputc('\\', fp);
+      if((unsigned char) *psz < ' ') fprintf(fp, "\\u%04x", (unsigned char) *psz);
+      else fputc(*psz, fp);
+   }
+   fputc('"', fp);
+}
+
+/*********************************************************
+* DumpProfile
+* Writes the profile by operator and by source position,
+* costliest first.
+*  uFormat  EQPROFILE_TEXT: tables for reading
+*           EQPROFILE_JSON: one object on one line,
+*     {"equation":"..","evaluations":N,"tick_unit":"cycles",
+*      "tick_bias":B,"by_op":[{"op":"Sin","type":2,"code":28,
+*      "count":N,"ticks":T},..],"by_pos":[{"pos":4,"len":9,
+*      "source":"sin(pi*y)","op":"Sin","count":N,"self":T,
+*      "total":T},..]}
+* Returns an error code.
+*********************************************************/
+int CEquation::DumpProfile(FILE *fp, UINT uFormat) {
+   EQPROFILEENTRY    *pOp, *pPos;           // entries by op and by position
+   unsigned long long uSum;                 // ticks of all tokens
+   const char        *pszUnit;              // tick unit
+   int iNumOp, iNumPos;                     // number of entries
+   int k;                                   // entry loop counter
+
+   if(iEqnLength <= 0) return(iError=EQERR_EVAL_NOEQUATION);
+#ifdef EQPROFILE
+   pszUnit = EQPROFILE_TICKUNIT;
+#else
+   pszUnit = "ticks";
+#endif//EQPROFILE
+   pOp  = (EQPROFILEENTRY*) malloc(iEqnLength * sizeof(EQPROFILEENTRY));
+   pPos = (EQPROFILEENTRY*) malloc(iEqnLength * sizeof(EQPROFILEENTRY));
+   if((pOp == NULL) || (pPos == NULL)) {
+      if(pOp)  free(pOp);
+      if(pPos) free(pPos);
+      return(iError=EQERR_PARSE_ALLOCFAIL);
+   }
+   iNumOp  = GetProfile(pOp,  iEqnLength, EQPROFILE_BYOP);
+   iNumPos = GetProfile(pPos, iEqnLength, EQPROFILE_BYPOS);
+   for(uSum=0, k=0; k<iNumOp; k++) uSum += pOp[k].uTicks;
+   if(uSum == 0) uSum = 1;                  // percentages of nothing
+
+   //===JSON==============================================
+   if(uFormat == EQPROFILE_JSON) {
+      fprintf(fp, "{\"equation\":");
+      _EqProfileJsonStr(fp, pszSrcEquation ? pszSrcEquation : "", 0x7FFFFFFF);
+      fprintf(fp, ",\"evaluations\":%llu,\"tick_unit\":\"%s\",\"tick_bias\":%llu,\"by_op\":[",
+         m_uProfileEvals, pszUnit, m_uProfileBias);
+      for(k=0; k<iNumOp; k++)
+         fprintf(fp, "%s{\"op\":\"%s\",\"type\":%d,\"code\":%d,\"count\":%llu,\"ticks\":%llu}",
+            (k>0) ? "," : "", pOp[k].pszName, pOp[k].uTyp, pOp[k].iOp, pOp[k].uCount, pOp[k].uTicks);
+      fprintf(fp, "],\"by_pos\":[");
+      for(k=0; k<iNumPos; k++) {
+         fprintf(fp, "%s{\"pos\":%d,\"len\":%d,\"source\":", (k>0) ? "," : "", pPos[k].iPos, pPos[k].iLen);
+         _EqProfileJsonStr(fp, pszSrcEquation + pPos[k].iPos, pPos[k].iLen);
+         fprintf(fp, ",\"op\":\"%s\",\"count\":%llu,\"self\":%llu,\"total\":%llu}",
+            pPos[k].pszName, pPos[k].uCount, pPos[k].uTicks, pPos[k].uTicksTotal);
+      }
+      fprintf(fp, "]}\n");
+
+   //===Text==============================================
+   } else {
+      fprintf(fp, "Profile of \"%s\"\n", pszSrcEquation ? pszSrcEquation : "");
+      fprintf(fp, "%llu evaluations, %s, %llu subtracted per interval for the timer\n\n",
+         m_uProfileEvals, pszUnit, m_uProfileBias);
+      fprintf(fp, "%-12s %12s %14s %10s %7s\n", "Operator", "Count", "Self", "Per count", "Self %");
+      for(k=0; k<iNumOp; k++)
+         fprintf(fp, "%-12s %12llu %14llu %10.1f %7.1f\n", pOp[k].pszName, pOp[k].uCount, pOp[k].uTicks,
+            (pOp[k].uCount > 0) ? (double) pOp[k].uTicks / (double) pOp[k].uCount : 0.00,
+            100.00 * (double) pOp[k].uTicks / (double) uSum);
+      fprintf(fp, "\n%5s %-12s %12s %14s %14s %7s  %s\n", "Pos", "Operator", "Count", "Self", "Total", "Total %", "Source");
+      for(k=0; k<iNumPos; k++) {
+         fprintf(fp, "%5d %-12s %12llu %14llu %14llu %7.1f  %.*s%s\n", pPos[k].iPos, pPos[k].pszName,
+            pPos[k].uCount, pPos[k].uTicks, pPos[k].uTicksTotal,
+            100.00 * (double) pPos[k].uTicksTotal / (double) uSum,
+            MIN(pPos[k].iLen, EQPROFILE_SRCWIDTH), pszSrcEquation + pPos[k].iPos,
+            (pPos[k].iLen > EQPROFILE_SRCWIDTH) ? ".." : "");
+      }
+   }
+   free(pOp);
+   free(pPos);
+   return(iError=EQERR_NONE);
+}
@@ -0,0 +1,301 @@
+/*****************************************************************************
+*  CLCEqTable.cpp                                       CSIVM LaserCanvas
+*  Tables of data for interp1(..), e.g. material data
+*  Class declaration in CLCEqtn.h.
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* AddTable(..) registers sampled data, e.g. a refractive index versus wave-
+* length, under a name that equations then use with interp1(..):
+*
+*    CEquation::AddTable("nBK7", dLambda, dIndex, 120, 0, "nm");
+*    Eq.ParseEquation("interp1(nBK7, lambda nm) - 1", "lambda\0");
+*
+* interp1(table, x) interpolates linearly between the grid points. The grid
+* must be strictly increasing. Outside it, interp1(..) fails with
+* EQERR_MATH_DOMAIN, unless the table was added with
+*    EQINTERP_CLAMP        the first or last value is returned, or
+*    EQINTERP_EXTRAPOLATE  the first or last segment is extended.
+* A NaN argument gives NaN. With pszUnitX and pszUnitY, grid and values are
+* in those units: the argument must have the grid's dimension and the answer
+* has the values' dimension. Both are dimensionless by default.
+*
+* Lookup
+* ------
+* A table's name is parsed as a number identifying the table (a hash of the
+* name, the same in every process, so saved and library programs keep work-
+* ing if the same tables are registered). Finding the table from it takes
+* one probe of a hash index, once per DoEquation(..) call or batch chunk.
+*  - Grids with equal spacing, whether given by AddTable(.., dX0, dDx, ..) or
+*    found so in the pdX passed, compute the segment directly: O(1).
+*  - Other grids are searched by halving, with a conditional move rather
+*    than a branch at every step, so the time does not depend on the data
+*    and no mispredictions are paid: log2(n) steps over the grid array.
+* Each segment keeps its value and slope side by side, so the answer needs
+* one more cache line. In batches, each chunk of rows runs as a loop of its
+* own over the table (see CLCEqBatch.cpp).
+*
+* Tables are shared by all equations of the process. Register them before
+* equations using them are parsed and evaluated; AddTable(..) is not safe to
+* call while other threads evaluate. Adding a table under an existing name
+* replaces its data, which must keep its dimensions. Native code (Compile-
+* Native) is not generated for equations with interp1(..).
+******************************************************************************/
+#include "CLCEqtn.h"                        // header file and definitions
+#include <stdlib.h>                         // malloc, calloc, free
+#include <string.h>                         // memcpy, strlen
+#include <math.h>                           // fabs, floor, NAN
+#include <float.h>                          // DBL_MAX
+
+#define EQINTERP_MINSLOTS            64     // initial size of the hash index
+#define EQINTERP_UNIFORMTOL       1e-12     // relative spacing error of a uniform grid
+
+//===Registry=============================================
+// Open addressing on the handle; at most half the slots in
+// use. Each table is one block: EQINTERPTABLE, grid, value
+// and slope pairs, name.
+static EQINTERPTABLE **s_ppTable  = NULL;   // hash index of tables
+static int             s_iNumSlot = 0;      // size of s_ppTable (power of 2)
+static int             s_iNumTable = 0;     // tables registered
+
+//---Handle-------------------------------------
+// FNV-1a folded to 24 bits, so that float batches carry it
+// exactly.
+static unsigned int _EqTableHandle(const char *psz, size_t len) {
+   unsigned int u = EqHashFnv1a(psz, len);  // full hash
+   return((u ^ (u >> 24)) & 0x00FFFFFF);
+}
+
+//---Slot---------------------------------------
+static EQINTERPTABLE **_EqTableSlot(unsigned int uHandle) {
+   int k;                                   // slot
+   for(k=(int) (uHandle & (s_iNumSlot-1)); s_ppTable[k] != NULL; k=(k+1) & (s_iNumSlot-1))
+      if(s_ppTable[k]->uHandle == uHandle) break;
+   return(&s_ppTable[k]);
+}
+
+/*********************************************************
+* EqFindTable
+* Table identified by the value of its name, NULL if none
+* is registered.
+*********************************************************/
+const EQINTERPTABLE *EqFindTable(double dHandle) {
+   if((s_iNumTable == 0) || !(dHandle >= 0.00) || (dHandle > (double) 0x00FFFFFF)
+      || (dHandle != floor(dHandle))) return(NULL);
+   return(*_EqTableSlot((unsigned int) dHandle));
+}
+
+//---By name------------------------------------
+// Table named by the iLen characters at psz.
+const EQINTERPTABLE *EqFindTableName(const char *psz, int iLen) {
+   const EQINTERPTABLE *pt;                 // table of the same handle
+   if(s_iNumTable == 0) return(NULL);
+   pt = *_EqTableSlot(_EqTableHandle(psz, iLen));
+   if((pt == NULL) || ((int) strlen(pt->pszName) != iLen) || (memcmp(pt->pszName, psz, iLen) != 0)) return(NULL);
+   return(pt);
+}
+
+/*********************************************************
+* AddTable
+* Registers a table for interp1(..) (see top of file). The
+* data are copied. pdX gives the grid, or dX0 and dDx the
+* uniform grid dX0 + k*dDx. Returns
+*  EQERR_NONE
+*  EQERR_PARSE_UNKNOWNFUNCVAR  name not a valid identifier,
+*                    or has the handle of another table
+*  EQERR_PARSE_FUNCDEF  name of a built-in function or
+*                    constant, a unit, a user function or
+*                    a callback, which it would hide
+*  EQERR_MATH_DOMAIN fewer than 2 points, grid not strictly
+*                    increasing, or values not finite
+*  EQERR_PARSE_ALLOCFAIL, or the error of a unit string
+*********************************************************/
+int CEquation::AddTable(const char *pszName, const double pdX[], const double pdY[], int iNum, UINT uFlags, const char *pszUnitX, const char *pszUnitY) {
+   double dDx;                              // spacing, if uniform
+   int    k;                                // grid point
+
+   if((pdX == NULL) || (iNum < 2)) return(EQERR_MATH_DOMAIN);
+   dDx = (pdX[iNum-1] - pdX[0]) / (double) (iNum-1);
+   for(k=1; k<iNum; k++)
+      if(fabs(pdX[k] - (pdX[0] + k*dDx)) > EQINTERP_UNIFORMTOL * fabs(pdX[iNum-1] - pdX[0])) break;
+   return(_AddTable(pszName, pdX, (k == iNum) ? pdX[0] : 0.00, (k == iNum) ? dDx : 0.00, pdY, iNum, uFlags, pszUnitX, pszUnitY));
+}
+
+int CEquation::AddTable(const char *pszName, double dX0, double dDx, const double pdY[], int iNum, UINT uFlags, const char *pszUnitX, const char *pszUnitY) {
+   if(!(dDx > 0.00)) return(EQERR_MATH_DOMAIN);
+   return(_AddTable(pszName, NULL, dX0, dDx, pdY, iNum, uFlags, pszUnitX, pszUnitY));
+}
+
+//===Implementation=======================================
+// Uniform grid if dDx > 0, else pdX.
+int CEquation::_AddTable(const char *pszName, const double pdX[], double dX0, double dDx, const double pdY[], int iNum, UINT uFlags, const char *pszUnitX, const char *pszUnitY) {
+   CEquation       Eq;                      // for _StringToUnit(..)
+   EQINTERPTABLE  *pt;                      // new table
+   EQINTERPTABLE **ppSlot;                  // its slot
+   EQINTERPTABLE **ppOld;                   // index being grown
+   double         *pdXt, *pdYS;             // grid and (value, slope) pairs
+   double          dSclX=1.00, dOffX=0.00;  // grid unit to SI
+   double          dSclY=1.00, dOffY=0.00;  // value unit to SI
+   UNITBASE        uUnitX, uUnitY;          // dimensions
+   size_t          uLen;                    // name length
+   int             k, iOld;                 // points, slots
+   int             iErr;                    // unit errors
+
+   //---Check------------------------------------
+   if((pszName == NULL) || (pdY == NULL) || (iNum < 2)) return(EQERR_MATH_DOMAIN);
+   uLen = strlen(pszName);
+   if((uLen == 0) || (strchr(EQ_VALIDCHAR, pszName[0]) == NULL)) return(EQERR_PARSE_UNKNOWNFUNCVAR);
+   for(k=1; k<(int) uLen; k++)
+      if(strchr(EQ_VALIDSYMB, pszName[k]) == NULL) return(EQERR_PARSE_UNKNOWNFUNCVAR);
+   if(   EqIsBuiltinName(pszName, (int) uLen) || EqIsUnitName(pszName, (int) uLen)
+      || (EqFindFunction(pszName, (int) uLen) != NULL)
+      || (EqFindCallback(pszName, (int) uLen) != NULL)) return(EQERR_PARSE_FUNCDEF);
+   uUnitX.u = uUnitY.u = 0;
+   if(pszUnitX && ((iErr = Eq._StringToUnit(pszUnitX, NULL, 0, &uUnitX, &dSclX, &dOffX)) != EQERR_NONE)) return(iErr);
+   if(pszUnitY && ((iErr = Eq._StringToUnit(pszUnitY, NULL, 0, &uUnitY, &dSclY, &dOffY)) != EQERR_NONE)) return(iErr);
+   for(k=0; k<iNum; k++) {
+      if(!(fabs(pdY[k]) <= DBL_MAX)) return(EQERR_MATH_DOMAIN);
+      if(pdX && (!(fabs(pdX[k]) <= DBL_MAX) || ((k > 0) && !(pdX[k] > pdX[k-1])))) return(EQERR_MATH_DOMAIN);
+   }
+
+   //---Copy, in SI units------------------------
+   pt = (EQINTERPTABLE*) malloc(sizeof(EQINTERPTABLE) + ((dDx > 0.00) ? 2 : 3) * iNum * sizeof(double) + uLen + 1);
+   if(pt == NULL) return(EQERR_PARSE_ALLOCFAIL);
+   pdYS = (double*) (pt + 1);
+   pdXt = pdYS + 2*iNum;
+   for(k=0; k<iNum; k++) pdYS[2*k] = pdY[k] * dSclY + dOffY;
+   pt->uHandle   = _EqTableHandle(pszName, uLen);
+   pt->pdYS      = pdYS;
+   pt->uFlags    = uFlags;
+   pt->iNum      = iNum;
+   pt->tfUniform = (dDx > 0.00);
+   pt->uUnitX    = uUnitX;
+   pt->uUnitY    = uUnitY;
+   if(pt->tfUniform) {
+      dX0 = dX0 * dSclX + dOffX;
+      dDx = dDx * dSclX;
+      for(k=0; k<iNum-1; k++) pdYS[2*k+1] = pdYS[2*k+2] - pdYS[2*k]; // per step
+      pt->pdX    = NULL;
+      pt->dX0    = dX0;
+      pt->dXN    = dX0 + (iNum-1) * dDx;
+      pt->dInvDx = 1.00 / dDx;
+      pt->pszName = (char*) pdXt;
+   } else {
+      for(k=0; k<iNum; k++) pdXt[k] = pdX[k] * dSclX + dOffX;
+      for(k=0; k<iNum-1; k++) pdYS[2*k+1] = (pdYS[2*k+2] - pdYS[2*k]) / (pdXt[k+1] - pdXt[k]);
+      pt->pdX    = pdXt;
+      pt->dX0    = pdXt[0];
+      pt->dXN    = pdXt[iNum-1];
+      pt->dInvDx = 0.00;
+      pt->pszName = (char*) (pdXt + iNum);
+   }
+   pdYS[2*iNum-1] = 0.00;                   // no segment after the last point
+   memcpy((char*) pt->pszName, pszName, uLen+1);
+
+   //---Index------------------------------------
+   if(2*(s_iNumTable+1) > s_iNumSlot) {
+      ppOld = s_ppTable;
+      iOld  = s_iNumSlot;
+      s_iNumSlot = MAX(EQINTERP_MINSLOTS, 2*s_iNumSlot);
+      s_ppTable  = (EQINTERPTABLE**) calloc(s_iNumSlot, sizeof(EQINTERPTABLE*));
+      if(s_ppTable == NULL) {
+         s_ppTable  = ppOld;
+         s_iNumSlot = iOld;
+         free(pt);
+         return(EQERR_PARSE_ALLOCFAIL);
+      }
+      for(k=0; k<iOld; k++) if(ppOld[k]) *_EqTableSlot(ppOld[k]->uHandle) = ppOld[k];
+      if(ppOld) free(ppOld);
+   }
+   ppSlot = _EqTableSlot(pt->uHandle);
+   if(*ppSlot != NULL) {                    // replace, if the same name
+      if(strcmp((*ppSlot)->pszName, pszName) != 0) { free(pt); return(EQERR_PARSE_UNKNOWNFUNCVAR); }
+      free(*ppSlot);
+      s_iNumTable--;
+   }
+   *ppSlot = pt;
+   s_iNumTable++;
+   return(EQERR_NONE);
+}
+
+//===Free=================================================
+void CEquation::FreeTables(void) {
+   for(int k=0; k<s_iNumSlot; k++) if(s_ppTable[k]) free(s_ppTable[k]);
+   if(s_ppTable) free(s_ppTable);
+   s_ppTable   = NULL;
+   s_iNumSlot  = 0;
+   s_iNumTable = 0;
+}
+
+/*********************************************************
+* Interpolation
+* _EqInterpSeg finds the segment k of x, clamped to the
+* first and last, and returns y as y[k] + slope[k] * dx.
+* Out-of-range x are left as they are here; the callers
+* flag or clamp them first.
+*********************************************************/
+static inline double _EqInterpSeg(const EQINTERPTABLE *pt, double x) {
+   const double *p;                         // search window
+   double t;                                // grid steps from dX0
+   int    k, m, h;                          // segment, window size, half
+
+   if(pt->tfUniform) {
+      t = (x - pt->dX0) * pt->dInvDx;
+      k = (t >= 1.00) ? ((t < (double) (pt->iNum-1)) ? (int) t : pt->iNum-2) : 0; // NaN: 0
+      return(pt->pdYS[2*k] + (t - (double) k) * pt->pdYS[2*k+1]);
+   }
+   p = pt->pdX;                             // segment starts x[0]..x[n-2]
+   m = pt->iNum - 1;
+   while(m > 1) {
+      h = m / 2;
+      p = (p[h] <= x) ? p + h : p;          // conditional move
+      m -= h;
+   }
+   k = (int) (p - pt->pdX);
+   return(pt->pdYS[2*k] + (x - pt->pdX[k]) * pt->pdYS[2*k+1]);
+}
+
+//---Single value-------------------------------
+double EqInterp1(const EQINTERPTABLE *pt, double x, int *piErr) {
+   if(pt->uFlags & EQINTERP_CLAMP) {
+      x = (x < pt->dX0) ? pt->dX0 : ((x > pt->dXN) ? pt->dXN : x);
+   } else if(!(pt->uFlags & EQINTERP_EXTRAPOLATE) && ((x < pt->dX0) || (x > pt->dXN))) {
+      if(piErr) *piErr = EQERR_MATH_DOMAIN;
+      return(0.00);
+   }
+   return(_EqInterpSeg(pt, x));
+}
+
+//---Batch--------------------------------------
+// Rows outside the grid (without EQINTERP_CLAMP or _EXTRA-
+// POLATE) get NaN and are flagged in pucBad for DoEquation.
+template<class T>
+static void _EqInterp1Batch(const EQINTERPTABLE *pt, const T px[], T py[], int n, unsigned char pucBad[]) {
+   const double dX0 = pt->dX0, dXN = pt->dXN; // grid range
+   double x;                                // argument
+   int    r;                                // row
+
+   if(pt->uFlags & EQINTERP_CLAMP) {
+      for(r=0; r<n; r++) {
+         x = (double) px[r];
+         py[r] = (T) _EqInterpSeg(pt, (x < dX0) ? dX0 : ((x > dXN) ? dXN : x));
+      }
+   } else if(pt->uFlags & EQINTERP_EXTRAPOLATE) {
+      for(r=0; r<n; r++) py[r] = (T) _EqInterpSeg(pt, (double) px[r]);
+   } else {
+      for(r=0; r<n; r++) {
+         x = (double) px[r];
+         py[r] = ((x < dX0) || (x > dXN)) ? (T) NAN : (T) _EqInterpSeg(pt, x);
+         pucBad[r] |= ((x < dX0) || (x > dXN));
+      }
+   }
+}
+
+void EqInterp1Batch(const EQINTERPTABLE *pt, const double px[], double py[], int n, unsigned char pucBad[]) {
+   _EqInterp1Batch(pt, px, py, n, pucBad);
+}
+
+void EqInterp1Batch(const EQINTERPTABLE *pt, const float px[], float py[], int n, unsigned char pucBad[]) {
+   _EqInterp1Batch(pt, px, py, n, pucBad);
+}
@@ -90,6 +90,29 @@
 * DoEquation(..). The values for the variables are taken in the same order as
 * when the variables were defined.
 *
+* Parsing Many Equations
+* ----------------------
+* ParseEquation(..) builds its operator and RPN stacks in a bump arena. Pass
+* the same CEqParseContext to every call to keep that arena between calls;
+* an equation object that is parsed again reuses its own program and source
+* buffers when they are large enough. Re-parsing any number of equations
+* into one object with one context then allocates only when an equation is
+* larger than all before it.
+*    CEqParseContext Ctx;                   // one per thread
+*    for(..) Eq.ParseEquation(pszEqn[k], "x\0y\0", &Ctx);
+*
+* Copying Equations
+* -----------------
+* A copy of a CEquation shares the compiled program and source of the ori-
+* ginal through a reference count, so copying is cheap and does not parse:
+* equations can be kept by value, in containers, or handed to other threads.
+* The program is never changed in place; whichever copy is parsed or loaded
+* again gets buffers of its own. Native code, batch tables and profile
+* counters are not shared; a copy builds its own when used. A moved-from
+* equation is empty, as if just constructed. Copying an equation while an-
+* other thread uses the same object is not safe; the copies themselves may
+* be used, parsed and destroyed in different threads.
+*
 * Usage Example
 * -------------
 *    CEquation Eq;                          // create a CEquation object
@@ -137,8 +160,31 @@ void DisplayOpStack(TEqStack<int> *pStack, const char *pszHead) {
 *  Constructor and initialization
 *********************************************************/
 CEquation::CEquation(void) { //printf("CEquation::CEquation\n");
+   _Construct();
+}
+
+void CEquation::_Construct(void) {
    pszSrcEquation = NULL;                   // no data allocated
    pvoEquation    = NULL;                   // no equation allocated
+   m_tfAttached   = FALSE;                  // buffers are our own
+   m_plRefs       = NULL;                   // and not shared
+   m_dScleTarget  = 0.00;                   // no target unit
+   m_szUnit[0]    = '\0';
+   m_pdConst      = NULL;                   // no constant tables
+   m_pfConst      = NULL;
+   m_iConstAlloc  = 0;
+   m_iSrcAlloc    = 0;                      // no buffers to reuse
+   m_iEqnAlloc    = 0;
+   m_hNative      = NULL;                   // no native code
+   m_pfnNative    = NULL;
+   m_pfnNativeBatch = NULL;
+   m_tfProfile    = FALSE;                  // no profiling
+   m_pProfile     = NULL;
+   m_uProfileEvals = 0;
+   m_uProfileBias = 0;
+   m_pArray       = NULL;                   // no reductions split
+   m_puRefUnit    = NULL;                   // variables dimensionless
+   _ResetProgramState();                    // no answer yet
    iEqnLength     = 0;                      // no ops parsed
    iError         = EQERR_NONE;             // no error occurred
    iErrorLocation = 0;                      // no error location
@@ -148,9 +194,89 @@ CEquation::CEquation(void) { //printf("CEquation::CEquation\n");
 *  Destructor
 *********************************************************/
 CEquation::~CEquation() {
+   _Destruct();
+//printf("Deleted ~CEquation\n");
+}
+
+void CEquation::_Destruct(void) {
    FreeSrcEquation();                       // free memory buffer
    FreeEquation();                          // free equation stack
-//printf("Deleted ~CEquation\n");
+   if(m_pdConst) free(m_pdConst);           // batch constant tables
+   FreeNative();                            // native code, if loaded
+   if(m_pProfile) free(m_pProfile);         // profile counters
+   if(m_pArray) _FreeArrayPlan();           // programs of reductions
+   if(m_plRefs) free((void*) m_plRefs);     // share count, ours alone by now
+   m_plRefs = NULL;
+}
+
+/*********************************************************
+*  Copy and move
+*  A copy shares the program (see _ShareProgram); a move
+*  takes over everything, including native code, and
+*  leaves the other equation empty (see _MoveFrom).
+*********************************************************/
+CEquation::CEquation(const CEquation &Eq) {
+   _Construct();
+   _ShareProgram(&Eq);
+}
+
+CEquation& CEquation::operator=(const CEquation &Eq) {
+   _ShareProgram(&Eq);
+   return(*this);
+}
+
+#ifdef EQMOVE
+CEquation::CEquation(CEquation &&Eq) {
+   _MoveFrom(&Eq);
+}
+
+CEquation& CEquation::operator=(CEquation &&Eq) {
+   if(&Eq == this) return(*this);
+   _Destruct();
+   _MoveFrom(&Eq);
+   return(*this);
+}
+#endif//EQMOVE
+
+//===Move=================================================
+// Takes over every member of pEq, whose buffers, counts and
+// native code are now ours, and leaves pEq empty. Members
+// added to CEquation must be added here.
+void CEquation::_MoveFrom(CEquation *pEq) {
+   pszSrcEquation   = pEq->pszSrcEquation;  // program
+   iEqnLength       = pEq->iEqnLength;
+   pvoEquation      = pEq->pvoEquation;
+   m_tfAttached     = pEq->m_tfAttached;
+   m_plRefs         = pEq->m_plRefs;
+   iError           = pEq->iError;
+   iErrorLocation   = pEq->iErrorLocation;
+   m_iSrcAlloc      = pEq->m_iSrcAlloc;
+   m_iEqnAlloc      = pEq->m_iEqnAlloc;
+   memcpy(m_szUnit, pEq->m_szUnit, sizeof(m_szUnit)); // units
+   m_uUnitTarget    = pEq->m_uUnitTarget;
+   m_dScleTarget    = pEq->m_dScleTarget;
+   m_dOffsTarget    = pEq->m_dOffsTarget;
+   m_uUnitAns       = pEq->m_uUnitAns;
+   m_tfUnitAnsDerived = pEq->m_tfUnitAnsDerived;
+   m_tfUnitStale    = pEq->m_tfUnitStale;
+   m_tfAnalyzed     = pEq->m_tfAnalyzed;    // batch analysis
+   m_tfBatchScalar  = pEq->m_tfBatchScalar;
+   m_iBatchDepth    = pEq->m_iBatchDepth;
+   m_iBatchNumVar   = pEq->m_iBatchNumVar;
+   m_uUnitStatic    = pEq->m_uUnitStatic;
+   m_pdConst        = pEq->m_pdConst;
+   m_pfConst        = pEq->m_pfConst;
+   m_iConstAlloc    = pEq->m_iConstAlloc;
+   m_puRefUnit      = pEq->m_puRefUnit;
+   m_pArray         = pEq->m_pArray;        // array reductions
+   m_hNative        = pEq->m_hNative;       // native code
+   m_pfnNative      = pEq->m_pfnNative;
+   m_pfnNativeBatch = pEq->m_pfnNativeBatch;
+   m_tfProfile      = pEq->m_tfProfile;     // profiling
+   m_pProfile       = pEq->m_pProfile;
+   m_uProfileEvals  = pEq->m_uProfileEvals;
+   m_uProfileBias   = pEq->m_uProfileBias;
+   pEq->_Construct();                       // ownership passed on
 }
 
 /*********************************************************
@@ -182,37 +308,277 @@ double CEquation::Answer(double dVar[], BOOL tfAllowAssign) {
 *  Memory for source string
 *********************************************************/
 //===Allocate=============================================
+// Keeps the existing buffer if the string fits.
 BOOL CEquation::SetSrcEquation(const char *sz) {
-   FreeSrcEquation();                       // free previously allocated
-   pszSrcEquation = (char*) malloc((strlen(sz)+1) * sizeof(char)); // allocate new
-   if(pszSrcEquation == NULL) return(FALSE); // verify allocation
-   strcpy(pszSrcEquation, sz);              // copy the string
-   return(TRUE);                            // return success
+   int iLen = (int) strlen(sz) + 1;         // bytes needed
+   _Unshare();                              // sz stays valid: another copy holds it
+   if(m_tfAttached || (pszSrcEquation == NULL) || (iLen > m_iSrcAlloc)) {
+      FreeSrcEquation();                    // free previously allocated
+      pszSrcEquation = (char*) malloc(iLen * sizeof(char)); // allocate new
+      if(pszSrcEquation == NULL) return(FALSE); // verify allocation
+      m_iSrcAlloc = iLen;
+   }
+   memmove(pszSrcEquation, sz, iLen);       // copy the string (may be our own)
+   return(_CountProgram());                 // return success
 }
 
 //===Free=================================================
 void CEquation::FreeSrcEquation(void) {
+   _Unshare();
+   if(m_tfAttached) { _Detach(); return; }  // not ours to free
    if(pszSrcEquation == NULL) return;
    free(pszSrcEquation);
    pszSrcEquation = NULL;
+   m_iSrcAlloc    = 0;
 }
 
 /*********************************************************
 *  Memory for VALOP equation stack
 *********************************************************/
 //===Allocate=============================================
+// Keeps the existing buffer if the program fits.
 BOOL CEquation::AllocEquation(int iNumOps) {
+   _Unshare();
+   if(!m_tfAttached && (pvoEquation != NULL) && (iNumOps <= m_iEqnAlloc)) {
+      iEqnLength = 0;                       // as if freed
+      return(TRUE);
+   }
    FreeEquation();                          // free previously allocated
    pvoEquation = (VALOP*) malloc(iNumOps * sizeof(VALOP));
+   m_iEqnAlloc = (pvoEquation!=NULL) ? iNumOps : 0;
    return( (pvoEquation!=NULL) ? TRUE : FALSE ); // return success
 }
 
 //===Free=================================================
 void CEquation::FreeEquation(void) {
+   _Unshare();
+   if(m_tfAttached) { _Detach(); return; }  // not ours to free
    if(pvoEquation == NULL) return;
    free(pvoEquation);
    pvoEquation = NULL;
    iEqnLength = 0;                          // track how long buffer is
+   m_iEqnAlloc = 0;
+}
+
+//===Detach===============================================
+// An equation attached to a CEquationLibrary or CEquationPool
+// points into it for both its source and its program. Replacing
+// either drops both references; nothing is freed.
+void CEquation::_Detach(void) {
+   pszSrcEquation = NULL;
+   pvoEquation    = NULL;
+   iEqnLength     = 0;
+   m_iSrcAlloc    = 0;
+   m_iEqnAlloc    = 0;
+   m_tfAttached   = FALSE;
+}
+
+//===Share================================================
+// Copies of an equation refer to the same source and program
+// buffers, counted by m_plRefs. The count is allocated with
+// the source buffer (see _CountProgram), so that copying only
+// increments it, atomically: several threads may copy the
+// same const equation at once. Before anything writes to or
+// frees the buffers, _Unshare() drops this equation's share:
+// the last one to go keeps the buffers and the count as its
+// own, the others let go of them. Equations attached to a
+// library or pool are copied as attached to it.
+void CEquation::_ShareProgram(const CEquation *pEqSrc) {
+   if(pEqSrc == this) return;
+   FreeSrcEquation();                       // release our own
+   FreeEquation();
+   if(m_plRefs) { free((void*) m_plRefs); m_plRefs = NULL; } // nothing left to count
+   if(pEqSrc->m_tfAttached || (pEqSrc->m_plRefs != NULL)) {
+      if(!pEqSrc->m_tfAttached) {
+         EQREF_INC(pEqSrc->m_plRefs);
+         m_plRefs = pEqSrc->m_plRefs;
+      }
+      pszSrcEquation = pEqSrc->pszSrcEquation;
+      pvoEquation    = pEqSrc->pvoEquation;
+      iEqnLength     = pEqSrc->iEqnLength;
+      m_tfAttached   = pEqSrc->m_tfAttached;
+      m_iSrcAlloc    = pEqSrc->m_iSrcAlloc;
+      m_iEqnAlloc    = pEqSrc->m_iEqnAlloc;
+   }
+   memcpy(m_szUnit, pEqSrc->m_szUnit, sizeof(m_szUnit));
+   m_uUnitTarget  = pEqSrc->m_uUnitTarget;  // target unit state
+   m_dScleTarget  = pEqSrc->m_dScleTarget;
+   m_dOffsTarget  = pEqSrc->m_dOffsTarget;
+   _ResetProgramState();
+   iError         = pEqSrc->iError;
+   iErrorLocation = pEqSrc->iErrorLocation;
+}
+
+void CEquation::_Unshare(void) {
+   if(m_plRefs == NULL) return;
+   if(EQREF_DEC(m_plRefs) == 0) {           // last: buffers are ours alone
+      *m_plRefs = 1;
+   } else {                                 // still used by other copies
+      m_plRefs = NULL;
+      _Detach();
+   }
+}
+
+//===Count================================================
+// Allocates the share count of a source buffer of our own,
+// if it does not have one yet. Returns FALSE without memory.
+BOOL CEquation::_CountProgram(void) {
+   if(m_plRefs != NULL) return(TRUE);
+   if((m_plRefs = (EQREFCOUNT*) malloc(sizeof(EQREFCOUNT))) == NULL) return(FALSE);
+   *m_plRefs = 1;                           // this equation
+   return(TRUE);
+}
+
+//===Copy=================================================
+// Duplicates the compiled program of another equation, i.e.
+// everything ParseEquation would have produced, without re-
+// parsing the source. Used by CEquationCache.
+int CEquation::_CopyProgram(const CEquation *pEqSrc) {
+   if((pEqSrc==NULL) || (pEqSrc->iEqnLength<=0) || (pEqSrc->pszSrcEquation==NULL))
+      return(iError=EQERR_PARSE_NOEQUATION);
+   if(!SetSrcEquation(pEqSrc->pszSrcEquation)) return(iError=EQERR_PARSE_ALLOCFAIL);
+   if(!AllocEquation(pEqSrc->iEqnLength)) return(iError=EQERR_PARSE_ALLOCFAIL);
+   memcpy(pvoEquation, pEqSrc->pvoEquation, pEqSrc->iEqnLength * sizeof(VALOP));
+   iEqnLength    = pEqSrc->iEqnLength;
+   memcpy(m_szUnit, pEqSrc->m_szUnit, sizeof(m_szUnit));
+   m_uUnitTarget = pEqSrc->m_uUnitTarget;   // target unit state
+   m_dScleTarget = pEqSrc->m_dScleTarget;
+   m_dOffsTarget = pEqSrc->m_dOffsTarget;
+   _ResetProgramState();
+   iErrorLocation = 0;
+   return(iError=EQERR_NONE);
+}
+
+//===Reset================================================
+// Forget everything derived from the previous program, i.e.
+// the answer dimension and the batch analysis, whenever a
+// new program is parsed, copied or loaded. Keeps the target
+// unit string, if there is one.
+void CEquation::_ResetProgramState(void) {
+   m_uUnitAns.u       = 0;                  // dimensionless
+   m_tfUnitAnsDerived = FALSE;
+   m_tfUnitStale      = FALSE;
+   if(m_dScleTarget == 0.00) m_szUnit[0] = '\0';
+   m_tfAnalyzed       = FALSE;              // see _AnalyzeProgram()
+   if(m_hNative) FreeNative();              // compiled for the old program
+   if(m_pProfile) { free(m_pProfile); m_pProfile = NULL; } // counted the old program
+   if(m_pArray) _FreeArrayPlan();           // split the old program
+   m_uProfileEvals    = 0;
+}
+
+
+/*********************************************************
+*  GetMemoryUsage
+*  Bytes of the object and of the buffers it owns; those
+*  of a CEquationLibrary or CEquationPool it is attached
+*  to, and native code, are not counted. A program shared
+*  by copies is divided among them.
+*********************************************************/
+size_t CEquation::GetMemoryUsage(void) {
+   size_t uBytes = sizeof(CEquation);       // object itself
+   size_t uProg  = m_iSrcAlloc + m_iEqnAlloc * sizeof(VALOP);
+   if(m_plRefs && !m_tfAttached) uBytes += (uProg + sizeof(EQREFCOUNT)) / MAX(1, (size_t) *m_plRefs);
+   else if(!m_tfAttached) uBytes += uProg;
+   uBytes += m_iConstAlloc * (sizeof(double) + sizeof(float));
+   if(m_pProfile) uBytes += iEqnLength * sizeof(EQPROFILETOKEN);
+   return(uBytes);
+}
+
+
+/*********************************************************
+*  Bump Arena
+*  See CLCEqtn.h. Allocations are rounded up to
+*  EQARENA_ALIGN; the data of a block follows its header.
+*********************************************************/
+#define EQARENA_ROUND(n) (((n) + EQARENA_ALIGN-1) & ~((size_t) EQARENA_ALIGN-1))
+#define EQARENA_HEADER   EQARENA_ROUND(sizeof(EQARENABLOCK))
+#define EQARENA_DATA(b)  ((char*) (b) + EQARENA_HEADER)
+
+//===Management===========================================
+CEqArena::CEqArena(void) {
+   m_pBlock    = NULL;                      // nothing allocated
+   m_pcLast    = NULL;
+   m_lenTotal  = 0;
+   m_iNumAlloc = 0;
+}
+
+CEqArena::~CEqArena() {
+   Free();
+}
+
+//---New block----------------------------------
+// At least twice the current block, so that a growing
+// arena needs few blocks, but no more than EQARENA_MAXBLOCK
+// unless asked for, to bound the unused end of the last.
+BOOL CEqArena::_NewBlock(size_t len) {
+   EQARENABLOCK *pBlock;                    // new block
+   len = MAX(len, (size_t) EQARENA_BLOCK);
+   if(m_pBlock) len = MAX(len, MIN(2 * m_pBlock->len, (size_t) EQARENA_MAXBLOCK));
+   pBlock = (EQARENABLOCK*) malloc(EQARENA_HEADER + len);
+   if(pBlock == NULL) return(FALSE);
+   pBlock->pPrev = m_pBlock;
+   pBlock->len   = len;
+   pBlock->used  = 0;
+   m_pBlock      = pBlock;
+   m_lenTotal   += len;
+   m_iNumAlloc++;
+   return(TRUE);
+}
+
+//---Reset--------------------------------------
+// More than one block means the last use outgrew the first;
+// replace them by one block that holds it all next time.
+void CEqArena::Reset(void) {
+   size_t lenTotal;                         // bytes held
+   m_pcLast = NULL;
+   if(m_pBlock == NULL) return;
+   if(m_pBlock->pPrev == NULL) { m_pBlock->used = 0; return; }
+   lenTotal = m_lenTotal;
+   Free();
+   _NewBlock(lenTotal);
+}
+
+//---Free---------------------------------------
+void CEqArena::Free(void) {
+   EQARENABLOCK *pPrev;                     // next block to free
+   while(m_pBlock) {
+      pPrev = m_pBlock->pPrev;
+      free(m_pBlock);
+      m_pBlock = pPrev;
+   }
+   m_pcLast   = NULL;
+   m_lenTotal = 0;
+}
+
+//===Allocation===========================================
+void *CEqArena::Alloc(size_t len) {
+   char *pc;                                // allocated memory
+   len = EQARENA_ROUND(MAX(len, (size_t) 1));
+   if((m_pBlock == NULL) || (m_pBlock->used + len > m_pBlock->len))
+      if(!_NewBlock(len)) return(NULL);
+   pc = EQARENA_DATA(m_pBlock) + m_pBlock->used;
+   m_pBlock->used += len;
+   return(m_pcLast = pc);
+}
+
+//---Grow---------------------------------------
+// The most recent allocation grows in place while its block
+// has room; anything else moves, leaving its old space.
+void *CEqArena::Grow(void *p, size_t lenOld, size_t lenNew) {
+   size_t used;                             // block bytes up to p
+   void  *pNew;                             // moved allocation
+   if(p == NULL) return(Alloc(lenNew));
+   if(((char*) p == m_pcLast) && (m_pBlock != NULL)) {
+      used = (size_t) ((char*) p - EQARENA_DATA(m_pBlock));
+      if(used + EQARENA_ROUND(lenNew) <= m_pBlock->len) {
+         m_pBlock->used = used + EQARENA_ROUND(MAX(lenNew, (size_t) 1));
+         return(p);
+      }
+   }
+   if(lenNew <= lenOld) return(p);
+   if((pNew = Alloc(lenNew)) == NULL) return(NULL);
+   memcpy(pNew, p, lenOld);
+   return(pNew);
 }
 
 
@@ -337,6 +703,101 @@ int CEquation::ParseDoubleEquation(double dVal, const char *pszFmt) {
 }
 
 
+/*********************************************************
+* Unit Lookup Table
+* Every input unit, alone and with each of the prefixes,
+* is entered once into an open-addressed hash table so
+* that a unit token is recognized with a single lookup
+* instead of comparing it against each unit string with
+* and without every prefix. Where a unit name could also
+* be read as prefix + unit, the plain unit wins as it al-
+* ways has (e.g. "nmi" is nautical miles).
+* The table is built on first use and never changes.
+*********************************************************/
+#define EQUNIT_NUMHASH             1024     // hash slots (power of 2)
+#define EQUNIT_MAXKEY                 8     // longest key incl. NULL
+
+typedef struct tagEQUNITKEY {
+   char     szKey[EQUNIT_MAXKEY];           // prefix and unit text, "" if unused
+   int      iLen;                           // length of key
+   int      iUnit;                          // index into CEquationSIUnit
+   int      iPrfx;                          // index into CEquationSIUnitPrefix, or -1
+   double   dScale;                         // prefix times unit scale
+   double   dOffset;                        // unit offset
+   UNITBASE uDim;                           // unit dimension
+} EQUNITKEY;
+static EQUNITKEY     _EqUnitHash[EQUNIT_NUMHASH]; // lookup table
+static volatile BOOL _tfEqUnitHashReady = FALSE;  // table has been built
+static CEqLock       _EqUnitHashLock;       // guards building the table
+
+//===Insert===============================================
+// Keeps an existing entry with the same key, so plain
+// units must be inserted before prefixed ones.
+static void _EqUnitInsert(const char *pszUnit, int iUnit, int iPrfx) {
+   char szKey[EQUNIT_MAXKEY];               // assembled key
+   int  iLen;                               // key length
+   unsigned int uSlot;                      // probe position
+
+   iLen = 0;
+   if(iPrfx >= 0) szKey[iLen++] = CEquationSIUnitPrefixStr[iPrfx];
+   if(iLen + (int) strlen(pszUnit) >= EQUNIT_MAXKEY) return; // won't happen with our tables
+   strcpy(szKey+iLen, pszUnit); iLen += (int) strlen(pszUnit);
+
+   for(uSlot=EqHashFnv1a(szKey, iLen); ; uSlot++) {
+      uSlot &= EQUNIT_NUMHASH-1;
+      if(_EqUnitHash[uSlot].iLen == 0) break; // free slot
+      if((_EqUnitHash[uSlot].iLen == iLen) && (memcmp(_EqUnitHash[uSlot].szKey, szKey, iLen) == 0)) return;
+   }
+   memcpy(_EqUnitHash[uSlot].szKey, szKey, iLen+1);
+   _EqUnitHash[uSlot].iLen    = iLen;
+   _EqUnitHash[uSlot].iUnit   = iUnit;
+   _EqUnitHash[uSlot].iPrfx   = iPrfx;
+   _EqUnitHash[uSlot].dScale  = ((iPrfx >= 0) ? CEquationSIUnitPrefix[iPrfx] : 1.00) * CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE];
+   _EqUnitHash[uSlot].dOffset = CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE+1];
+   _EqUnitHash[uSlot].uDim    = CEquationSIDim[iUnit];
+}
+
+//===Build================================================
+static void _EqUnitBuild(void) {
+   const char *psz;                         // loop pointer into unit strings
+   int iUnit, iPrfx;                        // loop counters
+
+   _EqUnitHashLock.Enter();
+   if(!_tfEqUnitHashReady) {
+      for(psz=CEquationSIUnitStr, iUnit=0; iUnit<EQSI_NUMUNIT_INPUT; psz+=strlen(psz)+1, iUnit++)
+         _EqUnitInsert(psz, iUnit, -1);     // plain units first
+      for(iPrfx=0; iPrfx<EQSI_NUMUNIT_PREFIX; iPrfx++)
+         for(psz=CEquationSIUnitStr, iUnit=0; iUnit<EQSI_NUMUNIT_INPUT; psz+=strlen(psz)+1, iUnit++)
+            _EqUnitInsert(psz, iUnit, iPrfx);
+      _tfEqUnitHashReady = TRUE;
+   }
+   _EqUnitHashLock.Leave();
+}
+
+//===Lookup===============================================
+// Returns the entry whose key is exactly the iLen charac-
+// ters at psz, or NULL if they are not a (prefixed) unit.
+static const EQUNITKEY *_EqUnitLookup(const char *psz, int iLen) {
+   unsigned int uSlot;                      // probe position
+
+   if((iLen <= 0) || (iLen >= EQUNIT_MAXKEY)) return(NULL);
+   if(!_tfEqUnitHashReady) _EqUnitBuild();
+   for(uSlot=EqHashFnv1a(psz, iLen); ; uSlot++) {
+      uSlot &= EQUNIT_NUMHASH-1;
+      if(_EqUnitHash[uSlot].iLen == 0) return(NULL); // end of probe chain
+      if((_EqUnitHash[uSlot].iLen == iLen) && (memcmp(_EqUnitHash[uSlot].szKey, psz, iLen) == 0))
+         return(&_EqUnitHash[uSlot]);
+   }
+}
+
+//===Name=================================================
+// TRUE if the iLen characters at psz are a unit; names of
+// tables must not hide them.
+BOOL EqIsUnitName(const char *psz, int iLen) {
+   return(_EqUnitLookup(psz, iLen) != NULL);
+}
+
+
 /*********************************************************
 * ParseEquationUnits                              Private
 * Parses the  token at  the current equation  position in
@@ -350,7 +811,7 @@ int CEquation::ParseDoubleEquation(double dVal, const char *pszFmt) {
 *********************************************************/
 int CEquation::_ParseEquationUnits(const char *_szEqtn, int iThisPt, int iBrktOff, TEqStack<int> &isOps, TEqStack<int> &isPos, TEqStack<VALOP> &vosParsEqn, UINT uLookFor) {
    int   iThisScan;                         // advance this scan location
-   char *pszSt;                             // offset into character arrays
+   const EQUNITKEY *pKey;                   // matched unit
    int   iTokLen;                           // token length
    int   iPrfx;                             // prefix index
    int   iUnit;                             // loop counter
@@ -358,87 +819,86 @@ int CEquation::_ParseEquationUnits(const char *_szEqtn, int iThisPt, int iBrktOf
    VALOP voThisValop;                       // value/operator to push onto stack
 
    iThisScan =  0;                          // found no unit yet
-   iPrfx     = -1;                          // no prefix yet
 
    //---Get token length------------------------
-   for(iTokLen=1; (iThisPt+iTokLen<(int)strlen(_szEqtn)) && strchr(EQ_VALIDUNIT, _szEqtn[iThisPt+iTokLen]); iTokLen++);
-   if(iTokLen<=0) return(0);                // ignore bad token
-
-   //---Scan for Unit---------------------------
-   do {                                     // search twice: once with and then without prefix
-      pszSt = (char*) CEquationSIUnitStr;      // start at beginning of string
-      for(iUnit = 0; iUnit < EQSI_NUMUNIT_INPUT; iUnit++) {
-         if( strncmp(_szEqtn+iThisPt, pszSt, MAX((int)strlen(pszSt), iTokLen)) == 0 ) {
-            //---hanging---
-            if(uLookFor == LOOKFOR_NUMBER) {
-               iThisOp = isOps.Peek(); while(iThisOp > OP_BRACKETOFFSET) iThisOp -= OP_BRACKETOFFSET;
-               switch(iThisOp) {
-               case OP_DIV:                 // hanging / --> add "1"
-                  voThisValop.uTyp = VOTYP_PREFIX; // scale factor
-                  voThisValop.dVal = 1.00;
-                  voThisValop.iPos = iThisPt;
-                  vosParsEqn.Push(voThisValop); // push scale factor
-                  iBrktOff += OP_BRACKETOFFSET; // higher precedence
-                  break;
-               case OP_MUL:                 // after "*" not needed
-                  isOps.Pop();              // remove the multiplication
-                  isPos.Pop();
-                  break;
-               default:                     // everything else is an error
-                  iError = EQERR_PARSE_NUMBEREXPECTED;
-                  return(0);
-               }
-            } else {
-               iThisOp = iBrktOff + OP_BRACKETOFFSET; // do everthing higher than me
-               _ProcessOps(&vosParsEqn, &isOps, &isPos, iThisOp, iBrktOff);
-            }
-
-            //---prefix---
-            if(iPrfx>=0) {
-               if(iError != EQERR_NONE) return(0);
-               voThisValop.uTyp = VOTYP_PREFIX; // scale factor
-               voThisValop.dVal = CEquationSIUnitPrefix[iPrfx];
-               voThisValop.iPos = iThisPt;
-               vosParsEqn.Push(voThisValop); // push scale factor
-               isOps.Push(OP_MUL + iBrktOff);
-               isPos.Push(iThisPt);
-            }
-
-            //---unit---
-            iThisOp = isOps.Peek(); while(iThisOp>OP_BRACKETOFFSET) iThisOp-=OP_BRACKETOFFSET;
-            iThisOp = OP_MUL + iBrktOff + (iThisOp==OP_DIV)*OP_BRACKETOFFSET;
-            voThisValop.uTyp  = VOTYP_UNIT;
-            voThisValop.iUnit = iUnit;
-            voThisValop.iPos  = iThisPt;       // store const's position
-            vosParsEqn.Push(voThisValop);      // save this const*/
-            _ProcessOps(&vosParsEqn, &isOps, &isPos, iThisOp, iBrktOff);
-            iThisScan = strlen(pszSt) + ((iPrfx>=0) ? 1 : 0); // length of this scan
-            iPrfx = -9999;                     // stop searching prefixes
-            break;                             // stop looking
-         }
-         pszSt += strlen(pszSt) + 1;           // advance to next part in string
+   for(iTokLen=1; _szEqtn[iThisPt+iTokLen] && strchr(EQ_VALIDUNIT, _szEqtn[iThisPt+iTokLen]); iTokLen++);
+
+   //---Look up Unit----------------------------
+   pKey = _EqUnitLookup(_szEqtn+iThisPt, iTokLen);
+   if(pKey == NULL) return(0);              // not a unit
+   iUnit = pKey->iUnit;
+   iPrfx = pKey->iPrfx;                     // -1 if no prefix
+   if(iPrfx >= 0) iThisPt++;                // positions refer to unit after prefix
+
+   //---hanging---
+   if(uLookFor == LOOKFOR_NUMBER) {
+      iThisOp = isOps.Peek(); while(iThisOp > OP_BRACKETOFFSET) iThisOp -= OP_BRACKETOFFSET;
+      switch(iThisOp) {
+      case OP_DIV:                          // hanging / --> add "1"
+         voThisValop.uTyp = VOTYP_PREFIX;   // scale factor
+         voThisValop.dVal = 1.00;
+         voThisValop.iPos = iThisPt;
+         vosParsEqn.Push(voThisValop);      // push scale factor
+         iBrktOff += OP_BRACKETOFFSET;      // higher precedence
+         break;
+      case OP_MUL:                          // after "*" not needed
+         isOps.Pop();                       // remove the multiplication
+         isPos.Pop();
+         break;
+      default:                              // everything else is an error
+         iError = EQERR_PARSE_NUMBEREXPECTED;
+         return(0);
       }
-      if(iPrfx <= -9999) break;
+   } else {
+      iThisOp = iBrktOff + OP_BRACKETOFFSET; // do everthing higher than me
+      _ProcessOps(&vosParsEqn, &isOps, &isPos, iThisOp, iBrktOff);
+   }
 
-      //---Scan for prefix-------------------------
-      for(iPrfx=0; iPrfx<EQSI_NUMUNIT_PREFIX; iPrfx++)
-         if(CEquationSIUnitPrefixStr[iPrfx] == _szEqtn[iThisPt]) break;
-      if(iPrfx >= EQSI_NUMUNIT_PREFIX) break; // skip if not found
-      iThisPt++;                            // start back up one
-      iTokLen--;                            // string is one char longer
-   } while(1);
+   //---prefix---
+   if(iPrfx>=0) {
+      if(iError != EQERR_NONE) return(0);
+      voThisValop.uTyp = VOTYP_PREFIX;      // scale factor
+      voThisValop.dVal = CEquationSIUnitPrefix[iPrfx];
+      voThisValop.iPos = iThisPt;
+      vosParsEqn.Push(voThisValop);         // push scale factor
+      isOps.Push(OP_MUL + iBrktOff);
+      isPos.Push(iThisPt);
+   }
+
+   //---unit---
+   iThisOp = isOps.Peek(); while(iThisOp>OP_BRACKETOFFSET) iThisOp-=OP_BRACKETOFFSET;
+   iThisOp = OP_MUL + iBrktOff + (iThisOp==OP_DIV)*OP_BRACKETOFFSET;
+   voThisValop.uTyp  = VOTYP_UNIT;
+   voThisValop.iUnit = iUnit;
+   voThisValop.iPos  = iThisPt;             // store const's position
+   vosParsEqn.Push(voThisValop);            // save this const*/
+   _ProcessOps(&vosParsEqn, &isOps, &isPos, iThisOp, iBrktOff);
+   iThisScan = iTokLen;                     // length of this scan
    return(iThisScan);
 }
 
 /*********************************************************
 * Parse equation
+* pCtx holds the scratch memory between calls; if NULL,
+* a context is made for this call only.
 * Return value is an error code
 *********************************************************/
+int CEquation::ParseEquation(const char *szEqn, const char *pszVars, CEqParseContext *pCtx) {
+   CEqParseContext Ctx;                     // scratch for this call only
+   if(pCtx == NULL) pCtx = &Ctx;
+   pCtx->m_Arena.Reset();                   // previous parse's stacks
+   return(_ParseEquation(szEqn, pszVars, &pCtx->m_Arena));
+}
+
+//===Implementation=======================================
+// The stacks start large enough for nearly any equation of
+// this length, so that they need not grow in the arena.
 #pragma warn -csu                           // ignore warnings of comparisons between signed iThisPt and unsigned strlen(.)
-int CEquation::ParseEquation(const char *_szEqtn, const char *pszVars) {
-   TEqStack<int>   isPos;                   // stack of operator positions
-   TEqStack<int>   isOps;                   // stack of pending operations
-   TEqStack<VALOP> vosParsEqn;              // RPN stack of parsed equation
+int CEquation::_ParseEquation(const char *_szEqtn, const char *pszVars, CEqArena *pArena) {
+   const int iSrcLen = (int) strlen(_szEqtn); // length of source
+   TEqStack<int>   isPos(pArena, iSrcLen+1); // stack of operator positions
+   TEqStack<int>   isOps(pArena, iSrcLen+1); // stack of pending operations
+   TEqStack<VALOP> vosParsEqn(pArena, 2*iSrcLen+1); // RPN stack of parsed equation
    UINT   uLookFor;                         // parse status, next token
    int    iThisPt;                          // index into source string
    int    iThisScan;                        // advance in this scan
@@ -454,21 +914,23 @@ int CEquation::ParseEquation(const char *_szEqtn, const char *pszVars) {
    char   cChar;                            // char buffer for binary op
    int    iBrktOff;                         // bracket offset
    VALOP  voThisValop;                      // value/operator for stack
+   const EQINTERPTABLE *pTable;             // interp1(..) table
 
    //===Parse Equation====================================
    memset(&m_uUnitTarget, 0x00, sizeof(m_uUnitTarget));
    memset(&m_szUnit     , 0x00, sizeof(m_szUnit));
    m_dScleTarget = 0.00;                    // target scaling (used as flag!)
    m_dOffsTarget = 0.00;                    // target offset
+   _ResetProgramState();                    // no answer yet
 
    iThisPt  = 0;                            // scan from start of buffer
    iBrktOff = 0;                            // no bracket offset
    iError   = EQERR_NONE;                   // no error
    uLookFor = LOOKFOR_NUMBER;               // start by looking for a number
 
-   while((iThisPt < strlen(_szEqtn)) && (iError==EQERR_NONE)) {
+   while((iThisPt < iSrcLen) && (iError==EQERR_NONE)) {
       while(_szEqtn[iThisPt] == ' ') iThisPt++; // skip blank chars
-      if(iThisPt >= strlen(_szEqtn)) break; // end of equation reached
+      if(iThisPt >= iSrcLen) break;         // end of equation reached
       if(strchr(EQ_ILLEGALCHAR, _szEqtn[iThisPt]) != NULL) {
          iError = EQERR_PARSE_ILLEGALCHAR;
          break;
@@ -484,7 +946,7 @@ int CEquation::ParseEquation(const char *_szEqtn, const char *pszVars) {
          if(strchr(EQ_VALIDCHAR, _szEqtn[iThisPt]) != NULL) {
             //---tokenize---
             iTokLen = 1;
-            while((iThisPt+iTokLen < strlen(_szEqtn))
+            while((iThisPt+iTokLen < iSrcLen)
                   && (strchr(EQ_VALIDSYMB, _szEqtn[iThisPt+iTokLen]) != NULL)) {
                iTokLen++;
             }
@@ -533,6 +995,17 @@ int CEquation::ParseEquation(const char *_szEqtn, const char *pszVars) {
             }
             if(iCnst < EQSI_NUMCONST) break; // break out if already found constant
 
+            //---table---
+            // Name of an interp1(..) table stands for its handle
+            if((pTable = EqFindTableName(_szEqtn+iThisPt, iTokLen)) != NULL) {
+               voThisValop.uTyp = VOTYP_VAL;
+               voThisValop.dVal = (double) pTable->uHandle;
+               voThisValop.iPos = iThisPt;
+               vosParsEqn.Push(voThisValop);
+               iThisScan = iTokLen;
+               uLookFor = LOOKFOR_BINARYOP;
+               break;
+            }
 
             //---unary---
             // Scan for unary operators using CEquationUnaryOpStr
@@ -563,6 +1036,16 @@ int CEquation::ParseEquation(const char *_szEqtn, const char *pszVars) {
             }
             if(iNArgOp < NUM_NARGOP) break; // break out if found n-arg op
 
+            //---user function or callback---
+            // Parsed as an n-arg op; see _ResolveFunctions()
+            if((EqFindFunction(_szEqtn+iThisPt, iTokLen) != NULL) || (EqFindCallback(_szEqtn+iThisPt, iTokLen) != NULL)) {
+               isPos.Push(iThisPt);         // name is found again from here
+               isOps.Push(OP_NARG + OP_NARG_FUNCTION + iBrktOff);
+               iThisScan = iTokLen;         // length of this token
+               uLookFor = LOOKFOR_BRACKET;  // look for opening bracket
+               break;
+            }
+
             //---hanging unit---
             iThisScan = _ParseEquationUnits(_szEqtn, iThisPt, iBrktOff, isOps, isPos, vosParsEqn, uLookFor);
             if(iThisScan > 0) { uLookFor = LOOKFOR_BINARYOP; break; }
@@ -742,7 +1225,7 @@ int CEquation::ParseEquation(const char *_szEqtn, const char *pszVars) {
                iError = _StringToUnit(_szEqtn+iThisPt, m_szUnit, sizeof(m_szUnit),
                   &m_uUnitTarget, &m_dScleTarget, &m_dOffsTarget);
                if(iError != EQERR_NONE) iThisPt += iErrorLocation; // shift error into string
-               else iThisPt = strlen(_szEqtn); // this should be last on line
+               else iThisPt = iSrcLen;      // this should be last on line
                iThisScan = 1;
             } else {
                iError = EQERR_PARSE_BINARYOPEXPECTED;
@@ -808,6 +1291,8 @@ int CEquation::ParseEquation(const char *_szEqtn, const char *pszVars) {
       while((voThisValop.uTyp == VOTYP_OP) && (voThisValop.uOp == OP_PSH)) voThisValop = vosParsEqn.Pop();
       pvoEquation[iThisPt] = voThisValop;
    }
+   if((iError = _ResolveFunctions()) != EQERR_NONE) { iEqnLength = 0; return(iError); }
+   _AnalyzeProgram(pArena);                 // static unit check for batch evaluation
    return(iError=EQERR_NONE);
 }
 
@@ -822,18 +1307,15 @@ int CEquation::_StringToUnit(const char *_szEqtnOffset, char *pszUnitOut, int iL
    double   dPwrCur;                        // current scaling power
    double   dSclCur;                        // current scale factor
    char    *pszEqtn;                        // pointer into equation
-   char    *psz;                            // loop pointer into unit
+   const EQUNITKEY *pKey;                   // matched unit
    double   dVal;                           // scanned value
-   int      iUnit;                          // unit loop counter
-   int      iBase;                          // base unit loop counter
+   int      iUnit;                          // matched unit index
    int      iSign;                          // sign, top or bottom
-   int      iPrfx;                          // flag that unit is found
    int      iTokLen;                        // token length
 
    //===Preliminaries=====================================
    memset(szUnitOut, 0x00, sizeof(szUnitOut)); // clear buffer
-   for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++)
-      uUnitCur.d[iBase] = uUnit.d[iBase] = 0.00; // clear unit arrays
+   uUnitCur.u = uUnit.u = 0;                // clear units
    iError   = EQERR_NONE;                   // default, no error
    iErrorLocation = 0;                      // just in case this becomes important
    dScale   = 1.00;                         // no scaling
@@ -852,10 +1334,11 @@ int CEquation::_StringToUnit(const char *_szEqtnOffset, char *pszUnitOut, int iL
    do {
       //---Apply current------------------------
       if(iUnit>=0) {
-         for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) {
-            uUnit.d[iBase] += iSign * dPwrCur * uUnitCur.d[iBase]; // apply current unit
-            uUnitCur.d[iBase] = CEquationSIUnit[iUnit][iBase]; // new base unit scaling
+         if( (EqDimPow(uUnitCur, iSign * dPwrCur, &uUnitCur) != EQERR_NONE)
+            || (EqDimMul(uUnit, uUnitCur, &uUnit) != EQERR_NONE) ) { // apply current unit
+            iError = EQERR_PARSE_UNITINCOMPATIBLE; break;
          }
+         uUnitCur = CEquationSIDim[iUnit];  // new base unit scaling
          if(iSign>0) dScale  *= pow(dSclCur, dPwrCur); else dScale  /= pow(dSclCur, dPwrCur);
          dSclCur = dPwrCur = 1.00;
       }
@@ -875,47 +1358,25 @@ int CEquation::_StringToUnit(const char *_szEqtnOffset, char *pszUnitOut, int iL
       }
 
       //---Unit---------------------------------
-      iPrfx = -1;                           // haven't searched for prefix yet
       iTokLen=0; while(pszEqtn[iTokLen] && strchr(EQ_VALIDUNIT, pszEqtn[iTokLen])) iTokLen++;
+      pKey = _EqUnitLookup(pszEqtn, iTokLen); // unit, with or without prefix
+      if(pKey == NULL) { iError = EQERR_PARSE_UNITEXPECTED; break; }
+      iUnit = pKey->iUnit;
+
+      //---Scale and Offset---
+      if( ((CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE] != 1.00) && (dOffset != 0.00)) // don't allow offsets on pre-scaled
+         || ((pKey->dOffset != 0.00) && (dScale != 1.00)) // don't combine scales and offsets
+         || ((pKey->dOffset != 0.00) && (iSign < 0)) // don't allow offsets in denominator
+         ) {
+         iError = EQERR_PARSE_UNITINCOMPATIBLE; break;
+      }
+      uUnitCur = pKey->uDim;                // new base unit scaling
+      dSclCur *= pKey->dScale;              // prefix and unit scale
+      dOffset += pKey->dOffset;
 
-      do {
-         for(psz=(char*)CEquationSIUnitStr, iUnit=0; iUnit<EQSI_NUMUNIT_INPUT; iUnit++, psz+=strlen(psz)+1) {
-            if(strncmp(pszEqtn, psz, MAX(iTokLen, strlen(psz))) == 0) {
-               //---Scale and Offset---
-               if( ((CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE] != 1.00) && (dOffset != 0.00)) // don't allow offsets on pre-scaled
-                  || ((CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE+1] != 0.00) && (dScale != 1.00)) // don't combine scales and offsets
-                  || ((CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE+1] != 0.00) && (iSign < 0)) // don't allow offsets in denominator
-                  ) {
-                  iError = EQERR_PARSE_UNITINCOMPATIBLE; break;
-               }
-               for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) {
-                  uUnitCur.d[iBase] = CEquationSIUnit[iUnit][iBase]; // new base unit scaling
-               }
-               dSclCur *= CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE];
-               dOffset += CEquationSIUnit[iUnit][EQSI_NUMUNIT_BASE+1];
-
-               //---Format---
-               sprintf(szUnitOut+strlen(szUnitOut), "%s", psz); // print this unit to output
-               pszEqtn += strlen(psz);
-               iPrfx = -999;                // indicate unit was found
-               break;
-            }//if(matched)
-         }//for(unit)
-         if((iPrfx <= -999) || (iError!=EQERR_NONE)) break; // continue out of loop once unit found
-         if((iPrfx >= 0) || (iTokLen <= 1)) { iError = EQERR_PARSE_UNITEXPECTED; break; }
-
-         //---Prefix----------------------------
-         for(iPrfx=0; iPrfx<EQSI_NUMUNIT_PREFIX; iPrfx++) {
-            if(*pszEqtn == CEquationSIUnitPrefixStr[iPrfx]) {
-               dSclCur *= CEquationSIUnitPrefix[iPrfx];
-               sprintf(szUnitOut+strlen(szUnitOut), "%c", CEquationSIUnitPrefixStr[iPrfx]);
-               pszEqtn++; iTokLen--;
-               break;
-            }
-         }
-         if(iPrfx >= EQSI_NUMUNIT_PREFIX) { iError = EQERR_PARSE_UNITEXPECTED; break; }
-         while(*pszEqtn == ' ') pszEqtn++;  // skip whitespace
-      } while(iError == EQERR_NONE); // try again, with prefix second time
+      //---Format---
+      strcat(szUnitOut, pKey->szKey);       // print this unit to output
+      pszEqtn += iTokLen;
 
       //---Power--------------------------------
       while(*pszEqtn == ' ') pszEqtn++;     // skip whitespace
@@ -934,7 +1395,7 @@ int CEquation::_StringToUnit(const char *_szEqtnOffset, char *pszUnitOut, int iL
    //===Finalize==========================================
    if(iError != EQERR_NONE) iErrorLocation = pszEqtn - _szEqtnOffset; // distance into string
    if(pszUnitOut) strncpy(pszUnitOut, szUnitOut, iLen);
-   if(pUnit) for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) pUnit->d[iBase] = uUnit.d[iBase];
+   if(pUnit) *pUnit = uUnit;
    if(pdScale ) *pdScale  = dScale;
    if(pdOffset) *pdOffset = dOffset;
 
@@ -1037,21 +1498,121 @@ int CEquation::_ProcessOps(TEqStack<VALOP> *pvosParsEqn, TEqStack<int> *pisOps,
 }
 
 
+/*********************************************************
+* Packed Dimensions
+* Unit exponents are packed into UNITBASE, see CLCEqtn.h.
+* With integer exponents (denominator 1), multiplication
+* and division are carried out on all seven lanes at once
+* by adding or subtracting the packed bytes; only rational
+* exponents need to be unpacked. All functions return
+* EQERR_EVAL_UNITRANGE if the result doesn't fit.
+*********************************************************/
+static long _EqGcd(long a, long b) {
+   long t;                                  // remainder
+   a = ABS(a); b = ABS(b);
+   while(b != 0) { t = a % b; a = b; b = t; }
+   return(a);
+}
+
+//===Unpack / Pack========================================
+static void _EqDimUnpack(UNITBASE u1, long *plNum, long *plDen) {
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) plNum[iBase] = EQDIM_NUM(u1, iBase);
+   *plDen = EQDIM_DEN(u1);
+}
+
+static int _EqDimPack(long *plNum, long lDen, UNITBASE *pu) {
+   long lGcd;                               // common factor
+   int  iBase;                              // base unit loop counter
+   for(lGcd=lDen, iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) lGcd = _EqGcd(lGcd, plNum[iBase]);
+   if(lGcd > 1) {                           // reduce to keep representation unique
+      for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) plNum[iBase] /= lGcd;
+      lDen /= lGcd;
+   }
+   if((lDen < 1) || (lDen > 256)) return(EQERR_EVAL_UNITRANGE);
+   pu->u = (unsigned long long) (lDen-1) << EQDIM_DENSHIFT;
+   for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) {
+      if((plNum[iBase] < -128) || (plNum[iBase] > 127)) return(EQERR_EVAL_UNITRANGE);
+      pu->u |= EQDIM_LANE(plNum[iBase], iBase);
+   }
+   return(EQERR_NONE);
+}
+
+//===Multiply=============================================
+int EqDimMul(UNITBASE u1, UNITBASE u2, UNITBASE *pu) {
+   unsigned long long uSum;                 // packed lane-wise sum
+   long lNum1[EQSI_NUMUNIT_BASE], lDen1;    // unpacked first argument
+   long lNum2[EQSI_NUMUNIT_BASE], lDen2;    // unpacked second argument
+
+   if(((u1.u | u2.u) >> EQDIM_DENSHIFT) == 0) { // both integer
+      uSum = ((u1.u & EQDIM_LOBITS) + (u2.u & EQDIM_LOBITS)) ^ ((u1.u ^ u2.u) & EQDIM_HIBITS);
+      if((~(u1.u ^ u2.u) & (u1.u ^ uSum)) & EQDIM_HIBITS) return(EQERR_EVAL_UNITRANGE); // signed overflow
+      pu->u = uSum;
+      return(EQERR_NONE);
+   }
+   _EqDimUnpack(u1, lNum1, &lDen1);
+   _EqDimUnpack(u2, lNum2, &lDen2);
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) lNum1[iBase] = lNum1[iBase]*lDen2 + lNum2[iBase]*lDen1;
+   return(_EqDimPack(lNum1, lDen1*lDen2, pu));
+}
+
+//===Divide===============================================
+int EqDimDiv(UNITBASE u1, UNITBASE u2, UNITBASE *pu) {
+   unsigned long long uDif;                 // packed lane-wise difference
+   long lNum1[EQSI_NUMUNIT_BASE], lDen1;    // unpacked first argument
+   long lNum2[EQSI_NUMUNIT_BASE], lDen2;    // unpacked second argument
+
+   if(((u1.u | u2.u) >> EQDIM_DENSHIFT) == 0) { // both integer
+      uDif = ((u1.u | EQDIM_HIBITS) - (u2.u & EQDIM_LOBITS)) ^ ((u1.u ^ ~u2.u) & EQDIM_HIBITS);
+      if(((u1.u ^ u2.u) & (u1.u ^ uDif)) & EQDIM_HIBITS) return(EQERR_EVAL_UNITRANGE); // signed overflow
+      pu->u = uDif;
+      return(EQERR_NONE);
+   }
+   _EqDimUnpack(u1, lNum1, &lDen1);
+   _EqDimUnpack(u2, lNum2, &lDen2);
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) lNum1[iBase] = lNum1[iBase]*lDen2 - lNum2[iBase]*lDen1;
+   return(_EqDimPack(lNum1, lDen1*lDen2, pu));
+}
+
+//===Power================================================
+// The power must be a rational p/q with q <= EQDIM_MAXDEN,
+// e.g. 2, 0.5, or 1/3 to within rounding.
+int EqDimPow(UNITBASE u1, double dPwr, UNITBASE *pu) {
+   long   lNum[EQSI_NUMUNIT_BASE], lDen;    // unpacked argument
+   long   lP, lQ;                           // power as fraction p/q
+   double dP;                               // scaled power
+
+   if((u1.u == 0) || (dPwr == 1.00)) { *pu = u1; return(EQERR_NONE); } // nothing to scale
+   if(fabs(dPwr) > 32767.00) return(EQERR_EVAL_UNITRANGE);
+   for(lQ=1; lQ<=EQDIM_MAXDEN; lQ++) {      // find smallest denominator
+      dP = dPwr * lQ;
+      lP = (long) floor(dP + 0.50);
+      if(fabs(dP - lP) < 1e-9 * lQ) break;
+   }
+   if(lQ > EQDIM_MAXDEN) return(EQERR_EVAL_UNITRANGE);
+   _EqDimUnpack(u1, lNum, &lDen);
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) lNum[iBase] *= lP;
+   return(_EqDimPack(lNum, lDen*lQ, pu));
+}
+
+//===Unpack to doubles====================================
+void EqDimToDouble(UNITBASE u1, double *pdExp) {
+   for(int iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++)
+      pdExp[iBase] = (double) EQDIM_NUM(u1, iBase) / (double) EQDIM_DEN(u1);
+}
+
+
 /*********************************************************
 *  DoEquation
 *  Perform calculation, using the variables given
 *  The answer is placed in dpAns, the return value is an
 *  error code
 *********************************************************/
-#define M_PI_180  0.01745329251994
-#define M_180_PI 57.29577951308232
 int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL tfAllowDerived) {
    TEqStack<double> dsVals;                 // RPN stack of values
    TEqStack<UNITBASE> usUnits;              // RPN stack of unit factors
    VALOP    voThisValop;                    // token being processed
    int      iThisPt;                        // pointer into equation
    int      iArg;                           // multi-arg loop counter
-   int      iBase;                          // units checking loop counter
    UNITBASE uUnitZero;                      // zeros unit block for convenience
    UNITBASE uUnit;                          // result unit
    UNITBASE uUnit1;                         // argument 1 unit
@@ -1060,13 +1621,30 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
    double   dArg1;                          // argument 1 value
    double   dArg2;                          // argument 2 value
    char    *psz;                            // unit loop pointer
+   const EQINTERPTABLE *pTable;             // interp1(..) table
+   const EQCALLBACK *pCall;                 // native function
+   double   dArgs[EQCALLBACK_MAXARG];       // its arguments..
+   UNITBASE uArgs[EQCALLBACK_MAXARG];       //..and their units
+#ifdef EQPROFILE
+   EQPROFILETOKEN *pProf;                   // counters, NULL unless profiling
+   unsigned long long uTick = 0;            // ticks at start of token
+   int      iProfPt = 0;                    // token being timed
+#endif//EQPROFILE
 
    if(iEqnLength <= 0) return(iError=EQERR_EVAL_NOEQUATION);
-   memset(&uUnitZero, 0x00, sizeof(UNITBASE));
+   if(m_pfnNative && !m_tfProfile && ((dVar != NULL) || (m_iBatchNumVar == 0))) // see CompileNative(..)
+      return(_DoEquationNative(dVar, pdAns, tfAllowDerived));
+   uUnitZero.u = 0;                         // dimensionless
+#ifdef EQPROFILE
+   if((pProf = _ProfileCounters()) != NULL) m_uProfileEvals++;
+#endif//EQPROFILE
 
    iError = EQERR_NONE;                     // no error
    for(iThisPt=0; iThisPt<iEqnLength && iError==EQERR_NONE; iThisPt++) {
       voThisValop = pvoEquation[iThisPt];
+#ifdef EQPROFILE
+      if(pProf) { iProfPt = iThisPt; uTick = EQPROFILE_TICKS(); }
+#endif//EQPROFILE
 
       //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
       // Simple Cases
@@ -1087,14 +1665,13 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
          }
          dsVals.Push( dVar[voThisValop.iRef] ); // save variable value
 ///TODO: Variables with units!
-         usUnits.Push(uUnitZero);
+         usUnits.Push((m_puRefUnit) ? m_puRefUnit[voThisValop.iRef] : uUnitZero); // see DoEquationArray(..)
          break;
 
       //===Units==========================================
       case VOTYP_UNIT:
          uUnit = usUnits.Pop();             // get last unit
-         for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++)
-            uUnit.d[iBase] += CEquationSIUnit[voThisValop.iUnit][iBase];
+         iError = EqDimMul(uUnit, CEquationSIDim[voThisValop.iUnit], &uUnit);
          usUnits.Push(uUnit);               // push multiplied unit
          dVal = dsVals.Pop();
          dVal =      CEquationSIUnit[voThisValop.iUnit][EQSI_NUMUNIT_BASE+1] // offset
@@ -1102,6 +1679,18 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
          dsVals.Push(dVal);
          break;
 
+      //===Callback=======================================
+      // Straight through the pointer, see AddCallback(..)
+      case VOTYP_CALL:
+         pCall = voThisValop.pCall;
+         if(dsVals.Top() < pCall->iArgc) { iError = EQERR_EVAL_STACKUNDERFLOW; break; }
+         for(iArg=pCall->iArgc-1; iArg>=0; iArg--) { dArgs[iArg] = dsVals.Pop(); uArgs[iArg] = usUnits.Pop(); }
+         iError = EqCallbackDim(pCall, uArgs, &uUnit);
+         dVal   = 0.00;
+         if(iError == EQERR_NONE) dVal = pCall->pfn(dArgs, pCall->pUser, &iError);
+         dsVals.Push(dVal); usUnits.Push(uUnit);
+         break;
+
       //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
       // Operators
       //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -1140,8 +1729,7 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
             case OP_LTE:  case OP_GTE:
             case OP_LT:   case OP_GT :
             case OP_NEQ:  case OP_EQ :
-               for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (uUnit1.d[iBase]==uUnit2.d[iBase]); iBase++);
-               if(iBase < EQSI_NUMUNIT_BASE) {
+               if(uUnit1.u != uUnit2.u) {
                   iError = EQERR_EVAL_UNITMISMATCH; // mismatch triggers error
                }
                else switch(voThisValop.uOp) {
@@ -1156,13 +1744,12 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
                      break;
                }
                break;
-            case OP_MUL: for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) uUnit.d[iBase] = uUnit1.d[iBase] + uUnit2.d[iBase]; break;
-            case OP_DIV: for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) uUnit.d[iBase] = uUnit1.d[iBase] - uUnit2.d[iBase]; break;
+            case OP_MUL: if(EqDimMul(uUnit1, uUnit2, &uUnit) != EQERR_NONE) iError = EQERR_EVAL_UNITRANGE; break;
+            case OP_DIV: if(EqDimDiv(uUnit1, uUnit2, &uUnit) != EQERR_NONE) iError = EQERR_EVAL_UNITRANGE; break;
 
             case OP_POW:
-               for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (uUnit2.d[iBase]==0.00); iBase++)
-                  uUnit.d[iBase] = uUnit1.d[iBase] * dArg2; // argument factors up as power
-               if(iBase < EQSI_NUMUNIT_BASE) iError = EQERR_EVAL_UNITNOTDIMLESS;
+               if(uUnit2.u != 0) iError = EQERR_EVAL_UNITNOTDIMLESS;
+               else if(EqDimPow(uUnit1, dArg2, &uUnit) != EQERR_NONE) iError = EQERR_EVAL_UNITRANGE; // argument factors up as power
                break;
             }
 
@@ -1213,7 +1800,7 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
                break;
 
             //---power---
-            case OP_SQRT: for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) uUnit.d[iBase] *= 0.50; break;
+            case OP_SQRT: if(EqDimPow(uUnit, 0.50, &uUnit) != EQERR_NONE) iError = EQERR_EVAL_UNITRANGE; break;
 
             //---dimless---
             case OP_EXP:
@@ -1236,8 +1823,7 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
             case OP_ATAND:
             case OP_NOT:
             case OP_SIGN:
-               for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (uUnit.d[iBase]==0.00); iBase++);
-               if(iBase < EQSI_NUMUNIT_BASE) iError = EQERR_EVAL_UNITNOTDIMLESS;
+               if(uUnit.u != 0) iError = EQERR_EVAL_UNITNOTDIMLESS;
                break;
             }
 
@@ -1288,8 +1874,7 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
                      break;
                   }
 
-                  for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (uUnit1.d[iBase]==uUnit2.d[iBase]); iBase++); // units must match
-                  if(iBase<EQSI_NUMUNIT_BASE) iError = EQERR_EVAL_UNITMISMATCH; else uUnit = uUnit2; // answer has same units
+                  if(uUnit1.u != uUnit2.u) iError = EQERR_EVAL_UNITMISMATCH; else uUnit = uUnit2; // units must match, answer has same units
 
                   dVal = dArg1 - dArg2*floor(dArg1/dArg2);
                   if((voThisValop.uOp-OP_NARG) == OP_NARG_REM) {
@@ -1299,8 +1884,7 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
 
                case OP_NARG_ATAN2:
                case OP_NARG_ATAN2D:
-                  for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (uUnit1.d[iBase]==uUnit2.d[iBase]); iBase++); // units must match
-                  if(iBase<EQSI_NUMUNIT_BASE) iError = EQERR_EVAL_UNITMISMATCH; else uUnit = uUnitZero; // answer is dimensionless
+                  if(uUnit1.u != uUnit2.u) iError = EQERR_EVAL_UNITMISMATCH; else uUnit = uUnitZero; // units must match, answer is dimensionless
 
                   dVal = (dArg2==0.00) ?
                      ((dArg1==0.00) ? 0.00 : ((dArg1>0.00) ? M_PI/2.00 : -M_PI/2.00))
@@ -1308,6 +1892,19 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
                   if((voThisValop.uOp-OP_NARG)==OP_NARG_ATAN2D) dVal *= M_180_PI;
                   break;
 
+               case OP_NARG_DOT:            // of one-element arrays
+                  if(EqDimMul(uUnit1, uUnit2, &uUnit) != EQERR_NONE) iError = EQERR_EVAL_UNITRANGE;
+                  dVal = dArg1 * dArg2;
+                  break;
+
+               case OP_NARG_INTERP1:        // table handle, x
+                  if((pTable = EqFindTable(dArg1)) == NULL) { iError = EQERR_EVAL_NOTABLE; break; }
+                  if(uUnit1.u != 0) iError = EQERR_EVAL_UNITNOTDIMLESS;
+                  else if(uUnit2.u != pTable->uUnitX.u) iError = EQERR_EVAL_UNITMISMATCH;
+                  else uUnit = pTable->uUnitY;
+                  if(iError == EQERR_NONE) dVal = EqInterp1(pTable, dArg2, &iError);
+                  break;
+
                default: iError = EQERR_EVAL_UNKNOWNNARGOP;
                }
             //---Variable-Argument--------------
@@ -1322,8 +1919,7 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
                   for(iArg=1; iArg<pvoEquation[iThisPt].iArgc; iArg++) {
                      dArg1 = dsVals.Pop(); uUnit1 = usUnits.Pop();
 
-                     for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (uUnit1.d[iBase]==uUnit.d[iBase]); iBase++);
-                     if(iBase<EQSI_NUMUNIT_BASE) iError = EQERR_EVAL_UNITMISMATCH; // units must match
+                     if(uUnit1.u != uUnit.u) iError = EQERR_EVAL_UNITMISMATCH; // units must match
 
                      switch(voThisValop.uOp - OP_NARG) {
                      case OP_NARG_MAX: if(dArg1 > dVal) dVal = dArg1; break;
@@ -1341,11 +1937,17 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
                   dArg2 = dsVals.Pop(); uUnit2 = usUnits.Pop(); // value-if-false
                   dArg1 = dsVals.Pop(); uUnit1 = usUnits.Pop(); // value-if-true
                   dVal  = dsVals.Pop(); uUnit  = usUnits.Pop(); // conditional test
-                  for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (uUnit.d[iBase]==0.00); iBase++); // units must match
-                  if(iBase<EQSI_NUMUNIT_BASE) iError = EQERR_EVAL_UNITNOTDIMLESS;
+                  if(uUnit.u != 0) iError = EQERR_EVAL_UNITNOTDIMLESS; // condition must be dimensionless
                   uUnit = (dVal==0.00) ? uUnit2 : uUnit1;
                   dVal  = (dVal==0.00) ? dArg2  : dArg1;
                   break;
+               case OP_NARG_SUM:            // a scalar is an array of one element;
+               case OP_NARG_MEAN:           // see DoEquationArray(..) for arrays
+               case OP_NARG_RMS:
+               case OP_NARG_NORM:
+                  dVal = dsVals.Pop(); uUnit = usUnits.Pop();
+                  if(((voThisValop.uOp-OP_NARG)==OP_NARG_RMS) || ((voThisValop.uOp-OP_NARG)==OP_NARG_NORM)) dVal = fabs(dVal);
+                  break;
                default: iError = EQERR_EVAL_UNKNOWNNARGOP;
                }
             }
@@ -1358,6 +1960,13 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
          iError = EQERR_EVAL_UNKNOWNVALOP;
          break;
       }//switch
+#ifdef EQPROFILE
+      if(pProf) {
+         pProf[iProfPt].uCount++;
+         pProf[iProfPt].uTimed++;
+         pProf[iProfPt].uTicks += EQPROFILE_TICKS() - uTick;
+      }
+#endif//EQPROFILE
    }//for
 
    //===Error handling====================================
@@ -1374,10 +1983,7 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
    //---Unit Specified------
    if(m_dScleTarget != 0.00) {              // dScle gets set to at least 1.0 on custom
       //---dimensions check---
-      for(iBase=0; (iBase<EQSI_NUMUNIT_BASE) && (m_uUnitTarget.d[iBase]==uUnit.d[iBase]); iBase++);
-      if(iBase < EQSI_NUMUNIT_BASE) {       // dimensions check
-//printf("\nResult:"); for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) printf(" %lg ", uUnit.d[iBase]);
-//printf("\nTarget:"); for(iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) printf(" %lg ", m_uUnitTarget.d[iBase]);
+      if(m_uUnitTarget.u != uUnit.u) {      // dimensions check
          iErrorLocation = strlen(pszSrcEquation);
          return(iError = EQERR_EVAL_UNITMISMATCH);
       }
@@ -1385,8 +1991,12 @@ int CEquation::DoEquation(double dVar[], double *pdAns, BOOL tfAllowAssign, BOOL
       dVal = (dVal - m_dOffsTarget) / m_dScleTarget;
 
    //---Not spec'd-------
-   } else {
-      _AnswerUnitString(&dVal, &uUnit, tfAllowDerived);   // convert answer with units
+   // Only remember the dimension here; the unit string is formatted
+   // by _AnswerUnitStr() if and when it is asked for.
+   } else if((uUnit.u != m_uUnitAns.u) || (tfAllowDerived != m_tfUnitAnsDerived)) {
+      m_uUnitAns = uUnit;
+      m_tfUnitAnsDerived = tfAllowDerived;
+      m_tfUnitStale = TRUE;                 // m_szUnit no longer describes answer
    }
 
    if(pdAns) *pdAns = dVal;
@@ -1421,6 +2031,7 @@ int CEquation::GetLastError(char *szBuffer, size_t len) {
       (iError==EQERR_PARSE_UNITEXPECTED)     ? "Unit expected" :
       (iError==EQERR_PARSE_UNITALREADYDEF)   ? "Result unit already defined" :
       (iError==EQERR_PARSE_UNITINCOMPATIBLE) ? "Incompatible unit" :
+      (iError==EQERR_PARSE_FUNCDEF)          ? "Bad function definition" :
       (iError==EQERR_PARSE_ILLEGALCHAR)      ? "Illegal character" :
 
       (iError==EQERR_EVAL_UNKNOWNBINARYOP)   ? "Unknown binary operator" :
@@ -1434,6 +2045,9 @@ int CEquation::GetLastError(char *szBuffer, size_t len) {
       (iError==EQERR_EVAL_ASSIGNNOTALLOWED)  ? "Assignment not allowed" :
       (iError==EQERR_EVAL_UNITMISMATCH)      ? "Incompatible units" :
       (iError==EQERR_EVAL_UNITNOTDIMLESS)    ? "Dimensionless argument expected" :
+      (iError==EQERR_EVAL_UNITRANGE)         ? "Unit power out of range" :
+      (iError==EQERR_EVAL_ARRAYNOTREDUCED)   ? "Array must be reduced, e.g. by sum(..)" :
+      (iError==EQERR_EVAL_NOTABLE)           ? "No such table" :
       (iError==EQERR_EVAL_NOEQUATION)        ? "No equation to evaluate" :
 
       (iError==EQERR_MATH_DIV_ZERO)          ? "Division by zero" :
@@ -1442,6 +2056,15 @@ int CEquation::GetLastError(char *szBuffer, size_t len) {
       (iError==EQERR_MATH_LOG_ZERO)          ? "Log of zero" :
       (iError==EQERR_MATH_LOG_NEG)           ? "Log of negative number" :
       (iError==EQERR_MATH_OVERFLOW)          ? "Overflow" :
+
+      (iError==EQERR_FILE_BUFFERSIZE)        ? "Buffer too small for saved equation" :
+      (iError==EQERR_FILE_BADFORMAT)         ? "Not a saved equation" :
+      (iError==EQERR_FILE_VERSION)           ? "Saved equation has different version" :
+      (iError==EQERR_FILE_CHECKSUM)          ? "Saved equation is corrupted" :
+      (iError==EQERR_FILE_READWRITE)         ? "Could not read or write saved equation" :
+      (iError==EQERR_FILE_COMPILE)           ? "Could not compile or load native code" :
+      (iError==EQERR_FILE_NOTNATIVE)         ? "Equation cannot be compiled to native code" :
+      (iError==EQERR_FILE_CALLBACK)          ? "Equation calls a function of this process" :
       "Unknown error", len);
    return(iErrorLocation);
 }
@@ -1497,6 +2120,8 @@ void CEquation::LastErrorMessage(char *szBuffer, size_t len, const char *szSourc
    case EQERR_EVAL_STACKNOTEMPTY:
    case EQERR_EVAL_STACKUNDERFLOW:
    case EQERR_EVAL_CONTAINSVAR:
+   case EQERR_EVAL_ARRAYNOTREDUCED:
+   case EQERR_EVAL_NOTABLE:
    case EQERR_EVAL_NOEQUATION:
    case EQERR_MATH_DIV_ZERO:
    case EQERR_MATH_DOMAIN:
@@ -1599,14 +2224,65 @@ void CEquation::LastErrorMessage(char *szBuffer, size_t len, const char *szSourc
 
 
 
+/*********************************************************
+* _AnswerUnitStr
+* Returns the unit of the last answer, or the target unit
+* if one was given with #. Formatting the answer unit is
+* comparatively expensive, so DoEquation(..) only records
+* the answer dimension and the string is prepared here on
+* first request. Strings are also remembered per dimension
+* across all equations, so repeated evaluations with the
+* same result dimension never format twice.
+*********************************************************/
+#define EQUNIT_NUMMEMO               64     // remembered unit strings (power of 2)
+typedef struct tagEQUNITMEMO {
+   UNITBASE uUnit;                          // answer dimension
+   BOOL     tfAllowDerived;                 // formatted with derived units
+   BOOL     tfValid;                        // entry in use
+   char     szUnit[32];                     // formatted string
+} EQUNITMEMO;
+static EQUNITMEMO _EqUnitMemo[EQUNIT_NUMMEMO]; // direct-mapped by dimension
+static CEqLock    _EqUnitMemoLock;          // guards _EqUnitMemo
+
+const char* CEquation::_AnswerUnitStr(void) {
+   EQUNITMEMO *pMemo;                       // memo slot for this dimension
+   unsigned long long uKey;                 // hash of dimension
+
+   if(!m_tfUnitStale) return(m_szUnit);     // up to date, or target unit
+   m_tfUnitStale = FALSE;
+   if(m_uUnitAns.u == 0) { m_szUnit[0] = '\0'; return(m_szUnit); } // dimensionless
+
+   uKey  = (m_uUnitAns.u ^ (m_uUnitAns.u >> 29) ^ (unsigned long long) m_tfUnitAnsDerived) * 0x9E3779B97F4A7C15ull;
+   pMemo = &_EqUnitMemo[uKey >> 58 & (EQUNIT_NUMMEMO-1)];
+   _EqUnitMemoLock.Enter();
+   if(pMemo->tfValid && (pMemo->uUnit.u == m_uUnitAns.u) && (pMemo->tfAllowDerived == m_tfUnitAnsDerived)) {
+      memcpy(m_szUnit, pMemo->szUnit, sizeof(m_szUnit));
+      _EqUnitMemoLock.Leave();
+      return(m_szUnit);
+   }
+   _EqUnitMemoLock.Leave();
+
+   _AnswerUnitString(&m_uUnitAns, m_tfUnitAnsDerived, m_szUnit, sizeof(m_szUnit));
+
+   _EqUnitMemoLock.Enter();
+   pMemo->uUnit          = m_uUnitAns;
+   pMemo->tfAllowDerived = m_tfUnitAnsDerived;
+   pMemo->tfValid        = TRUE;
+   memcpy(pMemo->szUnit, m_szUnit, sizeof(pMemo->szUnit));
+   _EqUnitMemoLock.Leave();
+   return(m_szUnit);
+}
+
+
+
 /*********************************************************
 * AnswerUnitString                                Private
-* If pdVal is supplied, searches for prefixes that make
-* the value better and replaces the value there.
-* This APPENDS to the string already in m_szUnit to al-
-* llow target unit processing
+* Formats the dimension *puUnit into pszOut, using the
+* derived unit that best simplifies it if tfAllowDerived.
 *********************************************************/
-void CEquation::_AnswerUnitString(double *pdVal, UNITBASE *puUnit, BOOL tfAllowDerived) {
+void CEquation::_AnswerUnitString(UNITBASE *puUnit, BOOL tfAllowDerived, char *pszOut, size_t len) {
+   char   szOut[256];                       // formatted unit, before truncation
+   int    iOut;                             // length of szOut
    double ddUnit[EQSI_NUMUNIT_BASE];        // scaled powers for matched unit
    int    iUnit;                            // matching unit loop counter
    int    iMaxUnit;                         // end point for matching unit
@@ -1623,8 +2299,8 @@ void CEquation::_AnswerUnitString(double *pdVal, UNITBASE *puUnit, BOOL tfAllowD
    char  *psz;                              // pointer into units string
 
    //---Preliminaries---------------------------
+   EqDimToDouble(*puUnit, ddUnit);          // unpack from input
    for(iNum=iBase=0; iBase<EQSI_NUMUNIT_BASE; iBase++) {
-      ddUnit[iBase] = puUnit->d[iBase];     // copy from input
       if(ddUnit[iBase] != 0.00) iNum++;     // count units used
    }
 
@@ -1689,30 +2365,441 @@ void CEquation::_AnswerUnitString(double *pdVal, UNITBASE *puUnit, BOOL tfAllowD
    }
 
    //===Format Unit=======================================
+   szOut[0] = '\0'; iOut = 0;               // start with empty string
    for(k=1; k>=-1; k-=2) {                  // repeat for top and bottom lines
       //---Solidus---
-      if(k==-1) sprintf(m_szUnit+strlen(m_szUnit), "/");
+      if(k==-1) iOut += sprintf(szOut+iOut, "/");
 
       //---Matched---
       if((indxUnitMin >= 0) & (SIGN(dSclUnitMin)==k)) {
          for(psz=(char*)CEquationSIUnitStr, iUnit=0; iUnit<indxUnitMin; psz+=strlen(psz)+1, iUnit++);
-         sprintf(m_szUnit+strlen(m_szUnit), "%s", psz); // append matched unit
-         if(fabs(dSclUnitMin) != 1.00) sprintf(m_szUnit+strlen(m_szUnit), "%g", k*dSclUnitMin);
+         iOut += sprintf(szOut+iOut, "%s", psz); // append matched unit
+         if(fabs(dSclUnitMin) != 1.00) iOut += sprintf(szOut+iOut, "%g", k*dSclUnitMin);
       }
 
       //---Base---
       for(psz=(char*)CEquationSIUnitStr, iBase=0; iBase<EQSI_NUMUNIT_BASE; psz+=strlen(psz)+1, iBase++) {
          if(k*ddUnit[iBase] <= 0.00) continue; // this base unit not used
-         if((strlen(m_szUnit)>0) && (m_szUnit[strlen(m_szUnit)-1]!='/')) sprintf(m_szUnit+strlen(m_szUnit), " ");
-         sprintf(m_szUnit+strlen(m_szUnit), "%s", psz);
-         if(k*ddUnit[iBase] != 1.00) sprintf(m_szUnit+strlen(m_szUnit), "%g", k*ddUnit[iBase]);
+         if((iOut>0) && (szOut[iOut-1]!='/')) iOut += sprintf(szOut+iOut, " ");
+         iOut += sprintf(szOut+iOut, "%s", psz);
+         if(k*ddUnit[iBase] != 1.00) iOut += sprintf(szOut+iOut, "%g", k*ddUnit[iBase]);
+      }
+   }
+   if((iOut>0) && (szOut[iOut-1] == '/')) szOut[--iOut] = '\0'; // truncate unused trailing solidus
+
+   strncpy(pszOut, szOut, len-1);
+   pszOut[len-1] = '\0';
+}
+
+
+
+
+
+
+
+/*********************************************************
+* EqHashFnv1a
+* FNV-1a hash of a block of memory. Pass the result of a
+* previous call as uHash to continue hashing.
+*********************************************************/
+unsigned int EqHashFnv1a(const void *pv, size_t len, unsigned int uHash) {
+   const unsigned char *pc = (const unsigned char*) pv; // byte pointer
+   for(size_t k=0; k<len; k++) {
+      uHash ^= pc[k];
+      uHash *= 16777619u;                   // FNV prime
+   }
+   return(uHash);
+}
+
+
+/*********************************************************
+* Binary Save / Load
+* A saved equation holds the compiled RPN stack, the tar-
+* get unit state and the source string, so that it can be
+* evaluated after LoadEquation(..) without re-parsing. See
+* CLCEqtn.h for the record layout. All values are written
+* little-endian regardless of the host byte order.
+*
+* The record carries a signature of the operator and unit
+* tables: op codes and unit indices stored in the program
+* are only meaningful for the tables they were compiled
+* with. A record with a different version or signature is
+* stale; LoadEquation(..) then re-parses the stored source
+* with the supplied variable names and sets *ptfReparsed.
+* Records with a bad checksum are rejected.
+*********************************************************/
+#define EQFILE_OPSIZE                13     // bytes per saved VALOP
+
+//===Little-endian helpers================================
+static int _EqHostIsLE(void) {
+   unsigned int u = 1;
+   return(*(unsigned char*) &u == 1);
+}
+static void _EqPutU16(unsigned char *p, unsigned int u) {
+   p[0] = (unsigned char) (u      ); p[1] = (unsigned char) (u >>  8);
+}
+static void _EqPutU32(unsigned char *p, unsigned int u) {
+   p[0] = (unsigned char) (u      ); p[1] = (unsigned char) (u >>  8);
+   p[2] = (unsigned char) (u >> 16); p[3] = (unsigned char) (u >> 24);
+}
+static void _EqPutF64(unsigned char *p, double d) {
+   unsigned char b[8];                      // IEEE bits in host order
+   memcpy(b, &d, 8);
+   for(int k=0; k<8; k++) p[k] = b[_EqHostIsLE() ? k : 7-k];
+}
+static unsigned int _EqGetU16(const unsigned char *p) {
+   return( (unsigned int) p[0] | ((unsigned int) p[1] << 8) );
+}
+static unsigned int _EqGetU32(const unsigned char *p) {
+   return( (unsigned int) p[0] | ((unsigned int) p[1] << 8)
+      | ((unsigned int) p[2] << 16) | ((unsigned int) p[3] << 24) );
+}
+static double _EqGetF64(const unsigned char *p) {
+   unsigned char b[8];                      // IEEE bits in host order
+   double        d;                         // return value
+   for(int k=0; k<8; k++) b[_EqHostIsLE() ? k : 7-k] = p[k];
+   memcpy(&d, b, 8);
+   return(d);
+}
+
+//===Checksum=============================================
+// Covers the whole record except the checksum field itself
+static unsigned int _EqRecordChecksum(const unsigned char *p, size_t len) {
+   unsigned int uHash;
+   uHash = EqHashFnv1a(p, 12);
+   return(EqHashFnv1a(p+16, len-16, uHash));
+}
+
+//===Table signature======================================
+// Changes whenever the operator or unit tables change, which
+// invalidates op codes and unit indices in compiled programs
+unsigned int EqTableSignature(void) {
+   static unsigned int uSig = 0;            // computed once
+   unsigned int u;
+   if(uSig != 0) return(uSig);
+   u = EqHashFnv1a(CEquationBinaryOpStr, sizeof(CEquationBinaryOpStr));
+   u = EqHashFnv1a(CEquationUnaryOpStr,  sizeof(CEquationUnaryOpStr), u);
+   u = EqHashFnv1a(CEquationNArgOpStr,   sizeof(CEquationNArgOpStr), u);
+   u = EqHashFnv1a(CEquationNArgOpArgc,  sizeof(CEquationNArgOpArgc), u);
+   u = EqHashFnv1a(CEquationSIUnitStr,   sizeof(CEquationSIUnitStr), u);
+   u = EqHashFnv1a(CEquationSIUnitPrefixStr, sizeof(CEquationSIUnitPrefixStr), u);
+   return(uSig = (u==0) ? 1 : u);
+}
+
+/*********************************************************
+* SaveEquation
+* Writes the compiled equation into pBuf. On entry, *pLen
+* is the size of pBuf; on return it is the record size.
+* Pass pBuf=NULL to query the required size only.
+*********************************************************/
+int CEquation::SaveEquation(void *pBuf, size_t *pLen) {
+   unsigned char *p;                        // write pointer
+   size_t len;                              // record length
+   int    iSrcLen;                          // source string length
+   int    iUnitLen;                         // target unit string length
+   int    k;                                // op loop counter
+
+   if(pLen == NULL) return(iError=EQERR_FILE_BUFFERSIZE);
+   if((iEqnLength<=0) || (pszSrcEquation==NULL)) return(iError=EQERR_PARSE_NOEQUATION);
+
+   iSrcLen  = (int) strlen(pszSrcEquation);
+   iUnitLen = (m_dScleTarget != 0.00) ? (int) strlen(m_szUnit) : 0; // target unit only
+   len = EQFILE_HEADERSIZE + iSrcLen        // header and source
+       + 4 + 8 + 8 + 8                      // length, target unit, scale, offset
+       + 1 + iUnitLen                       // target unit string
+       + iEqnLength * EQFILE_OPSIZE;        // program
+   if(pBuf == NULL) { *pLen = len; return(iError=EQERR_NONE); }
+   if(*pLen < len)  { *pLen = len; return(iError=EQERR_FILE_BUFFERSIZE); }
+   *pLen = len;
+
+   //---Header----------------------------------
+   p = (unsigned char*) pBuf;
+   memcpy(p, EQFILE_MAGIC, 4);
+   _EqPutU16(p+ 4, EQFILE_VERSION);
+   _EqPutU16(p+ 6, 0);
+   _EqPutU32(p+ 8, (unsigned int) len);
+   _EqPutU32(p+16, EqTableSignature());
+   _EqPutU32(p+20, (unsigned int) iSrcLen);
+   memcpy(p+EQFILE_HEADERSIZE, pszSrcEquation, iSrcLen);
+   p += EQFILE_HEADERSIZE + iSrcLen;
+
+   //---Target unit-----------------------------
+   _EqPutU32(p, (unsigned int) iEqnLength);
+   p += 4;
+   _EqPutU32(p, (unsigned int) (m_uUnitTarget.u      ));
+   p += 4;
+   _EqPutU32(p, (unsigned int) (m_uUnitTarget.u >> 32));
+   p += 4;
+   _EqPutF64(p, m_dScleTarget);
+   p += 8;
+   _EqPutF64(p, m_dOffsTarget);
+   p += 8;
+   *p++ = (unsigned char) iUnitLen;
+   memcpy(p, m_szUnit, iUnitLen);
+   p += iUnitLen;
+
+   //---Program---------------------------------
+   for(k=0; k<iEqnLength; k++, p+=EQFILE_OPSIZE) {
+      p[0] = pvoEquation[k].uTyp;
+      _EqPutU32(p+1, (unsigned int) pvoEquation[k].iPos);
+      switch(pvoEquation[k].uTyp) {
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+         _EqPutF64(p+5, pvoEquation[k].dVal);
+         break;
+      case VOTYP_CALL:                      // found again by name, see LoadEquation(..)
+         _EqPutU32(p+5, (unsigned int) pvoEquation[k].pCall->iArgc);
+         _EqPutU32(p+9, 0);
+         break;
+      default:                              // all integer members share storage
+         _EqPutU32(p+5, (unsigned int) pvoEquation[k].iRef);
+         _EqPutU32(p+9, 0);
+         break;
       }
    }
-   if(m_szUnit[strlen(m_szUnit)-1] == '/') m_szUnit[strlen(m_szUnit)-1] = '\0'; // truncate unused trailing solidus
 
+   //---Checksum--------------------------------
+   p = (unsigned char*) pBuf;
+   _EqPutU32(p+12, _EqRecordChecksum(p, len));
+   return(iError=EQERR_NONE);
 }
 
+//===Check program========================================
+// Walks the tokens as the evaluator will and returns FALSE
+// if any is unknown, out of range, or would pop more than
+// is on the stack. Variable references must be below
+// iNumVar. Used for programs read from outside, which
+// DoEquation(..) would otherwise trust.
+BOOL CEquation::_CheckProgram(const VALOP *pvo, int iNumOps, int iNumVar) {
+   int  iPt, iTop;                          // program walk
+   int  iArgc;                              // n-arg operator argument count
+   UINT uOp;                                // operator
+
+   if((pvo == NULL) || (iNumOps <= 0)) return(FALSE);
+   for(iTop=0, iPt=0; iPt<iNumOps; iPt++) {
+      switch(pvo[iPt].uTyp) {
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+         iTop++;
+         break;
+      case VOTYP_REF:
+         if((pvo[iPt].iRef < 0) || (pvo[iPt].iRef >= iNumVar)) return(FALSE);
+         iTop++;
+         break;
+      case VOTYP_UNIT:
+         if((pvo[iPt].iUnit < 0) || (pvo[iPt].iUnit >= EQSI_NUMUNIT_INPUT+EQSI_NUMUNIT_CONST)) return(FALSE);
+         if(iTop < 1) return(FALSE);
+         break;
+      case VOTYP_CALL:
+         if((pvo[iPt].pCall == NULL) || (iTop < pvo[iPt].pCall->iArgc)) return(FALSE);
+         iTop -= pvo[iPt].pCall->iArgc - 1;
+         break;
+      case VOTYP_OP:
+         uOp = pvo[iPt].uOp;
+         //---Assignment: variable follows---
+         if(uOp == OP_SET) {
+            if((iTop < 1) || (iPt+1 >= iNumOps) || (pvo[iPt+1].uTyp != VOTYP_REF)) return(FALSE);
+            iPt++;
+            if((pvo[iPt].iRef < 0) || (pvo[iPt].iRef >= iNumVar)) return(FALSE);
+         //---Binary---
+         } else if((uOp >= OP_PSH) && (uOp <= OP_BINARYMAX)) {
+            if(iTop < 2) return(FALSE);
+            if(uOp != OP_PSH) iTop--;
+         //---Unary---
+         } else if((uOp >= OP_UNARY) && (uOp < OP_UNARY+NUM_UNARYOP)) {
+            if(iTop < 1) return(FALSE);
+         //---N-arg: count follows if variable---
+         } else if((uOp >= OP_NARG) && (uOp < OP_NARG+NUM_NARGOP) && (uOp-OP_NARG != OP_NARG_FUNCTION)) {
+            iArgc = CEquationNArgOpArgc[uOp-OP_NARG];
+            if(iArgc < 0) {
+               if((iPt+1 >= iNumOps) || (pvo[iPt+1].uTyp != VOTYP_NARGC) || (pvo[iPt+1].iArgc < -iArgc)) return(FALSE);
+               iPt++;
+               iArgc = pvo[iPt].iArgc;
+            }
+            if(iTop < iArgc) return(FALSE);
+            iTop -= iArgc - 1;
+         } else {
+            return(FALSE);
+         }
+         break;
+      default:                              // includes NARGC not after its operator
+         return(FALSE);
+      }
+   }
+   return(iTop == 1);
+}
 
+/*********************************************************
+* LoadEquation
+* Restores an equation written by SaveEquation(..). The
+* variable names pszVars must match those used when the
+* equation was originally parsed: a stale record is
+* re-parsed with them, and a program referring to more
+* variables than pszVars names is rejected. A record is
+* also re-parsed if a callback is not found by the name at
+* its position, as for one called in a user function.
+* Records that are not consistent programs are rejected
+* with EQERR_FILE_BADFORMAT.
+*********************************************************/
+int CEquation::LoadEquation(const void *pBuf, size_t len, const char *pszVars, BOOL *ptfReparsed) {
+   const unsigned char *p;                  // read pointer
+   const unsigned char *pEnd;               // end of record
+   const char *psz;                         // variable name walk
+   char    *pszSrc;                         // source string copy
+   size_t   lenRec;                         // stored record length
+   int      iSrcLen;                        // source string length
+   int      iNumOps;                        // number of ops
+   int      iUnitLen;                       // target unit string length
+   int      k;                              // op loop counter
+   int      iLen;                           // length of a callback's name
+   int      iNumVar;                        // variables named in pszVars
+   VALOP    vo;                             // op being decoded
+
+   if(ptfReparsed) *ptfReparsed = FALSE;
+   p = (const unsigned char*) pBuf;
+
+   //---Header----------------------------------
+   if((p==NULL) || (len < EQFILE_HEADERSIZE) || (memcmp(p, EQFILE_MAGIC, 4) != 0))
+      return(iError=EQERR_FILE_BADFORMAT);
+   lenRec  = _EqGetU32(p+8);
+   iSrcLen = (int) _EqGetU32(p+20);
+   if((lenRec > len) || (lenRec < EQFILE_HEADERSIZE) || ((size_t) iSrcLen > lenRec-EQFILE_HEADERSIZE))
+      return(iError=EQERR_FILE_BADFORMAT);
+   if(_EqGetU32(p+12) != _EqRecordChecksum(p, lenRec))
+      return(iError=EQERR_FILE_CHECKSUM);
+
+   if((_EqGetU16(p+4) != EQFILE_VERSION) || (_EqGetU32(p+16) != EqTableSignature())) goto Reparse;
+
+   //---Target unit-----------------------------
+   pEnd = p + lenRec;
+   p   += EQFILE_HEADERSIZE + iSrcLen;
+   if(p + 4 + 8 + 8 + 8 + 1 > pEnd) return(iError=EQERR_FILE_BADFORMAT);
+   iNumOps = (int) _EqGetU32(p);
+   p += 4;
+   m_uUnitTarget.u = (unsigned long long) _EqGetU32(p) | ((unsigned long long) _EqGetU32(p+4) << 32);
+   p += 8;
+   m_dScleTarget = _EqGetF64(p);
+   p += 8;
+   m_dOffsTarget = _EqGetF64(p);
+   p += 8;
+   iUnitLen = *p++;
+   if((iUnitLen >= (int) sizeof(m_szUnit)) || (iNumOps <= 0)
+      || (p + iUnitLen + (size_t) iNumOps * EQFILE_OPSIZE != pEnd)) return(iError=EQERR_FILE_BADFORMAT);
+   memset(m_szUnit, 0x00, sizeof(m_szUnit));
+   memcpy(m_szUnit, p, iUnitLen);
+   p += iUnitLen;
+   _ResetProgramState();
+
+   //---Program---------------------------------
+   if(!AllocEquation(iNumOps)) return(iError=EQERR_PARSE_ALLOCFAIL);
+   for(k=0; k<iNumOps; k++, p+=EQFILE_OPSIZE) {
+      memset(&vo, 0x00, sizeof(vo));
+      vo.uTyp = p[0];
+      vo.iPos = (int) _EqGetU32(p+1);
+      switch(vo.uTyp) {
+      case VOTYP_VAL:
+      case VOTYP_PREFIX:
+         vo.dVal = _EqGetF64(p+5);
+         break;
+      case VOTYP_UNIT:
+         vo.iUnit = (int) _EqGetU32(p+5);
+         if((vo.iUnit < 0) || (vo.iUnit >= EQSI_NUMUNIT_INPUT+EQSI_NUMUNIT_CONST)) vo.uTyp = VOTYP_UNDEFINED;
+         break;
+      case VOTYP_OP:
+         vo.uOp = _EqGetU32(p+5);
+         if((vo.uOp >= OP_NARG) && (vo.uOp - OP_NARG >= NUM_NARGOP)) vo.uTyp = VOTYP_UNDEFINED;
+         break;
+      case VOTYP_REF:
+      case VOTYP_NARGC:
+         vo.iRef = (int) _EqGetU32(p+5);
+         if(vo.iRef < 0) vo.uTyp = VOTYP_UNDEFINED;
+         break;
+      case VOTYP_CALL:                      // registered in this process under the same name
+         if((vo.iPos < 0) || (vo.iPos >= iSrcLen)) { vo.uTyp = VOTYP_UNDEFINED; break; }
+         for(iLen=0; (vo.iPos+iLen < iSrcLen)
+            && (strchr(EQ_VALIDSYMB, ((const char*) pBuf)[EQFILE_HEADERSIZE+vo.iPos+iLen]) != NULL); iLen++) ;
+         vo.pCall = EqFindCallback((const char*) pBuf + EQFILE_HEADERSIZE + vo.iPos, iLen);
+         if((vo.pCall == NULL) || (vo.pCall->iArgc != (int) _EqGetU32(p+5))) { FreeEquation(); goto Reparse; }
+         break;
+      default:
+         vo.uTyp = VOTYP_UNDEFINED;
+      }
+      if(vo.uTyp == VOTYP_UNDEFINED) { FreeEquation(); return(iError=EQERR_FILE_BADFORMAT); }
+      pvoEquation[k] = vo;
+   }
+   for(iNumVar=0, psz=pszVars; (psz != NULL) && (*psz != '\0'); psz+=strlen(psz)+1) iNumVar++;
+   if(!_CheckProgram(pvoEquation, iNumOps, iNumVar)) {
+      FreeEquation();
+      return(iError=EQERR_FILE_BADFORMAT);
+   }
+   iEqnLength = iNumOps;
+
+   //---Source----------------------------------
+   FreeSrcEquation();
+   pszSrcEquation = (char*) malloc(iSrcLen+1);
+   if((pszSrcEquation == NULL) || !_CountProgram()) {
+      FreeSrcEquation();
+      FreeEquation();
+      return(iError=EQERR_PARSE_ALLOCFAIL);
+   }
+   m_iSrcAlloc = iSrcLen+1;
+   memcpy(pszSrcEquation, (const unsigned char*) pBuf + EQFILE_HEADERSIZE, iSrcLen);
+   pszSrcEquation[iSrcLen] = '\0';
+   iErrorLocation = 0;
+   return(iError=EQERR_NONE);
 
+   //---Stale record: re-parse source-----------
+Reparse:
+   pszSrc = (char*) malloc(iSrcLen+1);
+   if(pszSrc == NULL) return(iError=EQERR_PARSE_ALLOCFAIL);
+   memcpy(pszSrc, (const unsigned char*) pBuf + EQFILE_HEADERSIZE, iSrcLen);
+   pszSrc[iSrcLen] = '\0';
+   ParseEquation(pszSrc, pszVars);
+   free(pszSrc);
+   if((iError==EQERR_NONE) && ptfReparsed) *ptfReparsed = TRUE;
+   return(iError);
+}
 
+/*********************************************************
+* SaveEquationFile / LoadEquationFile
+* Stream versions of SaveEquation / LoadEquation. Records
+* are self-delimiting, so many equations may be written
+* one after another to the same file.
+*********************************************************/
+int CEquation::SaveEquationFile(FILE *fp) {
+   void  *pBuf;                             // record buffer
+   size_t len;                              // record length
+
+   if(fp == NULL) return(iError=EQERR_FILE_READWRITE);
+   if(SaveEquation(NULL, &len) != EQERR_NONE) return(iError);
+   pBuf = malloc(len);
+   if(pBuf == NULL) return(iError=EQERR_PARSE_ALLOCFAIL);
+   if(SaveEquation(pBuf, &len) == EQERR_NONE) {
+      if(fwrite(pBuf, 1, len, fp) != len) iError = EQERR_FILE_READWRITE;
+   }
+   free(pBuf);
+   return(iError);
+}
 
+int CEquation::LoadEquationFile(FILE *fp, const char *pszVars, BOOL *ptfReparsed) {
+   unsigned char  ucHead[12];               // fixed start of record
+   unsigned char *pBuf;                     // whole record
+   size_t len;                              // record length
+
+   if(ptfReparsed) *ptfReparsed = FALSE;
+   if(fp == NULL) return(iError=EQERR_FILE_READWRITE);
+   if(fread(ucHead, 1, sizeof(ucHead), fp) != sizeof(ucHead)) return(iError=EQERR_FILE_READWRITE);
+   if(memcmp(ucHead, EQFILE_MAGIC, 4) != 0) return(iError=EQERR_FILE_BADFORMAT);
+   len = _EqGetU32(ucHead+8);
+   if((len < EQFILE_HEADERSIZE) || (len > EQFILE_MAXRECORD)) return(iError=EQERR_FILE_BADFORMAT);
+   pBuf = (unsigned char*) malloc(len);
+   if(pBuf == NULL) return(iError=EQERR_PARSE_ALLOCFAIL);
+   memcpy(pBuf, ucHead, sizeof(ucHead));
+   if(fread(pBuf+sizeof(ucHead), 1, len-sizeof(ucHead), fp) != len-sizeof(ucHead)) {
+      free(pBuf);
+      return(iError=EQERR_FILE_READWRITE);
+   }
+   LoadEquation(pBuf, len, pszVars, ptfReparsed);
+   free(pBuf);
+   return(iError);
+}
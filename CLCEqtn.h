@@ -6,395 +6,297 @@
 #ifndef CLCEQTN_H
 #define CLCEQTN_H
 class CEquation;                            // CEquation object for LaserCanvas
+class CEquationCache;                       // cache of parsed equations
+class CEquationLibrary;                     // memory-mapped file of compiled equations
+class CEqArena;                             // bump allocator for parse scratch
+class CEqParseContext;                      // reusable ParseEquation(..) scratch
 
 #define CLCEQTN_SZVERSION "CEquation v7a"    // revision string
 
+#ifdef _WIN32
 #include <windows.h>                        // standard Windows header
+#else
+#include <stdlib.h>                         // malloc, free
+typedef int          BOOL;                  // Windows types used throughout
+typedef unsigned int UINT;
+#ifndef TRUE
+# define TRUE  1
+# define FALSE 0
+#endif//TRUE
+# define _snprintf snprintf
+#endif//_WIN32
 #include <stdio.h>                          // for sprintf
 #include <string.h>                         // string manipulation
 #include <math.h>                           // standard Math library
 
-//---Macros-------------------------------------
-#ifndef MAX
-#define MAX(a,b)  ((a)>(b)?(a):(b))
-#endif/*MAX*/
-#ifndef MIN
-#define MIN(a,b)  ((a)<(b)?(a):(b))
-#endif/*MIN*/
-#ifndef ABS
-# define ABS(x) (((x)<0)? (-(x)) : (x))
-#endif/*ABS*/
-#ifndef SIGN
-# define SIGN(x) ( ((x)==0.00) ? 0 : (((x)>0) ? +1 : -1) )
-#endif//SIGN
-#ifndef M_PI
-# define M_PI 3.1415926536897932
-#endif//M_PI
-
-//---Characters---------------------------------
-// ILLEGALCHAR: Characters not ever allowed in the string
-#define EQ_ILLEGALCHAR "`~@$%[]{}?\;:"
-
-// VALIDCHAR: Valid first characters of variable name
-#define EQ_VALIDCHAR "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-
-// VALIDSYMB: Valid variable name symbols
-#define EQ_VALIDSYMB "abcdefghijklmnopqrstuvwxyz_ABCDEFGHIJKLMNOPQRSTUVWXYZ1234567890'\""
-
-//===Operators============================================
-#define OP_NULL             0x0000
-#define OP_PSH                   1          // comma (Push) binary op
-#define OP_POP                   2          // remove (comma in non-multi situations)
-#define OP_SET                   3          // set (variable = expression)
-
-#define OP_BINARYMIN             4          // first "real" binary operator
-//                               | - equal
-#define OP_OR                    4          // or ||
-#define OP_AND                   5          // and &&
-
-#define OP_RELOPMIN              6          // start of relational operators
-#define OP_LTE                   6          // less or equal <=
-#define OP_GTE                   7          // greater or equal >=
-#define OP_LT                    8          // less than <
-#define OP_GT                    9          // greater than >
-#define OP_NEQ                  10          // not equal !=
-#define OP_EQ                   11          // equal ==
-#define OP_RELOPMAX             11          // end of relation operators
-
-#define OP_ADD                  12          // ascending in precedence order
-#define OP_SUB                  13
-#define OP_MUL                  14
-#define OP_DIV                  15
-#define OP_POW                  16
-//                               | - equal
-#define OP_BINARYMAX            16          // last real binary operator
-
-#define OP_UNARY                20          // unary ops have OP_UNARY added
-#define OP_ABS                   0
-#define OP_SQRT                  1
-#define OP_EXP                   2
-#define OP_LOG                   3
-#define OP_LOG10                 4
-#define OP_CEIL                  5
-#define OP_FLOOR                 6
-#define OP_COS                   7
-#define OP_SIN                   8
-#define OP_TAN                   9
-#define OP_ACOS                 10
-#define OP_ASIN                 11
-#define OP_ATAN                 12
-#define OP_COSH                 13
-#define OP_SINH                 14
-#define OP_TANH                 15
-#define OP_SIND                 16
-#define OP_COSD                 17
-#define OP_TAND                 18
-#define OP_ASIND                19
-#define OP_ACOSD                20
-#define OP_ATAND                21
-#define OP_NOT                  22          // not !
-#define OP_SIGN                 23
-#define OP_ROUND                24
-#define NUM_UNARYOP             25          // number of defined unary ops
-
-#define OP_NARG                 50          // n-arg ops have OP_NARG added
-#define OP_NARG_MOD              0
-#define OP_NARG_REM              1
-#define OP_NARG_ATAN2            2
-#define OP_NARG_ATAN2D           3
-#define OP_NARG_MAX              4
-#define OP_NARG_MIN              5
-#define OP_NARG_IF               6
-#define NUM_NARGOP               7          // number of define n-arg ops
-
-#define OP_BRACKETOFFSET       100          // added for each nested bracket
-
-//---Character strings--------------------------
-// Each operator / constant is terminated by a single NULL character. The loops
-// count up to NUM_UNARYOP and NUM_CONSTANT, so ensure these values are correct
-
-const char CEquationBinaryOpStr[] =
-   "+\0-\0*\0/\0^\0||\0&&\0<=\0>=\0<\0>\0!=\0==\0";
-
-const char CEquationUnaryOpStr[] =
-   "abs\0sqrt\0exp\0log\0log10\0ceil\0floor\0cos\0sin\0tan\0"
-   "acos\0asin\0atan\0cosh\0sinh\0tanh\0sind\0cosd\0tand\0asind\0"
-   "acosd\0atand\0!\0sign\0round\0";
-
-const char CEquationNArgOpStr[] =           // n-arg operator strings
-   "mod\0rem\0atan2\0atan2d\0max\0min\0if\0";
-const int CEquationNArgOpArgc[NUM_NARGOP] = { // n-arg operator argument counts (-ve: min arg count)
-   2,2,2,2,-2,-2,3};
-
-#define OP2STR(o) (\
-   (o==OP_PSH)           ? "Push" : \
-   (o==OP_POP)           ? "Pop" : \
-   (o==OP_SET)           ? "Assign" : \
-   (o==OP_ADD)           ? "+" : \
-   (o==OP_SUB)           ? "-" : \
-   (o==OP_DIV)           ? "/" : \
-   (o==OP_MUL)           ? "*" : \
-   (o==OP_POW)           ? "^" : \
-   (o==OP_OR)            ? "Or" : \
-   (o==OP_AND)           ? "And" : \
-   (o==OP_LTE)           ? "<=" : \
-   (o==OP_GTE)           ? ">=" : \
-   (o==OP_LT )           ? "<" : \
-   (o==OP_GT )           ? ">" : \
-   (o==OP_NEQ)           ? "!=" : \
-   (o==OP_EQ )           ? "==" : \
-   (o-OP_UNARY)==OP_ABS  ? "Abs" : \
-   (o-OP_UNARY)==OP_SQRT ? "Sqrt" : \
-   (o-OP_UNARY)==OP_EXP  ? "Exp" : \
-   (o-OP_UNARY)==OP_LOG10? "Log10" : \
-   (o-OP_UNARY)==OP_LOG  ? "Log" : \
-   (o-OP_UNARY)==OP_CEIL ? "Ceil" : \
-   (o-OP_UNARY)==OP_FLOOR? "Floor" : \
-   (o-OP_UNARY)==OP_COS  ? "Cos" : \
-   (o-OP_UNARY)==OP_SIN  ? "Sin" : \
-   (o-OP_UNARY)==OP_TAN  ? "Tan" : \
-   (o-OP_UNARY)==OP_ACOS ? "ACos" : \
-   (o-OP_UNARY)==OP_ASIN ? "ASin" : \
-   (o-OP_UNARY)==OP_ATAN ? "ATan" : \
-   (o-OP_UNARY)==OP_COSH ? "Cosh" : \
-   (o-OP_UNARY)==OP_SINH ? "Sinh" : \
-   (o-OP_UNARY)==OP_TANH ? "Tanh" : \
-   (o-OP_UNARY)==OP_SIND ? "SinD" : \
-   (o-OP_UNARY)==OP_COSD ? "CosD" : \
-   (o-OP_UNARY)==OP_TAND ? "TanD" : \
-   (o-OP_UNARY)==OP_ASIND? "ASinD" : \
-   (o-OP_UNARY)==OP_ACOSD? "ACosD" : \
-   (o-OP_UNARY)==OP_ATAND? "ATanD" : \
-   (o-OP_UNARY)==OP_NOT  ? "Not" : \
-   (o-OP_UNARY)==OP_SIGN ? "Sign" : \
-   (o-OP_UNARY)==OP_ROUND? "Round" : \
-   (o-OP_NARG )==OP_NARG_MOD   ? "Mod" : \
-   (o-OP_NARG )==OP_NARG_REM   ? "Rem" : \
-   (o-OP_NARG )==OP_NARG_ATAN2 ? "Atan2" : \
-   (o-OP_NARG )==OP_NARG_ATAN2D? "Atan2D" : \
-   (o-OP_NARG )==OP_NARG_MAX   ? "Max" : \
-   (o-OP_NARG )==OP_NARG_MIN   ? "Min" : \
-   (o-OP_NARG )==OP_NARG_IF    ? "If" : \
-   "*unknown*")
-
-//===Units and Dimensions=================================
-// VALIDUNIT: Valid characters in units (including prefixes)
-#define EQ_VALIDUNIT "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ"
-
-// The dimensioned constants store an INDEX into the same
-// array as used for the named constants. The ordering is
-//  - Base units first; followed by
-//  - Named units; followed by
-//  - Units used in dimensioned constants
-// Why? Because when VOTYP_UNIT  is evaluated, it expects
-// a single value that is the index into the units list.
-#define EQSI_NUMDIM_SCL               9     // number of base unit dimensions plus scale factor coefficients
-
-#define EQSI_NUMUNIT_BASE             7     // number of SI base units
-#define EQSI_NUMUNIT                 16     // total number named units for output (base plus derived)
-#define EQSI_NUMUNIT_INPUT           26     // number of units for input
-
-#define EQSI_NUMUNIT_CONST            8     // number of units for dimensioned constants
-
-typedef struct tagUNITBASE {                // this needs to be a STRUCT for TEqStack
-   double d[EQSI_NUMUNIT_BASE];
-} UNITBASE;
-
-const double CEquationSIUnit[EQSI_NUMUNIT_INPUT+EQSI_NUMUNIT_CONST][EQSI_NUMDIM_SCL] = {
-   // kg      m      A      s      K     mol    cd    scale offset
-   // Values EARLIER in the table take precedence
-   //---SI Base Units---------------------------
-   {  1.0,     0,     0,     0,     0,     0,     0,    1.0,     0}, //  0 EQSI_KG  = mass
-   {    0,   1.0,     0,     0,     0,     0,     0,    1.0,     0}, //  1 EQSI_M   = length
-   {    0,     0,   1.0,     0,     0,     0,     0,    1.0,     0}, //  2 EQSI_A   = electric current
-   {    0,     0,     0,   1.0,     0,     0,     0,    1.0,     0}, //  3 EQSI_S   = time
-   {    0,     0,     0,     0,   1.0,     0,     0,    1.0,     0}, //  4 EQSI_K   = therm. temperature
-   {    0,     0,     0,     0,     0,   1.0,     0,    1.0,     0}, //  5 EQSI_MOL = amount of substance
-   {    0,     0,     0,     0,     0,     0,   1.0,    1.0,     0}, //  6 EQSI_CD  = lum. intensity
-   //---SI Derived Units------------------------
-   {  1.0,   2.0,     0,  -3.0,     0,     0,     0,    1.0,     0}, //  7 W  = J/s
-   {  1.0,   2.0,     0,  -2.0,     0,     0,     0,    1.0,     0}, //  8 J  = N m
-   {  1.0,  -1.0,     0,  -2.0,     0,     0,     0,    1.0,     0}, //  9 Pa = N/m2
-   {  1.0,   1.0,     0,  -2.0,     0,     0,     0,    1.0,     0}, // 10 N  = kg m /s2
-   {    0,     0,     0,  -1.0,     0,     0,     0,    1.0,     0}, // 11 Hz = 1/s
-   {    0,     0,   1.0,   1.0,     0,     0,     0,    1.0,     0}, // 12 C  = A s
-   {  1.0,   2.0,  -1.0,  -3.0,     0,     0,     0,    1.0,     0}, // 13 V  = W/A
-   { -1.0,  -2.0,   2.0,   4.0,     0,     0,     0,    1.0,     0}, // 14 F  = C/V
-   {  1.0,   2.0,  -2.0,  -3.0,     0,     0,     0,    1.0,     0}, // 15 Ohm= V/A
-   //---Allowed INPUT units only----------------
-   {  1.0,     0,     0,     0,     0,     0,     0,    1.0e-3,  0}, // 16 g -> kg
-   {    0,   3.0,     0,     0,     0,     0,     0,    1.0e-3,  0}, // 17 L -> m3
-   {    0,     0,     0,     0,   1.0,     0,     0,    1.0,273.15}, // 18 degC -> K
-   {    0,     0,     0, 0, 1.0, 0, 0, 5.0/9.0,273.15-5.0/9.0*32.0}, // 19 degF -> K
-   {    0,   1.0,     0,     0,     0,     0,     0, 1609.344,   0}, // 20 mi -> m
-   {    0,   1.0,     0,     0,     0,     0,     0, 1852.0,     0}, // 21 nmi -> m
-   {    0,   1.0,     0,     0,     0,     0,     0,    0.9144,  0}, // 22 yd -> m
-   {    0,   1.0,     0,     0,     0,     0,     0,    0.3048,  0}, // 23 ft -> m
-   {    0,   1.0,     0,     0,     0,     0,     0,    2.54e-2, 0}, // 24 in -> m
-   {  1.0,   2.0,     0,  -2.0,     0,     0,   0,1.60217646e-19,0}, // 25 eV -> J
-
-
-   //---Dimensioned Constants-------------------
-   // Offset by NUMUNIT_INPUT
-   {    0,   1.0,     0,  -1.0,     0,     0,     0,    1.0,     0}, //  0 c   = m/s
-   { -1.0,  -3.0,   2.0,   4.0,     0,     0,     0,    1.0,     0}, //  1 e0  = F/m
-   {  1.0,   1.0,  -2.0,  -2.0,     0,     0,     0,    1.0,     0}, //  2 mu0 = N/A2
-   { -1.0,   3.0,     0,  -2.0,     0,     0,     0,    1.0,     0}, //  3 G   = m3/ kg s2
-   {  1.0,   2.0,     0,  -1.0,     0,     0,     0,    1.0,     0}, //  4 h   = J s
-   {    0,     0,     0,     0,     0,  -1.0,     0,    1.0,     0}, //  5 N_A = 1/mol
-   {  1.0,   2.0,     0,  -2.0,  -1.0,     0,     0,    1.0,     0}, //  6 kB  = J/K
-   {  1.0,   2.0,     0,  -2.0,  -1.0,  -1.0,     0,    1.0,     0}, //  7 R   = J/K mol
-};
-
-const char CEquationSIUnitStr[] =
-// Base units . . . . . . | Derived units . . .          | Constants . .
-"kg\0m\0A\0s\0K\0mol\0cd\0W\0J\0Pa\0N\0Hz\0C\0V\0F\0Ohm\0"
-"g\0L\0degC\0degF\0mi\0nmi\0yd\0ft\0\in\0eV\0" // input only units
-"m/s\0F/m\0N/A2\0m3/kg s2\0J s\0/mol\0J/K\0J/K mol\0" // constants
-;
-
-//---Prefixes-----------------------------------
-#define EQSI_NUMUNIT_PREFIX          11     // number of recognized prefixes
-#define EQSI_NUMUNIT_PREFIX_OUTPUT   10     // number of prefixes used in output
-
-const double CEquationSIUnitPrefix[EQSI_NUMUNIT_PREFIX] =
-   {1e12,1e9,1e6,1e3,100,0.01,1e-3,1e-6,1e-9,1e-12,1e-15};
-const char CEquationSIUnitPrefixStr[] = "TGMkhcmunpf";
-
-// Used for auto-adjustment, disabled for now
-//const double CEquationSIUnitPrefixOutput[EQSI_NUMUNIT_PREFIX_OUTPUT] =
-//   {1e12,1e9,1e6,1e3,1,1e-3,1e-6,1e-9,1e-12,1e-15};
-//const char CEquationSIUnitPrefixOutputStr[] = "TGMk*munpf";
-
-//===Dimensioned Constants================================
-#define EQSI_NUMCONST                17     // number of dimensioned constants
-const int CEquationSIConstUnitIndx[EQSI_NUMCONST] = {
-   -1,                  // pi = []
-   EQSI_NUMUNIT_INPUT +  0,                  // c = m/s
-                        15,                  // Z0 = Ohm
-   EQSI_NUMUNIT_INPUT +  1,                  // e0 = F/m
-   EQSI_NUMUNIT_INPUT +  2,                  // mu0 = N/A2
-   EQSI_NUMUNIT_INPUT +  3,                  // G = m3/kg s2
-   EQSI_NUMUNIT_INPUT +  4,                  // h = Js
-   EQSI_NUMUNIT_INPUT +  4,                  // hbar = Js
-                        12,                  // e = C
-                         0,                  // m_alpha = kg
-                         0,                  // m_e = kg
-                         0,                  // m_n = kg
-                         0,                  // m_p = kg
-                         0,                  // m_u = kg (atomic mass constant)
-   EQSI_NUMUNIT_INPUT +  5,                  // N_A = 1/mol Avogadro's
-   EQSI_NUMUNIT_INPUT +  6,                  // kB = J/K Boltzmann's
-   EQSI_NUMUNIT_INPUT +  7,                  // R = J / K mol
-};
-
-const double CEquationSIConst[EQSI_NUMCONST] = {
-   M_PI,                // pi
-   299792458,           // c
-   376.730313461,       // Z0
-   8.854187817e-12,     // e0
-   4e-7*M_PI,           // mu0
-   6.67428e-11,         // G
-   6.62606896e-34,      // h
-   6.62606896e-34/(2.00*M_PI), // hbar = h/2pi
-   1.602176487e-19,     // e
-   6.64465620e-27,      // m_alpha
-   9.10938215e-31,      // m_e
-   1.674927211e-27,     // m_n
-   1.672621637e-27,     // m_p
-   1.660538782e-27,     // m_u
-   6.02214179e23,       // N_A
-   1.3806504e-23,       // kB
-   8.314472,            // R
+#include "CLCEqTables.h"                    // operators, units, error codes
+
+//---Locking------------------------------------
+// Minimal mutual exclusion for objects shared between threads
+// (e.g. CEquationCache). Windows builds use a critical section.
+#ifdef _WIN32
+typedef CRITICAL_SECTION EQLOCK;
+# define EQLOCK_INIT(p)     InitializeCriticalSection(p)
+# define EQLOCK_DELETE(p)   DeleteCriticalSection(p)
+# define EQLOCK_ENTER(p)    EnterCriticalSection(p)
+# define EQLOCK_LEAVE(p)    LeaveCriticalSection(p)
+#else
+# include <pthread.h>                       // POSIX threads
+typedef pthread_mutex_t EQLOCK;
+# define EQLOCK_INIT(p)     pthread_mutex_init(p, NULL)
+# define EQLOCK_DELETE(p)   pthread_mutex_destroy(p)
+# define EQLOCK_ENTER(p)    pthread_mutex_lock(p)
+# define EQLOCK_LEAVE(p)    pthread_mutex_unlock(p)
+#endif//_WIN32
+
+//---Reference counts---------------------------
+// Counts shared between threads, e.g. of a compiled program
+// shared by copies of a CEquation. Both return the new count.
+#ifdef _WIN32
+typedef LONG EQREFCOUNT;
+# define EQREF_INC(p)       InterlockedIncrement(p)
+# define EQREF_DEC(p)       InterlockedDecrement(p)
+#else
+typedef long EQREFCOUNT;
+# define EQREF_INC(p)       __sync_add_and_fetch(p, 1)
+# define EQREF_DEC(p)       __sync_sub_and_fetch(p, 1)
+#endif//_WIN32
+
+//---Move semantics-----------------------------
+#if (__cplusplus >= 201103L) || (defined(_MSC_VER) && (_MSC_VER >= 1600))
+# define EQMOVE                                // rvalue references available
+#endif
+
+class CEqLock {                             // EQLOCK for static instances
+private:
+   EQLOCK m_Lock;
+public:
+   CEqLock(void)  { EQLOCK_INIT(&m_Lock); };
+   ~CEqLock()     { EQLOCK_DELETE(&m_Lock); };
+   void Enter(void) { EQLOCK_ENTER(&m_Lock); };
+   void Leave(void) { EQLOCK_LEAVE(&m_Lock); };
 };
 
-const char CEquationSIUnitConstStr[] =
-"pi\0c\0Z0\0e0\0mu0\0G\0h\0hbar\0e\0m_alpha\0m_e\0m_n\0m_p\0m_u\0N_A\0kB\0R\0";
-
-
-
-//===Errors===============================================
-#define EQERR_NONE                    0     // no error
-
-#define EQERR_PARSE_ALLOCFAIL        -1     // could not allocate memory
-#define EQERR_PARSE_NOEQUATION       -2     // there's no equation
-
-#define EQERR_PARSE_NUMBEREXPECTED    1     // looking for number, (, -sign, or unary op
-#define EQERR_PARSE_UNKNOWNFUNCVAR    2
-#define EQERR_PARSE_BRACKETEXPECTED   3     // expecting ( (after unary operator)
-#define EQERR_PARSE_BINARYOPEXPECTED  4     // expecting +-*/^ operator
-#define EQERR_PARSE_BRACKETSOPEN      5     // not enough closing brackets
-#define EQERR_PARSE_UNOPENEDBRACKET   6     // not enough opening brackets
-#define EQERR_PARSE_NOADVANCE         7     // current token failed to advance iThisScan
-#define EQERR_PARSE_CONTAINSVAR       8     // contains vars when not permitted
-#define EQERR_PARSE_NARGBADCOUNT      9     // wrong number of arguments to function
-#define EQERR_PARSE_STACKOVERFLOW    10     // stack overflow, too many ops
-#define EQERR_PARSE_ASSIGNNOTVAR     11     // assignment needs variable
-#define EQERR_PARSE_UNITEXPECTED     12     // expected unit after "in" keyword
-#define EQERR_PARSE_UNITALREADYDEF   13     // target unit already defined
-#define EQERR_PARSE_UNITINCOMPATIBLE 14     // incompatible unit
-#define EQERR_PARSE_ILLEGALCHAR      99     // illegal character
-
-#define EQERR_EVAL_UNKNOWNBINARYOP  101     // Unknown binary operator
-#define EQERR_EVAL_UNKNOWNUNARYOP   102     // Unknown unary operator
-#define EQERR_EVAL_UNKNOWNNARGOP    103     // Unkown n-arg operator
-#define EQERR_EVAL_UNKNOWNVALOP     104     // Unknown Valop type
-#define EQERR_EVAL_STACKNOTEMPTY    105     // Stack not empty at end of equation
-#define EQERR_EVAL_STACKUNDERFLOW   106     // Stack hasn't enough entries
-#define EQERR_EVAL_CONTAINSVAR      108     // contains variables than are not supplied
-#define EQERR_EVAL_BADTOKEN         109     // not right type of token
-#define EQERR_EVAL_ASSIGNNOTALLOWED 110     // not allowed to change variables
-#define EQERR_EVAL_UNITMISMATCH     111     // mismatched units
-#define EQERR_EVAL_UNITNOTDIMLESS   112     // unit on expected dimensionless arg
-#define EQERR_EVAL_NOEQUATION       199     // there is no equation to evaluate
-
-#define EQERR_MATH_DIV_ZERO         201     // division by zero
-#define EQERR_MATH_DOMAIN           202     // domain error (acos, etc) (sometimes cplx)
-#define EQERR_MATH_SQRT_NEG         203     // square root of negative (--> cplx)
-#define EQERR_MATH_LOG_ZERO         204     // log of zero - always undefined
-#define EQERR_MATH_LOG_NEG          205     // log of negative (--> cplx)
-#define EQERR_MATH_OVERFLOW         206     // exp(large number) overflow
-
-//---Parse status-------------------------------
-#define LOOKFOR_NUMBER     0x01  // number, unary op, parentheses, negative, constant
-#define LOOKFOR_BINARYOP   0x02  // binary op only
-#define LOOKFOR_BRACKET    0x03  // brackets only (after unary op)
+//---Dimensions (CLCEqTables.h)---------------
+int  EqDimMul(UNITBASE u1, UNITBASE u2, UNITBASE *pu); // u1*u2: add exponents
+int  EqDimDiv(UNITBASE u1, UNITBASE u2, UNITBASE *pu); // u1/u2: subtract exponents
+int  EqDimPow(UNITBASE u1, double dPwr, UNITBASE *pu); // u1^dPwr: scale exponents
+void EqDimToDouble(UNITBASE u1, double *pdExp);        // unpack into EQSI_NUMUNIT_BASE doubles
+BOOL EqIsUnitName(const char *psz, int iLen);          // unit, with or without prefix
+
+//===Binary Format========================================
+// SaveEquation(..) writes a compiled equation as a little-endian
+// record. The leading fields, up to and including the source
+// string, keep the same layout in all versions so that stale
+// records can still be re-parsed from source.
+//  0  char[4]  EQFILE_MAGIC
+//  4  uint16   EQFILE_VERSION
+//  6  uint16   reserved (0)
+//  8  uint32   total record length in bytes
+// 12  uint32   checksum (FNV-1a of all other bytes of the record)
+// 16  uint32   signature of operator and unit tables
+// 20  uint32   source string length n
+// 24  char[n]  source string (no NULL)
+//     ...      version-dependent compiled program
+#define EQFILE_MAGIC             "CEQB"     // record identifier
+#define EQFILE_VERSION                2     // increment when program layout or op codes change
+#define EQFILE_HEADERSIZE            24     // bytes before source string
+#define EQFILE_MAXRECORD     0x1000000     // longest record LoadEquationFile(..) will read
+
+unsigned int EqTableSignature(void);        // signature of operator and unit tables
+unsigned int EqHashFnv1a(const void *pv, size_t len, unsigned int uHash=2166136261u); // FNV-1a hash
 
 //===Operator stack typedef===============================
 template<class T> class TEqStack;
 
-//---Valop types--------------------------------
-#define VOTYP_UNDEFINED       0x00          // undefined
-#define VOTYP_VAL             0x01          // valop is numeric value
-#define VOTYP_OP              0x02          // valop is built-in operator or function
-#define VOTYP_REF             0x03          // valop is index into variable array
-#define VOTYP_UNIT            0x04          // unit: immediate multiply by value
-#define VOTYP_NARGC           0x05          // n-argument count whenever bracket is closed
-#define VOTYP_PREFIX          0x06          // same effect as TYP_VAL
-
 //---Data Structure-------------------
+// Widest member first: 16 bytes rather than 24 with padding.
+typedef struct tagEQCALLBACK EQCALLBACK;
 typedef struct tagVALOP {
-   unsigned char   uTyp;                    // type (op, value, variable)
    union {
       double    dVal;                    // value for constants
+      const EQCALLBACK *pCall;              // function called
       unsigned int uOp;                     // operator code
       int          iRef;                    // index into variable array
       int          iUnit;                   // index into unit array
       int          iArgc;                   // number of pushed arguments
    };
    int             iPos;                    // position in source string
+   unsigned char   uTyp;                    // type (op, value, variable)
 } VALOP, *PVALOP;
 
+//---Batch evaluation flags---------------------
+#define EQBATCH_UNCHECKED        0x0001     // no per-op argument checks, re-check rows with inf/NaN answers
+#define EQBATCH_FASTMATH         0x0002     // approximate exp, log, trig, tanh to 1e-7 (CLCEqFast.h)
+#define EQBATCH_FASTMATH_HIGH    0x0004     // the same to within 4 ulp
+#define EQBATCH_SUMPAIRWISE      0x0008     // DoEquationArray(..): pairwise summation
+#define EQBATCH_SUMKAHAN         0x0010     // DoEquationArray(..): compensated summation
+
+typedef struct tagEQROWERROR {
+   int iRow;                                // row index
+   int iError;                              // EQERR_ code
+   int iPos;                                // position in source string
+} EQROWERROR;
+
+typedef struct tagEQBATCHSTATUS {           // see DoEquationBatchRows(..)
+   unsigned char *pucBits;                  // one bit per row, set on error (may be NULL)
+   EQROWERROR    *pErr;                     // first iMaxErr errors (may be NULL)
+   int            iMaxErr;                  // capacity of pErr
+   int            iNumErr;                  // number of rows with errors
+} EQBATCHSTATUS;
+
+typedef struct tagEQFILTER {                // see DoEquationFilter(..)
+   unsigned char *pucBits;                  // one bit per row, set if selected (may be NULL)
+   int           *piSel;                    // indices of selected rows, one per row (may be NULL)
+   int            iNumSel;                  // number of rows selected
+   int            iNumErr;                  // rows left out because of an error
+} EQFILTER;
+
+//---Bound variables----------------------------
+// Where DoEquationBound(..) finds a variable: the value of row
+// r is at (char*) pBase + r * uStride, of type iType. Stride
+// sizeof(STRUCT) reads one member of an array of structs,
+// stride sizeof(double) a column, stride 0 the same value in
+// every row.
+#define EQBIND_DOUBLE                 0     // double
+#define EQBIND_FLOAT                  1     // float
+#define EQBIND_INT32                  2     // 32-bit signed integer
+
+typedef struct tagEQBIND {
+   const void *pBase;                       // value of row 0
+   size_t      uStride;                     // bytes from one row to the next
+   int         iType;                       // EQBIND_ type
+} EQBIND;
+double EqBindValue(const EQBIND *pb, int iRow); // value of row iRow
+
+//---Array variables (CLCEqArray.cpp)-----------
+typedef struct tagEQARRAYPLAN EQARRAYPLAN;  // programs of the reductions
+
+//---Tables (CLCEqTable.cpp)--------------------
+// Data registered by CEquation::AddTable(..) for interp1(..).
+// The table's name stands for uHandle in equations. Values
+// are stored in SI units, with the slope of each segment.
+#define EQINTERP_CLAMP           0x0001     // hold the end values outside the grid
+#define EQINTERP_EXTRAPOLATE     0x0002     // extend the end segments outside the grid
+
+typedef struct tagEQINTERPTABLE {
+   unsigned int uHandle;                    // 24-bit hash of the name, exact in float
+   UINT         uFlags;                     // EQINTERP_ flags
+   int          iNum;                       // grid points
+   BOOL         tfUniform;                  // x[k] = dX0 + k / dInvDx
+   double       dX0, dXN;                   // first and last grid point
+   double       dInvDx;                     // 1 / grid spacing, if tfUniform
+   const double *pdX;                       // grid, iNum points (NULL if tfUniform)
+   const double *pdYS;                      // y[k] and the slope from k to k+1, in pairs
+   UNITBASE     uUnitX, uUnitY;             // dimensions of grid and values
+   const char  *pszName;                    // name in equations
+} EQINTERPTABLE;
+
+const EQINTERPTABLE *EqFindTable(double dHandle); // table by handle, NULL if none
+const EQINTERPTABLE *EqFindTableName(const char *psz, int iLen); // table by name
+double EqInterp1(const EQINTERPTABLE *pt, double x, int *piErr); // y(x), EQERR_MATH_DOMAIN outside
+void   EqInterp1Batch(const EQINTERPTABLE *pt, const double px[], double py[], int n, unsigned char pucBad[]);
+void   EqInterp1Batch(const EQINTERPTABLE *pt, const float  px[], float  py[], int n, unsigned char pucBad[]);
+
+//---User functions (CLCEqFunc.cpp)------------
+// Defined by CEquation::DefineFunction(..), inlined into the
+// programs that call them.
+#define EQFUNC_MAXPARAM              16     // parameters of a user function
+typedef struct tagEQFUNCTION EQFUNCTION;    // name, parameter count and program
+const EQFUNCTION *EqFindFunction(const char *psz, int iLen); // function by name, NULL if none
+BOOL EqIsBuiltinName(const char *psz, int iLen); // built-in function, operator or constant
+
+//---Callbacks (CLCEqFunc.cpp)------------------
+// Native functions registered by CEquation::AddCallback(..).
+// A VOTYP_CALL token points to the EQCALLBACK. The scalar
+// function sets *piErr (EQERR_NONE on entry) on failure; the
+// batch function, if any, returns non-zero to have the rows
+// evaluated one at a time instead.
+#define EQCALLBACK_MAXARG             8     // arguments of a callback
+#define EQCALLBACK_SAMEDIM       0x0001     // arguments of one dimension, answer of the same
+#define EQCALLBACK_ANYDIM        0x0002     // arguments not checked
+typedef double (*EQCALLBACKFN)(const double pdArg[], void *pUser, int *piErr);
+typedef int    (*EQCALLBACKBATCHFN)(const double *const pdArg[], int iNumRows, double pdAns[], void *pUser);
+
+struct tagEQCALLBACK {
+   EQCALLBACKFN      pfn;                   // one row
+   EQCALLBACKBATCHFN pfnBatch;              // many rows, or NULL
+   void             *pUser;                 // passed to both
+   int               iArgc;                 // arguments, 1..EQCALLBACK_MAXARG
+   UINT              uFlags;                // EQCALLBACK_ dimension rule
+   UNITBASE          uUnitArg[EQCALLBACK_MAXARG]; // dimensions of the arguments
+   UNITBASE          uUnitAns;              // dimension of the answer
+   unsigned int      uHash;                 // FNV-1a hash of the name
+   const char       *pszName;               // name in equations
+};
+
+const EQCALLBACK *EqFindCallback(const char *psz, int iLen); // callback by name, NULL if none
+int EqCallbackDim(const EQCALLBACK *pc, const UNITBASE puArg[], UNITBASE *puAns); // dimension rule
+
+//---Native code (CLCEqNative.cpp)--------------
+#define EQNATIVE_ABI                  1     // increment when exported signatures change
+typedef int (*EQNATIVEFN)(const double *pdVar, double *pdAns, int *piPos);
+typedef int (*EQNATIVEBATCHFN)(const double *const pdVar[], int iNumRows, double pdAns[], int *piErrRow, int *piPos);
+
+//---Profiling (CLCEqProfile.cpp)---------------
+// Compile with EQPROFILE defined to count the executions and
+// ticks of every token in DoEquation(..) and the batch calls;
+// see EnableProfile(..). Without it the counters compile out.
+#ifdef EQPROFILE
+# if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#  include <intrin.h>                       // __rdtsc
+#  define EQPROFILE_TICKS()     __rdtsc()
+#  define EQPROFILE_TICKUNIT    "cycles"
+# elif defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>                    // __rdtsc
+#  define EQPROFILE_TICKS()     __rdtsc()
+#  define EQPROFILE_TICKUNIT    "cycles"
+# else
+#  define EQPROFILE_TICKS()     EqProfileNs()
+#  define EQPROFILE_TICKUNIT    "ns"
+# endif
+unsigned long long EqProfileNs(void);       // monotonic clock in nanoseconds
+#endif//EQPROFILE
+
+#define EQPROFILE_BYOP                0     // GetProfile(..): one entry per operator
+#define EQPROFILE_BYPOS               1     // one entry per source position
+#define EQPROFILE_TEXT                0     // DumpProfile(..): table
+#define EQPROFILE_JSON                1     // single JSON object
+
+typedef struct tagEQPROFILETOKEN {          // counters of one program token
+   unsigned long long uCount;               // executions (rows, for batches)
+   unsigned long long uTimed;               // intervals timed (chunks, for batches)
+   unsigned long long uTicks;               // ticks spent
+} EQPROFILETOKEN;
+
+typedef struct tagEQPROFILEENTRY {          // see GetProfile(..)
+   int    uTyp;                             // VOTYP_ of the token(s)
+   int    iOp;                              // OP_ code if VOTYP_OP
+   const char *pszName;                     // OP2STR(..), or "Value", "Variable", "Unit", "Prefix"
+   int    iPos;                             // position in source string (-1 for EQPROFILE_BYOP)
+   int    iLen;                             // characters at iPos, e.g. whole "sin(..)" call
+   unsigned long long uCount;               // executions
+   unsigned long long uTicks;               // ticks in the token(s) themselves, less timer overhead
+   unsigned long long uTicksTotal;          // including arguments (EQPROFILE_BYPOS only)
+} EQPROFILEENTRY;
+
 /*********************************************************
 * CEquation declaration
 *********************************************************/
 class CEquation {
+   friend class CEquationCache;             // copies compiled programs in and out
+   friend class CEquationLibrary;           // writes programs, attaches to mapped ones
+   friend class CEquationPool;              // stores programs, attaches to pooled ones
 private:
    char  *pszSrcEquation;                   // string of equation source
    int    iEqnLength;                       // number of legitimate ops in valop stack
    VALOP *pvoEquation;                      // array of ops
+   BOOL   m_tfAttached;                     // source and ops belong to a library or pool
+   EQREFCOUNT *m_plRefs;                    // copies sharing source and ops, with the source buffer
    int    iError;                           // error that occured
    int    iErrorLocation;                   // location of error (pointer into SrcEquation)
+   int    m_iSrcAlloc;                      // bytes allocated at pszSrcEquation
+   int    m_iEqnAlloc;                      // VALOPs allocated at pvoEquation
    char   m_szUnit[32];                     // formatted string before output
    UNITBASE m_uUnitTarget;                  // target unit base
    double   m_dScleTarget;                  // target scaling
@@ -404,25 +306,112 @@ private:
    void   FreeSrcEquation(void);            // free previously allocated buffer
    BOOL   AllocEquation(int iNumOps);       // allocate memory for the VALOP stack
    void   FreeEquation(void);               // free previously allocated memory
+   int    _CopyProgram(const CEquation *pEqSrc); // duplicate another equation's compiled program
+   void   _Detach(void);                    // drop references to library-owned buffers
+   void   _Unshare(void);                   // drop share of copied program
+   BOOL   _CountProgram(void);              // allocate m_plRefs for our own source buffer
+   void   _ShareProgram(const CEquation *pEqSrc); // refer to another equation's program
+   static BOOL _CheckProgram(const VALOP *pvo, int iNumOps, int iNumVar); // tokens safe to evaluate
+   void   _Construct(void);                 // initialize all members
+   void   _MoveFrom(CEquation *pEq);        // take over all members, leaving pEq empty
+   void   _Destruct(void);                  // free everything owned
+   int   _ParseEquation(const char *_szEqtn, const char *pszVars, CEqArena *pArena);
    int   _ProcessOps(TEqStack<VALOP> *pvosParsEqn, TEqStack<int> *pisOps, TEqStack<int> *pisPos, int iThisOp, int iBrktOff);
 
    int   _ParseEquationUnits(const char *_szEqtnOffset, int iThisPt, int iBrktOff,
       TEqStack<int> &isOps, TEqStack<int> &isPos, TEqStack<VALOP> &vosParsEqn,
       UINT uLookFor);
 
-   void _AnswerUnitString(double *pdVal, UNITBASE *puUnit, BOOL tfAllowDerived=TRUE); // automatic determination of answer
+   UNITBASE m_uUnitAns;                     // dimension of last answer
+   BOOL     m_tfUnitAnsDerived;             // last answer allows derived units
+   BOOL     m_tfUnitStale;                  // m_szUnit not yet formatted for last answer
+   void _ResetProgramState(void);           // forget answer dimension and analysis
+   static void _AnswerUnitString(UNITBASE *puUnit, BOOL tfAllowDerived, char *pszOut, size_t len); // automatic determination of answer
+
+   //---Batch evaluation (CLCEqBatch.cpp)---
+   BOOL     m_tfAnalyzed;                   // _AnalyzeProgram() has run for this program
+   BOOL     m_tfBatchScalar;                // evaluate batches row by row (see _AnalyzeProgram)
+   int      m_iBatchDepth;                  // maximum stack depth
+   int      m_iBatchNumVar;                 // number of variables referenced
+   UNITBASE m_uUnitStatic;                  // answer dimension, same for every row
+   double  *m_pdConst;                      // constants and unit factors by token (see _AnalyzeProgram)
+   float   *m_pfConst;                      // the same in float, within m_pdConst's block
+   int      m_iConstAlloc;                  // entries allocated per table
+   void _AnalyzeProgram(CEqArena *pArena=NULL); // static unit and stack analysis
+   void _BuildConstTable(void);             // fill m_pdConst, m_pfConst
+   template<class T> BOOL _DoBatchRow(const T *const pVar[], const EQBIND *pBind, int iRow, double *pdRow, T pAns[], EQBATCHSTATUS *pStatus, EQROWERROR *pFirst); // one row via DoEquation
+   template<class T> int  _DoEquationBatch(const T *const pVar[], const EQBIND *pBind, int iNumRows, T pAns[], const T *pConst, UINT uFlags, EQBATCHSTATUS *pStatus, int *piErrRow, EQFILTER *pFilter=NULL);
+   template<class T> BOOL _DoFilterRow(const T *const pVar[], const EQBIND *pBind, int iRow, double *pdRow, EQFILTER *pFilter); // one row via DoEquation
+   unsigned char *_FilterConjuncts(void);   // tokens ending a top-level && operand
+   int     *_StackHeights(void);            // stack height after each token (malloc'd)
+   const UNITBASE *m_puRefUnit;             // dimensions of variables, NULL if all dimensionless
+
+   //---Array variables (CLCEqArray.cpp)----
+   EQARRAYPLAN *m_pArray;                   // reductions split into programs, see DoEquationArray(..)
+   BOOL  _BuildArrayPlan(void);             // fill m_pArray
+   void  _FreeArrayPlan(void);              // free m_pArray
+   CEquation *_ArrayProgram(int iStart, int iEnd, BOOL tfTarget); // tokens with reductions as variables
+
+   //---Tables (CLCEqTable.cpp)-------------
+   static int _AddTable(const char *pszName, const double pdX[], double dX0, double dDx, const double pdY[], int iNum, UINT uFlags, const char *pszUnitX, const char *pszUnitY);
+
+   //---User functions (CLCEqFunc.cpp)-----
+   int   _ResolveFunctions(void);           // inline user functions, point to callbacks
+
+   //---Native code (CLCEqNative.cpp)-------
+   void    *m_hNative;                      // loaded shared object, or NULL
+   EQNATIVEFN      m_pfnNative;             // compiled DoEquation(..)
+   EQNATIVEBATCHFN m_pfnNativeBatch;        // compiled DoEquationBatch(..)
+   char *_NativeSource(void);               // generate C source (malloc'd)
+   int   _LoadNative(const char *pszLib);   // attach shared object
+   int   _DoEquationNative(double dVar[], double *pdAns, BOOL tfAllowDerived);
+   int   _DoEquationNativeBatch(const double *const pdVar[], int iNumRows, double pdAns[], int *piErrRow);
+
+   //---Profiling (CLCEqProfile.cpp)--------
+   BOOL     m_tfProfile;                    // counting enabled, see EnableProfile(..)
+   EQPROFILETOKEN *m_pProfile;              // counters by token, allocated on first use
+   unsigned long long m_uProfileEvals;      // evaluations (rows) counted
+   unsigned long long m_uProfileBias;       // timer overhead per token, in ticks
+   EQPROFILETOKEN *_ProfileCounters(void);  // m_pProfile if enabled, else NULL
 public:   int  _StringToUnit(const char *_szEqtnOffset, char *pszUnitOut, int iLen, UNITBASE *pUnit, double *pdScale, double *pdOffset);
 
 
 public:
    CEquation(void);                         // constructor and initialization
+   CEquation(const CEquation &Eq);          // copy, sharing the compiled program
+   CEquation& operator=(const CEquation &Eq);
+#ifdef EQMOVE
+   CEquation(CEquation &&Eq);               // move, leaving Eq empty
+   CEquation& operator=(CEquation &&Eq);
+#endif//EQMOVE
    ~CEquation();                            // destructor
-   int    ParseEquation(const char *szEqn, const char *pszVars); // supply a new string and parse it
+   int    ParseEquation(const char *szEqn, const char *pszVars, CEqParseContext *pCtx=NULL); // supply a new string and parse it
    int    DoEquation(double dVar[], double *dAns, BOOL tfAllowAssign=FALSE, BOOL tfAllowDerived=FALSE); // calculate equation - returns err code
+   int    DoEquationBatch(const double *const pdVar[], int iNumRows, double pdAns[], int *piErrRow=NULL, UINT uFlags=0); // calculate many rows, variables by column
+   int    DoEquationBatchRows(const double *const pdVar[], int iNumRows, double pdAns[], EQBATCHSTATUS *pStatus, UINT uFlags=0); // as above, errors reported per row
+   int    DoEquation(float fVar[], float *pfAns); // single precision
+   int    DoEquationBatch(const float *const pfVar[], int iNumRows, float pfAns[], int *piErrRow=NULL, UINT uFlags=0);
+   int    DoEquationBatchRows(const float *const pfVar[], int iNumRows, float pfAns[], EQBATCHSTATUS *pStatus, UINT uFlags=0);
+   int    DoEquationBound(const EQBIND pBind[], int iNumRows, double pdAns[], int *piErrRow=NULL, UINT uFlags=0); // variables read in place, see EQBIND
+   int    DoEquationBoundRows(const EQBIND pBind[], int iNumRows, double pdAns[], EQBATCHSTATUS *pStatus, UINT uFlags=0);
+   int    DoEquationBound(const EQBIND pBind[], int iNumRows, float pfAns[], int *piErrRow=NULL, UINT uFlags=0);
+   int    DoEquationFilter(const double *const pdVar[], int iNumRows, EQFILTER *pFilter, UINT uFlags=0); // select rows with non-zero answers
+   int    DoEquationFilterBound(const EQBIND pBind[], int iNumRows, EQFILTER *pFilter, UINT uFlags=0);
+   int    DoEquationArray(const EQBIND pBind[], int iNumElem, double *pdAns, UINT uFlags=0); // array variables, reduced by sum(..) etc.
+   static int AddTable(const char *pszName, const double pdX[], const double pdY[], int iNum, UINT uFlags=0, const char *pszUnitX=NULL, const char *pszUnitY=NULL); // data for interp1(..)
+   static int AddTable(const char *pszName, double dX0, double dDx, const double pdY[], int iNum, UINT uFlags=0, const char *pszUnitX=NULL, const char *pszUnitY=NULL); // on a uniform grid
+   static void FreeTables(void);            // forget all tables
+   static int DefineFunction(const char *pszDef); // user function, e.g. "sq(x) = x*x"
+   static void FreeFunctions(void);         // forget all user functions
+   static int AddCallback(const char *pszName, int iArgc, EQCALLBACKFN pfn, EQCALLBACKBATCHFN pfnBatch=NULL, void *pUser=NULL,
+      UINT uFlags=0, const char *pszUnitArg=NULL, const char *pszUnitAns=NULL); // native function
+   static void FreeCallbacks(void);         // forget all callbacks
+   static int ConvertUnits(const char *pszFrom, const char *pszTo, const double pdIn[], double pdOut[], int iNum); // convert values between units
    double Answer(double dVar[], BOOL tfAllowAssign=FALSE);      // overloaded equation solver, no error info
    void   GetEquationString(char *szBuf, size_t len); // get source string
    int    GetLastError(char *szBuffer, size_t len); // position and description of last error
    void   LastErrorMessage(char *szBuffer, size_t len, const char *szSource); // formatted message string
+   size_t GetMemoryUsage(void);             // bytes of this object and the buffers it owns
    //void   LastErrorMessageBox(HWND hWnd, const char *szTitle); // MessageBox describing last error
 
    BOOL   ParseConstantEquation(const char *szEqtn, double *pdAns); // parse an equation without variables
@@ -434,11 +423,83 @@ public:
    int    GetEquationLength(void) { return(iEqnLength); }; // returns equation length (debug only)
 
    const char* _GetSrcEqStr(void) { return(pszSrcEquation); }; // returns pointer to internal source equation (debug only)
-   const char* _AnswerUnitStr(void) { return(m_szUnit); }; // return last formatted unit (for convenience)
+   const char* _AnswerUnitStr(void);        // return last answer's unit, formatted on demand
+
+   int    SaveEquation(void *pBuf, size_t *pLen); // write compiled equation to buffer
+   int    LoadEquation(const void *pBuf, size_t len, const char *pszVars, BOOL *ptfReparsed=NULL); // restore saved equation
+   int    SaveEquationFile(FILE *fp);       // append compiled equation to file
+   int    LoadEquationFile(FILE *fp, const char *pszVars, BOOL *ptfReparsed=NULL); // read next saved equation
+
+   int    WriteNativeSource(char *pszBuf, size_t *pLen); // C source of compiled equation
+   int    CompileNative(const char *pszCacheDir=NULL, const char *pszCompiler=NULL); // build and load native code
+   void   FreeNative(void);                 // return to the interpreter
+   BOOL   IsNative(void) { return(m_pfnNative != NULL); }; // native code is loaded
+
+   BOOL   EnableProfile(BOOL tfEnable=TRUE); // count ticks by token (needs EQPROFILE)
+   void   ResetProfile(void);               // zero the counters
+   int    GetProfile(EQPROFILEENTRY *pEntry, int iMax, UINT uBy=EQPROFILE_BYOP); // counters by op or position
+   int    DumpProfile(FILE *fp, UINT uFormat=EQPROFILE_TEXT); // write profile as text or JSON
+};
+
+/*********************************************************
+*  Bump Arena
+*  Memory handed out in order and given back all at once
+*  by Reset(). Blocks come from malloc(..) as needed, each
+*  twice the last up to EQARENA_MAXBLOCK; Reset() or Free()
+*  gives them back. Reset() merges them into one block of
+*  the combined size, so an arena reused for similar work
+*  settles on a single block and stops allocating.
+*********************************************************/
+#define EQARENA_BLOCK              4096     // smallest block
+#define EQARENA_MAXBLOCK        1048576     // doubling stops here
+#define EQARENA_ALIGN                16     // alignment of every allocation
+
+typedef struct tagEQARENABLOCK {
+   struct tagEQARENABLOCK *pPrev;           // previous (full) block
+   size_t len;                              // bytes of data after header
+   size_t used;                             // bytes handed out
+} EQARENABLOCK;
+
+class CEqArena {
+private:
+   EQARENABLOCK *m_pBlock;                  // current block, NULL if none
+   char         *m_pcLast;                  // most recent allocation, may grow in place
+   size_t        m_lenTotal;                // bytes in all blocks
+   int           m_iNumAlloc;               // blocks allocated over lifetime
+   BOOL  _NewBlock(size_t len);             // chain a block of at least len bytes
+   CEqArena(const CEqArena&);               // not copyable
+   CEqArena& operator=(const CEqArena&);
+public:
+   CEqArena(void);                          // empty arena
+   ~CEqArena();                             // frees all blocks
+   void  *Alloc(size_t len);                // aligned memory, NULL if out of memory
+   void  *Grow(void *p, size_t lenOld, size_t lenNew); // enlarge in place if last, else move
+   void   Reset(void);                      // forget all allocations, keep memory
+   void   Free(void);                       // return all memory
+   size_t Size(void) { return(m_lenTotal); }; // bytes held
+   int    NumAlloc(void) { return(m_iNumAlloc); }; // blocks allocated so far
+};
+
+/*********************************************************
+*  CEqParseContext declaration
+*  Scratch memory for ParseEquation(..), kept between calls
+*  so that parsing many equations in a row allocates only
+*  for the programs it produces. One context per thread.
+*********************************************************/
+class CEqParseContext {
+   friend class CEquation;                  // parses into m_Arena
+private:
+   CEqArena m_Arena;                        // parse stacks, unit analysis
+public:
+   size_t Size(void) { return(m_Arena.Size()); }; // bytes held
+   int    NumAlloc(void) { return(m_Arena.NumAlloc()); }; // blocks allocated so far
+   void   Trim(void) { m_Arena.Free(); };   // give the memory back
 };
 
 /*********************************************************
 *  Stack Template
+*  With a CEqArena, the stack takes its memory from the
+*  arena and never frees it; the arena is reset as a whole.
 *********************************************************/
 #define EQSTACK_CHUNK                16     // chunks of elements to allocate at a time
 template<class T> class TEqStack {
@@ -447,9 +508,10 @@ private:
    T    tNul;                               // NULL returned on errors
    int  iLen;                               // number of entries allocated
    int  iTop;                               // pointer to top of stack
+   CEqArena *pArena;                        // memory source, NULL for malloc
    int  Alloc(int iNewLen);                 // allocate more memory
 public:
-   TEqStack(void);                          // initialize
+   TEqStack(CEqArena *_pArena=NULL, int iInitLen=EQSTACK_CHUNK); // initialize
    ~TEqStack();                             // exit
    int  Push(T t);                          // push a value - return top
    T    Pop(void);                          // pop a value
@@ -462,35 +524,45 @@ public:
 
 //---Management---------------------------------
 template <class T>
-TEqStack<T>::TEqStack(void) {
+TEqStack<T>::TEqStack(CEqArena *_pArena, int iInitLen) {
    tStck = (T*) NULL; iLen = 0;             // nothing allocated yet
    memset(&tNul, 0x00, sizeof(T));          // prepare NULL for errors
    iTop = 0;                                // no elements in stack
-   Alloc(EQSTACK_CHUNK);                    // allocate some space
+   pArena = _pArena;                        // memory source
+   Alloc(MAX(iInitLen, EQSTACK_CHUNK));     // allocate some space
 }
 
 template <class T>
 TEqStack<T>::~TEqStack() {
-   if(tStck) delete(tStck); tStck = (T*) NULL; iLen = 0; // free existing
+   if(tStck && !pArena) free(tStck);        // arena memory goes with the arena
 }
 
 template <class T>
 int TEqStack<T>::Alloc(int iNewLen) {
    T *ptStckNew;                            // new stack
    if((iNewLen==iLen) || (iNewLen<iTop)) return(iLen);   // ignore non-changes and too-smalls
+   if(pArena) {                             // grows in place if allocated last
+      ptStckNew = (T*) pArena->Grow(tStck, iLen*sizeof(T), iNewLen*sizeof(T));
+      if(ptStckNew == (T*) NULL) return(iLen);
+      tStck = ptStckNew;
+      iLen  = iNewLen;
+      return(iNewLen);
+   }
    ptStckNew = (T*) malloc(iNewLen * sizeof(T));         // allocate new stack
    if(ptStckNew == (T*) NULL) return(iLen);              // return existing length on alloc failure
    memset(ptStckNew, 0x00, iNewLen * sizeof(T));         // clear stack (not really necessary)
    memcpy(ptStckNew, tStck, iTop*sizeof(T));             // copy as needed
-   if(tStck) delete(tStck); tStck = (T*) NULL; iLen = 0; // free existing
+   if(tStck) free(tStck);                   // free existing
    tStck = ptStckNew; iLen = iNewLen;       // point to new stack
    return(iNewLen);
 }
 
 //---Functions----------------------------------
+// Arena stacks grow by doubling: a stack that is not the
+// arena's last allocation moves, and leaves its old space.
 template <class T>
 int TEqStack<T>::Push(T t) {
-   if(iTop >= iLen) Alloc(iLen + EQSTACK_CHUNK); // allocate some more
+   if(iTop >= iLen) Alloc((pArena) ? 2*iLen : iLen + EQSTACK_CHUNK); // allocate some more
    if(iTop >= iLen) return(-1);             // didn't work, return with error
    tStck[iTop] = t;                         // save the value and..
    iTop++;                                  //..increment the counter
@@ -499,7 +571,7 @@ int TEqStack<T>::Push(T t) {
 
 template <class T>
 int TEqStack<T>::InsertBack(T t, int iOffs) {
-   if(iTop >= iLen) Alloc(iLen + EQSTACK_CHUNK); // allocate some more
+   if(iTop >= iLen) Alloc((pArena) ? 2*iLen : iLen + EQSTACK_CHUNK); // allocate some more
    if(iTop >= iLen) return(-1);             // didn't work, return with error
    for(int k=iTop; k>iTop+iOffs; k--) tStck[k]=tStck[k-1];
    tStck[iTop+iOffs] = t;
@@ -0,0 +1,617 @@
+/*****************************************************************************
+*  CLCEqBench.cpp                                       CSIVM LaserCanvas
+*  Throughput and latency benchmark of the CEquation parse and evaluate paths
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* Stand-alone program, linked with the CEquation sources:
+*
+*    c++ -O2 -o ceqbench bench/CLCEqBench.cpp CLCEqtn.cpp CLCEqBatch.cpp \
+*        CLCEqFast.cpp CLCEqNative.cpp CLCEqProfile.cpp CLCEqPool.cpp \
+*        CLCEqArray.cpp CLCEqTable.cpp CLCEqFunc.cpp -lpthread -ldl
+*    ./ceqbench -c bench/CLCEqBench.txt -o bench_output.txt
+*
+* Add -DEQPROFILE to use -p, which writes the DumpProfile(..) of each equa-
+* tion, one JSON object per line, to find the operators that make it slow.
+*
+* With -a the program measures accuracy instead of time: every approximate
+* kernel of CLCEqFast.cpp, at each tier and in double and float, is compared
+* with libm by EqFastMeasure(..), over the whole domain of the function or the
+* range given with -r. Each result is one line of JSON with the largest error
+* in ulp and its argument, and the largest and RMS relative errors, e.g.
+*
+*    ./ceqbench -a 10000000 -r -1000 1000
+*
+* to choose the EQBATCH_FASTMATH tier for the arguments a deployment sees.
+*
+* Every equation of the corpus (CLCEqBench.txt) is timed on each path of each
+* engine selected with -e:
+*
+*  interp   parse     ParseEquation(..)
+*           parsectx  ParseEquation(..) with a CEqParseContext kept between
+*                     calls
+*           eval      DoEquation(..)
+*           answer    Answer(..)
+*           const     ParseConstantEquation(..), on the equation with the var-
+*                     iables replaced by their values
+*  batch    eval      DoEquationBatch(..) over EQBENCH_BATCHROWS rows, time
+*                     per row
+*  native   eval      DoEquation(..) after CompileNative(..); skipped for pro-
+*                     grams that stay interpreted
+*  pool     eval      CEquationPool::DoEquation(..) over EQBENCH_POOLCOPIES
+*                     pooled copies in handle order, time per call
+*
+* With the pool engine, the last line compares the memory held per equation
+* by the pool with that of the same equations as stand-alone CEquations.
+*
+* Calls are timed in groups, long enough to be well above the timer resolu-
+* tion; the latency of a call is the group time divided by the calls in the
+* group. Each result is one line of JSON on the output, with the median, the
+* 90th and 99th percentiles and the fastest of the samples in nanoseconds per
+* call, and the throughput from the mean. The first line describes the run.
+* Results of different engines, versions or machines line up by "id", "engine"
+* and "path", so that tools can compare them without knowing the corpus.
+*
+* Options
+* -------
+*  -c file     corpus (default CLCEqBench.txt)
+*  -o file     output (default stdout)
+*  -e list     engines, comma separated (default interp,batch); any of
+*              interp, batch, native, pool
+*  -n num      samples per result (default EQBENCH_SAMPLES)
+*  -t class    only equations of this class
+*  -k dir      cache directory for CompileNative(..)
+*  -p file     per-operator profile of EQBENCH_PROFILEREPS evaluations of
+*              each equation (needs EQPROFILE)
+*  -g n seed   print a generated equation of n terms and exit; the "long"
+*              entries of the corpus were made this way
+*  -a num      accuracy of the fast math kernels at num arguments each (0
+*              for EQBENCH_ACCURACYPTS), then exit
+*  -r lo hi    range of arguments for -a (default: whole domain)
+*
+* An equation of the corpus that does not parse is named on stderr, and the
+* bench exits with status 2 once the others have run.
+******************************************************************************/
+#include "../CLCEqtn.h"                     // CEquation class
+#include "../CLCEqPool.h"                   // CEquationPool class
+#include "../CLCEqFast.h"                   // EqFastMeasure(..)
+#include <stdlib.h>                         // malloc, qsort, strtol
+#ifdef _WIN32
+# define EQBENCH_TIMER        "QueryPerformanceCounter"
+#else
+# include <time.h>                          // clock_gettime
+# define EQBENCH_TIMER        "CLOCK_MONOTONIC"
+#endif//_WIN32
+
+#define EQBENCH_MAXLINE           16384     // longest corpus line
+#define EQBENCH_MAXVAR               64     // variables per equation
+#define EQBENCH_MAXVARLIST         1024     // length of variable list
+#define EQBENCH_SAMPLES             201     // default samples per result
+#define EQBENCH_MINGROUPNS         5000     // shortest timed group of calls
+#define EQBENCH_BATCHROWS          1024     // rows per DoEquationBatch(..)
+#define EQBENCH_PROFILEREPS       10000     // evaluations per profile (-p)
+#define EQBENCH_POOLCOPIES         1000     // copies of each equation in the pool
+#define EQBENCH_ACCURACYPTS     1000000     // default arguments per accuracy result (-a)
+
+//===Engines==============================================
+#define EQBENCH_INTERP             0x01
+#define EQBENCH_BATCH              0x02
+#define EQBENCH_NATIVE             0x04
+#define EQBENCH_POOL               0x08
+
+//---Corpus entry-------------------------------
+typedef struct tagEQBENCHENTRY {
+   char   szClass[32];                      // class, e.g. "short"
+   char   szId[48];                         // class and number, e.g. "short.3"
+   char  *pszEqn;                           // equation (malloc'd)
+   char  *pszConst;                         // equation with values in place of variables (malloc'd)
+   char   szVars[EQBENCH_MAXVARLIST];       // double-NULL terminated variable list
+   int    iNumVar;                          // number of variables
+   double dVar[EQBENCH_MAXVAR];             // values of variables
+} EQBENCHENTRY;
+
+//---Timed function-----------------------------
+// Makes iReps calls; returns a sum of the answers so
+// that the calls can not be optimized away.
+typedef struct tagEQBENCHCTX {
+   EQBENCHENTRY *pEntry;                    // equation
+   CEquation    *pEq;                       // parsed equation
+   const double *pdCol[EQBENCH_MAXVAR];     // batch columns
+   double       *pdAns;                     // batch answers
+   CEqParseContext *pParse;                 // parse scratch kept between calls
+   CEquationPool *pPool;                    // pooled equations
+   int           hPool;                     // handle of first pooled copy
+} EQBENCHCTX;
+typedef double (*EQBENCHFN)(EQBENCHCTX *pCtx, int iReps);
+
+//---Result-------------------------------------
+typedef struct tagEQBENCHSTATS {
+   double dP50, dP90, dP99, dMin;           // ns per call
+   double dMean;                            // ns per call
+   int    iGroup;                           // calls per sample
+   int    iSamples;                         // samples taken
+} EQBENCHSTATS;
+
+static volatile double _dEqBenchSink;       // keeps answers alive
+
+/*********************************************************
+* _EqBenchNow
+* Monotonic time in nanoseconds.
+*********************************************************/
+static double _EqBenchNow(void) {
+#ifdef _WIN32
+   static LARGE_INTEGER liFreq;             // counts per second
+   LARGE_INTEGER        liNow;              // current count
+   if(liFreq.QuadPart == 0) QueryPerformanceFrequency(&liFreq);
+   QueryPerformanceCounter(&liNow);
+   return((double) liNow.QuadPart * 1e9 / (double) liFreq.QuadPart);
+#else
+   struct timespec ts;                      // current time
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((double) ts.tv_sec * 1e9 + (double) ts.tv_nsec);
+#endif//_WIN32
+}
+
+/*********************************************************
+* Timed Paths
+*********************************************************/
+static double _EqBenchParse(EQBENCHCTX *pCtx, int iReps) {
+   double dSum = 0.00;
+   for(int k=0; k<iReps; k++) dSum += pCtx->pEq->ParseEquation(pCtx->pEntry->pszEqn, pCtx->pEntry->szVars);
+   return(dSum);
+}
+
+static double _EqBenchParseCtx(EQBENCHCTX *pCtx, int iReps) {
+   double dSum = 0.00;
+   for(int k=0; k<iReps; k++) dSum += pCtx->pEq->ParseEquation(pCtx->pEntry->pszEqn, pCtx->pEntry->szVars, pCtx->pParse);
+   return(dSum);
+}
+
+static double _EqBenchEval(EQBENCHCTX *pCtx, int iReps) {
+   double dSum = 0.00, dAns = 0.00;
+   for(int k=0; k<iReps; k++) { pCtx->pEq->DoEquation(pCtx->pEntry->dVar, &dAns); dSum += dAns; }
+   return(dSum);
+}
+
+static double _EqBenchAnswer(EQBENCHCTX *pCtx, int iReps) {
+   double dSum = 0.00;
+   for(int k=0; k<iReps; k++) dSum += pCtx->pEq->Answer(pCtx->pEntry->dVar);
+   return(dSum);
+}
+
+static double _EqBenchConst(EQBENCHCTX *pCtx, int iReps) {
+   double dSum = 0.00, dAns = 0.00;
+   for(int k=0; k<iReps; k++) { pCtx->pEq->ParseConstantEquation(pCtx->pEntry->pszConst, &dAns); dSum += dAns; }
+   return(dSum);
+}
+
+static double _EqBenchBatch(EQBENCHCTX *pCtx, int iReps) {
+   double dSum = 0.00;
+   for(int k=0; k<iReps; k++) {
+      pCtx->pEq->DoEquationBatch(pCtx->pdCol, EQBENCH_BATCHROWS, pCtx->pdAns);
+      dSum += pCtx->pdAns[k % EQBENCH_BATCHROWS];
+   }
+   return(dSum);
+}
+
+static double _EqBenchPool(EQBENCHCTX *pCtx, int iReps) {
+   double dSum = 0.00, dAns = 0.00;
+   for(int k=0; k<iReps; k++) {
+      pCtx->pPool->DoEquation(pCtx->hPool + k % EQBENCH_POOLCOPIES, pCtx->pEntry->dVar, &dAns);
+      dSum += dAns;
+   }
+   return(dSum);
+}
+
+/*********************************************************
+* _EqBenchMeasure
+* Finds the group size that takes EQBENCH_MINGROUPNS, then
+* times iSamples groups. iPerCall divides out the rows of
+* batch calls.
+*********************************************************/
+static int _EqBenchCmp(const void *pv1, const void *pv2) {
+   double d1 = *(const double*) pv1, d2 = *(const double*) pv2;
+   return((d1 < d2) ? -1 : (d1 > d2) ? 1 : 0);
+}
+
+static BOOL _EqBenchMeasure(EQBENCHCTX *pCtx, EQBENCHFN pfn, int iPerCall, int iSamples, EQBENCHSTATS *pStats) {
+   double *pdSample;                        // ns per call of each sample
+   double  dT0, dT;                         // times
+   int     iGroup;                          // calls per sample
+   int     k;                               // sample counter
+
+   memset(pStats, 0x00, sizeof(EQBENCHSTATS));
+   pdSample = (double*) malloc(iSamples * sizeof(double));
+   if(pdSample == NULL) return(FALSE);
+
+   //---Calibrate-----------------------------
+   _dEqBenchSink += pfn(pCtx, 1);           // warm up
+   for(iGroup=1; iGroup<(1<<24); iGroup*=2) {
+      dT0 = _EqBenchNow();
+      _dEqBenchSink += pfn(pCtx, iGroup);
+      if(_EqBenchNow() - dT0 >= EQBENCH_MINGROUPNS) break;
+   }
+
+   //---Sample--------------------------------
+   for(k=0; k<iSamples; k++) {
+      dT0 = _EqBenchNow();
+      _dEqBenchSink += pfn(pCtx, iGroup);
+      dT  = _EqBenchNow() - dT0;
+      pdSample[k] = dT / ((double) iGroup * iPerCall);
+      pStats->dMean += pdSample[k] / iSamples;
+   }
+   qsort(pdSample, iSamples, sizeof(double), _EqBenchCmp);
+   pStats->dMin  = pdSample[0];             // nearest-rank percentiles
+   pStats->dP50  = pdSample[(int) ceil(0.50 * iSamples) - 1];
+   pStats->dP90  = pdSample[(int) ceil(0.90 * iSamples) - 1];
+   pStats->dP99  = pdSample[(int) ceil(0.99 * iSamples) - 1];
+   pStats->iGroup   = iGroup;
+   pStats->iSamples = iSamples;
+   free(pdSample);
+   return(TRUE);
+}
+
+/*********************************************************
+* _EqBenchReport
+* One JSON line per result; iError is reported instead of
+* times when the path can not run.
+*********************************************************/
+static void _EqBenchReport(FILE *fp, const char *pszEngine, const char *pszPath, const EQBENCHENTRY *pEntry, const EQBENCHSTATS *pStats, int iError) {
+   fprintf(fp, "{\"id\":\"%s\",\"class\":\"%s\",\"engine\":\"%s\",\"path\":\"%s\",\"len\":%d,\"vars\":%d",
+      pEntry->szId, pEntry->szClass, pszEngine, pszPath, (int) strlen(pEntry->pszEqn), pEntry->iNumVar);
+   if((iError != EQERR_NONE) || (pStats == NULL)) {
+      fprintf(fp, ",\"error\":%d}\n", iError);
+   } else {
+      fprintf(fp, ",\"samples\":%d,\"group\":%d,\"ns_p50\":%.2f,\"ns_p90\":%.2f,\"ns_p99\":%.2f,\"ns_min\":%.2f,\"ns_mean\":%.2f,\"per_s\":%.0f}\n",
+         pStats->iSamples, pStats->iGroup, pStats->dP50, pStats->dP90, pStats->dP99, pStats->dMin, pStats->dMean,
+         (pStats->dMean > 0.00) ? 1e9 / pStats->dMean : 0.00);
+   }
+   fflush(fp);
+}
+
+/*********************************************************
+* _EqBenchConstText
+* Copies the equation with every variable replaced by its
+* value in brackets, for ParseConstantEquation(..).
+*********************************************************/
+static char *_EqBenchConstText(const EQBENCHENTRY *pEntry) {
+   const char *psz = pEntry->pszEqn;        // source
+   const char *pszVar;                      // variable loop pointer
+   char  *pszOut, *pszPut;                  // copy
+   int    iTokLen, iVar;                    // identifier, variable index
+
+   pszOut = (char*) malloc(strlen(psz) * 28 + 1); // worst case: every character a variable
+   if(pszOut == NULL) return(NULL);
+   for(pszPut=pszOut; *psz; ) {
+      if(strchr(EQ_VALIDCHAR, *psz) == NULL) { *pszPut++ = *psz++; continue; }
+      for(iTokLen=1; psz[iTokLen] && strchr(EQ_VALIDSYMB, psz[iTokLen]); iTokLen++);
+      for(pszVar=pEntry->szVars, iVar=0; *pszVar; pszVar+=strlen(pszVar)+1, iVar++)
+         if(((int) strlen(pszVar) == iTokLen) && (strncmp(psz, pszVar, iTokLen) == 0)) break;
+      if(*pszVar) pszPut += sprintf(pszPut, "(%.17g)", pEntry->dVar[iVar]);
+      else { memcpy(pszPut, psz, iTokLen); pszPut += iTokLen; }
+      psz += iTokLen;
+   }
+   *pszPut = '\0';
+   return(pszOut);
+}
+
+/*********************************************************
+* _EqBenchLoad
+* Reads the corpus: one equation per line as
+*    class;variables;equation
+* with variables separated by commas. Blank lines and
+* lines starting with '#' are skipped. Variable k is given
+* a fixed value in [0.25, 0.75].
+* Returns the number of entries, -1 on error.
+*********************************************************/
+static int _EqBenchLoad(const char *pszFile, const char *pszClass, EQBENCHENTRY **ppEntry) {
+   FILE  *fp;                               // corpus file
+   char  *pszLine;                          // line buffer
+   char  *pszVars, *pszEqn, *psz;           // fields
+   EQBENCHENTRY *pEntry = NULL, *pNew;      // entries
+   int    iNum = 0, iInClass, iLen, k;      // counters
+   char  *pszOut;                           // variable list copy
+
+   *ppEntry = NULL;
+   if((fp = fopen(pszFile, "rt")) == NULL) return(-1);
+   if((pszLine = (char*) malloc(EQBENCH_MAXLINE)) == NULL) { fclose(fp); return(-1); }
+
+   while(fgets(pszLine, EQBENCH_MAXLINE, fp)) {
+      for(iLen=(int) strlen(pszLine); (iLen > 0) && strchr("\r\n \t", pszLine[iLen-1]); iLen--) pszLine[iLen-1] = '\0';
+      if((pszLine[0] == '\0') || (pszLine[0] == '#')) continue;
+      if((pszVars = strchr(pszLine, ';')) == NULL) continue;
+      *pszVars++ = '\0';
+      if((pszEqn = strchr(pszVars, ';')) == NULL) continue;
+      *pszEqn++ = '\0';
+      if(pszClass && strcmp(pszClass, pszLine)) continue;
+
+      pNew = (EQBENCHENTRY*) realloc(pEntry, (iNum+1) * sizeof(EQBENCHENTRY));
+      if(pNew == NULL) break;
+      pEntry = pNew;
+      memset(&pEntry[iNum], 0x00, sizeof(EQBENCHENTRY));
+      for(iInClass=1, k=0; k<iNum; k++) if(strcmp(pEntry[k].szClass, pszLine) == 0) iInClass++;
+      snprintf(pEntry[iNum].szClass, sizeof(pEntry[iNum].szClass), "%s", pszLine);
+      snprintf(pEntry[iNum].szId, sizeof(pEntry[iNum].szId), "%s.%d", pszLine, iInClass);
+
+      //---Variables-----------------------------
+      if(strlen(pszVars) + 2 > EQBENCH_MAXVARLIST) continue;
+      for(psz=pszVars, pszOut=pEntry[iNum].szVars; *psz; psz++) {
+         if(*psz == ' ') continue;
+         if(*psz == ',') {
+            *pszOut++ = '\0';
+            pEntry[iNum].iNumVar++;
+            continue;
+         }
+         *pszOut++ = *psz;
+      }
+      if(pszOut > pEntry[iNum].szVars) { *pszOut++ = '\0'; pEntry[iNum].iNumVar++; }
+      *pszOut = '\0';
+      if(pEntry[iNum].iNumVar > EQBENCH_MAXVAR) continue;
+      for(k=0; k<pEntry[iNum].iNumVar; k++) pEntry[iNum].dVar[k] = 0.25 + 0.50 * fmod(0.6180339887 * (k+1), 1.00);
+
+      pEntry[iNum].pszEqn   = strdup(pszEqn);
+      pEntry[iNum].pszConst = _EqBenchConstText(&pEntry[iNum]);
+      if(pEntry[iNum].pszEqn && pEntry[iNum].pszConst) iNum++;
+   }
+   free(pszLine);
+   fclose(fp);
+   *ppEntry = pEntry;
+   return(iNum);
+}
+
+/*********************************************************
+* _EqBenchGenerate
+* Prints a long equation of iTerms random terms in the
+* variables x0..x9, reproducible from uSeed.
+*********************************************************/
+static unsigned int _EqBenchRand(unsigned int *puSeed, unsigned int uMod) {
+   *puSeed = *puSeed * 1664525u + 1013904223u; // LCG, same on every platform
+   return((*puSeed >> 8) % uMod);
+}
+
+static void _EqBenchGenerate(FILE *fp, int iTerms, unsigned int uSeed) {
+   static const char *pszFmt[] = {          // %d is a variable, %g a constant
+      "%g*x%d", "sin(x%d)", "cos(%g*x%d)", "sqrt(x%d+%g)", "(x%d-%g)^2", "exp(-x%d)",
+      "log(x%d+%g)", "max(x%d,%g)", "atan2(x%d,%g)", "if(x%d>%g,1,-1)", "abs(x%d-%g)", "x%d/(%g+x%d)" };
+   int iTerm, iDepth = 0, iFmt, iVar;       // counters
+   double dC;                               // constant
+
+   for(iTerm=0; iTerm<iTerms; iTerm++) {
+      if(iTerm > 0) fputs((_EqBenchRand(&uSeed, 3) == 0) ? " - " : (_EqBenchRand(&uSeed, 4) == 0) ? "*" : " + ", fp);
+      if((iDepth < 8) && (_EqBenchRand(&uSeed, 5) == 0)) { fputc('(', fp); iDepth++; }
+      iFmt = (int) _EqBenchRand(&uSeed, sizeof(pszFmt)/sizeof(pszFmt[0]));
+      iVar = (int) _EqBenchRand(&uSeed, 10);
+      dC   = 0.5 + _EqBenchRand(&uSeed, 20) / 4.0;
+      switch(iFmt) {
+      case 0: case 2:  fprintf(fp, pszFmt[iFmt], dC, iVar); break;
+      case 1: case 5:  fprintf(fp, pszFmt[iFmt], iVar); break;
+      case 11:         fprintf(fp, pszFmt[iFmt], iVar, dC, (iVar+1) % 10); break;
+      default:         fprintf(fp, pszFmt[iFmt], iVar, dC); break;
+      }
+      if((iDepth > 0) && (_EqBenchRand(&uSeed, 4) == 0)) { fputc(')', fp); iDepth--; }
+   }
+   for(; iDepth>0; iDepth--) fputc(')', fp);
+   fputc('\n', fp);
+}
+
+/*********************************************************
+* _EqBenchAccuracy
+* Prints the errors of every fast math kernel, tier and
+* precision over iNum arguments between dLo and dHi (the
+* whole domain if dLo >= dHi), one JSON line each.
+*********************************************************/
+static void _EqBenchAccuracy(FILE *fp, int iNum, double dLo, double dHi) {
+   static const int   iOp[] = { OP_EXP, OP_LOG, OP_LOG10, OP_SIN, OP_COS, OP_TAN, OP_ATAN, OP_TANH,
+                                OP_SIND, OP_COSD, OP_TAND, OP_ATAND };
+   static const char *pszOp[] = { "exp", "log", "log10", "sin", "cos", "tan", "atan", "tanh",
+                                  "sind", "cosd", "tand", "atand" };
+   EQFASTERR Err;                           // measured errors
+   int       iErr, k, iTier, iFloat;        // result, loop counters
+
+   fprintf(fp, "{\"bench\":\"CLCEqBench\",\"version\":\"%s\",\"mode\":\"accuracy\",\"points\":%d,\"lo\":%.17g,\"hi\":%.17g}\n",
+      CLCEQTN_SZVERSION, iNum, dLo, dHi);
+   for(k=0; k<(int) (sizeof(iOp)/sizeof(iOp[0])); k++) {
+      for(iTier=EQFAST_LOW; iTier<=EQFAST_HIGH; iTier++) {
+         for(iFloat=0; iFloat<=1; iFloat++) {
+            iErr = EqFastMeasure(iOp[k], iTier, iFloat ? TRUE : FALSE, dLo, dHi, iNum, &Err);
+            fprintf(fp, "{\"engine\":\"fastmath\",\"path\":\"accuracy\",\"op\":\"%s\",\"tier\":\"%s\",\"type\":\"%s\",",
+               pszOp[k], (iTier == EQFAST_HIGH) ? "high" : "low", iFloat ? "float" : "double");
+            if(iErr != EQERR_NONE) { fprintf(fp, "\"error\":%d}\n", iErr); continue; }
+            fprintf(fp, "\"points\":%d,\"max_ulp\":%.3g,\"arg_max_ulp\":%.17g,\"max_rel\":%.3g,\"rms_rel\":%.3g}\n",
+               Err.iNum, Err.dMaxUlp, Err.dArgMaxUlp, Err.dMaxRel, Err.dRmsRel);
+         }
+      }
+   }
+}
+
+/*********************************************************
+* main
+*********************************************************/
+int main(int argc, char *argv[]) {
+   const char   *pszCorpus = "CLCEqBench.txt"; // corpus file
+   const char   *pszOut    = NULL;          // output file, NULL for stdout
+   const char   *pszClass  = NULL;          // class filter
+   const char   *pszCache  = NULL;          // native cache directory
+   const char   *pszProf   = NULL;          // profile output file
+   FILE         *fpProf    = NULL;          // profile output
+   int           iSamples  = EQBENCH_SAMPLES; // samples per result
+   int           iAccuracy = -1;            // arguments per accuracy result, -1 to time
+   double        dLo = 0.00, dHi = 0.00;    // range of accuracy arguments
+   UINT          uEngine   = EQBENCH_INTERP | EQBENCH_BATCH; // engines to run
+   EQBENCHENTRY *pEntry;                    // corpus
+   EQBENCHCTX    Ctx;                       // timed context
+   EQBENCHSTATS  Stats;                     // measurement
+   CEquation     Eq;                        // equation under test
+   CEqParseContext Parse;                   // parse scratch for "parsectx"
+   CEquationPool Pool;                      // pooled copies for "pool"
+   EQPOOLSTATS   PoolStats;                 // memory held by Pool
+   size_t        uBytesAlone = 0;           // memory of the same as stand-alone equations
+   FILE         *fp;                        // output
+   double       *pdBatch;                   // batch columns and answers
+   double        dAns;                      // test answer
+   int           iNum, iEntry, iErr, k, r;  // counters
+   int           iNumFail = 0;              // corpus equations that do not parse
+
+   //===Options===========================================
+   for(k=1; k<argc; k++) {
+      if((strcmp(argv[k], "-c") == 0) && (k+1 < argc)) pszCorpus = argv[++k];
+      else if((strcmp(argv[k], "-o") == 0) && (k+1 < argc)) pszOut = argv[++k];
+      else if((strcmp(argv[k], "-t") == 0) && (k+1 < argc)) pszClass = argv[++k];
+      else if((strcmp(argv[k], "-k") == 0) && (k+1 < argc)) pszCache = argv[++k];
+      else if((strcmp(argv[k], "-p") == 0) && (k+1 < argc)) pszProf = argv[++k];
+      else if((strcmp(argv[k], "-n") == 0) && (k+1 < argc)) { iSamples = atoi(argv[++k]); iSamples = MAX(1, iSamples); }
+      else if((strcmp(argv[k], "-e") == 0) && (k+1 < argc)) {
+         k++; uEngine = 0;
+         if(strstr(argv[k], "interp")) uEngine |= EQBENCH_INTERP;
+         if(strstr(argv[k], "batch"))  uEngine |= EQBENCH_BATCH;
+         if(strstr(argv[k], "native")) uEngine |= EQBENCH_NATIVE;
+         if(strstr(argv[k], "pool"))   uEngine |= EQBENCH_POOL;
+      } else if((strcmp(argv[k], "-a") == 0) && (k+1 < argc)) {
+         iAccuracy = atoi(argv[++k]);
+         if(iAccuracy <= 0) iAccuracy = EQBENCH_ACCURACYPTS;
+      } else if((strcmp(argv[k], "-r") == 0) && (k+2 < argc)) {
+         dLo = atof(argv[k+1]); dHi = atof(argv[k+2]); k += 2;
+      } else if((strcmp(argv[k], "-g") == 0) && (k+2 < argc)) {
+         _EqBenchGenerate(stdout, atoi(argv[k+1]), (unsigned int) strtoul(argv[k+2], NULL, 0));
+         return(0);
+      } else {
+         fprintf(stderr, "usage: %s [-c corpus] [-o out] [-e interp,batch,native,pool] [-n samples] [-t class] [-k cachedir] [-p profile] [-g terms seed] [-a num [-r lo hi]]\n", argv[0]);
+         return(1);
+      }
+   }
+
+   //===Accuracy==========================================
+   if(iAccuracy > 0) {
+      fp = (pszOut) ? fopen(pszOut, "wt") : stdout;
+      if(fp == NULL) { fprintf(stderr, "cannot write %s\n", pszOut); return(1); }
+      _EqBenchAccuracy(fp, iAccuracy, dLo, dHi);
+      if(fp != stdout) fclose(fp);
+      return(0);
+   }
+
+   iNum = _EqBenchLoad(pszCorpus, pszClass, &pEntry);
+   if(iNum < 0) { fprintf(stderr, "cannot read corpus %s\n", pszCorpus); return(1); }
+   fp = (pszOut) ? fopen(pszOut, "wt") : stdout;
+   if(fp == NULL) { fprintf(stderr, "cannot write %s\n", pszOut); return(1); }
+   if(pszProf) {
+      if(!Eq.EnableProfile(FALSE)) { fprintf(stderr, "-p needs a build with -DEQPROFILE\n"); return(1); }
+      if((fpProf = fopen(pszProf, "wt")) == NULL) { fprintf(stderr, "cannot write %s\n", pszProf); return(1); }
+   }
+   pdBatch = (double*) malloc((EQBENCH_MAXVAR+1) * EQBENCH_BATCHROWS * sizeof(double));
+   if(pdBatch == NULL) return(1);
+
+   fprintf(fp, "{\"bench\":\"CLCEqBench\",\"version\":\"%s\",\"corpus\":\"%s\",\"entries\":%d,\"samples\":%d,\"min_group_ns\":%d,\"batch_rows\":%d,\"timer\":\"%s\"}\n",
+      CLCEQTN_SZVERSION, pszCorpus, iNum, iSamples, EQBENCH_MINGROUPNS, EQBENCH_BATCHROWS, EQBENCH_TIMER);
+
+   //===Each Equation=====================================
+   for(iEntry=0; iEntry<iNum; iEntry++) {
+      memset(&Ctx, 0x00, sizeof(Ctx));
+      Ctx.pEntry = &pEntry[iEntry];
+      Ctx.pEq    = &Eq;
+      Ctx.pParse = &Parse;
+
+      //---Parse---------------------------------
+      iErr = Eq.ParseEquation(Ctx.pEntry->pszEqn, Ctx.pEntry->szVars);
+      if(uEngine & EQBENCH_INTERP) {
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchParse, 1, iSamples, &Stats))
+            _EqBenchReport(fp, "interp", "parse", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "interp", "parse", Ctx.pEntry, NULL, iErr);
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchParseCtx, 1, iSamples, &Stats))
+            _EqBenchReport(fp, "interp", "parsectx", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "interp", "parsectx", Ctx.pEntry, NULL, iErr);
+      }
+      if(iErr != EQERR_NONE) {
+         fprintf(stderr, "%s: error %d parsing \"%s\"\n", Ctx.pEntry->szId, iErr, Ctx.pEntry->pszEqn);
+         iNumFail++;
+         continue;
+      }
+      iErr = Eq.DoEquation(Ctx.pEntry->dVar, &dAns);
+
+      //---Interpreter---------------------------
+      if(uEngine & EQBENCH_INTERP) {
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchEval, 1, iSamples, &Stats))
+            _EqBenchReport(fp, "interp", "eval", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "interp", "eval", Ctx.pEntry, NULL, iErr);
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchAnswer, 1, iSamples, &Stats))
+            _EqBenchReport(fp, "interp", "answer", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "interp", "answer", Ctx.pEntry, NULL, iErr);
+      }
+
+      //---Profile-------------------------------
+      if(fpProf && (iErr == EQERR_NONE)) {
+         Eq.EnableProfile(TRUE);
+         _EqBenchEval(&Ctx, EQBENCH_PROFILEREPS);
+         Eq.DumpProfile(fpProf, EQPROFILE_JSON); // one line, in corpus order
+         Eq.EnableProfile(FALSE);
+         Eq.ResetProfile();
+      }
+
+      //---Batch---------------------------------
+      if((uEngine & EQBENCH_BATCH) && (iErr == EQERR_NONE)) {
+         for(k=0; k<Ctx.pEntry->iNumVar; k++) {
+            for(r=0; r<EQBENCH_BATCHROWS; r++)
+               pdBatch[k*EQBENCH_BATCHROWS + r] = Ctx.pEntry->dVar[k] * (1.00 + 1e-6 * r);
+            Ctx.pdCol[k] = pdBatch + k*EQBENCH_BATCHROWS;
+         }
+         Ctx.pdAns = pdBatch + EQBENCH_MAXVAR*EQBENCH_BATCHROWS;
+         iErr = Eq.DoEquationBatch(Ctx.pdCol, EQBENCH_BATCHROWS, Ctx.pdAns);
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchBatch, EQBENCH_BATCHROWS, iSamples, &Stats))
+            _EqBenchReport(fp, "batch", "eval", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "batch", "eval", Ctx.pEntry, NULL, iErr);
+         iErr = EQERR_NONE;
+      }
+
+      //---Native--------------------------------
+      if((uEngine & EQBENCH_NATIVE) && (iErr == EQERR_NONE)) {
+         iErr = Eq.CompileNative(pszCache);
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchEval, 1, iSamples, &Stats))
+            _EqBenchReport(fp, "native", "eval", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "native", "eval", Ctx.pEntry, NULL, iErr);
+         Eq.FreeNative();
+      }
+
+      //---Pool----------------------------------
+      if((uEngine & EQBENCH_POOL) && (iErr == EQERR_NONE)) {
+         CEquation EqAlone;                 // as an application would hold it
+         EqAlone.ParseEquation(Ctx.pEntry->pszEqn, Ctx.pEntry->szVars);
+         EqAlone.DoEquation(Ctx.pEntry->dVar, &dAns);
+         uBytesAlone += EQBENCH_POOLCOPIES * EqAlone.GetMemoryUsage();
+         Ctx.pPool = &Pool;
+         Ctx.hPool = Pool.Parse(Ctx.pEntry->pszEqn, Ctx.pEntry->szVars, &iErr);
+         for(k=1; (k<EQBENCH_POOLCOPIES) && (iErr == EQERR_NONE); k++)
+            if(Pool.Add(&EqAlone) < 0) iErr = EQERR_PARSE_ALLOCFAIL;
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchPool, 1, iSamples, &Stats))
+            _EqBenchReport(fp, "pool", "eval", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "pool", "eval", Ctx.pEntry, NULL, iErr);
+      }
+
+      //---Constant------------------------------
+      if(uEngine & EQBENCH_INTERP) {
+         iErr = Eq.ParseConstantEquation(Ctx.pEntry->pszConst, &dAns);
+         if((iErr == EQERR_NONE) && _EqBenchMeasure(&Ctx, _EqBenchConst, 1, iSamples, &Stats))
+            _EqBenchReport(fp, "interp", "const", Ctx.pEntry, &Stats, EQERR_NONE);
+         else _EqBenchReport(fp, "interp", "const", Ctx.pEntry, NULL, iErr);
+      }
+   }
+
+   //===Pool Memory=======================================
+   if((uEngine & EQBENCH_POOL) && (Pool.GetCount() > 0)) {
+      Pool.GetStats(&PoolStats);
+      fprintf(fp, "{\"engine\":\"pool\",\"path\":\"memory\",\"equations\":%d,\"bytes_per_eq\":%.1f,\"alone_bytes_per_eq\":%.1f,\"ratio\":%.2f}\n",
+         PoolStats.iNumEquations, PoolStats.dBytesPerEquation, (double) uBytesAlone / PoolStats.iNumEquations,
+         (double) uBytesAlone / PoolStats.uBytesHeld);
+   }
+
+   //===Clean Up==========================================
+   for(iEntry=0; iEntry<iNum; iEntry++) { free(pEntry[iEntry].pszEqn); free(pEntry[iEntry].pszConst); }
+   free(pEntry);
+   free(pdBatch);
+   if(fp != stdout) fclose(fp);
+   if(fpProf) fclose(fpProf);
+   if(iNumFail > 0) {
+      fprintf(stderr, "%d of %d corpus equations did not parse\n", iNumFail, iNum);
+      return(2);
+   }
+   return(0);
+}
@@ -0,0 +1,660 @@
+/*****************************************************************************
+*  CLCEqStream.cpp                                      CSIVM LaserCanvas
+*  Evaluates equations over every row of a CSV file or of binary column files
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* Stand-alone Linux program, linked with the CEquation sources:
+*
+*    c++ -O2 -o ceqstream stream/CLCEqStream.cpp CLCEqtn.cpp CLCEqBatch.cpp \
+*        CLCEqFast.cpp CLCEqNative.cpp CLCEqProfile.cpp CLCEqArray.cpp \
+*        CLCEqTable.cpp CLCEqFunc.cpp -lpthread -ldl
+*    ./ceqstream -e "P = V * I" -e "V / I" -o out.csv data.csv
+*
+* The input is mapped into memory, not read: only the pages being evaluated
+* need to be resident, so files much larger than RAM stream through. Two kinds
+* of input are understood:
+*
+*  CSV      one file; the first line names the columns, each later line is a
+*           row of numbers. Empty or unreadable fields are NaN.
+*  binary   -b, then one file per column, raw values in the byte order of the
+*           host (little-endian on x86 and ARM). The file name without its
+*           extension names the column and the extension gives the type:
+*           .f64 (double), .f32 (float) or .i32 (32-bit signed integer). All
+*           files must hold the same number of rows. Double columns are read
+*           where they are mapped (see DoEquationBound(..)), without a copy.
+*
+* The column names are the variables of the equations. Each equation is given
+* by -e, as "name = equation" or as the equation alone, in which case its text
+* names the output column. Only the columns that some equation uses are read.
+*
+* The rows are cut into blocks, which -j threads take in turn: each parses
+* its block (CSV only), evaluates every equation over it EQSTREAM_ROWS rows at
+* a time with DoEquationBatchRows(..) and formats the answers; blocks are then
+* written in their input order, so the output is the same for any number of
+* threads. Memory use does not grow with the input: a few blocks per thread.
+*
+* The output is CSV, a header line and one line of answers per input row, or
+* with -f bin the answers of each row one after the other as doubles, in the
+* byte order of the host. The answer of a row that fails is NaN. On completion
+* the rows, time, rows per second and input MB per second are written to std-
+* err, with the number of answers that failed.
+*
+* Options
+* -------
+*  -e eqn      equation, "name = equation" or "equation"; repeat for more
+*  -o file     output (default stdout)
+*  -f fmt      output format, csv (default) or bin
+*  -b          inputs are binary column files, not one CSV file
+*  -d c        CSV delimiter (default ','), "tab" for a tab
+*  -p digits   significant digits of CSV answers (default EQSTREAM_DIGITS)
+*  -j n        threads (default: processors online)
+*  -u          faster: EQBATCH_UNCHECKED and EQBATCH_FASTMATH_HIGH
+*  -q          no report on stderr
+******************************************************************************/
+#include "../CLCEqtn.h"                     // CEquation class
+#include <stdlib.h>                         // malloc, strtod, atoi
+#include <ctype.h>                          // isalpha, isalnum
+#include <fcntl.h>                          // open
+#include <unistd.h>                         // close, sysconf
+#include <sys/mman.h>                       // mmap, madvise
+#include <sys/stat.h>                       // fstat
+#include <pthread.h>                        // threads
+#include <time.h>                           // clock_gettime
+
+#define EQSTREAM_ROWS              1024     // rows evaluated together
+#define EQSTREAM_CSVBLOCK       1048576     // bytes of CSV per block
+#define EQSTREAM_BINBLOCK         65536     // rows of binary columns per block
+#define EQSTREAM_MAXEQ               64     // equations
+#define EQSTREAM_MAXCOL            1024     // columns
+#define EQSTREAM_MAXTHREAD          256     // threads
+#define EQSTREAM_MAXNAME             64     // length of a column or equation name
+#define EQSTREAM_MAXFIELD            64     // longest number handed to strtod(..)
+#define EQSTREAM_DIGITS              10     // default significant digits
+#define EQSTREAM_FIELDLEN            32     // output bytes reserved per answer
+
+//===Format===============================================
+#define EQSTREAM_CSV                  0     // CSV input or output
+#define EQSTREAM_BIN                  1     // binary columns or rows
+
+//---Column-------------------------------------
+typedef struct tagEQSTREAMCOL {
+   char    szName[EQSTREAM_MAXNAME];        // variable name
+   BOOL    tfUsed;                          // referenced by an equation
+   int     iType;                           // EQBIND_ type (binary)
+   size_t  uSize;                           // bytes per value (binary)
+   const unsigned char *pucData;            // mapped file (binary)
+   size_t  uLen;                            // bytes mapped (binary)
+} EQSTREAMCOL;
+
+//---Run----------------------------------------
+// Shared by all threads; the fields from Lock on are only
+// touched with it held.
+typedef struct tagEQSTREAMRUN {
+   int          iInFmt, iOutFmt;            // EQSTREAM_CSV or EQSTREAM_BIN
+   char         cDelim;                     // CSV delimiter
+   int          iDigits;                    // significant digits of CSV answers
+   UINT         uFlags;                     // EQBATCH_ flags
+   EQSTREAMCOL *pCol;                       // columns
+   int          iNumCol;
+   CEquation   *pEq;                        // parsed equations, copied per thread
+   int          iNumEq;
+   const char  *pcCsv, *pcCsvEnd;           // CSV rows, after the header
+   long long    llRows;                     // rows of binary columns
+   FILE        *fpOut;                      // output
+
+   pthread_mutex_t Lock;                    // guards the following
+   pthread_cond_t  Cond;                    // signalled when a block is written
+   const char  *pcNext;                     // next CSV block starts here
+   long long    llNext;                     // next binary block starts at this row
+   int          iNumBlock;                  // blocks handed out
+   int          iNextWrite;                 // block to be written next
+   BOOL         tfFailed;                   // stop: memory or write failure
+   long long    llRowsDone;                 // rows written
+   long long    llNumErr;                   // answers that failed
+} EQSTREAMRUN;
+
+//---Thread-------------------------------------
+typedef struct tagEQSTREAMWORKER {
+   EQSTREAMRUN *pRun;                       // shared state
+   pthread_t    hThread;                    // thread
+   CEquation   *pEq;                        // own copies of the equations
+   double      *pdCol;                      // EQSTREAM_ROWS values per used CSV column, then NaN
+   const double **ppdVar;                   // CSV: column by variable index
+   EQBIND      *pBind;                      // binary: column by variable index
+   double      *pdAns;                      // EQSTREAM_ROWS answers per equation
+   char        *pcOut;                      // formatted block
+   size_t       uOut, uOutMax;              // bytes used and allocated
+} EQSTREAMWORKER;
+
+static double _dEqStreamNaN;                // NaN, for missing fields and unused columns
+
+/*********************************************************
+* _EqStreamNow
+* Monotonic time in seconds.
+*********************************************************/
+static double _EqStreamNow(void) {
+   struct timespec ts;                      // current time
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return((double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec);
+}
+
+/*********************************************************
+* _EqStreamMap
+* Maps a whole file for reading. Returns NULL on error or
+* for an empty file (*puLen = 0).
+*********************************************************/
+static const unsigned char *_EqStreamMap(const char *pszFile, size_t *puLen) {
+   struct stat st;                          // file size
+   void *pv;                                // mapping
+   int   fd;                                // file descriptor
+
+   *puLen = 0;
+   if((fd = open(pszFile, O_RDONLY)) < 0) return(NULL);
+   if((fstat(fd, &st) != 0) || (st.st_size <= 0)) { close(fd); return(NULL); }
+   pv = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   close(fd);                               // mapping stays valid
+   if(pv == MAP_FAILED) return(NULL);
+   madvise(pv, (size_t) st.st_size, MADV_SEQUENTIAL);
+   *puLen = (size_t) st.st_size;
+   return((const unsigned char*) pv);
+}
+
+/*********************************************************
+* _EqStreamNumber
+* Reads one CSV field as a number. Up to 19 significant
+* digits with a decimal exponent within +/-22 are exact in
+* double arithmetic, i.e. rounded just as strtod(..) does;
+* anything else (more digits, inf, nan, hex) is handed to
+* strtod(..). A field that is not a number is NaN.
+* Returns the character after the field: the delimiter,
+* the end of the line or pcEnd.
+*********************************************************/
+static const double _dEqStreamPow10[23] = {
+   1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+   1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+static const char *_EqStreamNumber(const char *pc, const char *pcEnd, char cDelim, double *pd) {
+   char szField[EQSTREAM_MAXFIELD];         // copy for strtod(..)
+   const char *pc0;                         // start of number
+   unsigned long long u = 0;                // significant digits
+   int  iDig = 0, iExp = 0, iExp10 = 0;     // digits kept, exponent of u, written exponent
+   int  iAny = 0;                           // digits seen
+   BOOL tfNeg = FALSE, tfExpNeg = FALSE;    // signs
+   BOOL tfLost = FALSE;                     // non-zero digit dropped
+   char *pcStop;                            // end of strtod(..)
+   int  k;                                  // copy counter
+
+   while((pc < pcEnd) && ((*pc == ' ') || (*pc == '\t' && cDelim != '\t') || (*pc == '"'))) pc++;
+   pc0 = pc;
+   if((pc < pcEnd) && ((*pc == '-') || (*pc == '+'))) tfNeg = (*pc++ == '-');
+   for(; (pc < pcEnd) && (*pc >= '0') && (*pc <= '9'); pc++, iAny++) {
+      if(iDig < 19) {
+         u = 10*u + (unsigned) (*pc - '0');
+         if(u) iDig++;
+      } else {
+         iExp++;
+         tfLost |= (*pc != '0');
+      }
+   }
+   if((pc < pcEnd) && (*pc == '.')) {
+      for(pc++; (pc < pcEnd) && (*pc >= '0') && (*pc <= '9'); pc++, iAny++) {
+         if(iDig < 19) {
+            u = 10*u + (unsigned) (*pc - '0');
+            if(u) iDig++;
+            iExp--;
+         } else {
+            tfLost |= (*pc != '0');
+         }
+      }
+   }
+   if(iAny && (pc < pcEnd) && ((*pc == 'e') || (*pc == 'E'))) {
+      pc++;
+      if((pc < pcEnd) && ((*pc == '-') || (*pc == '+'))) tfExpNeg = (*pc++ == '-');
+      for(; (pc < pcEnd) && (*pc >= '0') && (*pc <= '9'); pc++)
+         if(iExp10 < 100000) iExp10 = 10*iExp10 + (*pc - '0');
+      iExp += (tfExpNeg) ? -iExp10 : iExp10;
+   }
+   while((pc < pcEnd) && ((*pc == ' ') || (*pc == '\r') || (*pc == '"') || (*pc == '\t' && cDelim != '\t'))) pc++;
+
+   //---Fast path--------------------------------
+   if(iAny && !tfLost && (u <= (1ULL << 53)) && (iExp >= -22) && (iExp <= 22)
+      && ((pc == pcEnd) || (*pc == cDelim) || (*pc == '\n'))) {
+      *pd = (iExp < 0) ? (double) u / _dEqStreamPow10[-iExp] : (double) u * _dEqStreamPow10[iExp];
+      if(tfNeg) *pd = -*pd;
+      return(pc);
+   }
+
+   //---Anything else----------------------------
+   for(k=0; (pc0+k < pcEnd) && (pc0[k] != cDelim) && (pc0[k] != '\n') && (k < EQSTREAM_MAXFIELD-1); k++)
+      szField[k] = pc0[k];
+   while((k > 0) && ((szField[k-1] == ' ') || (szField[k-1] == '\r') || (szField[k-1] == '"') || (szField[k-1] == '\t'))) k--;
+   szField[k] = '\0';
+   *pd = strtod(szField, &pcStop);
+   if((k == 0) || (*pcStop != '\0')) *pd = _dEqStreamNaN;
+   while((pc < pcEnd) && (*pc != cDelim) && (*pc != '\n')) pc++;
+   return(pc);
+}
+
+/*********************************************************
+* _EqStreamParseRows
+* Reads up to EQSTREAM_ROWS lines of CSV from pc into the
+* columns of the worker, skipping blank lines and fields
+* of unused columns. Returns the start of the next line;
+* *pn returns the rows read.
+*********************************************************/
+static const char *_EqStreamParseRows(EQSTREAMWORKER *pW, const char *pc, const char *pcEnd, int *pn) {
+   const EQSTREAMRUN *pRun = pW->pRun;      // columns and delimiter
+   char   cDelim = pRun->cDelim;            // field separator
+   double *pdVal;                           // column of this field
+   int    iCol, r = 0;                      // field and row counters
+
+   while((pc < pcEnd) && (r < EQSTREAM_ROWS)) {
+      if((*pc == '\n') || (*pc == '\r')) { pc++; continue; } // blank line
+      for(iCol=0; ; iCol++) {
+         if((iCol < pRun->iNumCol) && pRun->pCol[iCol].tfUsed) {
+            pdVal = (double*) pW->ppdVar[iCol];
+            pc = _EqStreamNumber(pc, pcEnd, cDelim, &pdVal[r]);
+         } else {                           // skip field
+            while((pc < pcEnd) && (*pc != cDelim) && (*pc != '\n')) pc++;
+         }
+         if((pc >= pcEnd) || (*pc == '\n')) break;
+         pc++;                              // past delimiter
+      }
+      for(iCol++; iCol < pRun->iNumCol; iCol++) // short line
+         if(pRun->pCol[iCol].tfUsed) ((double*) pW->ppdVar[iCol])[r] = _dEqStreamNaN;
+      if((pc < pcEnd) && (*pc == '\n')) pc++;
+      r++;
+   }
+   *pn = r;
+   return(pc);
+}
+
+/*********************************************************
+* _EqStreamFormat
+* Appends the answers of n rows to the block output.
+*********************************************************/
+static BOOL _EqStreamFormat(EQSTREAMWORKER *pW, int n) {
+   const EQSTREAMRUN *pRun = pW->pRun;      // format
+   size_t uNeed;                            // bytes at most
+   char  *pc;                               // output position
+   int    r, e;                             // row and equation counters
+
+   uNeed = (pRun->iOutFmt == EQSTREAM_BIN) ? (size_t) n * pRun->iNumEq * sizeof(double)
+                                           : (size_t) n * pRun->iNumEq * EQSTREAM_FIELDLEN;
+   if(pW->uOut + uNeed > pW->uOutMax) {
+      size_t uMax = MAX(2*pW->uOutMax, pW->uOut + uNeed);
+      char  *pcNew = (char*) realloc(pW->pcOut, uMax);
+      if(pcNew == NULL) return(FALSE);
+      pW->pcOut = pcNew; pW->uOutMax = uMax;
+   }
+   pc = pW->pcOut + pW->uOut;
+   if(pRun->iOutFmt == EQSTREAM_BIN) {
+      for(r=0; r<n; r++)
+         for(e=0; e<pRun->iNumEq; e++) { memcpy(pc, &pW->pdAns[e*EQSTREAM_ROWS + r], sizeof(double)); pc += sizeof(double); }
+   } else {
+      for(r=0; r<n; r++) {
+         for(e=0; e<pRun->iNumEq; e++) {
+            pc += snprintf(pc, EQSTREAM_FIELDLEN-1, "%.*g", pRun->iDigits, pW->pdAns[e*EQSTREAM_ROWS + r]);
+            *pc++ = (e+1 < pRun->iNumEq) ? pRun->cDelim : '\n';
+         }
+      }
+   }
+   pW->uOut = pc - pW->pcOut;
+   return(TRUE);
+}
+
+/*********************************************************
+* _EqStreamEvaluate
+* Evaluates every equation over n rows, from the worker's
+* CSV columns or from binary row llRow0 on.
+* Returns the number of answers that failed.
+*********************************************************/
+static int _EqStreamEvaluate(EQSTREAMWORKER *pW, long long llRow0, int n) {
+   EQSTREAMRUN  *pRun = pW->pRun;           // equations and columns
+   EQBATCHSTATUS Status;                    // failed rows
+   int iNumErr = 0;                         // failed answers
+   int e, c;                                // equation and column counters
+
+   if(pRun->iInFmt == EQSTREAM_BIN) {
+      for(c=0; c<pRun->iNumCol; c++)
+         if(pRun->pCol[c].tfUsed) pW->pBind[c].pBase = pRun->pCol[c].pucData + llRow0 * pRun->pCol[c].uSize;
+   }
+   for(e=0; e<pRun->iNumEq; e++) {
+      memset(&Status, 0x00, sizeof(Status));
+      if(pRun->iInFmt == EQSTREAM_BIN)
+         pW->pEq[e].DoEquationBoundRows(pW->pBind, n, pW->pdAns + e*EQSTREAM_ROWS, &Status, pRun->uFlags);
+      else
+         pW->pEq[e].DoEquationBatchRows(pW->ppdVar, n, pW->pdAns + e*EQSTREAM_ROWS, &Status, pRun->uFlags);
+      iNumErr += Status.iNumErr;
+   }
+   return(iNumErr);
+}
+
+/*********************************************************
+* _EqStreamWorker
+* Thread: takes the next block, evaluates and formats it,
+* then waits for its turn to write it.
+*********************************************************/
+static void *_EqStreamWorker(void *pv) {
+   EQSTREAMWORKER *pW = (EQSTREAMWORKER*) pv; // this thread
+   EQSTREAMRUN    *pRun = pW->pRun;         // shared state
+   const char *pc, *pcEnd;                  // CSV block
+   long long   llRow, llEnd;                // binary block
+   long long   llRows;                      // rows in block
+   int         iBlock, iNumErr, n;          // block, failures, rows in batch
+   BOOL        tfOk;                        // block complete
+
+   for(;;) {
+      //===Take a block==================================
+      pthread_mutex_lock(&pRun->Lock);
+      if(pRun->tfFailed) { pthread_mutex_unlock(&pRun->Lock); break; }
+      pc = pcEnd = NULL; llRow = llEnd = 0;
+      if(pRun->iInFmt == EQSTREAM_BIN) {
+         llRow = pRun->llNext;
+         llEnd = MIN(llRow + EQSTREAM_BINBLOCK, pRun->llRows);
+         pRun->llNext = llEnd;
+         if(llRow >= llEnd) { pthread_mutex_unlock(&pRun->Lock); break; }
+      } else {
+         pc = pRun->pcNext;                 // end at a line end
+         if(pc >= pRun->pcCsvEnd) { pthread_mutex_unlock(&pRun->Lock); break; }
+         if(pRun->pcCsvEnd - pc <= EQSTREAM_CSVBLOCK) pcEnd = pRun->pcCsvEnd;
+         else {
+            pcEnd = (const char*) memchr(pc + EQSTREAM_CSVBLOCK, '\n', pRun->pcCsvEnd - pc - EQSTREAM_CSVBLOCK);
+            pcEnd = (pcEnd) ? pcEnd+1 : pRun->pcCsvEnd;
+         }
+         pRun->pcNext = pcEnd;
+      }
+      iBlock = pRun->iNumBlock++;
+      pthread_mutex_unlock(&pRun->Lock);
+
+      //===Evaluate======================================
+      pW->uOut = 0; llRows = 0; iNumErr = 0; tfOk = TRUE;
+      if(pRun->iInFmt == EQSTREAM_BIN) {
+         for(; tfOk && (llRow < llEnd); llRow += n, llRows += n) {
+            n = (int) MIN((long long) EQSTREAM_ROWS, llEnd - llRow);
+            iNumErr += _EqStreamEvaluate(pW, llRow, n);
+            tfOk = _EqStreamFormat(pW, n);
+         }
+      } else {
+         while(tfOk && (pc < pcEnd)) {
+            pc = _EqStreamParseRows(pW, pc, pcEnd, &n);
+            if(n == 0) continue;
+            iNumErr += _EqStreamEvaluate(pW, 0, n);
+            tfOk = _EqStreamFormat(pW, n);
+            llRows += n;
+         }
+      }
+
+      //===Write in order================================
+      pthread_mutex_lock(&pRun->Lock);
+      while((pRun->iNextWrite != iBlock) && !pRun->tfFailed) pthread_cond_wait(&pRun->Cond, &pRun->Lock);
+      if(!tfOk) pRun->tfFailed = TRUE;
+      if(!pRun->tfFailed) {
+         if((pW->uOut > 0) && (fwrite(pW->pcOut, 1, pW->uOut, pRun->fpOut) != pW->uOut)) pRun->tfFailed = TRUE;
+         pRun->llRowsDone += llRows;
+         pRun->llNumErr   += iNumErr;
+         pRun->iNextWrite++;
+      }
+      pthread_cond_broadcast(&pRun->Cond);
+      pthread_mutex_unlock(&pRun->Lock);
+   }
+   return(NULL);
+}
+
+/*********************************************************
+* _EqStreamWorkerInit / _EqStreamWorkerFree
+* Copies of the equations (sharing their programs) and
+* the buffers of one thread.
+*********************************************************/
+static BOOL _EqStreamWorkerInit(EQSTREAMWORKER *pW, EQSTREAMRUN *pRun) {
+   double *pdNaN;                           // column of NaN
+   int c, e, iUsed = 0;                     // counters
+
+   memset(pW, 0x00, sizeof(EQSTREAMWORKER));
+   pW->pRun = pRun;
+   pW->pEq  = new CEquation[pRun->iNumEq];
+   for(e=0; e<pRun->iNumEq; e++) pW->pEq[e] = pRun->pEq[e];
+   pW->pdAns  = (double*) malloc(pRun->iNumEq * EQSTREAM_ROWS * sizeof(double));
+   pW->ppdVar = (const double**) malloc(pRun->iNumCol * sizeof(double*));
+   pW->pBind  = (EQBIND*) malloc(pRun->iNumCol * sizeof(EQBIND));
+   if(pRun->iInFmt == EQSTREAM_CSV)
+      for(c=0; c<pRun->iNumCol; c++) iUsed += (pRun->pCol[c].tfUsed) ? 1 : 0;
+   pW->pdCol  = (double*) malloc((iUsed+1) * EQSTREAM_ROWS * sizeof(double));
+   if(!pW->pdAns || !pW->ppdVar || !pW->pBind || !pW->pdCol) return(FALSE);
+
+   //---Unused columns: NaN----------------------
+   // Read only when a failed row is evaluated again, which
+   // copies every variable of the row.
+   pdNaN = pW->pdCol + iUsed * EQSTREAM_ROWS;
+   for(c=0; c<EQSTREAM_ROWS; c++) pdNaN[c] = _dEqStreamNaN;
+   for(iUsed=0, c=0; c<pRun->iNumCol; c++) {
+      pW->ppdVar[c] = pdNaN;
+      pW->pBind[c].pBase   = pdNaN;
+      pW->pBind[c].uStride = 0;
+      pW->pBind[c].iType   = EQBIND_DOUBLE;
+      if(!pRun->pCol[c].tfUsed) continue;
+      if(pRun->iInFmt == EQSTREAM_CSV) pW->ppdVar[c] = pW->pdCol + (iUsed++) * EQSTREAM_ROWS;
+      pW->pBind[c].uStride = pRun->pCol[c].uSize;
+      pW->pBind[c].iType   = pRun->pCol[c].iType;
+   }
+   return(TRUE);
+}
+
+static void _EqStreamWorkerFree(EQSTREAMWORKER *pW) {
+   if(pW->pEq)    delete[] pW->pEq;
+   if(pW->pdAns)  free(pW->pdAns);
+   if(pW->ppdVar) free((void*) pW->ppdVar);
+   if(pW->pBind)  free(pW->pBind);
+   if(pW->pdCol)  free(pW->pdCol);
+   if(pW->pcOut)  free(pW->pcOut);
+   memset(pW, 0x00, sizeof(EQSTREAMWORKER));
+}
+
+/*********************************************************
+* _EqStreamHeader
+* Reads the column names from the first line of the CSV.
+* Returns the number of columns, or -1 if there are too
+* many; *ppcRows returns the start of the second line.
+*********************************************************/
+static int _EqStreamHeader(const char *pc, const char *pcEnd, char cDelim, EQSTREAMCOL *pCol, const char **ppcRows) {
+   const char *pcField;                     // start of name
+   int iNum = 0, k;                         // columns, name length
+
+   for(;;) {
+      while((pc < pcEnd) && ((*pc == ' ') || (*pc == '"') || (*pc == '\t' && cDelim != '\t'))) pc++;
+      for(pcField=pc; (pc < pcEnd) && (*pc != cDelim) && (*pc != '\n'); pc++) ;
+      for(k=(int) (pc - pcField); (k > 0) && ((pcField[k-1] == ' ') || (pcField[k-1] == '"') || (pcField[k-1] == '\r') || (pcField[k-1] == '\t')); k--) ;
+      if(iNum >= EQSTREAM_MAXCOL) return(-1);
+      memset(&pCol[iNum], 0x00, sizeof(EQSTREAMCOL));
+      k = MIN(k, EQSTREAM_MAXNAME-1);
+      memcpy(pCol[iNum].szName, pcField, k);
+      pCol[iNum].szName[k] = '\0';
+      pCol[iNum].iType = EQBIND_DOUBLE;
+      pCol[iNum].uSize = sizeof(double);
+      iNum++;
+      if((pc >= pcEnd) || (*pc == '\n')) break;
+      pc++;
+   }
+   *ppcRows = (pc < pcEnd) ? pc+1 : pcEnd;
+   return(iNum);
+}
+
+/*********************************************************
+* _EqStreamBinary
+* Maps one column file; its name and type come from the
+* file name, e.g. "data/T.f32" is column T of floats.
+*********************************************************/
+static BOOL _EqStreamBinary(const char *pszFile, EQSTREAMCOL *pCol) {
+   const char *pszBase, *pszExt;            // file name and extension
+   int k;                                   // name length
+
+   memset(pCol, 0x00, sizeof(EQSTREAMCOL));
+   pszBase = strrchr(pszFile, '/');
+   pszBase = (pszBase) ? pszBase+1 : pszFile;
+   pszExt  = strrchr(pszBase, '.');
+   if(pszExt == NULL) return(FALSE);
+   if(strcmp(pszExt, ".f64") == 0)      { pCol->iType = EQBIND_DOUBLE; pCol->uSize = sizeof(double); }
+   else if(strcmp(pszExt, ".f32") == 0) { pCol->iType = EQBIND_FLOAT;  pCol->uSize = sizeof(float); }
+   else if(strcmp(pszExt, ".i32") == 0) { pCol->iType = EQBIND_INT32;  pCol->uSize = sizeof(int); }
+   else return(FALSE);
+   k = MIN((int) (pszExt - pszBase), EQSTREAM_MAXNAME-1);
+   memcpy(pCol->szName, pszBase, k);
+   pCol->szName[k] = '\0';
+   pCol->pucData = _EqStreamMap(pszFile, &pCol->uLen);
+   return((pCol->pucData != NULL) && (pCol->uLen % pCol->uSize == 0));
+}
+
+/*********************************************************
+* _EqStreamSplit
+* Separates "name = equation" into its parts. Without a
+* name, or for "a == b", the equation names itself.
+*********************************************************/
+static const char *_EqStreamSplit(const char *pszArg, char *pszName) {
+   const char *pc = pszArg;                 // scan
+   int k;                                   // name length
+
+   while(*pc == ' ') pc++;
+   if(isalpha((unsigned char) *pc) || (*pc == '_')) {
+      while(isalnum((unsigned char) *pc) || (*pc == '_')) pc++;
+      k = (int) (pc - pszArg);
+      while(*pc == ' ') pc++;
+      if((pc[0] == '=') && (pc[1] != '=')) {
+         for(; (k > 0) && (*pszArg == ' '); pszArg++, k--) ;
+         k = MIN(k, EQSTREAM_MAXNAME-1);
+         memcpy(pszName, pszArg, k); pszName[k] = '\0';
+         return(pc+1);
+      }
+   }
+   strncpy(pszName, pszArg, EQSTREAM_MAXNAME-1);
+   pszName[EQSTREAM_MAXNAME-1] = '\0';
+   return(pszArg);
+}
+
+int main(int argc, char *argv[]) {
+   static EQSTREAMCOL Col[EQSTREAM_MAXCOL]; // columns
+   static EQSTREAMWORKER Worker[EQSTREAM_MAXTHREAD]; // threads
+   const char  *pszEqn[EQSTREAM_MAXEQ];     // equation arguments
+   char         szName[EQSTREAM_MAXEQ][EQSTREAM_MAXNAME]; // output column names
+   const char  *pszIn[EQSTREAM_MAXCOL];     // input files
+   const char  *pszOut = NULL;              // output file, NULL for stdout
+   const unsigned char *pucCsv = NULL;      // mapped CSV file
+   size_t       uCsv = 0;                   // bytes of CSV file
+   char        *pszVars, *pcVar;            // double-NULL terminated variable list
+   char         szErr[256];                 // parse error message
+   EQSTREAMRUN  Run;                        // shared state
+   CEquation   *pEq;                        // parsed equations
+   double       dStart, dSecs, dBytes;      // timing
+   BOOL         tfQuiet = FALSE;            // no report
+   int          iNumEq = 0, iNumIn = 0;     // arguments
+   int          iNumThread;                 // threads
+   int          k, c, e;                    // counters
+   union { unsigned short u; unsigned char uc[2]; } Endian = { 1 };
+
+   memset(&Run, 0x00, sizeof(Run));
+   Run.cDelim  = ',';
+   Run.iDigits = EQSTREAM_DIGITS;
+   iNumThread  = (int) sysconf(_SC_NPROCESSORS_ONLN);
+   _dEqStreamNaN = strtod("nan", NULL);
+
+   //===Options===========================================
+   for(k=1; k<argc; k++) {
+      if((strcmp(argv[k], "-e") == 0) && (k+1 < argc) && (iNumEq < EQSTREAM_MAXEQ)) pszEqn[iNumEq++] = argv[++k];
+      else if((strcmp(argv[k], "-o") == 0) && (k+1 < argc)) pszOut = argv[++k];
+      else if((strcmp(argv[k], "-f") == 0) && (k+1 < argc)) Run.iOutFmt = (strcmp(argv[++k], "bin") == 0) ? EQSTREAM_BIN : EQSTREAM_CSV;
+      else if(strcmp(argv[k], "-b") == 0) Run.iInFmt = EQSTREAM_BIN;
+      else if((strcmp(argv[k], "-d") == 0) && (k+1 < argc)) { k++; Run.cDelim = (strcmp(argv[k], "tab") == 0) ? '\t' : argv[k][0]; }
+      else if((strcmp(argv[k], "-p") == 0) && (k+1 < argc)) { Run.iDigits = atoi(argv[++k]); Run.iDigits = MAX(1, MIN(17, Run.iDigits)); }
+      else if((strcmp(argv[k], "-j") == 0) && (k+1 < argc)) iNumThread = atoi(argv[++k]);
+      else if(strcmp(argv[k], "-u") == 0) Run.uFlags = EQBATCH_UNCHECKED | EQBATCH_FASTMATH_HIGH;
+      else if(strcmp(argv[k], "-q") == 0) tfQuiet = TRUE;
+      else if((argv[k][0] != '-') && (iNumIn < EQSTREAM_MAXCOL)) pszIn[iNumIn++] = argv[k];
+      else iNumEq = 0;                      // usage
+   }
+   if((iNumEq == 0) || (iNumIn == 0) || ((Run.iInFmt == EQSTREAM_CSV) && (iNumIn != 1))) {
+      fprintf(stderr, "usage: %s -e [name =] eqn [-e ..] [-o out] [-f csv|bin] [-d delim] [-p digits] [-j threads] [-u] [-q] file.csv\n"
+                      "       %s -b -e [name =] eqn [-e ..] [options] col.f64|col.f32|col.i32 ..\n", argv[0], argv[0]);
+      return(1);
+   }
+   iNumThread = MAX(1, MIN(EQSTREAM_MAXTHREAD, iNumThread));
+
+   //===Columns===========================================
+   if(Run.iInFmt == EQSTREAM_BIN) {
+      if(Endian.uc[0] != 1) { fprintf(stderr, "-b needs a little-endian host\n"); return(1); }
+      for(c=0; c<iNumIn; c++) {
+         if(!_EqStreamBinary(pszIn[c], &Col[c])) { fprintf(stderr, "cannot map %s as a .f64, .f32 or .i32 column\n", pszIn[c]); return(1); }
+         if((c > 0) && (Col[c].uLen / Col[c].uSize != (size_t) Run.llRows)) { fprintf(stderr, "%s: rows differ from %s\n", pszIn[c], pszIn[0]); return(1); }
+         Run.llRows = (long long) (Col[c].uLen / Col[c].uSize);
+      }
+      Run.iNumCol = iNumIn;
+   } else {
+      if((pucCsv = _EqStreamMap(pszIn[0], &uCsv)) == NULL) { fprintf(stderr, "cannot map %s\n", pszIn[0]); return(1); }
+      Run.iNumCol = _EqStreamHeader((const char*) pucCsv, (const char*) pucCsv + uCsv, Run.cDelim, Col, &Run.pcCsv);
+      if(Run.iNumCol < 0) { fprintf(stderr, "%s: more than %d columns\n", pszIn[0], EQSTREAM_MAXCOL); return(1); }
+      Run.pcCsvEnd = (const char*) pucCsv + uCsv;
+   }
+   Run.pCol = Col;
+
+   //===Equations=========================================
+   pszVars = (char*) malloc(Run.iNumCol * EQSTREAM_MAXNAME + 1);
+   if(pszVars == NULL) return(1);
+   for(pcVar=pszVars, c=0; c<Run.iNumCol; c++) { strcpy(pcVar, Col[c].szName); pcVar += strlen(pcVar) + 1; }
+   *pcVar = '\0';
+   pEq = new CEquation[iNumEq];
+   for(e=0; e<iNumEq; e++) {
+      if(pEq[e].ParseEquation(_EqStreamSplit(pszEqn[e], szName[e]), pszVars) != EQERR_NONE) {
+         pEq[e].LastErrorMessage(szErr, sizeof(szErr), pszEqn[e]);
+         fprintf(stderr, "%s\n", szErr);
+         return(1);
+      }
+      for(c=0; c<Run.iNumCol; c++)
+         if(pEq[e].ContainsVariable(c) != EQERR_NONE) Col[c].tfUsed = TRUE;
+   }
+   Run.pEq = pEq; Run.iNumEq = iNumEq;
+
+   //===Output============================================
+   Run.fpOut = (pszOut) ? fopen(pszOut, "wb") : stdout;
+   if(Run.fpOut == NULL) { fprintf(stderr, "cannot write %s\n", pszOut); return(1); }
+   if(Run.iOutFmt == EQSTREAM_CSV)
+      for(e=0; e<iNumEq; e++) fprintf(Run.fpOut, (strchr(szName[e], Run.cDelim) || strchr(szName[e], '"')) ? "\"%s\"%c" : "%s%c",
+         szName[e], (e+1 < iNumEq) ? Run.cDelim : '\n');
+
+   //===Threads===========================================
+   dStart = _EqStreamNow();
+   pthread_mutex_init(&Run.Lock, NULL);
+   pthread_cond_init(&Run.Cond, NULL);
+   Run.pcNext = Run.pcCsv;
+   for(k=0; k<iNumThread; k++) {
+      if(!_EqStreamWorkerInit(&Worker[k], &Run)) { fprintf(stderr, "out of memory\n"); return(1); }
+      if(pthread_create(&Worker[k].hThread, NULL, _EqStreamWorker, &Worker[k]) != 0) {
+         _EqStreamWorkerFree(&Worker[k]);
+         if(k == 0) { fprintf(stderr, "cannot start threads\n"); return(1); }
+         iNumThread = k;
+      }
+   }
+   for(k=0; k<iNumThread; k++) {
+      pthread_join(Worker[k].hThread, NULL);
+      _EqStreamWorkerFree(&Worker[k]);
+   }
+   if(fflush(Run.fpOut) != 0) Run.tfFailed = TRUE;
+   dSecs = _EqStreamNow() - dStart;
+   pthread_cond_destroy(&Run.Cond);
+   pthread_mutex_destroy(&Run.Lock);
+
+   //===Report============================================
+   if(Run.iInFmt == EQSTREAM_BIN) {
+      for(dBytes=0.00, c=0; c<Run.iNumCol; c++) if(Col[c].tfUsed) dBytes += (double) Col[c].uLen;
+   } else dBytes = (double) uCsv;
+   if(!tfQuiet)
+      fprintf(stderr, "%lld rows, %d equations, %d threads: %.3f s, %.4g rows/s, %.1f MB/s, %lld answers failed%s\n",
+         Run.llRowsDone, iNumEq, iNumThread, dSecs, (dSecs > 0.00) ? (double) Run.llRowsDone / dSecs : 0.00,
+         (dSecs > 0.00) ? dBytes / dSecs / 1e6 : 0.00, Run.llNumErr, (Run.tfFailed) ? " - incomplete: write error or out of memory" : "");
+
+   if(pszOut) fclose(Run.fpOut);
+   for(c=0; c<Run.iNumCol; c++) if(Col[c].pucData) munmap((void*) Col[c].pucData, Col[c].uLen);
+   if(pucCsv) munmap((void*) pucCsv, uCsv);
+   delete[] pEq;
+   free(pszVars);
+   return((Run.tfFailed) ? 1 : 0);
+}
@@ -0,0 +1,272 @@
+/*****************************************************************************
+*  CLCEqTest.cpp                                        CSIVM LaserCanvas
+*  Regression checks of the CEquation input paths
+* $PSchlup 2004-2006 $     $Revision 7 $
+*****************************************************************************/
+
+/*****************************************************************************
+* Stand-alone program, linked with the CEquation sources:
+*
+*    c++ -O2 -o ceqtest test/CLCEqTest.cpp CLCEqtn.cpp CLCEqBatch.cpp \
+*        CLCEqFast.cpp CLCEqNative.cpp CLCEqProfile.cpp CLCEqArray.cpp \
+*        CLCEqTable.cpp CLCEqFunc.cpp CLCEqLib.cpp -lpthread -ldl
+*    ./ceqtest
+*
+* Checks the places where names, files and numbers from outside the program
+* enter CEquation, each of which once accepted input it should not have:
+*  functions  DefineFunction(..), and names it must refuse (e.g. "h", which
+*             is Planck's constant)
+*  tables     AddTable(..) names that would hide a built-in, constant, unit
+*             or user function, and functions that would hide a table
+*  library    CEquationLibrary::Open(..) on files whose programs were altered
+*             after Write(..): callbacks, references, units, op codes, stack
+*  float      DoEquation(..) and DoEquationBatch(..) in float, on answers
+*             beyond FLT_MAX
+*  load       LoadEquation(..) on truncated, corrupted and mismatched records
+*
+* Each failed check is named on stderr with its line. The exit status is 0
+* when all checks pass and 1 otherwise.
+******************************************************************************/
+#include "../CLCEqtn.h"                     // CEquation class
+#include "../CLCEqLib.h"                    // CEquationLibrary class
+#include <stdlib.h>                         // malloc, free
+
+#define EQTEST_LIBFILE    "ceqtest.eql"     // library file written and removed
+#define EQTEST_OPSIZE               13     // bytes per saved VALOP (EQFILE_OPSIZE)
+
+//---Check--------------------------------------
+static int s_iNumCheck = 0;                 // checks made
+static int s_iNumFail  = 0;                 // checks failed
+
+#define EQTEST_CHECK(c)  _EqTestCheck((c) ? TRUE : FALSE, __LINE__, #c)
+
+static void _EqTestCheck(BOOL tfOk, int iLine, const char *pszWhat) {
+   s_iNumCheck++;
+   if(tfOk) return;
+   fprintf(stderr, "CLCEqTest.cpp:%d: failed: %s\n", iLine, pszWhat);
+   s_iNumFail++;
+}
+
+//---Evaluate-----------------------------------
+// Parses and evaluates in double; returns the error code
+// of whichever step failed.
+static int _EqTestEval(const char *pszEqn, const char *pszVars, double *pdVar, double *pdAns) {
+   CEquation Eq;                            // equation under test
+   int       iErr;                          // return code
+
+   iErr = Eq.ParseEquation(pszEqn, pszVars);
+   if(iErr != EQERR_NONE) return(iErr);
+   return(Eq.DoEquation(pdVar, pdAns));
+}
+
+/*********************************************************
+* _EqTestFunctions
+* User functions are inlined; names of built-in functions
+* and constants are refused.
+*********************************************************/
+static void _EqTestFunctions(void) {
+   const char *pszBad[] = { "h(x) = x", "pi(x) = x", "c(x) = x", "sin(x) = x", "max(a, b) = a", "hbar(x) = x" };
+   double      dVar[2] = { 3.00, 4.00 };    // x, y
+   double      dAns;                        // answer
+   int         k;                           // loop counter
+
+   EQTEST_CHECK(CEquation::DefineFunction("sq(a) = a*a") == EQERR_NONE);
+   EQTEST_CHECK(CEquation::DefineFunction("hyp(a, b) = sqrt(sq(a) + sq(b))") == EQERR_NONE);
+   EQTEST_CHECK(_EqTestEval("hyp(x, y)", "x\0y\0", dVar, &dAns) == EQERR_NONE);
+   EQTEST_CHECK(dAns == 5.00);
+   EQTEST_CHECK(_EqTestEval("hyp(x)", "x\0y\0", dVar, &dAns) == EQERR_PARSE_NARGBADCOUNT);
+   for(k=0; k<(int) (sizeof(pszBad)/sizeof(pszBad[0])); k++)
+      EQTEST_CHECK(CEquation::DefineFunction(pszBad[k]) == EQERR_PARSE_FUNCDEF);
+   EQTEST_CHECK(_EqTestEval("h / h", NULL, NULL, &dAns) == EQERR_NONE); // still Planck's constant
+   EQTEST_CHECK(dAns == 1.00);
+   CEquation::FreeFunctions();
+   EQTEST_CHECK(_EqTestEval("sq(2)", NULL, NULL, &dAns) == EQERR_PARSE_UNKNOWNFUNCVAR);
+}
+
+/*********************************************************
+* _EqTestTables
+* Table names must not hide anything interp1(..) could
+* otherwise mean, nor be hidden by a later function.
+*********************************************************/
+static void _EqTestTables(void) {
+   const char *pszBad[] = { "h", "pi", "sqrt", "max", "mm", "km", "degC", "sq" };
+   double      dX[3] = { 0.00,  1.00,  2.00 }; // table
+   double      dY[3] = { 0.00, 10.00, 20.00 };
+   double      dAns;                        // answer
+   int         k;                           // loop counter
+
+   EQTEST_CHECK(CEquation::DefineFunction("sq(a) = a*a") == EQERR_NONE);
+   for(k=0; k<(int) (sizeof(pszBad)/sizeof(pszBad[0])); k++)
+      EQTEST_CHECK(CEquation::AddTable(pszBad[k], dX, dY, 3) == EQERR_PARSE_FUNCDEF);
+   EQTEST_CHECK(CEquation::AddTable("tbl", dX, dY, 3) == EQERR_NONE);
+   EQTEST_CHECK(CEquation::DefineFunction("tbl(a) = a") == EQERR_PARSE_FUNCDEF);
+   EQTEST_CHECK(_EqTestEval("sqrt(4) + interp1(tbl, 1.5)", NULL, NULL, &dAns) == EQERR_NONE);
+   EQTEST_CHECK(dAns == 17.00);
+   CEquation::FreeTables();
+   CEquation::FreeFunctions();
+}
+
+/*********************************************************
+* _EqTestLibrary
+* Writes a library, changes one token of the first pro-
+* gram, and opens it again: Open(..) must refuse every
+* change that evaluation could not survive.
+*********************************************************/
+static BOOL _EqTestPatchLib(const char *pszFile, int iTok, unsigned int uTyp, long long llVal) {
+   EQLIBHEADER Head;                        // file header
+   EQLIBENTRY  Ent;                         // first entry
+   VALOP       vo;                          // token to change
+   FILE       *fp;                          // library file
+   BOOL        tfOk;                        // all read and written
+
+   if((fp = fopen(pszFile, "r+b")) == NULL) return(FALSE);
+   tfOk = (fread(&Head, sizeof(Head), 1, fp) == 1);
+   tfOk = tfOk && (fseek(fp, (long) Head.uEntryOffs, SEEK_SET) == 0);
+   tfOk = tfOk && (fread(&Ent, sizeof(Ent), 1, fp) == 1);
+   tfOk = tfOk && (fseek(fp, (long) (Ent.uOpsOffs + iTok*sizeof(VALOP)), SEEK_SET) == 0);
+   tfOk = tfOk && (fread(&vo, sizeof(vo), 1, fp) == 1);
+   if(tfOk) {
+      vo.uTyp = uTyp;
+      memcpy(&vo.dVal, &llVal, sizeof(llVal)); // iOp, iRef, pCall alike
+   }
+   tfOk = tfOk && (fseek(fp, (long) (Ent.uOpsOffs + iTok*sizeof(VALOP)), SEEK_SET) == 0);
+   tfOk = tfOk && (fwrite(&vo, sizeof(vo), 1, fp) == 1);
+   fclose(fp);
+   return(tfOk);
+}
+
+static void _EqTestLibrary(void) {
+   struct {
+      int          iTok;                    // token of "x y sin mm +" to change
+      unsigned int uTyp;                    // new type
+      long long    llVal;                   // new operand
+      int          iErr;                    // Open(..) must return
+   } Patch[] = {
+      { 1, VOTYP_CALL, 0x1234,                         EQERR_FILE_CALLBACK  }, // pointer into this process
+      { 0, VOTYP_REF,  7,                              EQERR_FILE_BADFORMAT }, // variable beyond the list
+      { 4, VOTYP_UNIT, 9999,                           EQERR_FILE_BADFORMAT }, // unit beyond the table
+      { 2, VOTYP_OP,   OP_UNARY+NUM_UNARYOP,           EQERR_FILE_BADFORMAT }, // unknown op code
+      { 2, VOTYP_OP,   OP_NARG+OP_NARG_FUNCTION,       EQERR_FILE_BADFORMAT }, // placeholder of parser
+      { 3, VOTYP_OP,   OP_ADD,                         EQERR_FILE_BADFORMAT }, // stack underflow
+      { 0, 99,         0,                              EQERR_FILE_BADFORMAT }, // unknown token type
+   };
+   CEquation         Eq1, Eq2;              // programs written
+   CEquation        *pEq[2] = { &Eq1, &Eq2 };
+   const char       *pszName[2] = { "a", "b" };
+   CEquationLibrary  Lib;                   // library read
+   double            dVar[2] = { 1.00, 0.00 }; // x, y
+   double            dAns;                  // answer
+   int               k;                     // loop counter
+
+   EQTEST_CHECK(Eq1.ParseEquation("x + sin(y) mm", "x\0y\0") == EQERR_NONE);
+   EQTEST_CHECK(Eq2.ParseEquation("2*x", "x\0") == EQERR_NONE);
+   EQTEST_CHECK(CEquationLibrary::Write(EQTEST_LIBFILE, 2, pEq, pszName) == EQERR_NONE);
+   EQTEST_CHECK(Lib.Open(EQTEST_LIBFILE, TRUE) == EQERR_NONE);
+   {                                        // attached equation goes before the file
+      CEquation EqLib;
+      EQTEST_CHECK(Lib.Attach(Lib.Find("b"), &EqLib) == EQERR_NONE);
+      EQTEST_CHECK(EqLib.DoEquation(dVar, &dAns) == EQERR_NONE);
+      EQTEST_CHECK(dAns == 2.00);
+   }
+   Lib.Close();
+
+   for(k=0; k<(int) (sizeof(Patch)/sizeof(Patch[0])); k++) {
+      EQTEST_CHECK(CEquationLibrary::Write(EQTEST_LIBFILE, 1, pEq, pszName) == EQERR_NONE);
+      EQTEST_CHECK(_EqTestPatchLib(EQTEST_LIBFILE, Patch[k].iTok, Patch[k].uTyp, Patch[k].llVal));
+      EQTEST_CHECK(Lib.Open(EQTEST_LIBFILE) == Patch[k].iErr);
+      Lib.Close();
+   }
+   remove(EQTEST_LIBFILE);
+}
+
+/*********************************************************
+* _EqTestFloat
+* Answers that are finite in double but beyond FLT_MAX
+* are EQERR_MATH_OVERFLOW in float, not inf.
+*********************************************************/
+static void _EqTestFloat(void) {
+   CEquation    Eq;                         // equation under test
+   float        fVar[2] = { 1.00f, 1e-30f }; // one variable, two rows
+   float        fAns[2];                    // answers
+   const float *pfCol[1] = { fVar };        // batch columns
+   int          iRow;                       // failed row
+
+   EQTEST_CHECK(Eq.ParseEquation("exp(x*100)", "x\0") == EQERR_NONE);
+   EQTEST_CHECK(Eq.DoEquation(fVar, fAns) == EQERR_MATH_OVERFLOW);
+   EQTEST_CHECK(Eq.ParseEquation("exp(x*88)", "x\0") == EQERR_NONE);
+   EQTEST_CHECK(Eq.DoEquation(fVar, fAns) == EQERR_NONE);
+
+   EQTEST_CHECK(Eq.ParseEquation("x*1e30*1e30", "x\0") == EQERR_NONE);
+   EQTEST_CHECK(Eq.DoEquation(fVar, fAns) == EQERR_MATH_OVERFLOW);
+   EQTEST_CHECK(Eq.DoEquation(fVar+1, fAns) == EQERR_NONE);
+   iRow = -1;
+   EQTEST_CHECK(Eq.DoEquationBatch(pfCol, 2, fAns, &iRow) == EQERR_MATH_OVERFLOW);
+   EQTEST_CHECK(iRow == 0);
+   fVar[0] = 1e-30f;
+   EQTEST_CHECK(Eq.DoEquationBatch(pfCol, 2, fAns) == EQERR_NONE);
+}
+
+/*********************************************************
+* _EqTestLoad
+* A saved record cut short at any length, with a bad op
+* code under a correct checksum, or loaded with fewer
+* variables than it refers to, is refused.
+*********************************************************/
+static void _EqTestLoad(void) {
+   CEquation      Eq, EqLoad;               // saved, loaded
+   unsigned char *pBuf;                     // saved record
+   size_t         len, k;                   // record length, cut
+   unsigned int   uSum;                     // checksum after patch
+   double         dVar[2] = { 2.00, 0.00 }; // x, y
+   double         dAns;                     // answer
+   FILE          *fp;                       // record file
+
+   EQTEST_CHECK(Eq.ParseEquation("(x + sin(y)) mm # cm", "x\0y\0") == EQERR_NONE);
+   EQTEST_CHECK(Eq.SaveEquation(NULL, &len) == EQERR_NONE);
+   if((pBuf = (unsigned char*) malloc(len)) == NULL) return;
+   EQTEST_CHECK(Eq.SaveEquation(pBuf, &len) == EQERR_NONE);
+   EQTEST_CHECK(EqLoad.LoadEquation(pBuf, len, "x\0y\0") == EQERR_NONE);
+   EQTEST_CHECK(EqLoad.DoEquation(dVar, &dAns) == EQERR_NONE);
+   EQTEST_CHECK(fabs(dAns - 0.20) < 1e-15);
+
+   //---Truncated-------------------------------
+   for(k=0; k<len; k++)
+      EQTEST_CHECK(EqLoad.LoadEquation(pBuf, k, "x\0y\0") != EQERR_NONE);
+
+   //---Mismatched variables--------------------
+   EQTEST_CHECK(EqLoad.LoadEquation(pBuf, len, "x\0") == EQERR_FILE_BADFORMAT);
+   EQTEST_CHECK(EqLoad.LoadEquation(pBuf, len, NULL) == EQERR_FILE_BADFORMAT);
+
+   //---Corrupt, checksum intact----------------
+   pBuf[len - EQTEST_OPSIZE] = 99;          // type of last token
+   uSum = EqHashFnv1a(pBuf, 12);
+   uSum = EqHashFnv1a(pBuf+16, len-16, uSum);
+   pBuf[12] = (unsigned char) (uSum      );
+   pBuf[13] = (unsigned char) (uSum >>  8);
+   pBuf[14] = (unsigned char) (uSum >> 16);
+   pBuf[15] = (unsigned char) (uSum >> 24);
+   EQTEST_CHECK(EqLoad.LoadEquation(pBuf, len, "x\0y\0") == EQERR_FILE_BADFORMAT);
+
+   //---Length beyond EQFILE_MAXRECORD----------
+   pBuf[11] = 0x7F;                         // record length field
+   if((fp = tmpfile()) != NULL) {
+      fwrite(pBuf, 1, len, fp);
+      rewind(fp);
+      EQTEST_CHECK(EqLoad.LoadEquationFile(fp, "x\0y\0") != EQERR_NONE);
+      fclose(fp);
+   }
+   free(pBuf);
+}
+
+/*********************************************************
+* main
+*********************************************************/
+int main(void) {
+   _EqTestFunctions();
+   _EqTestTables();
+   _EqTestLibrary();
+   _EqTestFloat();
+   _EqTestLoad();
+   printf("%d checks, %d failures\n", s_iNumCheck, s_iNumFail);
+   return((s_iNumFail > 0) ? 1 : 0);
+}